@@ -34,7 +34,6 @@
 #import <SignalServiceKit/OWSMath.h>
 #import <SignalServiceKit/OWSMessageManager.h>
 #import <SignalServiceKit/OWSMessageSender.h>
-#import <SignalServiceKit/OWSReadReceiptManager.h>
 #import <SignalServiceKit/SSKEnvironment.h>
 #import <SignalServiceKit/SignalServiceKit-Swift.h>
 #import <SignalServiceKit/StickerInfo.h>
@@ -91,11 +90,6 @@ NSString *NSStringForLaunchFailure(LaunchFailure launchFailure)
     return [OWSProfileManager sharedManager];
 }
 
-- (OWSReadReceiptManager *)readReceiptManager
-{
-    return [OWSReadReceiptManager sharedManager];
-}
-
 - (id<OWSUDManager>)udManager
 {
     OWSAssertDebug(SSKEnvironment.shared.udManager);
@@ -1265,7 +1259,6 @@ NSString *NSStringForLaunchFailure(LaunchFailure launchFailure)
 #endif
 
     [self.profileManager fetchAndUpdateLocalUsersProfile];
-    [self.readReceiptManager prepareCachedValues];
 
     [SignalApp.sharedApp ensureRootViewController:launchStartedAt];
 
@@ -115,7 +115,7 @@ extension ConversationSearchController: UISearchResultsUpdating {
         lastSearchText = searchText
 
         var resultSet: ConversationScreenSearchResultSet?
-        databaseStorage.asyncRead(block: { [weak self] transaction in
+        databaseStorage.asyncRead(priority: .background, block: { [weak self] transaction in
             guard let self = self else {
                 return
             }
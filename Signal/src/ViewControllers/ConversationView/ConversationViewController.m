@@ -2749,7 +2749,7 @@ typedef enum : NSUInteger {
         }
         failure:^(NSError *error) {
             OWSLogWarn(@"Failed to redownload thumbnail with error: %@", error);
-            [self.databaseStorage writeWithBlock:^(SDSAnyWriteTransaction *transaction) {
+            [self.databaseStorage asyncCoalescedWriteWithBlock:^(SDSAnyWriteTransaction *transaction) {
                 [self.databaseStorage touchInteraction:message transaction:transaction];
             }];
         }];
@@ -698,19 +698,6 @@ NSString *NSStringForViewOnceMessageState(ViewOnceMessageState cellType)
     return cache;
 }
 
-- (DisplayableText *)displayableBodyTextForText:(NSString *)text interactionId:(NSString *)interactionId
-{
-    OWSAssertDebug(text);
-    OWSAssertDebug(interactionId.length > 0);
-
-    NSString *displayableTextCacheKey = [@"body-" stringByAppendingString:interactionId];
-
-    return [self displayableTextForCacheKey:displayableTextCacheKey
-                                  textBlock:^{
-                                      return text;
-                                  }];
-}
-
 - (DisplayableText *)displayableBodyTextForOversizeTextAttachment:(TSAttachmentStream *)attachmentStream
                                                     interactionId:(NSString *)interactionId
 {
@@ -864,9 +851,16 @@ NSString *NSStringForViewOnceMessageState(ViewOnceMessageState cellType)
         self.attachmentPointer = (TSAttachmentPointer *)oversizeTextAttachmentPointer;
         return;
     } else {
-        NSString *_Nullable bodyText = [message bodyTextWithTransaction:transaction];
-        if (bodyText) {
-            self.displayableBodyText = [self displayableBodyTextForText:bodyText interactionId:message.uniqueId];
+        if (message.body.length > 0) {
+            MessageBodyAnalysis *_Nullable bodyAnalysis =
+                [MessageBodyAnalysis fetchAnalysisForMessageId:message.uniqueId transaction:transaction];
+            if (!bodyAnalysis) {
+                // Messages saved before we analyzed bodies on insert, or by the
+                // YDB-to-GRDB migration, have no analysis until they're displayed.
+                bodyAnalysis = [MessageBodyAnalysis analyzeBody:message.body];
+                [bodyAnalysis backfillForMessageId:message.uniqueId];
+            }
+            self.displayableBodyText = [DisplayableText displayableTextWithBody:message.body analysis:bodyAnalysis];
         }
     }
 
@@ -448,32 +448,14 @@ NS_ASSUME_NONNULL_BEGIN
 - (void)conversationViewDatabaseSnapshotDidUpdateWithTransactionChanges:
     (ConversationViewDatabaseTransactionChanges *)transactionChanges
 {
-    if (self.thread.grdbId != nil) {
-        if (![transactionChanges containsThreadRowId:self.thread.grdbId]) {
-            // Ignoring irrelevant update.
-            return;
-        }
-    } else {
-        OWSFailDebug(@"Missing thread.grdbId.");
-    }
-    
-    __block NSError *dbError;
-    __block NSError *updateError;
-    __block NSSet<NSString *> *updatedInteractionIds;
-    [self.databaseStorage.grdbStorage uiReadAndReturnError:&dbError
-                                                     block:^(GRDBReadTransaction *transaction) {
-                                                         updatedInteractionIds = [transactionChanges
-                                                             updatedInteractionIdsForThreadId:self.thread.uniqueId
-                                                                                  transaction:transaction
-                                                                                        error:&updateError];
-                                                     }];
-
-    if (dbError || updateError || !updatedInteractionIds) {
-        OWSFailDebug(@"failure: %@, %@", dbError, updateError);
-        [self resetMappingWithSneakyTransaction];
+    if (![transactionChanges containsThreadId:self.thread.uniqueId]) {
+        // Ignoring irrelevant update.
         return;
     }
 
+    NSSet<NSString *> *updatedInteractionIds =
+        [transactionChanges updatedInteractionIdsForThreadId:self.thread.uniqueId];
+
     [self anyDBDidUpdateWithUpdatedInteractionIds:updatedInteractionIds];
 }
 
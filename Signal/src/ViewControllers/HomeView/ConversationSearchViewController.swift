@@ -402,7 +402,7 @@ class ConversationSearchViewController: UITableViewController, BlockListCacheDel
         lastSearchText = searchText
 
         var searchResults: HomeScreenSearchResultSet?
-        self.databaseStorage.asyncRead(block: {[weak self] transaction in
+        self.databaseStorage.asyncRead(priority: .background, block: {[weak self] transaction in
             guard let strongSelf = self else { return }
             searchResults = strongSelf.searcher.searchForHomeScreen(searchText: searchText, transaction: transaction)
         },
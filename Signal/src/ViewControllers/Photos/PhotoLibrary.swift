@@ -167,37 +167,19 @@ class PhotoCollectionContents {
         }
     }
 
-    private func requestVideoDataSource(for asset: PHAsset) -> Promise<(dataSource: DataSource, dataUTI: String)> {
+    private func requestVideoAsset(for asset: PHAsset) -> Promise<AVAsset> {
         return Promise { resolver in
 
             let options: PHVideoRequestOptions = PHVideoRequestOptions()
             options.isNetworkAccessAllowed = true
 
-            _ = imageManager.requestExportSession(forVideo: asset, options: options, exportPreset: AVAssetExportPresetMediumQuality) { exportSession, _ in
-
-                guard let exportSession = exportSession else {
-                    resolver.reject(PhotoLibraryError.assertionError(description: "exportSession was unexpectedly nil"))
+            _ = imageManager.requestAVAsset(forVideo: asset, options: options) { video, _, _ in
+                guard let video = video else {
+                    resolver.reject(PhotoLibraryError.assertionError(description: "video was unexpectedly nil"))
                     return
                 }
 
-                exportSession.outputFileType = AVFileType.mp4
-                exportSession.metadataItemFilter = AVMetadataItemFilter.forSharing()
-
-                let exportPath = OWSFileSystem.temporaryFilePath(withFileExtension: "mp4")
-                let exportURL = URL(fileURLWithPath: exportPath)
-                exportSession.outputURL = exportURL
-
-                Logger.debug("starting video export")
-                exportSession.exportAsynchronously {
-                    Logger.debug("Completed video export")
-
-                    do {
-                        let dataSource = try DataSourcePath.dataSource(with: exportURL, shouldDeleteOnDeallocation: true)
-                        resolver.fulfill((dataSource: dataSource, dataUTI: kUTTypeMPEG4 as String))
-                    } catch {
-                        resolver.reject(error)
-                    }
-                }
+                resolver.fulfill(video)
             }
         }
     }
@@ -209,8 +191,11 @@ class PhotoCollectionContents {
                 return SignalAttachment.attachment(dataSource: dataSource, dataUTI: dataUTI, imageQuality: imageQuality)
             }
         case .video:
-            return requestVideoDataSource(for: asset).map(on: .global()) { (dataSource: DataSource, dataUTI: String) in
-                return SignalAttachment.attachment(dataSource: dataSource, dataUTI: dataUTI)
+            return requestVideoAsset(for: asset).then(on: .global()) { (video: AVAsset) -> Promise<SignalAttachment> in
+                let (promise, _) = SignalAttachment.compressVideoAsMp4(asset: video,
+                                                                       mp4Filename: nil,
+                                                                       dataUTI: kUTTypeMPEG4 as String)
+                return promise
             }
         default:
             return Promise(error: PhotoLibraryError.unsupportedMediaType)
@@ -293,6 +293,13 @@ NS_ASSUME_NONNULL_BEGIN
     [AppUpdateNag.sharedInstance showAppUpgradeNagIfNecessary];
 
     [UIViewController attemptRotationToDeviceOrientation];
+
+    // The root view controller's first frame is committed at the end of
+    // this run loop pass, so anything non-critical can start after it.
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [LaunchTrace.shared didPresentFirstFrameWithLaunchStartedAt:launchStartedAt];
+        [SSKEnvironment.shared warmDeferredCaches];
+    });
 }
 
 - (BOOL)receivedVerificationCode:(NSString *)verificationCode
@@ -491,7 +491,8 @@ NS_ASSUME_NONNULL_BEGIN
     __block NSUInteger copiedAttachments = 0;
     __block NSUInteger copiedMisc = 0;
     self.unsavedAttachmentExports = [NSMutableArray new];
-    [self.databaseStorage readWithBlock:^(SDSAnyReadTransaction *transaction) {
+    [self.databaseStorage readWithPriority:SDSReadPriorityBackground
+                                     block:^(SDSAnyReadTransaction *transaction) {
         [TSThread anyEnumerateWithTransaction:transaction
                                       batched:YES
                                         block:^(TSThread *object, BOOL *stop) {
@@ -0,0 +1,172 @@
+//
+//  Copyright (c) 2020 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+import XCTest
+import MobileCoreServices
+import SignalServiceKit
+import SignalMessaging
+
+// Recompresses camera-sized photos as they would be sent, and reports the
+// time and peak memory for each photo size.
+class ImageRecompressionPerformanceTest: PerformanceBaseTest {
+
+    private let photoSizes: [(String, CGSize)] = [
+        ("12MP", CGSize(width: 4032, height: 3024)),
+        ("24MP", CGSize(width: 6000, height: 4000)),
+        ("48MP", CGSize(width: 8064, height: 6048))
+    ]
+
+    // A JPEG that looks enough like a photo to compress like one: smooth
+    // gradients with fine noise, plus camera metadata.
+    private func buildPhotoData(size: CGSize) -> Data {
+        let width = Int(size.width)
+        let height = Int(size.height)
+        let colorSpace = CGColorSpaceCreateDeviceRGB()
+        let bitmapInfo = CGImageAlphaInfo.noneSkipLast.rawValue
+
+        let noiseSize = 256
+        let noiseContext = CGContext(data: nil, width: noiseSize, height: noiseSize, bitsPerComponent: 8, bytesPerRow: 0, space: colorSpace, bitmapInfo: bitmapInfo)!
+        let noiseData = Randomness.generateRandomBytes(Int32(noiseSize * noiseContext.bytesPerRow))
+        noiseData.withUnsafeBytes { bytes in
+            noiseContext.data!.copyMemory(from: bytes.baseAddress!, byteCount: noiseData.count)
+        }
+        let noiseImage = noiseContext.makeImage()!
+
+        let context = CGContext(data: nil, width: width, height: height, bitsPerComponent: 8, bytesPerRow: 0, space: colorSpace, bitmapInfo: bitmapInfo)!
+        let gradient = CGGradient(colorsSpace: colorSpace,
+                                  colors: [UIColor.orange.cgColor, UIColor.blue.cgColor, UIColor.green.cgColor] as CFArray,
+                                  locations: [0, 0.5, 1])!
+        context.drawLinearGradient(gradient, start: .zero, end: CGPoint(x: width, y: height), options: [])
+        context.setAlpha(0.15)
+        context.draw(noiseImage, in: CGRect(x: 0, y: 0, width: noiseSize, height: noiseSize), byTiling: true)
+        let image = context.makeImage()!
+
+        let data = NSMutableData()
+        let destination = CGImageDestinationCreateWithData(data as CFMutableData, kUTTypeJPEG, 1, nil)!
+        let properties: [CFString: Any] = [
+            kCGImageDestinationLossyCompressionQuality: 0.92,
+            kCGImagePropertyOrientation: CGImagePropertyOrientation.right.rawValue,
+            kCGImagePropertyGPSDictionary: [kCGImagePropertyGPSLatitude: 37.77, kCGImagePropertyGPSLongitude: 122.42],
+            kCGImagePropertyExifDictionary: [kCGImagePropertyExifLensModel: "Test Lens"]
+        ]
+        CGImageDestinationAddImage(destination, image, properties as CFDictionary)
+        XCTAssertTrue(CGImageDestinationFinalize(destination))
+        return data as Data
+    }
+
+    private func maxByteCount(imageQuality: TSImageQuality) -> Int {
+        switch imageQuality {
+        case .original:
+            return Int(OWSMediaUtils.kMaxFileSizeImage)
+        case .medium:
+            return 1024 * 1024
+        case .compact:
+            return 400 * 1024
+        }
+    }
+
+    // MARK: -
+
+    func testRecompressPhotos() {
+        let byteFormatter = ByteCountFormatter()
+
+        for (sizeName, size) in photoSizes {
+            let photoData = autoreleasepool { buildPhotoData(size: size) }
+
+            for imageQuality in [TSImageQuality.medium, .compact] {
+                let memorySampler = PeakMemorySampler()
+                memorySampler.start()
+                let startDate = Date()
+
+                let attachment: SignalAttachment = autoreleasepool {
+                    let dataSource = DataSourceValue.dataSource(with: photoData, fileExtension: "jpg")!
+                    return SignalAttachment.attachment(dataSource: dataSource,
+                                                       dataUTI: kUTTypeJPEG as String,
+                                                       imageQuality: imageQuality)
+                }
+
+                let duration = Date().timeIntervalSince(startDate)
+                memorySampler.stop()
+
+                XCTAssertNil(attachment.error)
+                XCTAssertLessThan(Int(attachment.dataLength), maxByteCount(imageQuality: imageQuality))
+
+                // Metadata is stripped and the orientation is applied.
+                let source = CGImageSourceCreateWithData(attachment.data as CFData, nil)!
+                let properties = CGImageSourceCopyPropertiesAtIndex(source, 0, nil) as! [CFString: Any]
+                XCTAssertNil(properties[kCGImagePropertyGPSDictionary])
+                XCTAssertNil((properties[kCGImagePropertyExifDictionary] as? [CFString: Any])?[kCGImagePropertyExifLensModel])
+                let pixelWidth = (properties[kCGImagePropertyPixelWidth] as! NSNumber).intValue
+                let pixelHeight = (properties[kCGImagePropertyPixelHeight] as! NSNumber).intValue
+                XCTAssertGreaterThan(pixelHeight, pixelWidth)
+
+                Logger.info(String(format: "[Bench] %@ photo (%@) at %@ quality: %0.3fs, peak memory +%@, %dx%d, %@",
+                                   sizeName,
+                                   byteFormatter.string(fromByteCount: Int64(photoData.count)),
+                                   imageQuality == .medium ? "medium" : "compact",
+                                   duration,
+                                   byteFormatter.string(fromByteCount: Int64(memorySampler.peakSize - min(memorySampler.peakSize, memorySampler.initialSize))),
+                                   pixelWidth,
+                                   pixelHeight,
+                                   byteFormatter.string(fromByteCount: Int64(attachment.dataLength))))
+            }
+        }
+    }
+
+    func testSearchConvergence() {
+        let photoData = buildPhotoData(size: CGSize(width: 4032, height: 3024))
+
+        // Budgets too tight for the first encode should still be met in
+        // a few encodes.
+        for byteBudget: UInt in [600 * 1024, 250 * 1024, 120 * 1024, 60 * 1024] {
+            let result = try! ImageRecompressor.recompress(imageData: photoData,
+                                                           maxDimension: 2048,
+                                                           quality: 0.9,
+                                                           byteBudget: byteBudget)
+            XCTAssertLessThanOrEqual(UInt(result.data.count), byteBudget)
+            XCTAssertLessThanOrEqual(result.encodeCount, 6)
+            Logger.info("[Bench] Budget \(byteBudget): \(result.data.count) bytes, \(Int(result.image.size.width))x\(Int(result.image.size.height)) at quality \(result.quality) after \(result.encodeCount) encodes")
+        }
+    }
+}
+
+// MARK: -
+
+// Samples resident memory on a timer, since ImageIO allocates its
+// buffers internally.
+private class PeakMemorySampler {
+
+    private(set) var initialSize: mach_vm_size_t = 0
+    private(set) var peakSize: mach_vm_size_t = 0
+
+    private let serialQueue = DispatchQueue(label: "org.signal.peakMemorySampler")
+    private var timer: DispatchSourceTimer?
+
+    func start() {
+        initialSize = BenchResidentMemorySize() ?? 0
+        peakSize = initialSize
+
+        let timer = DispatchSource.makeTimerSource(queue: serialQueue)
+        timer.schedule(deadline: .now(), repeating: .milliseconds(5))
+        timer.setEventHandler { [weak self] in
+            guard let self = self, let size = BenchResidentMemorySize() else {
+                return
+            }
+            self.peakSize = max(self.peakSize, size)
+        }
+        timer.resume()
+        self.timer = timer
+    }
+
+    func stop() {
+        serialQueue.sync {
+            timer?.cancel()
+            timer = nil
+            if let size = BenchResidentMemorySize() {
+                peakSize = max(peakSize, size)
+            }
+        }
+    }
+}
@@ -0,0 +1,197 @@
+//
+//  Copyright (c) 2020 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+import XCTest
+import AVFoundation
+import SignalServiceKit
+import SignalMessaging
+
+// Transcodes fixture clips to a range of byte budgets, and reports how
+// fast each transcode runs and how close its output comes to the budget.
+class VideoTranscodePerformanceTest: PerformanceBaseTest {
+
+    private var tempURLs = [URL]()
+
+    override func tearDown() {
+        for url in tempURLs {
+            _ = OWSFileSystem.deleteFileIfExists(url.path)
+        }
+        tempURLs = []
+
+        super.tearDown()
+    }
+
+    private func tempURL() -> URL {
+        let url = URL(fileURLWithPath: OWSFileSystem.temporaryFilePath(withFileExtension: "mp4"))
+        tempURLs.append(url)
+        return url
+    }
+
+    // A clip of panning noise, which is harder to compress than most
+    // camera footage.
+    private func buildClip(size: CGSize, duration: TimeInterval, frameRate: Int32 = 30) -> URL {
+        let url = tempURL()
+        let writer = try! AVAssetWriter(outputURL: url, fileType: .mp4)
+        let input = AVAssetWriterInput(mediaType: .video, outputSettings: [
+            AVVideoCodecKey: AVVideoCodecType.h264,
+            AVVideoWidthKey: size.width,
+            AVVideoHeightKey: size.height,
+            AVVideoCompressionPropertiesKey: [AVVideoAverageBitRateKey: 8_000_000]
+        ])
+        let adaptor = AVAssetWriterInputPixelBufferAdaptor(assetWriterInput: input, sourcePixelBufferAttributes: [
+            kCVPixelBufferPixelFormatTypeKey as String: kCVPixelFormatType_32BGRA,
+            kCVPixelBufferWidthKey as String: Int(size.width),
+            kCVPixelBufferHeightKey as String: Int(size.height)
+        ])
+        writer.add(input)
+        XCTAssertTrue(writer.startWriting())
+        writer.startSession(atSourceTime: .zero)
+
+        let noise = Randomness.generateRandomBytes(4 * 1024 * 1024)
+        let frameCount = Int(duration * Double(frameRate))
+        for frameIndex in 0..<frameCount {
+            while !input.isReadyForMoreMediaData {
+                Thread.sleep(forTimeInterval: 0.001)
+            }
+            var pixelBuffer: CVPixelBuffer?
+            CVPixelBufferPoolCreatePixelBuffer(nil, adaptor.pixelBufferPool!, &pixelBuffer)
+            CVPixelBufferLockBaseAddress(pixelBuffer!, [])
+            let baseAddress = CVPixelBufferGetBaseAddress(pixelBuffer!)!
+            let bytesPerRow = CVPixelBufferGetBytesPerRow(pixelBuffer!)
+            noise.withUnsafeBytes { (bytes: UnsafeRawBufferPointer) in
+                // Each frame is the last one, shifted by a few pixels.
+                for row in 0..<CVPixelBufferGetHeight(pixelBuffer!) {
+                    let offset = (row * bytesPerRow + frameIndex * 4 * 3) % (bytes.count - bytesPerRow)
+                    (baseAddress + row * bytesPerRow).copyMemory(from: bytes.baseAddress! + offset, byteCount: bytesPerRow)
+                }
+            }
+            CVPixelBufferUnlockBaseAddress(pixelBuffer!, [])
+            XCTAssertTrue(adaptor.append(pixelBuffer!, withPresentationTime: CMTime(value: CMTimeValue(frameIndex), timescale: frameRate)))
+        }
+        input.markAsFinished()
+
+        let expectation = self.expectation(description: "build clip")
+        writer.finishWriting {
+            expectation.fulfill()
+        }
+        waitForExpectations(timeout: 60)
+        XCTAssertEqual(writer.status, .completed)
+        return url
+    }
+
+    private func fixtureClipURL() -> URL {
+        return Bundle(for: type(of: self)).url(forResource: "test-mp4", withExtension: "mp4")!
+    }
+
+    private func transcode(url: URL, maxByteCount: UInt) -> (duration: TimeInterval, byteCount: UInt)? {
+        let outputURL = tempURL()
+        let transcoder = VideoTranscoder(asset: AVAsset(url: url), outputURL: outputURL, maxByteCount: maxByteCount)
+
+        let expectation = self.expectation(description: "transcode")
+        var didSucceed = false
+        let startDate = Date()
+        transcoder.transcode().done {
+            didSucceed = true
+        }.catch { error in
+            XCTAssertEqual(error as? VideoTranscoder.TranscodeError, .durationTooLong)
+        }.finally {
+            expectation.fulfill()
+        }
+        waitForExpectations(timeout: 120)
+        let duration = Date().timeIntervalSince(startDate)
+
+        guard didSucceed else {
+            XCTAssertFalse(FileManager.default.fileExists(atPath: outputURL.path))
+            return nil
+        }
+        XCTAssertEqual(transcoder.progress.fractionCompleted, 1)
+        let byteCount = OWSFileSystem.fileSize(ofUrl: outputURL)!.uintValue
+        return (duration: duration, byteCount: byteCount)
+    }
+
+    // MARK: -
+
+    func testSettings() {
+        let hd = CGSize(width: 1920, height: 1080)
+
+        // Short videos are capped, and keep their audio bitrate.
+        let shortSettings = VideoTranscoder.settings(duration: 10, naturalSize: hd, sourceVideoBitRate: nil, hasAudio: true, maxByteCount: 100 * 1024 * 1024)!
+        XCTAssertEqual(shortSettings.videoBitRate, 1_500_000)
+        XCTAssertEqual(shortSettings.audioBitRate, 64_000)
+        XCTAssertEqual(shortSettings.dimensions, CGSize(width: 1280, height: 720))
+
+        // The source's bitrate is never exceeded.
+        let lowSourceSettings = VideoTranscoder.settings(duration: 10, naturalSize: hd, sourceVideoBitRate: 400_000, hasAudio: false, maxByteCount: 100 * 1024 * 1024)!
+        XCTAssertEqual(lowSourceSettings.videoBitRate, 400_000)
+        XCTAssertEqual(lowSourceSettings.dimensions, CGSize(width: 640, height: 360))
+
+        // Small videos aren't upscaled, and stay even.
+        let smallSettings = VideoTranscoder.settings(duration: 10, naturalSize: CGSize(width: 321, height: 241), sourceVideoBitRate: nil, hasAudio: false, maxByteCount: 100 * 1024 * 1024)!
+        XCTAssertEqual(smallSettings.dimensions, CGSize(width: 322, height: 242))
+
+        // Long videos get fewer bits, and fewer pixels.
+        let longSettings = VideoTranscoder.settings(duration: 60 * 60, naturalSize: hd, sourceVideoBitRate: nil, hasAudio: true, maxByteCount: 100 * 1024 * 1024)!
+        XCTAssertEqual(longSettings.audioBitRate, 32_000)
+        XCTAssertLessThan(longSettings.videoBitRate, 250_000)
+        XCTAssertEqual(longSettings.dimensions, CGSize(width: 480, height: 270))
+        let totalByteCount = Double(longSettings.videoBitRate + longSettings.audioBitRate) * 60 * 60 / 8
+        XCTAssertLessThan(totalByteCount, 100 * 1024 * 1024)
+
+        // Videos that would need too low a bitrate are rejected up front.
+        XCTAssertNil(VideoTranscoder.settings(duration: 2 * 60 * 60, naturalSize: hd, sourceVideoBitRate: nil, hasAudio: true, maxByteCount: 100 * 1024 * 1024))
+    }
+
+    func testTranscodeClips() {
+        let clips: [(String, URL)] = [
+            ("fixture", fixtureClipURL()),
+            ("720p 10s", buildClip(size: CGSize(width: 1280, height: 720), duration: 10)),
+            ("1080p 20s", buildClip(size: CGSize(width: 1920, height: 1080), duration: 20))
+        ]
+        // Small budgets, so that the fixture clips need the lower tiers.
+        let maxByteCounts: [UInt] = [4 * 1024 * 1024, 1024 * 1024, 256 * 1024]
+        let byteFormatter = ByteCountFormatter()
+
+        for (clipName, url) in clips {
+            let clipDuration = AVAsset(url: url).duration.seconds
+            XCTAssertGreaterThan(clipDuration, 0)
+
+            for maxByteCount in maxByteCounts {
+                guard let result = transcode(url: url, maxByteCount: maxByteCount) else {
+                    Logger.info("[Bench] \(clipName) clip, \(byteFormatter.string(fromByteCount: Int64(maxByteCount))) budget: too long to send")
+                    continue
+                }
+                XCTAssertLessThanOrEqual(result.byteCount, maxByteCount)
+
+                Logger.info(String(format: "[Bench] %@ clip, %@ budget: %0.2fs (%0.1fx realtime), %@ (%0.0f%% of budget)",
+                                   clipName,
+                                   byteFormatter.string(fromByteCount: Int64(maxByteCount)),
+                                   result.duration,
+                                   clipDuration / result.duration,
+                                   byteFormatter.string(fromByteCount: Int64(result.byteCount)),
+                                   Double(result.byteCount) * 100 / Double(maxByteCount)))
+            }
+        }
+    }
+
+    func testCancel() {
+        let url = buildClip(size: CGSize(width: 1920, height: 1080), duration: 20)
+        let outputURL = tempURL()
+        let transcoder = VideoTranscoder(asset: AVAsset(url: url), outputURL: outputURL, maxByteCount: 100 * 1024 * 1024)
+
+        let expectation = self.expectation(description: "transcode")
+        transcoder.transcode().done {
+            XCTFail("Transcode should have been cancelled.")
+        }.catch { error in
+            XCTAssertEqual(error as? VideoTranscoder.TranscodeError, .cancelled)
+        }.finally {
+            expectation.fulfill()
+        }
+        DispatchQueue.main.asyncAfter(deadline: .now() + 0.5) {
+            transcoder.progress.cancel()
+        }
+        waitForExpectations(timeout: 120)
+        XCTAssertFalse(FileManager.default.fileExists(atPath: outputURL.path))
+    }
+}
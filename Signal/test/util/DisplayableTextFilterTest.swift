@@ -5,6 +5,7 @@
 import XCTest
 @testable import Signal
 @testable import SignalMessaging
+import SignalServiceKit
 
 class DisplayableTextTest: SignalBaseTest {
 
@@ -111,11 +112,15 @@ class DisplayableTextTest: SignalBaseTest {
         func assertLinkifies(_ text: String, file: StaticString = #file, line: UInt = #line) {
             let displayableText = DisplayableText.displayableText(text)
             XCTAssert(displayableText.shouldAllowLinkification, "was not linkifiable text: \(text)", file: file, line: line)
+            let analyzedText = DisplayableText.displayableText(body: text, analysis: MessageBodyAnalysis.analyze(body: text))
+            XCTAssert(analyzedText.shouldAllowLinkification, "was not linkifiable text: \(text)", file: file, line: line)
         }
 
         func assertNotLinkifies(_ text: String, file: StaticString = #file, line: UInt = #line) {
             let displayableText = DisplayableText.displayableText(text)
             XCTAssertFalse(displayableText.shouldAllowLinkification, "was linkifiable text: \(text)", file: file, line: line)
+            let analyzedText = DisplayableText.displayableText(body: text, analysis: MessageBodyAnalysis.analyze(body: text))
+            XCTAssertFalse(analyzedText.shouldAllowLinkification, "was linkifiable text: \(text)", file: file, line: line)
         }
 
         // some basic happy paths
@@ -7,6 +7,15 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+@interface OWSScrubbingLogFormatter (Testing)
+
+- (NSString *)scrubbedLogString:(NSString *)logString;
+- (NSString *)regexScrubbedLogString:(NSString *)logString;
+
+@end
+
+#pragma mark -
+
 @interface OWSScrubbingLogFormatterTest : SignalBaseTest
 
 @property (nonatomic) NSDate *testDate;
@@ -207,6 +216,77 @@ NS_ASSUME_NONNULL_BEGIN
     XCTAssertEqual(NSNotFound, uuidRange.location, "Failed to redact UUID string: %@", uuidString);
 }
 
+- (NSArray<NSString *> *)goldenLogStrings
+{
+    return @[
+        @"",
+        @"Some unfiltered string",
+        @"Nothing to see here: deadbeef cafe 12345 1.2.3 <0123> {length = 0}",
+        @"My phone number is +13331231234",
+        @"+123456789 is too short, +1234567890 is not, nor is +12345678901234567890",
+        @"UUIDs: BAF1768C-2A25-4D8F-83B7-A89C59C98748 and baf1768c-2a25-4d8f-83b7-a89c59c98748x",
+        @"Not a UUID: BAF1768C-2A25-4D8F-83B7-A89C59C9874",
+        @"Hex run before a UUID: 0123BAF1768C-2A25-4D8F-83B7-A89C59C98748",
+        @"Data: <01234567 89a23def 23234567 89ab1234> <0123456> <01234567 89ab> <ABCDEF01>",
+        @"iOS 13 data: {length = 8, bytes = 0x0123456789abcdef} {LENGTH = 3, BYTES = 0X012345}",
+        @"Odd iOS 13 data: {length = 8, bytes = 0x0123456789abcde} {length = , bytes = 0x01}",
+        @"Long iOS 13 data: {length = 100, bytes = 0x01234567 89abcdef ... 01234567 89abcdef}",
+        @"IP addresses: 0.0.0.0, http://127.0.0.1:80/, 1.2.3.4.5.6.7.8, 1.2.3., 1..2.3.4",
+        @"Adjacent tokens: +133312312341.2.3.4<01234567>{length = 1, bytes = 0x01}",
+        @"An IPv4 address running into a UUID: 1.2.3.4BAF1768C-2A25-4D8F-83B7-A89C59C98748",
+        @"An IPv4 address running into a UUID: 9.1.2.3.4BAF1768C-2A25-4D8F-83B7-A89C59C98748",
+        @"Non-ASCII digits: +١٢٣٤٥٦٧٨٩٠١٢ and emoji 👍 1.2.3.4",
+    ];
+}
+
+// The scanner should reproduce the output of the regular expressions exactly.
+- (void)testScannerMatchesRegularExpressions
+{
+    OWSScrubbingLogFormatter *formatter = [OWSScrubbingLogFormatter new];
+
+    for (NSString *logString in self.goldenLogStrings) {
+        XCTAssertEqualObjects([formatter regexScrubbedLogString:logString],
+            [formatter scrubbedLogString:logString],
+            @"Scrubbing differs for: %@",
+            logString);
+    }
+
+    XCTAssertEqualObjects(@"Adjacent tokens: [ REDACTED_PHONE_NUMBER:xxx341 ].2.3.4[ REDACTED_DATA:01... ][ "
+                          @"REDACTED_DATA:01... ]",
+        [formatter scrubbedLogString:@"Adjacent tokens: +133312312341.2.3.4<01234567>{length = 1, bytes = 0x01}"]);
+    XCTAssertEqualObjects(@"[ REDACTED_IPV4_ADDRESS:...3 ].4[ REDACTED_UUID:xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxx48 ]",
+        [formatter scrubbedLogString:@"9.1.2.3.4BAF1768C-2A25-4D8F-83B7-A89C59C98748"]);
+}
+
+- (void)testUnscrubbedStringIsReturnedUntouched
+{
+    OWSScrubbingLogFormatter *formatter = [OWSScrubbingLogFormatter new];
+    NSString *logString = [NSString stringWithFormat:@"Nothing to scrub in line %d", 1];
+    XCTAssertEqual(logString, [formatter scrubbedLogString:logString]);
+}
+
+- (void)testScrubbingPerformance
+{
+    OWSScrubbingLogFormatter *formatter = [OWSScrubbingLogFormatter new];
+    NSArray<NSString *> *logStrings = @[
+        @"2019/12/03 10:11:12:131 [OWSMessageManager.m:123 -[OWSMessageManager handleEnvelope:]]: Handling message.",
+        @"2019/12/03 10:11:12:132 [OWSMessageSender.m:456 -[OWSMessageSender sendMessage:]]: Sending to "
+        @"+13331231234 (BAF1768C-2A25-4D8F-83B7-A89C59C98748).",
+        @"2019/12/03 10:11:12:133 [OWSWebSocket.m:789 -[OWSWebSocket processMessage:]]: Received "
+        @"{length = 16, bytes = 0x0123456789abcdef0123456789abcdef} from 10.0.0.1.",
+    ];
+    const NSUInteger lineCount = 10000;
+
+    [self measureBlock:^{
+        NSDate *startDate = [NSDate new];
+        for (NSUInteger i = 0; i < lineCount; i++) {
+            [formatter scrubbedLogString:logStrings[i % logStrings.count]];
+        }
+        NSTimeInterval duration = MAX(-startDate.timeIntervalSinceNow, 0.001);
+        OWSLogInfo(@"Scrubbed %.0f lines per second.", lineCount / duration);
+    }];
+}
+
 @end
 
 NS_ASSUME_NONNULL_END
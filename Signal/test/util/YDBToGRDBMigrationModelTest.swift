@@ -549,6 +549,74 @@ class YDBToGRDBMigrationModelTest: SignalBaseTest {
         }
     }
 
+    func testResumedInteractionMigration() {
+        storageCoordinator.useGRDBForTests()
+
+        let contactThread = TSContactThread(contactAddress: SignalServiceAddress(phoneNumber: "+13213334444"))
+        let message1 = TSOutgoingMessage(in: contactThread, messageBody: "good heavens", attachmentId: nil)
+        let message2 = TSOutgoingMessage(in: contactThread, messageBody: "land's sakes", attachmentId: nil)
+        let message3 = TSOutgoingMessage(in: contactThread, messageBody: "oh my word", attachmentId: nil)
+
+        self.yapWrite { transaction in
+            contactThread.anyInsert(transaction: transaction.asAnyWrite)
+            message1.anyInsert(transaction: transaction.asAnyWrite)
+            message2.anyInsert(transaction: transaction.asAnyWrite)
+            message3.anyInsert(transaction: transaction.asAnyWrite)
+        }
+
+        let threadMigratorGroups = [
+            GRDBMigratorGroup { ydbTransaction in
+                return [
+                    GRDBUnorderedRecordMigrator<TSThread>(label: "threads", ydbTransaction: ydbTransaction)
+                ]
+            }
+        ]
+        try! YDBToGRDBMigration().migrate(migratorGroups: threadMigratorGroups)
+
+        // Simulate an interrupted migration which committed a batch
+        // containing the first two interactions.
+        let interactionMigratorLabel = "Migrate Interactions"
+        self.write { transaction in
+            guard case .grdbWrite(let grdbTransaction) = transaction.writeTransaction else {
+                XCTFail("Unexpected transaction type.")
+                return
+            }
+            message1.anyInsert(transaction: transaction)
+            message2.anyInsert(transaction: transaction)
+            GRDBMigrationCheckpoint.setCursor(2, label: interactionMigratorLabel, transaction: grdbTransaction)
+        }
+
+        let interactionMigratorGroups = [
+            GRDBMigratorGroup { ydbTransaction in
+                return [
+                    GRDBInteractionMigrator(ydbTransaction: ydbTransaction)
+                ]
+            }
+        ]
+        try! YDBToGRDBMigration().migrate(migratorGroups: interactionMigratorGroups)
+
+        self.read { transaction in
+            XCTAssertEqual(3, TSInteraction.anyCount(transaction: transaction))
+            XCTAssertEqual([message1.uniqueId, message2.uniqueId, message3.uniqueId].sorted(), TSInteraction.anyAllUniqueIds(transaction: transaction).sorted())
+
+            guard case .grdbRead(let grdbTransaction) = transaction.readTransaction else {
+                XCTFail("Unexpected transaction type.")
+                return
+            }
+            XCTAssertTrue(GRDBMigrationCheckpoint.isComplete(label: interactionMigratorLabel, transaction: grdbTransaction))
+
+            // FTS indexing is deferred during the migration, then
+            // built by a post-pass.
+            var searchResults = [String]()
+            FullTextSearchFinder().enumerateObjects(searchText: "word", transaction: transaction) { object, _, _ in
+                if let message = object as? TSMessage {
+                    searchResults.append(message.uniqueId)
+                }
+            }
+            XCTAssertEqual([message3.uniqueId], searchResults)
+        }
+    }
+
     func testThreadAndInteractionOrdering() {
         storageCoordinator.useGRDBForTests()
 
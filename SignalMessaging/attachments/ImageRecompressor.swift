@@ -0,0 +1,210 @@
+//
+//  Copyright (c) 2020 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+import ImageIO
+import MobileCoreServices
+import SignalServiceKit
+
+// Re-encodes an image as a JPEG that fits within a byte budget.
+//
+// The image is decoded once, straight from the image source at the
+// target dimension, so a large photo is never fully decoded unless it is
+// sent at full size. The JPEG quality is then searched toward the budget:
+// each encode's size refines an estimate of how size falls with quality,
+// so most images fit within one or two encodes. If the image won't fit
+// at a quality that suits its dimension, it is downsampled again, to a
+// dimension estimated from the same model.
+//
+// The output carries no metadata: the orientation is applied to the
+// pixels, and nothing else from the source is copied.
+@objc
+public class ImageRecompressor: NSObject {
+
+    public struct Result {
+        public let data: Data
+        public let image: UIImage
+        public let quality: CGFloat
+        public let encodeCount: Int
+    }
+
+    public enum RecompressionError: Error {
+        case couldNotParseImage
+        case couldNotResizeImage
+        case couldNotConvertToJpeg
+        case fileSizeTooLarge
+    }
+
+    // The smallest dimension and lowest quality we'll send, matching the
+    // lowest TSImageQualityTier.
+    public static let minDimension: CGFloat = 512
+    public static let minQuality: CGFloat = 0.5
+
+    // Past this many encodes, we fall back to the smallest, lowest quality
+    // output.
+    private static let maxEncodeCount = 5
+
+    // Aim slightly below the budget so that the estimate's error doesn't
+    // cost another encode.
+    private static let budgetMargin: Double = 0.95
+
+    // JPEG size falls roughly exponentially with quality: at typical
+    // qualities, 0.2 less quality about halves the size. This is refined
+    // after the first encode.
+    private static let defaultSizeSlope: Double = log(2) / 0.2
+
+    private let source: CGImageSource
+    private let byteBudget: UInt
+    private let sourceDimension: CGFloat
+
+    private init?(imageData: Data, byteBudget: UInt) {
+        let sourceOptions = [kCGImageSourceShouldCache: false] as CFDictionary
+        guard let source = CGImageSourceCreateWithData(imageData as CFData, sourceOptions),
+            CGImageSourceGetCount(source) > 0,
+            let properties = CGImageSourceCopyPropertiesAtIndex(source, 0, sourceOptions) as? [CFString: Any],
+            let pixelWidth = properties[kCGImagePropertyPixelWidth] as? NSNumber,
+            let pixelHeight = properties[kCGImagePropertyPixelHeight] as? NSNumber else {
+                return nil
+        }
+        self.source = source
+        self.byteBudget = byteBudget
+        self.sourceDimension = CGFloat(max(pixelWidth.doubleValue, pixelHeight.doubleValue))
+
+        super.init()
+    }
+
+    // maxDimension limits the longer side of the output; if nil, the
+    // image is only downsampled if it can't otherwise fit the budget.
+    // quality is the JPEG quality to use if the image fits at it.
+    public class func recompress(imageData: Data,
+                                 maxDimension: CGFloat?,
+                                 quality: CGFloat,
+                                 byteBudget: UInt) throws -> Result {
+        guard let recompressor = ImageRecompressor(imageData: imageData, byteBudget: byteBudget) else {
+            throw RecompressionError.couldNotParseImage
+        }
+        return try recompressor.recompress(maxDimension: maxDimension, initialQuality: quality)
+    }
+
+    // MARK: -
+
+    private func recompress(maxDimension: CGFloat?, initialQuality: CGFloat) throws -> Result {
+        let minDimension = ImageRecompressor.minDimension
+        let minQuality = ImageRecompressor.minQuality
+        let targetByteCount = log(Double(byteBudget) * ImageRecompressor.budgetMargin)
+
+        var dimension = min(maxDimension ?? sourceDimension, sourceDimension).rounded(.down)
+        var quality = max(initialQuality, minQuality)
+        var image = try downsample(toDimension: dimension)
+        // The (quality, log size) of each encode at the current dimension.
+        var samples = [(Double, Double)]()
+        var encodeCount = 0
+
+        while true {
+            let data = try encode(image, quality: quality)
+            encodeCount += 1
+
+            if data.count <= byteBudget {
+                Logger.verbose("Recompressed to \(Int(dimension))px at quality \(quality) in \(encodeCount) encodes.")
+                return Result(data: data, image: UIImage(cgImage: image), quality: quality, encodeCount: encodeCount)
+            }
+
+            let qualityFloor = self.qualityFloor(dimension: dimension)
+            let isAtMinDimension = dimension <= minDimension
+            let isAtMinQuality = quality <= qualityFloor
+            if isAtMinDimension && isAtMinQuality {
+                throw RecompressionError.fileSizeTooLarge
+            }
+            if encodeCount >= ImageRecompressor.maxEncodeCount {
+                // Give up on the search; try the smallest output.
+                if !isAtMinDimension {
+                    dimension = min(dimension, minDimension)
+                    image = try downsample(toDimension: dimension)
+                }
+                quality = minQuality
+                samples = []
+                continue
+            }
+
+            let byteCount = log(Double(data.count))
+            samples.append((Double(quality), byteCount))
+            let slope = sizeSlope(samples: samples)
+
+            // The quality at which we estimate the image will fit.
+            let fittingQuality = Double(quality) - (byteCount - targetByteCount) / slope
+            if fittingQuality >= Double(qualityFloor) || isAtMinDimension {
+                // Always make some progress, in case the estimate is off.
+                quality = max(qualityFloor, min(CGFloat(fittingQuality), quality - 0.05))
+                continue
+            }
+
+            // The image won't fit at a reasonable quality, so shrink it.
+            // Size is roughly proportional to pixel count.
+            let byteCountAtQualityFloor = byteCount - slope * (Double(quality) - Double(qualityFloor))
+            let scale = CGFloat(exp((targetByteCount - byteCountAtQualityFloor) / 2))
+            let newDimension = max(minDimension, min(dimension * scale, dimension * 0.9).rounded(.down))
+            let byteCountAtNewDimension = byteCount + 2 * log(Double(newDimension / dimension))
+
+            dimension = newDimension
+            image = try downsample(toDimension: dimension)
+            samples = []
+            let newFittingQuality = Double(quality) - (byteCountAtNewDimension - targetByteCount) / slope
+            quality = max(self.qualityFloor(dimension: dimension), min(initialQuality, CGFloat(newFittingQuality)))
+        }
+    }
+
+    // Below this quality, it looks better to send fewer pixels. Follows the
+    // TSImageQualityTiers, which pair 2048px with 0.9 down to 512px with
+    // 0.5, less one tier's worth of quality.
+    private func qualityFloor(dimension: CGFloat) -> CGFloat {
+        let tierCount = log2(Double(dimension / ImageRecompressor.minDimension)) * 2
+        let tierQuality = CGFloat(0.5 + 0.1 * tierCount) - 0.1
+        return min(max(tierQuality, ImageRecompressor.minQuality), 0.8)
+    }
+
+    private func sizeSlope(samples: [(Double, Double)]) -> Double {
+        guard samples.count >= 2 else {
+            return ImageRecompressor.defaultSizeSlope
+        }
+        let (quality1, byteCount1) = samples[samples.count - 2]
+        let (quality2, byteCount2) = samples[samples.count - 1]
+        let slope = (byteCount1 - byteCount2) / (quality1 - quality2)
+        guard slope.isFinite, slope > 0 else {
+            return ImageRecompressor.defaultSizeSlope
+        }
+        return slope
+    }
+
+    // Decodes the image at (at most) dimension pixels on its longer side,
+    // with its orientation applied. For JPEGs, ImageIO decodes at a reduced
+    // scale rather than decoding the full image and then scaling it.
+    private func downsample(toDimension dimension: CGFloat) throws -> CGImage {
+        let options: [CFString: Any] = [
+            kCGImageSourceCreateThumbnailFromImageAlways: true,
+            kCGImageSourceCreateThumbnailWithTransform: true,
+            kCGImageSourceShouldCacheImmediately: true,
+            kCGImageSourceThumbnailMaxPixelSize: Int(dimension)
+        ]
+        guard let image = CGImageSourceCreateThumbnailAtIndex(source, 0, options as CFDictionary) else {
+            owsFailDebug("Could not downsample image.")
+            throw RecompressionError.couldNotResizeImage
+        }
+        return image
+    }
+
+    private func encode(_ image: CGImage, quality: CGFloat) throws -> Data {
+        let data = NSMutableData()
+        guard let destination = CGImageDestinationCreateWithData(data as CFMutableData, kUTTypeJPEG, 1, nil) else {
+            owsFailDebug("Could not create image destination.")
+            throw RecompressionError.couldNotConvertToJpeg
+        }
+        let properties = [kCGImageDestinationLossyCompressionQuality: quality] as CFDictionary
+        CGImageDestinationAddImage(destination, image, properties)
+        guard CGImageDestinationFinalize(destination) else {
+            owsFailDebug("Could not encode image.")
+            throw RecompressionError.couldNotConvertToJpeg
+        }
+        return data as Data
+    }
+}
@@ -727,7 +727,7 @@ public class SignalAttachment: NSObject {
                 return removeImageMetadata(attachment: attachment)
             } else {
                 Logger.verbose("Recompressing \(ByteCountFormatter.string(fromByteCount: Int64(dataSource.dataLength()), countStyle: .file)) attachment as image/jpeg.")
-                return compressImageAsJPEG(image: image, attachment: attachment, filename: dataSource.sourceFilename, imageQuality: imageQuality)
+                return compressImageAsJPEG(attachment: attachment, filename: dataSource.sourceFilename, imageQuality: imageQuality)
             }
         }
     }
@@ -751,7 +751,7 @@ public class SignalAttachment: NSObject {
         return false
     }
 
-    private class func compressImageAsJPEG(image: UIImage, attachment: SignalAttachment, filename: String?, imageQuality: TSImageQuality) -> SignalAttachment {
+    private class func compressImageAsJPEG(attachment: SignalAttachment, filename: String?, imageQuality: TSImageQuality) -> SignalAttachment {
         assert(attachment.error == nil)
 
         if imageQuality == .original &&
@@ -761,108 +761,40 @@ public class SignalAttachment: NSObject {
             return attachment
         }
 
-        var imageUploadQuality = imageQuality.imageQualityTier()
-
-        while true {
-            let maxSize = maxSizeForImage(image: image, imageUploadQuality: imageUploadQuality)
-            var dstImage: UIImage! = image
-            if image.size.width > maxSize ||
-                image.size.height > maxSize {
-                guard let resizedImage = imageScaled(image, toMaxSize: maxSize) else {
-                    attachment.error = .couldNotResizeImage
-                    return attachment
-                }
-                dstImage = resizedImage
-            }
-            guard let jpgImageData = dstImage.jpegData(compressionQuality: jpegCompressionQuality(imageUploadQuality: imageUploadQuality)) else {
-                                                                attachment.error = .couldNotConvertToJpeg
-                                                                return attachment
-            }
-
-            guard let dataSource = DataSourceValue.dataSource(with: jpgImageData, fileExtension: "jpg") else {
-                attachment.error = .couldNotConvertToJpeg
-                return attachment
-            }
-
-            let baseFilename = filename?.filenameWithoutExtension
-            let jpgFilename = baseFilename?.appendingFileExtension("jpg")
-            dataSource.sourceFilename = jpgFilename
-
-            if doesImageHaveAcceptableFileSize(dataSource: dataSource, imageQuality: imageQuality) &&
-                dataSource.dataLength() <= kMaxFileSizeImage {
-                let recompressedAttachment = SignalAttachment(dataSource: dataSource, dataUTI: kUTTypeJPEG as String)
-                recompressedAttachment.cachedImage = dstImage
-                Logger.verbose("Converted \(attachment.mimeType) to \(ByteCountFormatter.string(fromByteCount: Int64(jpgImageData.count), countStyle: .file)) image/jpeg")
-                return recompressedAttachment
-            }
-
-            // If the JPEG output is larger than the file size limit,
-            // continue to try again by progressively reducing the
-            // image upload quality.
-            switch imageUploadQuality {
-            case .original:
-                imageUploadQuality = .high
-            case .high:
-                imageUploadQuality = .mediumHigh
-            case .mediumHigh:
-                imageUploadQuality = .medium
-            case .medium:
-                imageUploadQuality = .mediumLow
-            case .mediumLow:
-                imageUploadQuality = .low
-            case .low:
-                attachment.error = .fileSizeTooLarge
-                return attachment
-            }
-        }
-    }
-
-    // NOTE: For unknown reasons, resizing images with UIGraphicsBeginImageContext()
-    // crashes reliably in the share extension after screen lock's auth UI has been presented.
-    // Resizing using a CGContext seems to work fine.
-    private class func imageScaled(_ uiImage: UIImage, toMaxSize maxSize: CGFloat) -> UIImage? {
-        guard let cgImage = uiImage.cgImage else {
-            owsFailDebug("UIImage missing cgImage.")
-            return nil
+        let imageUploadQuality = imageQuality.imageQualityTier()
+        let recompressionResult: ImageRecompressor.Result
+        do {
+            recompressionResult = try ImageRecompressor.recompress(imageData: attachment.data,
+                                                                   maxDimension: maxSizeForImage(imageUploadQuality: imageUploadQuality),
+                                                                   quality: jpegCompressionQuality(imageUploadQuality: imageUploadQuality),
+                                                                   byteBudget: maxFileSizeForImage(imageQuality: imageQuality))
+        } catch ImageRecompressor.RecompressionError.couldNotParseImage {
+            attachment.error = .couldNotParseImage
+            return attachment
+        } catch ImageRecompressor.RecompressionError.couldNotResizeImage {
+            attachment.error = .couldNotResizeImage
+            return attachment
+        } catch ImageRecompressor.RecompressionError.fileSizeTooLarge {
+            attachment.error = .fileSizeTooLarge
+            return attachment
+        } catch {
+            attachment.error = .couldNotConvertToJpeg
+            return attachment
         }
 
-        // It's essential that we work consistently in "CG" coordinates (which are
-        // pixels and don't reflect orientation), not "UI" coordinates (which
-        // are points and do reflect orientation).
-        let scrSize = CGSize(width: cgImage.width, height: cgImage.height)
-        var maxSizeRect = CGRect.zero
-        maxSizeRect.size = CGSize(width: maxSize, height: maxSize)
-        let newSize = AVMakeRect(aspectRatio: scrSize, insideRect: maxSizeRect).size
-        assert(newSize.width <= maxSize)
-        assert(newSize.height <= maxSize)
-
-        let colorSpace = CGColorSpaceCreateDeviceRGB()
-        let bitmapInfo: CGBitmapInfo = [
-            CGBitmapInfo(rawValue: CGImageByteOrderInfo.orderDefault.rawValue),
-            CGBitmapInfo(rawValue: CGImageAlphaInfo.premultipliedLast.rawValue)]
-        guard let context = CGContext.init(data: nil,
-                                           width: Int(newSize.width),
-                                           height: Int(newSize.height),
-                                           bitsPerComponent: 8,
-                                           bytesPerRow: 0,
-                                           space: colorSpace,
-                                           bitmapInfo: bitmapInfo.rawValue) else {
-                                            owsFailDebug("could not create CGContext.")
-            return nil
+        guard let dataSource = DataSourceValue.dataSource(with: recompressionResult.data, fileExtension: "jpg") else {
+            attachment.error = .couldNotConvertToJpeg
+            return attachment
         }
-        context.interpolationQuality = .high
 
-        var drawRect = CGRect.zero
-        drawRect.size = newSize
-        context.draw(cgImage, in: drawRect)
+        let baseFilename = filename?.filenameWithoutExtension
+        let jpgFilename = baseFilename?.appendingFileExtension("jpg")
+        dataSource.sourceFilename = jpgFilename
 
-        guard let newCGImage = context.makeImage() else {
-            owsFailDebug("could not create new CGImage.")
-            return nil
-        }
-        return UIImage(cgImage: newCGImage,
-                       scale: uiImage.scale,
-                       orientation: uiImage.imageOrientation)
+        let recompressedAttachment = SignalAttachment(dataSource: dataSource, dataUTI: kUTTypeJPEG as String)
+        recompressedAttachment.cachedImage = recompressionResult.image
+        Logger.verbose("Converted \(attachment.mimeType) to \(ByteCountFormatter.string(fromByteCount: Int64(recompressionResult.data.count), countStyle: .file)) image/jpeg")
+        return recompressedAttachment
     }
 
     private class func doesImageHaveAcceptableFileSize(dataSource: DataSource, imageQuality: TSImageQuality) -> Bool {
@@ -876,10 +808,23 @@ public class SignalAttachment: NSObject {
         }
     }
 
-    private class func maxSizeForImage(image: UIImage, imageUploadQuality: TSImageQualityTier) -> CGFloat {
+    // The largest acceptable output, in bytes; see doesImageHaveAcceptableFileSize().
+    private class func maxFileSizeForImage(imageQuality: TSImageQuality) -> UInt {
+        switch imageQuality {
+        case .original:
+            return kMaxFileSizeImage
+        case .medium:
+            return min(kMaxFileSizeImage, UInt(1024 * 1024) - 1)
+        case .compact:
+            return min(kMaxFileSizeImage, UInt(400 * 1024) - 1)
+        }
+    }
+
+    // Returns nil if the image shouldn't be resized.
+    private class func maxSizeForImage(imageUploadQuality: TSImageQualityTier) -> CGFloat? {
         switch imageUploadQuality {
         case .original:
-            return max(image.size.width, image.size.height)
+            return nil
         case .high:
             return 2048
         case .mediumHigh:
@@ -1004,7 +949,7 @@ public class SignalAttachment: NSObject {
         return videoDir
     }
 
-    public class func compressVideoAsMp4(dataSource: DataSource, dataUTI: String) -> (Promise<SignalAttachment>, AVAssetExportSession?) {
+    public class func compressVideoAsMp4(dataSource: DataSource, dataUTI: String) -> (Promise<SignalAttachment>, VideoTranscoder?) {
         Logger.debug("")
 
         guard let url = dataSource.dataUrl() else {
@@ -1014,45 +959,53 @@ public class SignalAttachment: NSObject {
         }
 
         let asset = AVAsset(url: url)
+        let baseFilename = dataSource.sourceFilename
+        let mp4Filename = baseFilename?.filenameWithoutExtension.appendingFileExtension("mp4")
+        return compressVideoAsMp4(asset: asset, mp4Filename: mp4Filename, dataUTI: dataUTI)
+    }
 
-        guard let exportSession = AVAssetExportSession(asset: asset, presetName: AVAssetExportPresetMediumQuality) else {
-            let attachment = SignalAttachment(dataSource: DataSourceValue.emptyDataSource(), dataUTI: dataUTI)
-            attachment.error = .couldNotConvertToMpeg4
-            return (Promise.value(attachment), nil)
-        }
-
-        exportSession.shouldOptimizeForNetworkUse = true
-        exportSession.outputFileType = AVFileType.mp4
-        exportSession.metadataItemFilter = AVMetadataItemFilter.forSharing()
-
+    // Transcodes the video with a bitrate that fits kMaxFileSizeVideo.
+    //
+    // NOTE: The attachment returned by the promise may not be valid.
+    //       Check the attachment's error property.
+    public class func compressVideoAsMp4(asset: AVAsset, mp4Filename: String?, dataUTI: String) -> (Promise<SignalAttachment>, VideoTranscoder) {
         let exportURL = videoTempPath.appendingPathComponent(UUID().uuidString).appendingPathExtension("mp4")
-        exportSession.outputURL = exportURL
+        let transcoder = VideoTranscoder(asset: asset, outputURL: exportURL, maxByteCount: kMaxFileSizeVideo)
 
-        let (promise, resolver) = Promise<SignalAttachment>.pending()
-
-        Logger.debug("starting video export")
-        exportSession.exportAsynchronously {
-            Logger.debug("Completed video export")
-            let baseFilename = dataSource.sourceFilename
-            let mp4Filename = baseFilename?.filenameWithoutExtension.appendingFileExtension("mp4")
+        Logger.debug("starting video transcode")
+        let promise = transcoder.transcode().map(on: DispatchQueue.global()) { () -> SignalAttachment in
+            Logger.debug("Completed video transcode")
 
+            let dataSource: DataSource
             do {
-                let dataSource = try DataSourcePath.dataSource(with: exportURL,
-                                                               shouldDeleteOnDeallocation: true)
-                dataSource.sourceFilename = mp4Filename
-
-                let attachment = SignalAttachment(dataSource: dataSource, dataUTI: kUTTypeMPEG4 as String)
-                resolver.fulfill(attachment)
+                dataSource = try DataSourcePath.dataSource(with: exportURL,
+                                                           shouldDeleteOnDeallocation: true)
             } catch {
                 owsFailDebug("Failed to build data source for exported video URL")
-                let attachment = SignalAttachment(dataSource: DataSourceValue.emptyDataSource(), dataUTI: dataUTI)
+                throw error
+            }
+            dataSource.sourceFilename = mp4Filename
+
+            // The bitrate leaves a margin, so this should only happen if
+            // the encoder badly overshoots it.
+            guard dataSource.dataLength() <= kMaxFileSizeVideo else {
+                owsFailDebug("Transcoded video is too large: \(dataSource.dataLength()).")
+                throw SignalAttachmentError.fileSizeTooLarge
+            }
+
+            return SignalAttachment(dataSource: dataSource, dataUTI: kUTTypeMPEG4 as String)
+        }.recover(on: DispatchQueue.main) { (error: Error) -> Promise<SignalAttachment> in
+            Logger.warn("Could not transcode video: \(error)")
+            let attachment = SignalAttachment(dataSource: DataSourceValue.emptyDataSource(), dataUTI: dataUTI)
+            switch error {
+            case VideoTranscoder.TranscodeError.durationTooLong, SignalAttachmentError.fileSizeTooLarge:
+                attachment.error = .fileSizeTooLarge
+            default:
                 attachment.error = .couldNotConvertToMpeg4
-                resolver.fulfill(attachment)
-                return
             }
+            return Promise.value(attachment)
         }
-
-        return (promise, exportSession)
+        return (promise, transcoder)
     }
 
     @objc
@@ -1061,19 +1014,19 @@ public class SignalAttachment: NSObject {
         public let attachmentPromise: AnyPromise
 
         @objc
-        public let exportSession: AVAssetExportSession?
+        public let transcoder: VideoTranscoder?
 
-        fileprivate init(attachmentPromise: Promise<SignalAttachment>, exportSession: AVAssetExportSession?) {
+        fileprivate init(attachmentPromise: Promise<SignalAttachment>, transcoder: VideoTranscoder?) {
             self.attachmentPromise = AnyPromise(attachmentPromise)
-            self.exportSession = exportSession
+            self.transcoder = transcoder
             super.init()
         }
     }
 
     @objc
     public class func compressVideoAsMp4(dataSource: DataSource, dataUTI: String) -> VideoCompressionResult {
-        let (attachmentPromise, exportSession) = compressVideoAsMp4(dataSource: dataSource, dataUTI: dataUTI)
-        return VideoCompressionResult(attachmentPromise: attachmentPromise, exportSession: exportSession)
+        let (attachmentPromise, transcoder) = compressVideoAsMp4(dataSource: dataSource, dataUTI: dataUTI)
+        return VideoCompressionResult(attachmentPromise: attachmentPromise, transcoder: transcoder)
     }
 
     @objc
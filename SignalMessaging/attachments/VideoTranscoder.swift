@@ -0,0 +1,362 @@
+//
+//  Copyright (c) 2020 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+import AVFoundation
+import PromiseKit
+import SignalServiceKit
+
+// Transcodes a video to an H.264/AAC mp4 that fits within a byte budget.
+//
+// Unlike an export preset, the bitrate is chosen from the video's duration
+// and the budget, so the output size is predictable, and a video that is
+// too long to send at a watchable bitrate is rejected before any work is
+// done. The resolution follows the bitrate, since a small bitrate spread
+// over many pixels looks worse than a smaller picture.
+//
+// Samples are decoded by an AVAssetReader and re-encoded by an
+// AVAssetWriter, which use the hardware codecs where available.
+@objc
+public class VideoTranscoder: NSObject {
+
+    public enum TranscodeError: Error {
+        case invalidInput
+        case durationTooLong
+        case transcodeFailed
+        case cancelled
+    }
+
+    public struct Settings: Equatable {
+        public let videoBitRate: Int
+        public let audioBitRate: Int
+        // Even, and in the orientation of the source track.
+        public let dimensions: CGSize
+    }
+
+    // Leaves room for the container and for the encoder overshooting its
+    // average bitrate.
+    private static let budgetMargin: Double = 0.9
+    // Past this, more bits don't visibly improve a phone-sized video.
+    private static let maxVideoBitRate: Double = 1_500_000
+    // Below this, the video isn't worth sending.
+    private static let minVideoBitRate: Double = 150_000
+    private static let audioBitRate = 64_000
+    private static let lowAudioBitRate = 32_000
+    // The longer side of the output for each video bitrate.
+    private static let dimensionTiers: [(minVideoBitRate: Double, dimension: CGFloat)] = [
+        (1_000_000, 1280),
+        (500_000, 960),
+        (250_000, 640),
+        (0, 480)
+    ]
+    private static let audioSampleRate = 44100
+    private static let keyFrameInterval: TimeInterval = 2
+
+    private let asset: AVAsset
+    private let outputURL: URL
+    private let maxByteCount: UInt
+
+    @objc
+    public let progress: Progress
+
+    private let serialQueue = DispatchQueue(label: "org.signal.videoTranscoder")
+    private let videoQueue = DispatchQueue(label: "org.signal.videoTranscoder.video")
+    private let audioQueue = DispatchQueue(label: "org.signal.videoTranscoder.audio")
+
+    // Should only be accessed on serialQueue.
+    private var reader: AVAssetReader?
+    private var writer: AVAssetWriter?
+
+    private let _isCancelled = AtomicBool(false)
+
+    public init(asset: AVAsset, outputURL: URL, maxByteCount: UInt) {
+        self.asset = asset
+        self.outputURL = outputURL
+        self.maxByteCount = maxByteCount
+        self.progress = Progress(totalUnitCount: 1000)
+
+        super.init()
+
+        progress.isCancellable = true
+        progress.cancellationHandler = { [weak self] in
+            self?.cancel()
+        }
+    }
+
+    // Returns nil if the video can't fit the budget at the lowest bitrate
+    // we'll send.
+    public class func settings(duration: TimeInterval,
+                               naturalSize: CGSize,
+                               sourceVideoBitRate: Float?,
+                               hasAudio: Bool,
+                               maxByteCount: UInt) -> Settings? {
+        guard duration > 0, naturalSize.width > 0, naturalSize.height > 0 else {
+            return nil
+        }
+
+        let totalBitRate = Double(maxByteCount) * 8 * budgetMargin / duration
+        var audioBitRate = 0
+        if hasAudio {
+            audioBitRate = totalBitRate >= maxVideoBitRate / 2 ? self.audioBitRate : lowAudioBitRate
+        }
+        let availableVideoBitRate = min(totalBitRate - Double(audioBitRate), maxVideoBitRate)
+        guard availableVideoBitRate >= minVideoBitRate else {
+            return nil
+        }
+        // Don't spend more bits than the source has.
+        var videoBitRate = availableVideoBitRate
+        if let sourceVideoBitRate = sourceVideoBitRate, sourceVideoBitRate > 0 {
+            videoBitRate = min(videoBitRate, max(Double(sourceVideoBitRate), minVideoBitRate))
+        }
+
+        let maxDimension = dimensionTiers.first { videoBitRate >= $0.minVideoBitRate }?.dimension ?? 480
+        let scale = min(1, maxDimension / max(naturalSize.width, naturalSize.height))
+        let evenDimension = { (value: CGFloat) -> CGFloat in
+            return max(2, (value * scale / 2).rounded() * 2)
+        }
+        return Settings(videoBitRate: Int(videoBitRate),
+                        audioBitRate: audioBitRate,
+                        dimensions: CGSize(width: evenDimension(naturalSize.width),
+                                           height: evenDimension(naturalSize.height)))
+    }
+
+    // The output is deleted if the transcode fails or is cancelled.
+    public func transcode() -> Promise<Void> {
+        let (promise, resolver) = Promise<Void>.pending()
+        serialQueue.async {
+            do {
+                try self.start(resolver: resolver)
+            } catch {
+                self.fail(error: error, resolver: resolver)
+            }
+        }
+        return promise
+    }
+
+    @objc
+    public func cancel() {
+        do {
+            try _isCancelled.transition(from: false, to: true)
+        } catch {
+            return
+        }
+        serialQueue.async {
+            // The pumps will find no more samples and finish.
+            self.reader?.cancelReading()
+        }
+    }
+
+    private var isCancelled: Bool {
+        return _isCancelled.get()
+    }
+
+    // MARK: -
+
+    private func start(resolver: Resolver<Void>) throws {
+        assertOnQueue(serialQueue)
+
+        guard !isCancelled else {
+            throw TranscodeError.cancelled
+        }
+        guard let videoTrack = asset.tracks(withMediaType: .video).first else {
+            Logger.warn("Video has no video track.")
+            throw TranscodeError.invalidInput
+        }
+        let audioTrack = asset.tracks(withMediaType: .audio).first
+        let duration = asset.duration.seconds
+        guard duration > 0, videoTrack.naturalSize.width > 0, videoTrack.naturalSize.height > 0 else {
+            Logger.warn("Video has no duration or dimensions.")
+            throw TranscodeError.invalidInput
+        }
+        let sourceVideoBitRate = videoTrack.estimatedDataRate
+        guard let settings = VideoTranscoder.settings(duration: duration,
+                                                      naturalSize: videoTrack.naturalSize,
+                                                      sourceVideoBitRate: sourceVideoBitRate,
+                                                      hasAudio: audioTrack != nil,
+                                                      maxByteCount: maxByteCount) else {
+            Logger.warn("Video is too long to send: \(duration)s.")
+            throw TranscodeError.durationTooLong
+        }
+        Logger.info("Transcoding \(Int(duration))s video at \(settings.videoBitRate / 1000)kbps, \(Int(settings.dimensions.width))x\(Int(settings.dimensions.height)).")
+
+        _ = OWSFileSystem.deleteFileIfExists(outputURL.path)
+        let reader = try AVAssetReader(asset: asset)
+        let writer = try AVAssetWriter(outputURL: outputURL, fileType: .mp4)
+        writer.shouldOptimizeForNetworkUse = true
+        writer.metadata = []
+        self.reader = reader
+        self.writer = writer
+
+        let videoOutput = AVAssetReaderTrackOutput(track: videoTrack, outputSettings: [
+            kCVPixelBufferPixelFormatTypeKey as String: kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange
+        ])
+        videoOutput.alwaysCopiesSampleData = false
+        var compressionProperties: [String: Any] = [
+            AVVideoAverageBitRateKey: settings.videoBitRate,
+            AVVideoProfileLevelKey: AVVideoProfileLevelH264HighAutoLevel,
+            AVVideoMaxKeyFrameIntervalDurationKey: VideoTranscoder.keyFrameInterval
+        ]
+        if videoTrack.nominalFrameRate > 0 {
+            compressionProperties[AVVideoExpectedSourceFrameRateKey] = videoTrack.nominalFrameRate
+        }
+        let videoInput = AVAssetWriterInput(mediaType: .video, outputSettings: [
+            AVVideoCodecKey: AVVideoCodecType.h264,
+            AVVideoWidthKey: settings.dimensions.width,
+            AVVideoHeightKey: settings.dimensions.height,
+            AVVideoScalingModeKey: AVVideoScalingModeResizeAspect,
+            AVVideoCompressionPropertiesKey: compressionProperties
+        ])
+        videoInput.expectsMediaDataInRealTime = false
+        videoInput.transform = videoTrack.preferredTransform
+        guard reader.canAdd(videoOutput), writer.canAdd(videoInput) else {
+            owsFailDebug("Could not add video track.")
+            throw TranscodeError.transcodeFailed
+        }
+        reader.add(videoOutput)
+        writer.add(videoInput)
+
+        var audioPump: (AVAssetReaderOutput, AVAssetWriterInput)?
+        if let audioTrack = audioTrack {
+            let channelCount = min(2, VideoTranscoder.channelCount(track: audioTrack))
+            let audioOutput = AVAssetReaderTrackOutput(track: audioTrack, outputSettings: [
+                AVFormatIDKey: kAudioFormatLinearPCM,
+                AVSampleRateKey: VideoTranscoder.audioSampleRate,
+                AVNumberOfChannelsKey: channelCount
+            ])
+            audioOutput.alwaysCopiesSampleData = false
+            let audioInput = AVAssetWriterInput(mediaType: .audio, outputSettings: [
+                AVFormatIDKey: kAudioFormatMPEG4AAC,
+                AVSampleRateKey: VideoTranscoder.audioSampleRate,
+                AVNumberOfChannelsKey: channelCount,
+                AVEncoderBitRateKey: settings.audioBitRate
+            ])
+            audioInput.expectsMediaDataInRealTime = false
+            if reader.canAdd(audioOutput), writer.canAdd(audioInput) {
+                reader.add(audioOutput)
+                writer.add(audioInput)
+                audioPump = (audioOutput, audioInput)
+            } else {
+                // Better to send the video without its audio than not at all.
+                owsFailDebug("Could not add audio track.")
+            }
+        }
+
+        guard reader.startReading() else {
+            Logger.warn("Could not start reading: \(String(describing: reader.error))")
+            throw TranscodeError.invalidInput
+        }
+        guard writer.startWriting() else {
+            owsFailDebug("Could not start writing: \(String(describing: writer.error))")
+            throw TranscodeError.transcodeFailed
+        }
+        writer.startSession(atSourceTime: videoTrack.timeRange.start)
+
+        let group = DispatchGroup()
+        let startTime = videoTrack.timeRange.start.seconds
+        pump(output: videoOutput, input: videoInput, queue: videoQueue, group: group) { [weak self] presentationTime in
+            guard let self = self, duration > 0 else {
+                return
+            }
+            let fractionCompleted = min(1, max(0, (presentationTime.seconds - startTime) / duration))
+            self.progress.completedUnitCount = Int64(fractionCompleted * Double(self.progress.totalUnitCount))
+        }
+        if let (audioOutput, audioInput) = audioPump {
+            pump(output: audioOutput, input: audioInput, queue: audioQueue, group: group, sampleBlock: nil)
+        }
+
+        group.notify(queue: serialQueue) {
+            self.finish(resolver: resolver)
+        }
+    }
+
+    // Appends samples to the input whenever it can take them, until the
+    // output runs out.
+    private func pump(output: AVAssetReaderOutput,
+                      input: AVAssetWriterInput,
+                      queue: DispatchQueue,
+                      group: DispatchGroup,
+                      sampleBlock: ((CMTime) -> Void)?) {
+        group.enter()
+        // Should only be accessed on queue.
+        var isFinished = false
+        input.requestMediaDataWhenReady(on: queue) {
+            guard !isFinished else {
+                return
+            }
+            while input.isReadyForMoreMediaData {
+                guard !self.isCancelled,
+                    let sampleBuffer = output.copyNextSampleBuffer(),
+                    input.append(sampleBuffer) else {
+                        isFinished = true
+                        input.markAsFinished()
+                        group.leave()
+                        return
+                }
+                sampleBlock?(CMSampleBufferGetPresentationTimeStamp(sampleBuffer))
+            }
+        }
+    }
+
+    private func finish(resolver: Resolver<Void>) {
+        assertOnQueue(serialQueue)
+
+        guard let reader = reader, let writer = writer else {
+            owsFailDebug("Missing reader or writer.")
+            fail(error: TranscodeError.transcodeFailed, resolver: resolver)
+            return
+        }
+        guard !isCancelled else {
+            fail(error: TranscodeError.cancelled, resolver: resolver)
+            return
+        }
+        guard reader.status == .completed else {
+            Logger.warn("Reading failed: \(String(describing: reader.error))")
+            fail(error: TranscodeError.invalidInput, resolver: resolver)
+            return
+        }
+        guard writer.status == .writing else {
+            owsFailDebug("Writing failed: \(String(describing: writer.error))")
+            fail(error: TranscodeError.transcodeFailed, resolver: resolver)
+            return
+        }
+
+        writer.finishWriting {
+            self.serialQueue.async {
+                guard writer.status == .completed else {
+                    owsFailDebug("Could not finish writing: \(String(describing: writer.error))")
+                    self.fail(error: TranscodeError.transcodeFailed, resolver: resolver)
+                    return
+                }
+                self.reader = nil
+                self.writer = nil
+                self.progress.completedUnitCount = self.progress.totalUnitCount
+                resolver.fulfill(())
+            }
+        }
+    }
+
+    private func fail(error: Error, resolver: Resolver<Void>) {
+        assertOnQueue(serialQueue)
+
+        reader?.cancelReading()
+        if let writer = writer, writer.status == .writing {
+            writer.cancelWriting()
+        }
+        reader = nil
+        writer = nil
+        _ = OWSFileSystem.deleteFileIfExists(outputURL.path)
+        resolver.reject(error)
+    }
+
+    private class func channelCount(track: AVAssetTrack) -> Int {
+        for formatDescription in track.formatDescriptions {
+            // formatDescriptions is declared as [Any].
+            let audioFormatDescription = formatDescription as! CMAudioFormatDescription
+            if let streamDescription = CMAudioFormatDescriptionGetStreamBasicDescription(audioFormatDescription) {
+                return max(1, Int(streamDescription.pointee.mChannelsPerFrame))
+            }
+        }
+        return 2
+    }
+}
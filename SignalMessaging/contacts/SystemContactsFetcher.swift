@@ -109,7 +109,7 @@ class ContactsFrameworkContactStoreAdaptee: NSObject, ContactStoreAdaptee {
             return .error(error)
         }
 
-        let contacts = systemContacts.map { Contact(systemContact: $0) }
+        let contacts = Contact.contacts(withSystemContacts: systemContacts)
         return .success(contacts)
     }
 
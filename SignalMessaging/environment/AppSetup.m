@@ -43,6 +43,9 @@ NS_ASSUME_NONNULL_BEGIN
 
     static dispatch_once_t onceToken;
     dispatch_once(&onceToken, ^{
+        LaunchTrace *launchTrace = LaunchTrace.shared;
+        [launchTrace startPhase:@"Environment setup"];
+
         // Order matters here.
         //
         // All of these "singletons" should have any dependencies used in their
@@ -174,7 +177,13 @@ NS_ASSUME_NONNULL_BEGIN
         NSObject *sleepBlockObject = [NSObject new];
         [DeviceSleepManager.sharedInstance addBlockWithBlockObject:sleepBlockObject];
 
+        [launchTrace completePhase:@"Environment setup"];
+
         dispatch_block_t completionBlock = ^{
+            if (databaseStorage.canLoadYdb) {
+                [launchTrace completePhase:@"Register YDB extensions"];
+            }
+
             if (StorageCoordinator.dataStoreForUI == DataStoreYdb) {
                 // It's only safe to do this for YDB. For GRDB-only users in
                 // the post yap world, the tables for this won't exist yet on
@@ -186,20 +195,28 @@ NS_ASSUME_NONNULL_BEGIN
                 if (AppSetup.shouldTruncateGrdbWal) {
                     // Try to truncate GRDB WAL before any readers or writers are
                     // active.
+                    [launchTrace startPhase:@"Truncate GRDB WAL"];
                     NSError *_Nullable error;
                     [databaseStorage.grdbStorage syncTruncatingCheckpointAndReturnError:&error];
                     if (error != nil) {
                         OWSFailDebug(@"error: %@", error);
                     }
+                    [launchTrace completePhase:@"Truncate GRDB WAL"];
                 }
 
                 dispatch_async(dispatch_get_main_queue(), ^{
-                    [storageCoordinator markStorageSetupAsComplete];
+                    [launchTrace tracePhase:@"Mark storage setup as complete"
+                                      block:^{
+                                          [storageCoordinator markStorageSetupAsComplete];
+                                      }];
 
                     // Don't start database migrations until storage is ready.
+                    [launchTrace startPhase:@"Version migrations"];
                     [VersionMigrations performUpdateCheckWithCompletion:^() {
                         OWSAssertIsOnMainThread();
 
+                        [launchTrace completePhase:@"Version migrations"];
+
                         [DeviceSleepManager.sharedInstance removeBlockWithBlockObject:sleepBlockObject];
 
                         if (StorageCoordinator.dataStoreForUI == DataStoreGrdb) {
@@ -215,6 +232,7 @@ NS_ASSUME_NONNULL_BEGIN
         };
 
         if (databaseStorage.canLoadYdb) {
+            [launchTrace startPhase:@"Register YDB extensions"];
             [OWSStorage registerExtensionsWithCompletionBlock:completionBlock];
         } else {
             completionBlock();
@@ -17,7 +17,9 @@ NS_ASSUME_NONNULL_BEGIN
 
 @interface SSKSessionStore (PrivateMethodsForMigration)
 
-@property (nonatomic, readonly) SDSKeyValueStore *keyValueStore;
+@property (nonatomic, readonly) SDSKeyValueStore *legacyKeyValueStore;
+@property (nonatomic, readonly) SDSKeyValueStore *deviceSessionStore;
+@property (nonatomic, readonly) SDSKeyValueStore *deviceIdStore;
 
 @end
 
@@ -40,11 +40,23 @@ public class GRDBMigratorGroup: NSObject {
 
     private let block: MigratorBlock
 
+    // Consecutive "independent" groups don't depend on each other's
+    // output and are migrated concurrently, each with its own YDB
+    // read connection. GRDB writes are still serialized by the pool,
+    // but YDB enumeration and deserialization overlap.
+    let isIndependent: Bool
+
     @objc
-    public required init(block: @escaping MigratorBlock) {
+    public required init(isIndependent: Bool, block: @escaping MigratorBlock) {
+        self.isIndependent = isIndependent
         self.block = block
     }
 
+    @objc
+    public convenience init(block: @escaping MigratorBlock) {
+        self.init(isIndependent: false, block: block)
+    }
+
     func migrators(ydbTransaction: YapDatabaseReadTransaction) -> [GRDBMigrator] {
         return block(ydbTransaction)
     }
@@ -132,31 +144,50 @@ extension YDBToGRDBMigration {
             GRDBMigratorGroup { ydbTransaction in
                 return self.allUnorderedRecordMigrators(ydbTransaction: ydbTransaction)
             },
-            GRDBMigratorGroup { ydbTransaction in
+            //
+            // The remaining groups only depend on the groups above, not
+            // on each other, so they can be migrated concurrently.
+            GRDBMigratorGroup(isIndependent: true) { ydbTransaction in
                 return [GRDBJobRecordMigrator(ydbTransaction: ydbTransaction)]
             },
-            GRDBMigratorGroup { ydbTransaction in
+            GRDBMigratorGroup(isIndependent: true) { ydbTransaction in
                 return [GRDBInteractionMigrator(ydbTransaction: ydbTransaction)]
             },
-            GRDBMigratorGroup { ydbTransaction in
+            GRDBMigratorGroup(isIndependent: true) { ydbTransaction in
                 return [GRDBDecryptJobMigrator(ydbTransaction: ydbTransaction)]
             }
         ]
 
         GRDBSchemaMigrator().runSchemaMigrations()
 
+        // From this point on, an interrupted migration can be resumed
+        // from its last committed batch on the next launch.
+        SSKPreferences.setIsYdbMigrationResumable(true)
+
         try self.migrate(migratorGroups: migratorGroups)
 
         try storage.write { transaction in
+            guard !GRDBMigrationCheckpoint.isComplete(label: GRDBMigrationCheckpoint.galleryRecordsLabel,
+                                                      transaction: transaction) else {
+                return
+            }
             do {
                 try createInitialGalleryRecords(transaction: transaction)
             } catch {
                 owsFail("error: \(error)")
             }
+            GRDBMigrationCheckpoint.markComplete(label: GRDBMigrationCheckpoint.galleryRecordsLabel,
+                                                 transaction: transaction)
         }
 
         removeYdb()
 
+        // Only discard the checkpoints once the migration can no longer
+        // be resumed.
+        try storage.write { transaction in
+            GRDBMigrationCheckpoint.removeAll(transaction: transaction)
+        }
+
         let migrationDuration = abs(startDate.timeIntervalSinceNow)
         Logger.info("Migration duration: \(OWSFormat.formatDurationSeconds(Int(migrationDuration))) (\(migrationDuration))")
     }
@@ -172,6 +203,7 @@ extension YDBToGRDBMigration {
         // since the GRDB database is considered disposable until this flag
         // is set if there are YDB files.
         SSKPreferences.setIsYdbMigrated(true)
+        SSKPreferences.setIsYdbMigrationResumable(false)
 
         guard !FeatureFlags.preserveYdb else {
             return
@@ -210,26 +242,94 @@ extension YDBToGRDBMigration {
         // GRDB at least supports nesting multiple database transactions, but the _both_
         // have to be accessed via GRDB
         //
-        // TODO: see if we can get reasonable perf by avoiding the nested transactions and
-        // instead doing work in non-overlapping batches.
+        // Large migrators avoid one giant GRDB transaction by committing
+        // in bounded batches; see GRDBMigrationBatcher.
+
+        UIDatabaseObserver.serializedSync {
+            UIDatabaseObserver.skipTouchObservations = true
+        }
+
+        // Logging queries is helpful for normal debugging, but expensive during a migration
+        SDSDatabaseStorage.shouldLogDBQueries = false
+
+        // Indexing every insert is expensive; build the FTS index
+        // once all records have been migrated.
+        FullTextSearchFinder.setIsIndexingDeferred(true)
+
+        // Group consecutive independent groups into stages which are
+        // migrated concurrently.
+        var stages = [[GRDBMigratorGroup]]()
+        for migratorGroup in migratorGroups {
+            if migratorGroup.isIndependent,
+                let lastStage = stages.last,
+                let lastGroup = lastStage.last,
+                lastGroup.isIndependent {
+                stages[stages.count - 1].append(migratorGroup)
+            } else {
+                stages.append([migratorGroup])
+            }
+        }
+
+        for stage in stages {
+            try migrate(stage: stage)
+        }
+
+        FullTextSearchFinder.setIsIndexingDeferred(false)
+        try buildDeferredFullTextSearchIndex()
+
+        SDSDatabaseStorage.shouldLogDBQueries = FeatureFlags.logSQLQueries
+
+        UIDatabaseObserver.serializedSync {
+            UIDatabaseObserver.skipTouchObservations = false
+        }
+    }
+
+    private func newYdbReadConnection() -> YapDatabaseConnection {
         guard let primaryStorage = primaryStorage else {
             owsFail("Missing primaryStorage.")
         }
         let ydbReadConnection = primaryStorage.newDatabaseConnection()
         ydbReadConnection.ignoreQueues = true
         ydbReadConnection.beginLongLivedReadTransaction()
+        return ydbReadConnection
+    }
 
-        UIDatabaseObserver.serializedSync {
-            UIDatabaseObserver.skipTouchObservations = true
+    private func migrate(stage: [GRDBMigratorGroup]) throws {
+        guard stage.count > 1 else {
+            for migratorGroup in stage {
+                try migrate(migratorGroup: migratorGroup,
+                            ydbReadConnection: newYdbReadConnection())
+            }
+            return
         }
 
-        for migratorGroup in migratorGroups {
-            try migrate(migratorGroup: migratorGroup,
-                        ydbReadConnection: ydbReadConnection)
+        Logger.info("Migrating \(stage.count) groups concurrently.")
+
+        let errorLock = NSLock()
+        var firstError: Error?
+        let dispatchGroup = DispatchGroup()
+        for migratorGroup in stage {
+            // Each group gets its own connection; YDB connections
+            // must not be shared across threads.
+            let ydbReadConnection = newYdbReadConnection()
+            DispatchQueue.global(qos: .userInitiated).async(group: dispatchGroup) {
+                do {
+                    try self.migrate(migratorGroup: migratorGroup,
+                                     ydbReadConnection: ydbReadConnection)
+                } catch {
+                    owsFailDebug("error: \(error)")
+                    errorLock.lock()
+                    if firstError == nil {
+                        firstError = error
+                    }
+                    errorLock.unlock()
+                }
+            }
         }
+        dispatchGroup.wait()
 
-        UIDatabaseObserver.serializedSync {
-            UIDatabaseObserver.skipTouchObservations = false
+        if let error = firstError {
+            throw error
         }
     }
 
@@ -237,22 +337,83 @@ extension YDBToGRDBMigration {
                          ydbReadConnection: YapDatabaseConnection) throws {
         Logger.info("")
 
-        // Logging queries is helpful for normal debugging, but expensive during a migration
-        SDSDatabaseStorage.shouldLogDBQueries = false
-
         try ydbReadConnection.read { ydbTransaction in
             let migrators = migratorGroup.migrators(ydbTransaction: ydbTransaction)
             // Migrate migrators.
             for migrator in migrators {
+                guard !(try self.isComplete(label: migrator.label)) else {
+                    Logger.info("Skipping completed migrator: \(migrator.label)")
+                    continue
+                }
+
                 try autoreleasepool {
-                    try self.storage.write { grdbTransaction in
-                        try! migrator.migrate(grdbTransaction: grdbTransaction)
-                    }
+                    try migrator.migrate(storage: self.storage)
+                }
+                // Migrators are idempotent, so it's safe if we're
+                // terminated before this completion is committed.
+                try self.storage.write { grdbTransaction in
+                    GRDBMigrationCheckpoint.markComplete(label: migrator.label,
+                                                         transaction: grdbTransaction)
                 }
             }
         }
+    }
 
-        SDSDatabaseStorage.shouldLogDBQueries = FeatureFlags.logSQLQueries
+    private func buildDeferredFullTextSearchIndex() throws {
+        try Bench(title: "Build FTS index", logInProduction: true) {
+            // An interrupted post-pass (or migrators which were skipped
+            // when resuming) can leave a partial index behind, so always
+            // start over from an empty index.
+            try storage.write { grdbTransaction in
+                FullTextSearchFinder.removeAllIndexEntries(transaction: grdbTransaction)
+            }
+
+            try indexAllModels(collection: TSThread.collection(),
+                               allUniqueIds: { TSThread.anyAllUniqueIds(transaction: $0) },
+                               fetch: { TSThread.anyFetch(uniqueId: $0, transaction: $1) })
+            try indexAllModels(collection: SignalAccount.collection(),
+                               allUniqueIds: { SignalAccount.anyAllUniqueIds(transaction: $0) },
+                               fetch: { SignalAccount.anyFetch(uniqueId: $0, transaction: $1) })
+            try indexAllModels(collection: TSInteraction.collection(),
+                               allUniqueIds: { TSInteraction.anyAllUniqueIds(transaction: $0) },
+                               fetch: { TSInteraction.anyFetch(uniqueId: $0, transaction: $1) })
+        }
+    }
+
+    private func isComplete(label: String) throws -> Bool {
+        var result = false
+        try storage.read { grdbTransaction in
+            result = GRDBMigrationCheckpoint.isComplete(label: label, transaction: grdbTransaction)
+        }
+        return result
+    }
+
+    private func indexAllModels(collection: String,
+                                allUniqueIds: (SDSAnyReadTransaction) -> [String],
+                                fetch: @escaping (String, SDSAnyReadTransaction) -> SDSModel?) throws {
+        var uniqueIds = [String]()
+        try storage.read { grdbTransaction in
+            uniqueIds = allUniqueIds(grdbTransaction.asAnyRead)
+        }
+        Logger.info("Indexing \(collection): \(uniqueIds.count)")
+
+        var batchStart = 0
+        while batchStart < uniqueIds.count {
+            let batchEnd = min(batchStart + GRDBMigrationCheckpoint.batchSize, uniqueIds.count)
+            let batch = uniqueIds[batchStart..<batchEnd]
+            try autoreleasepool {
+                try storage.write { grdbTransaction in
+                    for uniqueId in batch {
+                        guard let model = fetch(uniqueId, grdbTransaction.asAnyRead) else {
+                            owsFailDebug("Missing model: \(uniqueId)")
+                            continue
+                        }
+                        FullTextSearchFinder.indexModel(model, transaction: grdbTransaction)
+                    }
+                }
+            }
+            batchStart = batchEnd
+        }
     }
 
     private func allKeyValueMigrators(ydbTransaction: YapDatabaseReadTransaction) -> [GRDBMigrator] {
@@ -265,7 +426,9 @@ extension YDBToGRDBMigration {
 
             GRDBKeyValueStoreMigrator<ECKeyPair>(label: "ownIdentity", keyStore: identityManager.ownIdentityKeyValueStore, ydbTransaction: ydbTransaction),
 
-            GRDBKeyValueStoreMigrator<[Int: SessionRecord]>(label: "sessionStore", keyStore: sessionStore.keyValueStore, ydbTransaction: ydbTransaction),
+            GRDBKeyValueStoreMigrator<[Int: SessionRecord]>(label: "sessionStore", keyStore: sessionStore.legacyKeyValueStore, ydbTransaction: ydbTransaction),
+            GRDBKeyValueStoreMigrator<SessionRecord>(label: "sessionStore deviceSessions", keyStore: sessionStore.deviceSessionStore, ydbTransaction: ydbTransaction),
+            GRDBKeyValueStoreMigrator<[NSNumber]>(label: "sessionStore deviceIds", keyStore: sessionStore.deviceIdStore, ydbTransaction: ydbTransaction),
 
             GRDBKeyValueStoreMigrator<String>(label: "queuedVerificationStateSyncMessages", keyStore: identityManager.queuedVerificationStateSyncMessagesKeyValueStore, ydbTransaction: ydbTransaction),
 
@@ -408,13 +571,14 @@ private class LegacyInteractionFinder {
     }
 
     // We need to enumerate in ascending order of sort id.
-    public func enumerateLegacyKeysAndObjects(block: @escaping (String, TSInteraction) -> Void ) throws {
+    public func enumerateLegacyKeysAndObjects(block: @escaping (String, TSInteraction) throws -> Void ) throws {
         guard let view = transaction.safeAutoViewTransaction(TSInteractionsBySortIdDatabaseViewExtensionName) else {
             owsFail("Missing interaction view.")
         }
         var knownUniqueIds = Set<String>()
+        var errorToRaise: Error?
         view.safe_enumerateKeysAndObjects(inGroup: TSInteractionsBySortIdGroup,
-                                          extensionName: TSInteractionsBySortIdDatabaseViewExtensionName) { (_, _, object, _, _) in
+                                          extensionName: TSInteractionsBySortIdDatabaseViewExtensionName) { (_, _, object, _, stopPtr) in
                                             guard let interaction = object as? TSInteraction else {
                                                 owsFailDebug("unexpected interaction: \(type(of: object))")
                                                 return
@@ -428,7 +592,17 @@ private class LegacyInteractionFinder {
                                             }
                                             knownUniqueIds.insert(uniqueId)
 
-                                            block(uniqueId, interaction)
+                                            do {
+                                                try block(uniqueId, interaction)
+                                            } catch {
+                                                owsFailDebug("error: \(error)")
+                                                errorToRaise = error
+                                                stopPtr.pointee = true
+                                            }
+        }
+
+        if let errorToRaise = errorToRaise {
+            throw errorToRaise
         }
     }
 }
@@ -535,7 +709,9 @@ public protocol GRDBMigrator {
 
     var count: UInt { get }
 
-    func migrate(grdbTransaction: GRDBWriteTransaction) throws
+    // Migrators must be idempotent; a migrator may be re-run if the
+    // app is terminated before its completion is checkpointed.
+    func migrate(storage: GRDBDatabaseStorageAdapter) throws
 }
 
 extension GRDBMigrator {
@@ -551,6 +727,123 @@ extension GRDBMigrator {
     }
 }
 
+// MARK: - Checkpoints
+
+// Large migrators commit their work in bounded batches rather than in
+// one giant GRDB transaction. Each batch records a resume cursor (the
+// number of legacy records enumerated so far) in the same transaction
+// as the batch itself, so an interrupted migration can resume from
+// its last committed batch on the next launch.
+//
+// This relies on YDB enumeration order being stable, which holds since
+// YDB is read-only once the migration has begun.
+class GRDBMigrationCheckpoint {
+
+    static let batchSize = 1000
+
+    static let galleryRecordsLabel = "Create gallery records"
+
+    private static let keyValueStore = SDSKeyValueStore(collection: "YDBToGRDBMigration.checkpoint")
+
+    private class func completionKey(label: String) -> String {
+        return "complete.\(label)"
+    }
+
+    private class func cursorKey(label: String) -> String {
+        return "cursor.\(label)"
+    }
+
+    class func isComplete(label: String, transaction: GRDBReadTransaction) -> Bool {
+        return keyValueStore.getBool(completionKey(label: label),
+                                     defaultValue: false,
+                                     transaction: transaction.asAnyRead)
+    }
+
+    class func markComplete(label: String, transaction: GRDBWriteTransaction) {
+        keyValueStore.setBool(true, key: completionKey(label: label), transaction: transaction.asAnyWrite)
+        keyValueStore.removeValue(forKey: cursorKey(label: label), transaction: transaction.asAnyWrite)
+    }
+
+    class func cursor(label: String, transaction: GRDBReadTransaction) -> UInt {
+        return keyValueStore.getUInt(cursorKey(label: label),
+                                     defaultValue: 0,
+                                     transaction: transaction.asAnyRead)
+    }
+
+    class func setCursor(_ cursor: UInt, label: String, transaction: GRDBWriteTransaction) {
+        keyValueStore.setUInt(cursor, key: cursorKey(label: label), transaction: transaction.asAnyWrite)
+    }
+
+    class func removeAll(transaction: GRDBWriteTransaction) {
+        keyValueStore.removeAll(transaction: transaction.asAnyWrite)
+    }
+}
+
+// MARK: -
+
+private class GRDBMigrationBatcher<T> {
+    typealias EnumerationBlock = (@escaping (T) throws -> Void) throws -> Void
+    typealias InsertBlock = (T, GRDBWriteTransaction) -> Void
+
+    private let label: String
+    private let storage: GRDBDatabaseStorageAdapter
+
+    init(label: String, storage: GRDBDatabaseStorageAdapter) {
+        self.label = label
+        self.storage = storage
+    }
+
+    // Enumerates the legacy records, skipping any that were committed
+    // by a previous (interrupted) run, and inserts them in batches.
+    func migrate(enumerate: EnumerationBlock, insert: @escaping InsertBlock) throws -> UInt {
+        let label = self.label
+        let storage = self.storage
+
+        var cursor: UInt = 0
+        try storage.read { transaction in
+            cursor = GRDBMigrationCheckpoint.cursor(label: label, transaction: transaction)
+        }
+        if cursor > 0 {
+            Logger.info("Resuming \(label) after \(cursor) records.")
+        }
+
+        var enumeratedCount: UInt = 0
+        var batch = [T]()
+        batch.reserveCapacity(GRDBMigrationCheckpoint.batchSize)
+
+        let flush: () throws -> Void = {
+            guard !batch.isEmpty else {
+                return
+            }
+            let batchCursor = enumeratedCount
+            try autoreleasepool {
+                try storage.write { transaction in
+                    for item in batch {
+                        insert(item, transaction)
+                    }
+                    GRDBMigrationCheckpoint.setCursor(batchCursor, label: label, transaction: transaction)
+                }
+            }
+            batch.removeAll(keepingCapacity: true)
+        }
+
+        try enumerate { item in
+            enumeratedCount += 1
+            guard enumeratedCount > cursor else {
+                // Already migrated.
+                return
+            }
+            batch.append(item)
+            if batch.count >= GRDBMigrationCheckpoint.batchSize {
+                try flush()
+            }
+        }
+        try flush()
+
+        return enumeratedCount
+    }
+}
+
 // MARK: -
 
 public class GRDBKeyValueStoreMigrator<T>: GRDBMigrator {
@@ -568,7 +861,14 @@ public class GRDBKeyValueStoreMigrator<T>: GRDBMigrator {
         return finder.count
     }
 
-    public func migrate(grdbTransaction: GRDBWriteTransaction) throws {
+    // Key-value stores are small; they are migrated in a single transaction.
+    public func migrate(storage: GRDBDatabaseStorageAdapter) throws {
+        try storage.write { grdbTransaction in
+            try! self.migrate(grdbTransaction: grdbTransaction)
+        }
+    }
+
+    private func migrate(grdbTransaction: GRDBWriteTransaction) throws {
         let count = self.count
         Logger.info("\(label): \(count)")
         try Bench(title: label, memorySamplerRatio: memorySamplerRatio(count: count), logInProduction: true) { memorySampler in
@@ -602,16 +902,19 @@ public class GRDBUnorderedRecordMigrator<T>: GRDBMigrator where T: SDSModel {
         return finder.count
     }
 
-    public func migrate(grdbTransaction: GRDBWriteTransaction) throws {
+    public func migrate(storage: GRDBDatabaseStorageAdapter) throws {
         let count = self.count
         Logger.info("\(label): \(count)")
         try Bench(title: label, memorySamplerRatio: memorySamplerRatio(count: count), logInProduction: true) { memorySampler in
-            var recordCount = 0
-            try finder.enumerateLegacyKeysAndObjects { (_, legacyRecord) in
-                recordCount += 1
+            let batcher = GRDBMigrationBatcher<T>(label: label, storage: storage)
+            let recordCount = try batcher.migrate(enumerate: { block in
+                try self.finder.enumerateLegacyKeysAndObjects { (_, legacyRecord) in
+                    try block(legacyRecord)
+                }
+            }, insert: { legacyRecord, grdbTransaction in
                 legacyRecord.anyInsert(transaction: grdbTransaction.asAnyWrite)
                 memorySampler.sample()
-            }
+            })
             Logger.info("Completed with recordCount: \(recordCount)")
         }
     }
@@ -632,16 +935,17 @@ public class GRDBJobRecordMigrator: GRDBMigrator {
         return finder.count
     }
 
-    public func migrate(grdbTransaction: GRDBWriteTransaction) throws {
+    public func migrate(storage: GRDBDatabaseStorageAdapter) throws {
         let count = self.count
         Logger.info("\(label): \(count)")
         try Bench(title: label, memorySamplerRatio: memorySamplerRatio(count: count), logInProduction: true) { memorySampler in
-            var recordCount = 0
-            try finder.enumerateJobRecords { legacyRecord in
-                recordCount += 1
+            let batcher = GRDBMigrationBatcher<SSKJobRecord>(label: label, storage: storage)
+            let recordCount = try batcher.migrate(enumerate: { block in
+                try self.finder.enumerateJobRecords(block: block)
+            }, insert: { legacyRecord, grdbTransaction in
                 legacyRecord.anyInsert(transaction: grdbTransaction.asAnyWrite)
                 memorySampler.sample()
-            }
+            })
             Logger.info("Completed with recordCount: \(recordCount)")
         }
     }
@@ -662,42 +966,49 @@ public class GRDBInteractionMigrator: GRDBMigrator {
         return finder.count
     }
 
-    public func migrate(grdbTransaction: GRDBWriteTransaction) throws {
+    public func migrate(storage: GRDBDatabaseStorageAdapter) throws {
         let count = self.count
         Logger.info("\(label): \(count)")
         var prevSortId: UInt64?
         try Bench(title: label, memorySamplerRatio: memorySamplerRatio(count: count), logInProduction: true) { memorySampler in
-            var recordCount = 0
+            let batcher = GRDBMigrationBatcher<TSInteraction>(label: label, storage: storage)
             // This must enumerate the interactions in ascending order of sort id.
-            try finder.enumerateLegacyKeysAndObjects { (_, interaction) in
-
-                // Ensure all interactions have valid, monotonically increasing sort ids.
-                let minSortId: UInt64
-                if let previousSortId = prevSortId {
-                    minSortId = previousSortId + 1
-                } else {
-                    minSortId = 1
-                }
-                let sortId: UInt64
-                if interaction.sortId >= minSortId {
-                    // Interaction already has valid sort id.
-                    sortId = interaction.sortId
-                } else {
-                    if interaction.sortId > 0 {
-                        owsFailDebug("Replacing invalid sort id: \(interaction.sortId) -> \(minSortId)")
+            let recordCount = try batcher.migrate(enumerate: { block in
+                try self.finder.enumerateLegacyKeysAndObjects { (_, interaction) in
+
+                    // Ensure all interactions have valid, monotonically increasing sort ids.
+                    //
+                    // NOTE: This is applied to every enumerated interaction,
+                    //       including those skipped when resuming, so the
+                    //       assigned sort ids are deterministic across runs.
+                    let minSortId: UInt64
+                    if let previousSortId = prevSortId {
+                        minSortId = previousSortId + 1
                     } else {
-                        owsFailDebug("Setting missing sort id: \(minSortId)")
+                        minSortId = 1
                     }
-                    // NOTE: "replaced" sort ids will not be written to YDB.
-                    interaction.replaceSortId(minSortId)
-                    sortId = minSortId
-                }
-                prevSortId = sortId
+                    let sortId: UInt64
+                    if interaction.sortId >= minSortId {
+                        // Interaction already has valid sort id.
+                        sortId = interaction.sortId
+                    } else {
+                        if interaction.sortId > 0 {
+                            owsFailDebug("Replacing invalid sort id: \(interaction.sortId) -> \(minSortId)")
+                        } else {
+                            owsFailDebug("Setting missing sort id: \(minSortId)")
+                        }
+                        // NOTE: "replaced" sort ids will not be written to YDB.
+                        interaction.replaceSortId(minSortId)
+                        sortId = minSortId
+                    }
+                    prevSortId = sortId
 
+                    try block(interaction)
+                }
+            }, insert: { interaction, grdbTransaction in
                 interaction.anyInsert(transaction: grdbTransaction.asAnyWrite)
-                recordCount += 1
                 memorySampler.sample()
-            }
+            })
             Logger.info("Completed with recordCount: \(recordCount)")
         }
     }
@@ -718,17 +1029,18 @@ public class GRDBDecryptJobMigrator: GRDBMigrator {
         return finder.count
     }
 
-    public func migrate(grdbTransaction: GRDBWriteTransaction) throws {
+    public func migrate(storage: GRDBDatabaseStorageAdapter) throws {
         let count = self.count
         Logger.info("\(label): \(count)")
         try Bench(title: label, memorySamplerRatio: memorySamplerRatio(count: count), logInProduction: true) { memorySampler in
-            var recordCount = 0
-            try finder.enumerateJobRecords { legacyJob in
+            let batcher = GRDBMigrationBatcher<OWSMessageDecryptJob>(label: label, storage: storage)
+            let recordCount = try batcher.migrate(enumerate: { block in
+                try self.finder.enumerateJobRecords(block: block)
+            }, insert: { legacyJob, grdbTransaction in
                 let newJob = SSKMessageDecryptJobRecord(envelopeData: legacyJob.envelopeData, label: SSKMessageDecryptJobQueue.jobRecordLabel)
                 newJob.anyInsert(transaction: grdbTransaction.asAnyWrite)
-                recordCount += 1
                 memorySampler.sample()
-            }
+            })
             Logger.info("Completed with recordCount: \(recordCount)")
         }
     }
@@ -107,6 +107,13 @@ extern const NSUInteger kOWSProfileManager_MaxAvatarDiameter;
                        username:(nullable NSString *)username
                   avatarUrlPath:(nullable NSString *)avatarUrlPath;
 
+// Used to apply several fetched profiles in a single write transaction.
+- (void)updateProfileForAddress:(SignalServiceAddress *)address
+           profileNameEncrypted:(nullable NSData *)profileNameEncrypted
+                       username:(nullable NSString *)username
+                  avatarUrlPath:(nullable NSString *)avatarUrlPath
+                    transaction:(SDSAnyWriteTransaction *)transaction;
+
 #pragma mark - Clean Up
 
 + (NSSet<NSString *> *)allProfileAvatarFilePathsWithTransaction:(SDSAnyReadTransaction *)transaction;
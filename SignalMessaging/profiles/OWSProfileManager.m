@@ -248,6 +248,20 @@ typedef void (^ProfileManagerFailureBlock)(NSError *error);
     return _localUserProfile;
 }
 
+// Unlike localUserProfile, never opens a transaction of its own, so it is
+// safe to use within a write transaction.
+- (OWSUserProfile *)localUserProfileWithTransaction:(SDSAnyWriteTransaction *)transaction
+{
+    @synchronized(self)
+    {
+        if (!_localUserProfile) {
+            _localUserProfile = [OWSUserProfile getOrBuildUserProfileForAddress:OWSUserProfile.localProfileAddress
+                                                                    transaction:transaction];
+        }
+        return _localUserProfile;
+    }
+}
+
 - (BOOL)localProfileExistsWithTransaction:(SDSAnyReadTransaction *)transaction
 {
     return [OWSUserProfile localUserProfileExistsWithTransaction:transaction];
@@ -1544,55 +1558,72 @@ typedef void (^ProfileManagerFailureBlock)(NSError *error);
 
     // Ensure decryption, etc. off main thread.
     dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-        OWSUserProfile *localUserProfile = self.localUserProfile;
-        OWSAssertDebug(localUserProfile);
+        [self ensureLocalProfileCached];
 
-        __block OWSUserProfile *userProfile;
         [self.databaseStorage writeWithBlock:^(SDSAnyWriteTransaction *transaction) {
-            userProfile = [OWSUserProfile getOrBuildUserProfileForAddress:address transaction:transaction];
-
-            // If we're updating the profile that corresponds to our local number,
-            // make sure we're using the latest key.
-            if (address.isLocalAddress) {
-                [userProfile updateWithProfileKey:self.localUserProfile.profileKey
-                                      transaction:transaction
-                                       completion:nil];
-            }
+            [self updateProfileForAddress:address
+                     profileNameEncrypted:profileNameEncrypted
+                                 username:username
+                            avatarUrlPath:avatarUrlPath
+                              transaction:transaction];
+        }];
+    });
+}
 
-            if (!userProfile.profileKey) {
-                [userProfile updateWithUsername:username transaction:transaction];
-                return;
-            }
+- (void)updateProfileForAddress:(SignalServiceAddress *)address
+           profileNameEncrypted:(nullable NSData *)profileNameEncrypted
+                       username:(nullable NSString *)username
+                  avatarUrlPath:(nullable NSString *)avatarUrlPath
+                    transaction:(SDSAnyWriteTransaction *)transaction
+{
+    OWSAssertDebug(address.isValid);
 
-            // Decryption is slightly expensive to do inside this write transaction.
-            NSString *_Nullable profileName =
-                [self decryptProfileNameData:profileNameEncrypted profileKey:userProfile.profileKey];
-
-            [userProfile updateWithProfileName:profileName
-                                      username:username
-                                 avatarUrlPath:avatarUrlPath
-                                   transaction:transaction
-                                    completion:nil];
-
-            // If we're updating the profile that corresponds to our local number,
-            // update the local profile as well.
-            if (address.isLocalAddress) {
-                [localUserProfile updateWithProfileName:profileName
-                                               username:username
-                                          avatarUrlPath:avatarUrlPath
-                                            transaction:transaction
-                                             completion:nil];
-            }
-        }];
+    OWSUserProfile *localUserProfile = [self localUserProfileWithTransaction:transaction];
+    OWSAssertDebug(localUserProfile);
 
-        // Whenever we change avatarUrlPath, OWSUserProfile clears avatarFileName.
-        // So if avatarUrlPath is set and avatarFileName is not set, we should to
-        // download this avatar. downloadAvatarForUserProfile will de-bounce
-        // downloads.
-        if (userProfile.avatarUrlPath.length > 0 && userProfile.avatarFileName.length < 1) {
-            [self downloadAvatarForUserProfile:userProfile noCdn:kAvatarDownloadNoCdn];
-        }
-    });
+    OWSUserProfile *userProfile = [OWSUserProfile getOrBuildUserProfileForAddress:address transaction:transaction];
+
+    // If we're updating the profile that corresponds to our local number,
+    // make sure we're using the latest key.
+    if (address.isLocalAddress) {
+        [userProfile updateWithProfileKey:localUserProfile.profileKey transaction:transaction completion:nil];
+    }
+
+    if (!userProfile.profileKey) {
+        [userProfile updateWithUsername:username transaction:transaction];
+        return;
+    }
+
+    // Decryption is slightly expensive to do inside this write transaction.
+    NSString *_Nullable profileName =
+        [self decryptProfileNameData:profileNameEncrypted profileKey:userProfile.profileKey];
+
+    [userProfile updateWithProfileName:profileName
+                              username:username
+                         avatarUrlPath:avatarUrlPath
+                           transaction:transaction
+                            completion:nil];
+
+    // If we're updating the profile that corresponds to our local number,
+    // update the local profile as well.
+    if (address.isLocalAddress) {
+        [localUserProfile updateWithProfileName:profileName
+                                       username:username
+                                  avatarUrlPath:avatarUrlPath
+                                    transaction:transaction
+                                     completion:nil];
+    }
+
+    // Whenever we change avatarUrlPath, OWSUserProfile clears avatarFileName.
+    // So if avatarUrlPath is set and avatarFileName is not set, we should to
+    // download this avatar. downloadAvatarForUserProfile will de-bounce
+    // downloads.
+    if (userProfile.avatarUrlPath.length > 0 && userProfile.avatarFileName.length < 1) {
+        [transaction addCompletionWithQueue:dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0)
+                                      block:^{
+                                          [self downloadAvatarForUserProfile:userProfile noCdn:kAvatarDownloadNoCdn];
+                                      }];
+    }
 }
 
 - (BOOL)isNullableDataEqual:(NSData *_Nullable)left toData:(NSData *_Nullable)right
@@ -31,6 +31,28 @@ public class ProfileFetchOptions: NSObject {
         self.shouldUpdateProfile = shouldUpdateProfile
     }
 
+    // When two requests for the same subject are coalesced, the
+    // fetch should satisfy both of them.
+    fileprivate func merged(with other: ProfileFetchOptions) -> ProfileFetchOptions {
+        return ProfileFetchOptions(mainAppOnly: mainAppOnly && other.mainAppOnly,
+                                   ignoreThrottling: ignoreThrottling || other.ignoreThrottling,
+                                   shouldUpdateProfile: shouldUpdateProfile || other.shouldUpdateProfile)
+    }
+
+    // Whether a fetch made with these options behaves the same as one
+    // made with the other's. shouldUpdateProfile isn't consulted until
+    // the fetch completes, so it doesn't count.
+    fileprivate func hasSameFetchBehavior(as other: ProfileFetchOptions) -> Bool {
+        return mainAppOnly == other.mainAppOnly && ignoreThrottling == other.ignoreThrottling
+    }
+}
+
+// MARK: -
+
+private enum ProfileFetchPriority {
+    // Fetches for the conversation the user is looking at.
+    case visibleConversation
+    case background
 }
 
 // MARK: -
@@ -97,14 +119,14 @@ public class ProfileFetcherJob: NSObject {
         let options = ProfileFetchOptions(mainAppOnly: mainAppOnly,
                                           ignoreThrottling: ignoreThrottling,
                                           shouldUpdateProfile: shouldUpdateProfile)
-        return ProfileFetcherJob(subject: subject, options: options).runAsPromise()
+        return ProfileFetchScheduler.shared.fetch(subject: subject, options: options, priority: .background)
     }
 
     @objc
     public class func fetchAndUpdateProfile(address: SignalServiceAddress, ignoreThrottling: Bool) {
         let subject = ProfileRequestSubject.address(address: address)
         let options = ProfileFetchOptions(ignoreThrottling: ignoreThrottling)
-        ProfileFetcherJob(subject: subject, options: options).runAsPromise()
+        ProfileFetchScheduler.shared.fetch(subject: subject, options: options, priority: .background)
             .retainUntilComplete()
     }
 
@@ -115,7 +137,7 @@ public class ProfileFetcherJob: NSObject {
                                             failure: @escaping (_ error: Error?) -> Void) {
         let subject = ProfileRequestSubject.username(username: username)
         let options = ProfileFetchOptions(ignoreThrottling: true)
-        ProfileFetcherJob(subject: subject, options: options).runAsPromise()
+        ProfileFetchScheduler.shared.fetch(subject: subject, options: options, priority: .visibleConversation)
             .done { profile in
                 success(profile.address)
             }.catch { error in
@@ -129,21 +151,28 @@ public class ProfileFetcherJob: NSObject {
             .retainUntilComplete()
     }
 
+    // Only used for the conversation the user is viewing, so these
+    // fetches jump ahead of any background fetches.
     @objc(fetchAndUpdateProfilesWithThread:)
     public class func fetchAndUpdateProfiles(thread: TSThread) {
         let addresses = thread.recipientAddresses
         let subjects = addresses.map { ProfileRequestSubject.address(address: $0) }
         let options = ProfileFetchOptions()
-        var promises = [Promise<SignalServiceProfile>]()
         for subject in subjects {
-            let job = ProfileFetcherJob(subject: subject, options: options)
-            promises.append(job.runAsPromise())
+            ProfileFetchScheduler.shared.fetch(subject: subject, options: options, priority: .visibleConversation)
+                .catch { error in
+                    switch error {
+                    case ProfileFetchError.throttled, ProfileFetchError.notMainApp:
+                        break
+                    default:
+                        Logger.warn("Error: \(error)")
+                    }
+                }.retainUntilComplete()
         }
-        when(fulfilled: promises).retainUntilComplete()
     }
 
-    private init(subject: ProfileRequestSubject,
-                 options: ProfileFetchOptions) {
+    fileprivate init(subject: ProfileRequestSubject,
+                     options: ProfileFetchOptions) {
         self.subject = subject
         self.options = options
     }
@@ -180,7 +209,7 @@ public class ProfileFetcherJob: NSObject {
     }
 
     private var sessionStore: SSKSessionStore {
-        return SSKSessionStore()
+        return SSKEnvironment.shared.sessionStore
     }
 
     private var databaseStorage: SDSDatabaseStorage {
@@ -189,16 +218,13 @@ public class ProfileFetcherJob: NSObject {
 
     // MARK: -
 
-    private func runAsPromise() -> Promise<SignalServiceProfile> {
+    // Only fetches the profile; ProfileFetchScheduler applies the
+    // results of many jobs in a single write transaction.
+    fileprivate func fetchAsPromise() -> Promise<SignalServiceProfile> {
         return DispatchQueue.main.async(.promise) {
             self.addBackgroundTask()
         }.then(on: DispatchQueue.global()) { _ in
-            return self.requestProfileAttempt()
-        }.map(on: DispatchQueue.global()) { profile in
-            if self.options.shouldUpdateProfile {
-                self.updateProfile(signalServiceProfile: profile)
-            }
-            return profile
+            return self.requestProfile()
         }
     }
 
@@ -318,62 +344,65 @@ public class ProfileFetcherJob: NSObject {
         }
     }
 
-    private func updateProfile(signalServiceProfile: SignalServiceProfile) {
+    fileprivate func updateProfile(signalServiceProfile: SignalServiceProfile, transaction: SDSAnyWriteTransaction) {
         let address = signalServiceProfile.address
-        verifyIdentityUpToDateAsync(address: address, latestIdentityKey: signalServiceProfile.identityKey)
+        verifyIdentityUpToDate(address: address,
+                               latestIdentityKey: signalServiceProfile.identityKey,
+                               transaction: transaction)
 
         profileManager.updateProfile(for: address,
                                      profileNameEncrypted: signalServiceProfile.profileNameEncrypted,
                                      username: signalServiceProfile.username,
-                                     avatarUrlPath: signalServiceProfile.avatarUrlPath)
-
-        updateUnidentifiedAccess(address: address,
-                                 verifier: signalServiceProfile.unidentifiedAccessVerifier,
-                                 hasUnrestrictedAccess: signalServiceProfile.hasUnrestrictedUnidentifiedAccess)
+                                     avatarUrlPath: signalServiceProfile.avatarUrlPath,
+                                     transaction: transaction)
+
+        let mode = unidentifiedAccessMode(address: address,
+                                          verifier: signalServiceProfile.unidentifiedAccessVerifier,
+                                          hasUnrestrictedAccess: signalServiceProfile.hasUnrestrictedUnidentifiedAccess,
+                                          transaction: transaction)
+        udManager.setUnidentifiedAccessMode(mode, address: address, transaction: transaction)
     }
 
-    private func updateUnidentifiedAccess(address: SignalServiceAddress, verifier: Data?, hasUnrestrictedAccess: Bool) {
+    private func unidentifiedAccessMode(address: SignalServiceAddress,
+                                        verifier: Data?,
+                                        hasUnrestrictedAccess: Bool,
+                                        transaction: SDSAnyReadTransaction) -> UnidentifiedAccessMode {
         guard let verifier = verifier else {
             // If there is no verifier, at least one of this user's devices
             // do not support UD.
-            udManager.setUnidentifiedAccessMode(.disabled, address: address)
-            return
+            return .disabled
         }
 
         if hasUnrestrictedAccess {
-            udManager.setUnidentifiedAccessMode(.unrestricted, address: address)
-            return
+            return .unrestricted
         }
 
-        guard let udAccessKey = udManager.udAccessKey(forAddress: address) else {
-            udManager.setUnidentifiedAccessMode(.disabled, address: address)
-            return
+        guard let udAccessKey = udManager.udAccessKey(forAddress: address, transaction: transaction) else {
+            return .disabled
         }
 
         let dataToVerify = Data(count: 32)
         guard let expectedVerifier = Cryptography.computeSHA256HMAC(dataToVerify, withHMACKey: udAccessKey.keyData) else {
             owsFailDebug("could not compute verification")
-            udManager.setUnidentifiedAccessMode(.disabled, address: address)
-            return
+            return .disabled
         }
 
         guard expectedVerifier.ows_constantTimeIsEqual(to: verifier) else {
             Logger.verbose("verifier mismatch, new profile key?")
-            udManager.setUnidentifiedAccessMode(.disabled, address: address)
-            return
+            return .disabled
         }
 
-        udManager.setUnidentifiedAccessMode(.enabled, address: address)
+        return .enabled
     }
 
-    private func verifyIdentityUpToDateAsync(address: SignalServiceAddress, latestIdentityKey: Data) {
-        databaseStorage.asyncWrite { (transaction) in
-            if self.identityManager.saveRemoteIdentity(latestIdentityKey, address: address, transaction: transaction) {
-                Logger.info("updated identity key with fetched profile for recipient: \(address)")
-                self.sessionStore.archiveAllSessions(for: address, transaction: transaction)
-            } else {
-                // no change in identity.
-            }
+    private func verifyIdentityUpToDate(address: SignalServiceAddress,
+                                        latestIdentityKey: Data,
+                                        transaction: SDSAnyWriteTransaction) {
+        if identityManager.saveRemoteIdentity(latestIdentityKey, address: address, transaction: transaction) {
+            Logger.info("updated identity key with fetched profile for recipient: \(address)")
+            sessionStore.archiveAllSessions(for: address, transaction: transaction)
+        } else {
+            // no change in identity.
         }
     }
 
@@ -403,3 +432,239 @@ public class ProfileFetcherJob: NSObject {
         })
     }
 }
+
+// MARK: -
+
+// Schedules every profile fetch.
+//
+// * Concurrent requests for the same subject share a single fetch.
+// * At most maxConcurrentFetches fetches are in flight; fetches for the
+//   visible conversation are started before background fetches.
+// * Fetched profiles are applied in batches, so that opening a large
+//   group costs a handful of write transactions rather than several
+//   per member.
+private class ProfileFetchScheduler {
+
+    static let shared = ProfileFetchScheduler()
+
+    static let maxConcurrentFetches = 6
+    static let maxUpdateBatchSize = 32
+    // Fetches that complete within this window share a write transaction.
+    static let updateBatchInterval: TimeInterval = 0.1
+
+    private class PendingFetch {
+        let subject: ProfileRequestSubject
+        var options: ProfileFetchOptions
+        var priority: ProfileFetchPriority
+        var resolvers = [Resolver<SignalServiceProfile>]()
+        var isInFlight = false
+
+        init(subject: ProfileRequestSubject, options: ProfileFetchOptions, priority: ProfileFetchPriority) {
+            self.subject = subject
+            self.options = options
+            self.priority = priority
+        }
+    }
+
+    private struct PendingUpdate {
+        let job: ProfileFetcherJob
+        let profile: SignalServiceProfile
+        let resolvers: [Resolver<SignalServiceProfile>]
+    }
+
+    struct Metrics {
+        var requestCount: UInt = 0
+        var fetchCount: UInt = 0
+        var coalescedCount: UInt = 0
+        var updateTransactionCount: UInt = 0
+    }
+
+    private let serialQueue = DispatchQueue(label: "org.signal.profileFetchScheduler")
+
+    // Should only be accessed on serialQueue.
+    private var pendingFetches = [ProfileRequestSubject: PendingFetch]()
+    private var visibleQueue = [ProfileRequestSubject]()
+    private var backgroundQueue = [ProfileRequestSubject]()
+    private var inFlightCount = 0
+    private var pendingUpdates = [PendingUpdate]()
+    private var isUpdateScheduled = false
+    private var metrics = Metrics()
+
+    // MARK: - Dependencies
+
+    private var databaseStorage: SDSDatabaseStorage {
+        return SDSDatabaseStorage.shared
+    }
+
+    private var profileManager: OWSProfileManager {
+        return OWSProfileManager.shared()
+    }
+
+    // MARK: -
+
+    func fetch(subject: ProfileRequestSubject,
+               options: ProfileFetchOptions,
+               priority: ProfileFetchPriority) -> Promise<SignalServiceProfile> {
+        let (promise, resolver) = Promise<SignalServiceProfile>.pending()
+        serialQueue.async {
+            self.metrics.requestCount += 1
+
+            if let pendingFetch = self.pendingFetches[subject] {
+                let mergedOptions = pendingFetch.options.merged(with: options)
+                if !pendingFetch.isInFlight {
+                    self.metrics.coalescedCount += 1
+                    pendingFetch.resolvers.append(resolver)
+                    pendingFetch.options = mergedOptions
+                    if priority == .visibleConversation && pendingFetch.priority == .background {
+                        pendingFetch.priority = .visibleConversation
+                        self.backgroundQueue.removeAll(where: { $0 == subject })
+                        self.visibleQueue.append(subject)
+                    }
+                    return
+                }
+                if mergedOptions.hasSameFetchBehavior(as: pendingFetch.options) {
+                    self.metrics.coalescedCount += 1
+                    pendingFetch.resolvers.append(resolver)
+                    pendingFetch.options = mergedOptions
+                    return
+                }
+                // The in-flight fetch may be throttled or skipped where this
+                // request shouldn't be, so it gets a fetch of its own. Later
+                // requests for the subject coalesce with that one.
+            }
+
+            let pendingFetch = PendingFetch(subject: subject, options: options, priority: priority)
+            pendingFetch.resolvers.append(resolver)
+            self.pendingFetches[subject] = pendingFetch
+            switch priority {
+            case .visibleConversation:
+                self.visibleQueue.append(subject)
+            case .background:
+                self.backgroundQueue.append(subject)
+            }
+            self.startFetchesIfNecessary()
+        }
+        return promise
+    }
+
+    private func dequeueNextFetch() -> PendingFetch? {
+        let subject: ProfileRequestSubject
+        if !visibleQueue.isEmpty {
+            subject = visibleQueue.removeFirst()
+        } else if !backgroundQueue.isEmpty {
+            subject = backgroundQueue.removeFirst()
+        } else {
+            return nil
+        }
+        guard let pendingFetch = pendingFetches[subject] else {
+            owsFailDebug("Missing pending fetch.")
+            return nil
+        }
+        return pendingFetch
+    }
+
+    private func startFetchesIfNecessary() {
+        assertOnQueue(serialQueue)
+
+        while inFlightCount < ProfileFetchScheduler.maxConcurrentFetches,
+            let pendingFetch = dequeueNextFetch() {
+            pendingFetch.isInFlight = true
+            inFlightCount += 1
+            metrics.fetchCount += 1
+
+            let job = ProfileFetcherJob(subject: pendingFetch.subject, options: pendingFetch.options)
+            job.fetchAsPromise()
+                .done(on: serialQueue) { profile in
+                    self.didFetch(pendingFetch, job: job, profile: profile)
+                }.catch(on: serialQueue) { error in
+                    self.didFailFetch(pendingFetch, error: error)
+                }.retainUntilComplete()
+        }
+    }
+
+    private func didFetch(_ pendingFetch: PendingFetch, job: ProfileFetcherJob, profile: SignalServiceProfile) {
+        assertOnQueue(serialQueue)
+
+        inFlightCount -= 1
+        removePendingFetch(pendingFetch)
+
+        if pendingFetch.options.shouldUpdateProfile {
+            pendingUpdates.append(PendingUpdate(job: job, profile: profile, resolvers: pendingFetch.resolvers))
+            scheduleUpdates()
+        } else {
+            pendingFetch.resolvers.forEach { $0.fulfill(profile) }
+        }
+
+        startFetchesIfNecessary()
+    }
+
+    private func didFailFetch(_ pendingFetch: PendingFetch, error: Error) {
+        assertOnQueue(serialQueue)
+
+        inFlightCount -= 1
+        removePendingFetch(pendingFetch)
+
+        pendingFetch.resolvers.forEach { $0.reject(error) }
+
+        startFetchesIfNecessary()
+    }
+
+    private func removePendingFetch(_ pendingFetch: PendingFetch) {
+        assertOnQueue(serialQueue)
+
+        // A newer fetch for the same subject may have replaced this one.
+        if pendingFetches[pendingFetch.subject] === pendingFetch {
+            pendingFetches[pendingFetch.subject] = nil
+        }
+    }
+
+    // MARK: - Updates
+
+    private func scheduleUpdates() {
+        assertOnQueue(serialQueue)
+
+        if pendingUpdates.count >= ProfileFetchScheduler.maxUpdateBatchSize {
+            applyPendingUpdates()
+            return
+        }
+        guard !isUpdateScheduled else {
+            return
+        }
+        isUpdateScheduled = true
+        serialQueue.asyncAfter(deadline: .now() + ProfileFetchScheduler.updateBatchInterval) {
+            self.applyPendingUpdates()
+        }
+    }
+
+    private func applyPendingUpdates() {
+        assertOnQueue(serialQueue)
+
+        isUpdateScheduled = false
+        guard !pendingUpdates.isEmpty else {
+            return
+        }
+        let updates = pendingUpdates
+        pendingUpdates = []
+        metrics.updateTransactionCount += 1
+        logMetrics()
+
+        DispatchQueue.global().async {
+            // Loading the local profile for the first time can open a
+            // transaction, so make sure it's loaded before we write.
+            self.profileManager.warmCaches()
+
+            self.databaseStorage.write { transaction in
+                for update in updates {
+                    update.job.updateProfile(signalServiceProfile: update.profile, transaction: transaction)
+                }
+            }
+            for update in updates {
+                update.resolvers.forEach { $0.fulfill(update.profile) }
+            }
+        }
+    }
+
+    private func logMetrics() {
+        Logger.info("requests: \(metrics.requestCount), fetches: \(metrics.fetchCount), coalesced: \(metrics.coalescedCount), update transactions: \(metrics.updateTransactionCount)")
+    }
+}
@@ -326,7 +326,8 @@ typedef void (^OrphanDataBlock)(OWSOrphanData *);
     OWSLogVerbose(@"allOnDiskFilePaths: %lu", (unsigned long)allOnDiskFilePaths.count);
 
     __block NSSet<NSString *> *profileAvatarFilePaths;
-    [self.databaseStorage readWithBlock:^(SDSAnyReadTransaction *transaction) {
+    [self.databaseStorage readWithPriority:SDSReadPriorityBackground
+                                     block:^(SDSAnyReadTransaction *transaction) {
         profileAvatarFilePaths = [OWSProfileManager allProfileAvatarFilePathsWithTransaction:transaction];
     }];
 
@@ -356,7 +357,8 @@ typedef void (^OrphanDataBlock)(OWSOrphanData *);
     NSMutableSet<NSString *> *allMessageReactionIds = [NSMutableSet new];
     // Stickers
     NSMutableSet<NSString *> *activeStickerFilePaths = [NSMutableSet new];
-    [self.databaseStorage readWithBlock:^(SDSAnyReadTransaction *transaction) {
+    [self.databaseStorage readWithPriority:SDSReadPriorityBackground
+                                     block:^(SDSAnyReadTransaction *transaction) {
         [TSAttachmentStream
             anyEnumerateWithTransaction:transaction
                                 batched:YES
@@ -6,6 +6,284 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+// OWSScrubbingLogFormatter scrubs every line that we log, so rather than applying
+// each regular expression in turn (and allocating a new string per pass), it
+// recognizes every token class in a single pass over the line's ASCII bytes.
+//
+// The scanner reproduces the output of applying the patterns one after another,
+// in the order below: at each offset it tries each class in order and takes the
+// first match, and a match is cut short where a match of an earlier class begins,
+// since that earlier pass would already have replaced the text there.
+
+typedef NS_ENUM(NSUInteger, OWSScrubTokenClass) {
+    // \+\d{7,12}(\d{3})
+    OWSScrubTokenClassPhoneNumber = 0,
+    // [\da-f]{8}\-[\da-f]{4}\-[\da-f]{4}\-[\da-f]{4}\-[\da-f]{10}([\da-f]{2})
+    OWSScrubTokenClassUUID,
+    // <([\da-f]{2})[\da-f]{6}( [\da-f]{8})*>
+    OWSScrubTokenClassData,
+    // \{length = \d+, bytes = 0x([\da-f]{2})([\da-f]{2})*\}
+    OWSScrubTokenClassIOS13Data,
+    // \d+\.\d+\.\d+\.(\d+)
+    OWSScrubTokenClassIPv4Address,
+    OWSScrubTokenClassCount,
+};
+
+typedef struct {
+    const uint8_t *bytes;
+    NSUInteger length;
+} OWSScrubScanner;
+
+typedef struct {
+    OWSScrubTokenClass tokenClass;
+    NSUInteger end;
+    NSRange capture;
+} OWSScrubMatch;
+
+typedef NS_OPTIONS(uint8_t, OWSScrubCharacterFlags) {
+    OWSScrubCharacterFlagDigit = 1 << 0,
+    OWSScrubCharacterFlagHex = 1 << 1,
+};
+
+static OWSScrubCharacterFlags OWSScrubCharacterFlagsForByte(uint8_t byte)
+{
+    static OWSScrubCharacterFlags table[256];
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        for (uint8_t c = '0'; c <= '9'; c++) {
+            table[c] = OWSScrubCharacterFlagDigit | OWSScrubCharacterFlagHex;
+        }
+        for (uint8_t c = 'a'; c <= 'f'; c++) {
+            table[c] = OWSScrubCharacterFlagHex;
+            table[c - 'a' + 'A'] = OWSScrubCharacterFlagHex;
+        }
+    });
+    return table[byte];
+}
+
+// Returns the number of consecutive bytes with the given flag at index, before limit.
+static NSUInteger OWSScrubRunLength(
+    const OWSScrubScanner *scanner, NSUInteger index, NSUInteger limit, OWSScrubCharacterFlags flag)
+{
+    NSUInteger end = index;
+    while (end < limit && (OWSScrubCharacterFlagsForByte(scanner->bytes[end]) & flag) != 0) {
+        end++;
+    }
+    return end - index;
+}
+
+static BOOL OWSScrubHasByte(const OWSScrubScanner *scanner, NSUInteger index, NSUInteger limit, uint8_t byte)
+{
+    return index < limit && scanner->bytes[index] == byte;
+}
+
+// Matches an ASCII literal, ignoring case like the original patterns.
+static BOOL OWSScrubHasLiteral(const OWSScrubScanner *scanner, NSUInteger index, NSUInteger limit, const char *literal)
+{
+    size_t literalLength = strlen(literal);
+    if (index + literalLength > limit) {
+        return NO;
+    }
+    for (size_t i = 0; i < literalLength; i++) {
+        if (tolower(scanner->bytes[index + i]) != tolower((uint8_t)literal[i])) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+static BOOL OWSScrubMatchPhoneNumber(
+    const OWSScrubScanner *scanner, NSUInteger index, NSUInteger limit, OWSScrubMatch *match)
+{
+    if (!OWSScrubHasByte(scanner, index, limit, '+')) {
+        return NO;
+    }
+    NSUInteger digitCount = MIN(OWSScrubRunLength(scanner, index + 1, limit, OWSScrubCharacterFlagDigit), 15);
+    if (digitCount < 10) {
+        return NO;
+    }
+    match->end = index + 1 + digitCount;
+    match->capture = NSMakeRange(match->end - 3, 3);
+    return YES;
+}
+
+static BOOL OWSScrubMatchUUID(const OWSScrubScanner *scanner, NSUInteger index, NSUInteger limit, OWSScrubMatch *match)
+{
+    static const NSUInteger groupLengths[] = { 8, 4, 4, 4, 12 };
+    NSUInteger offset = index;
+    for (NSUInteger group = 0; group < 5; group++) {
+        if (group > 0) {
+            if (!OWSScrubHasByte(scanner, offset, limit, '-')) {
+                return NO;
+            }
+            offset++;
+        }
+        NSUInteger groupLength = groupLengths[group];
+        if (OWSScrubRunLength(scanner, offset, MIN(limit, offset + groupLength), OWSScrubCharacterFlagHex)
+            < groupLength) {
+            return NO;
+        }
+        offset += groupLength;
+    }
+    match->end = offset;
+    match->capture = NSMakeRange(offset - 2, 2);
+    return YES;
+}
+
+static BOOL OWSScrubMatchData(const OWSScrubScanner *scanner, NSUInteger index, NSUInteger limit, OWSScrubMatch *match)
+{
+    if (!OWSScrubHasByte(scanner, index, limit, '<')) {
+        return NO;
+    }
+    NSUInteger offset = index + 1;
+    if (OWSScrubRunLength(scanner, offset, MIN(limit, offset + 8), OWSScrubCharacterFlagHex) < 8) {
+        return NO;
+    }
+    match->capture = NSMakeRange(offset, 2);
+    offset += 8;
+    while (OWSScrubHasByte(scanner, offset, limit, ' ')
+        && OWSScrubRunLength(scanner, offset + 1, MIN(limit, offset + 9), OWSScrubCharacterFlagHex) == 8) {
+        offset += 9;
+    }
+    if (!OWSScrubHasByte(scanner, offset, limit, '>')) {
+        return NO;
+    }
+    match->end = offset + 1;
+    return YES;
+}
+
+static BOOL OWSScrubMatchIOS13Data(
+    const OWSScrubScanner *scanner, NSUInteger index, NSUInteger limit, OWSScrubMatch *match)
+{
+    if (!OWSScrubHasLiteral(scanner, index, limit, "{length = ")) {
+        return NO;
+    }
+    NSUInteger offset = index + 10;
+    NSUInteger lengthDigitCount = OWSScrubRunLength(scanner, offset, limit, OWSScrubCharacterFlagDigit);
+    if (lengthDigitCount < 1) {
+        return NO;
+    }
+    offset += lengthDigitCount;
+    if (!OWSScrubHasLiteral(scanner, offset, limit, ", bytes = 0x")) {
+        return NO;
+    }
+    offset += 12;
+    // The hex digits must come in pairs, so an odd run can't be followed by "}".
+    NSUInteger hexCount = OWSScrubRunLength(scanner, offset, limit, OWSScrubCharacterFlagHex);
+    if (hexCount < 2 || hexCount % 2 != 0) {
+        return NO;
+    }
+    match->capture = NSMakeRange(offset, 2);
+    offset += hexCount;
+    if (!OWSScrubHasByte(scanner, offset, limit, '}')) {
+        return NO;
+    }
+    match->end = offset + 1;
+    return YES;
+}
+
+static BOOL OWSScrubMatchIPv4Address(
+    const OWSScrubScanner *scanner, NSUInteger index, NSUInteger limit, OWSScrubMatch *match)
+{
+    NSUInteger offset = index;
+    for (NSUInteger quad = 0; quad < 4; quad++) {
+        if (quad > 0) {
+            if (!OWSScrubHasByte(scanner, offset, limit, '.')) {
+                return NO;
+            }
+            offset++;
+        }
+        NSUInteger digitCount = OWSScrubRunLength(scanner, offset, limit, OWSScrubCharacterFlagDigit);
+        if (digitCount < 1) {
+            return NO;
+        }
+        match->capture = NSMakeRange(offset, digitCount);
+        offset += digitCount;
+    }
+    match->end = offset;
+    return YES;
+}
+
+static BOOL OWSScrubMatchTokenClass(const OWSScrubScanner *scanner,
+    OWSScrubTokenClass tokenClass,
+    NSUInteger index,
+    NSUInteger limit,
+    OWSScrubMatch *match)
+{
+    match->tokenClass = tokenClass;
+    switch (tokenClass) {
+        case OWSScrubTokenClassPhoneNumber:
+            return OWSScrubMatchPhoneNumber(scanner, index, limit, match);
+        case OWSScrubTokenClassUUID:
+            return OWSScrubMatchUUID(scanner, index, limit, match);
+        case OWSScrubTokenClassData:
+            return OWSScrubMatchData(scanner, index, limit, match);
+        case OWSScrubTokenClassIOS13Data:
+            return OWSScrubMatchIOS13Data(scanner, index, limit, match);
+        case OWSScrubTokenClassIPv4Address:
+            return OWSScrubMatchIPv4Address(scanner, index, limit, match);
+        case OWSScrubTokenClassCount:
+            break;
+    }
+    OWSCFailDebug(@"Unexpected token class: %lu", (unsigned long)tokenClass);
+    return NO;
+}
+
+// Finds the match of the first of the token classes before classLimit at index, if any.
+static BOOL OWSScrubMatchAt(
+    const OWSScrubScanner *scanner, NSUInteger index, OWSScrubTokenClass classLimit, OWSScrubMatch *match)
+{
+    // Every token starts with one of these, so most bytes can be skipped at once.
+    uint8_t byte = scanner->bytes[index];
+    if (byte != '+' && byte != '<' && byte != '{' && OWSScrubCharacterFlagsForByte(byte) == 0) {
+        return NO;
+    }
+
+    for (OWSScrubTokenClass tokenClass = 0; tokenClass < classLimit; tokenClass++) {
+        NSUInteger limit = scanner->length;
+        BOOL didMatch = OWSScrubMatchTokenClass(scanner, tokenClass, index, limit, match);
+        NSUInteger offset = index + 1;
+        while (didMatch && offset < match->end) {
+            OWSScrubMatch earlierMatch;
+            if (tokenClass > 0 && OWSScrubMatchAt(scanner, offset, tokenClass, &earlierMatch)) {
+                // An earlier class's pass would have replaced the text from here on.
+                limit = offset;
+                didMatch = OWSScrubMatchTokenClass(scanner, tokenClass, index, limit, match);
+            }
+            offset++;
+        }
+        if (didMatch) {
+            return YES;
+        }
+    }
+    return NO;
+}
+
+static void OWSScrubAppendReplacement(NSMutableString *result, const OWSScrubScanner *scanner, const OWSScrubMatch *match)
+{
+    NSString *capture = [[NSString alloc] initWithBytes:scanner->bytes + match->capture.location
+                                                 length:match->capture.length
+                                               encoding:NSASCIIStringEncoding];
+    switch (match->tokenClass) {
+        case OWSScrubTokenClassPhoneNumber:
+            [result appendFormat:@"[ REDACTED_PHONE_NUMBER:xxx%@ ]", capture];
+            break;
+        case OWSScrubTokenClassUUID:
+            [result appendFormat:@"[ REDACTED_UUID:xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxx%@ ]", capture];
+            break;
+        case OWSScrubTokenClassData:
+        case OWSScrubTokenClassIOS13Data:
+            [result appendFormat:@"[ REDACTED_DATA:%@... ]", capture];
+            break;
+        case OWSScrubTokenClassIPv4Address:
+            [result appendFormat:@"[ REDACTED_IPV4_ADDRESS:...%@ ]", capture];
+            break;
+        case OWSScrubTokenClassCount:
+            OWSCFailDebug(@"Unexpected token class.");
+            break;
+    }
+}
+
 @implementation OWSScrubbingLogFormatter
 
 - (NSRegularExpression *)phoneRegex
@@ -93,8 +371,58 @@ NS_ASSUME_NONNULL_BEGIN
 
 - (NSString *__nullable)formatLogMessage:(DDLogMessage *)logMessage
 {
-    NSString *logString = [super formatLogMessage:logMessage];
+    NSString *_Nullable logString = [super formatLogMessage:logMessage];
+    if (logString == nil) {
+        return nil;
+    }
+    return [self scrubbedLogString:logString];
+}
+
+- (NSString *)scrubbedLogString:(NSString *)logString
+{
+    NSUInteger length = logString.length;
+    const char *_Nullable bytes = CFStringGetCStringPtr((__bridge CFStringRef)logString, kCFStringEncodingASCII);
+    NSData *_Nullable asciiData;
+    if (bytes == NULL) {
+        asciiData = [logString dataUsingEncoding:NSASCIIStringEncoding allowLossyConversion:NO];
+        if (asciiData == nil) {
+            return [self regexScrubbedLogString:logString];
+        }
+        bytes = asciiData.bytes;
+    }
+    OWSAssertDebug(asciiData == nil || asciiData.length == length);
+
+    OWSScrubScanner scanner = { (const uint8_t *)bytes, length };
+    NSMutableString *_Nullable result;
+    NSUInteger copiedLength = 0;
+    NSUInteger index = 0;
+    while (index < length) {
+        OWSScrubMatch match;
+        if (!OWSScrubMatchAt(&scanner, index, OWSScrubTokenClassCount, &match)) {
+            index++;
+            continue;
+        }
+        if (result == nil) {
+            result = [[NSMutableString alloc] initWithCapacity:length];
+        }
+        [result appendString:[logString substringWithRange:NSMakeRange(copiedLength, index - copiedLength)]];
+        OWSScrubAppendReplacement(result, &scanner, &match);
+        index = match.end;
+        copiedLength = index;
+    }
+    if (result == nil) {
+        // Nothing to scrub, which is the common case.
+        return logString;
+    }
+    [result appendString:[logString substringFromIndex:copiedLength]];
+    return [result copy];
+}
 
+// The reference implementation of scrubbing, which applies each pattern in turn.
+// It is used for lines the scanner can't handle, i.e. those containing non-ASCII
+// characters, since \d also matches non-ASCII digits.
+- (NSString *)regexScrubbedLogString:(NSString *)logString
+{
     NSRegularExpression *phoneRegex = self.phoneRegex;
     logString = [phoneRegex stringByReplacingMatchesInString:logString
                                                      options:0
@@ -779,3 +779,21 @@ CREATE
     ,"id"
 )
 ;
+
+CREATE
+    TABLE
+        IF NOT EXISTS "pending_outgoing_receipts" (
+            "id" INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL
+            ,"recipientIdentifier" TEXT NOT NULL
+            ,"receiptType" INTEGER NOT NULL
+            ,"timestamp" INTEGER NOT NULL
+        )
+;
+
+CREATE
+    UNIQUE INDEX "index_pending_outgoing_receipts_on_recipientIdentifier_and_receiptType_and_timestamp"
+        ON "pending_outgoing_receipts"("recipientIdentifier"
+    ,"receiptType"
+    ,"timestamp"
+)
+;
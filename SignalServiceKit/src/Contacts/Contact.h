@@ -40,6 +40,9 @@ NS_ASSUME_NONNULL_BEGIN
 
 - (instancetype)initWithSystemContact:(CNContact *)cnContact;
 
+// Returns a contact for each system contact, in the same order.
++ (NSArray<Contact *> *)contactsWithSystemContacts:(NSArray<CNContact *> *)cnContacts;
+
 - (instancetype)initWithUniqueId:(NSString *)uniqueId
                      cnContactId:(nullable NSString *)cnContactId
                        firstName:(nullable NSString *)firstName
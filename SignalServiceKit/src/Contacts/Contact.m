@@ -178,6 +178,35 @@ NS_ASSUME_NONNULL_BEGIN
                   imageDataToHash:[Contact avatarDataForCNContact:cnContact]];
 }
 
++ (NSArray<Contact *> *)contactsWithSystemContacts:(NSArray<CNContact *> *)cnContacts
+{
+    // Parsing phone numbers dominates building contacts, so we build them
+    // in parallel batches.
+    const NSUInteger kBatchSize = 64;
+    NSUInteger batchCount = (cnContacts.count + kBatchSize - 1) / kBatchSize;
+    NSMutableDictionary<NSNumber *, NSArray<Contact *> *> *batches = [NSMutableDictionary new];
+    dispatch_apply(batchCount, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t batchIndex) {
+        NSUInteger batchStart = batchIndex * kBatchSize;
+        NSRange batchRange = NSMakeRange(batchStart, MIN(kBatchSize, cnContacts.count - batchStart));
+        NSMutableArray<Contact *> *batch = [NSMutableArray new];
+        @autoreleasepool {
+            for (CNContact *cnContact in [cnContacts subarrayWithRange:batchRange]) {
+                [batch addObject:[[Contact alloc] initWithSystemContact:cnContact]];
+            }
+        }
+        @synchronized(batches) {
+            batches[@(batchIndex)] = batch;
+        }
+    });
+
+    NSMutableArray<Contact *> *contacts = [NSMutableArray new];
+    for (NSUInteger batchIndex = 0; batchIndex < batchCount; batchIndex++) {
+        [contacts addObjectsFromArray:batches[@(batchIndex)]];
+    }
+    OWSAssertDebug(contacts.count == cnContacts.count);
+    return [contacts copy];
+}
+
 - (NSString *)uniqueId
 {
     if (_uniqueId == nil) {
@@ -212,11 +241,12 @@ NS_ASSUME_NONNULL_BEGIN
 {
     NSMutableDictionary<NSString *, NSString *> *parsedPhoneNumberNameMap = [NSMutableDictionary new];
     NSMutableArray<PhoneNumber *> *parsedPhoneNumbers = [NSMutableArray new];
+    NSString *localNumber = [TSAccountManager localNumber];
 
     for (NSString *phoneNumberString in userTextPhoneNumbers) {
         for (PhoneNumber *phoneNumber in
             [PhoneNumber tryParsePhoneNumbersFromsUserSpecifiedText:phoneNumberString
-                                                  clientPhoneNumber:[TSAccountManager localNumber]]) {
+                                                  clientPhoneNumber:localNumber]) {
             [parsedPhoneNumbers addObject:phoneNumber];
             NSString *phoneNumberName = phoneNumberNameMap[phoneNumberString];
             if (phoneNumberName) {
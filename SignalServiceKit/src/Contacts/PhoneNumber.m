@@ -38,10 +38,58 @@ static NSString *const RPDefaultsKeyPhoneNumberCanonical = @"RPDefaultsKeyPhoneN
     return self;
 }
 
+// Parsed numbers whose text was already their E.164 form, keyed by that text.
++ (NSCache<NSString *, PhoneNumber *> *)canonicalPhoneNumberCache
+{
+    static NSCache *cache;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        cache = [NSCache new];
+        // E.164 numbers are at most 16 characters, so this bounds the cache
+        // to a few MB.
+        cache.countLimit = 10000;
+    });
+    return cache;
+}
+
+// Returns YES if text has the form toE164 produces: "+" and then
+// 7 to 15 digits, without a leading zero. Doesn't allocate.
++ (BOOL)isCanonicalE164:(NSString *)text
+{
+    const NSUInteger kMinLength = 8;
+    const NSUInteger kMaxLength = 16;
+
+    NSUInteger length = text.length;
+    if (length < kMinLength || length > kMaxLength) {
+        return NO;
+    }
+    unichar characters[kMaxLength];
+    [text getCharacters:characters range:NSMakeRange(0, length)];
+    if (characters[0] != '+' || characters[1] == '0') {
+        return NO;
+    }
+    for (NSUInteger i = 1; i < length; i++) {
+        if (characters[i] < '0' || characters[i] > '9') {
+            return NO;
+        }
+    }
+    return YES;
+}
+
 + (nullable PhoneNumber *)phoneNumberFromText:(NSString *)text andRegion:(NSString *)regionCode {
     OWSAssertDebug(text != nil);
     OWSAssertDebug(regionCode != nil);
 
+    // Numbers with a calling code don't depend on the region, and most
+    // numbers we parse are E.164 numbers we've already seen.
+    BOOL isCanonicalE164 = [self isCanonicalE164:text];
+    if (isCanonicalE164) {
+        PhoneNumber *_Nullable cachedPhoneNumber = [self.canonicalPhoneNumberCache objectForKey:text];
+        if (cachedPhoneNumber != nil) {
+            return cachedPhoneNumber;
+        }
+    }
+
     PhoneNumberUtil *phoneUtil = [PhoneNumberUtil sharedThreadLocal];
 
     NSError *parseError   = nil;
@@ -63,7 +111,11 @@ static NSString *const RPDefaultsKeyPhoneNumberCanonical = @"RPDefaultsKeyPhoneN
         return nil;
     }
 
-    return [[PhoneNumber alloc] initWithPhoneNumber:number e164:e164];
+    PhoneNumber *phoneNumber = [[PhoneNumber alloc] initWithPhoneNumber:number e164:e164];
+    if (isCanonicalE164 && [e164 isEqualToString:text]) {
+        [self.canonicalPhoneNumberCache setObject:phoneNumber forKey:e164];
+    }
+    return phoneNumber;
 }
 
 + (nullable PhoneNumber *)phoneNumberFromUserSpecifiedText:(NSString *)text {
@@ -227,8 +279,7 @@ static NSString *const RPDefaultsKeyPhoneNumberCanonical = @"RPDefaultsKeyPhoneN
     static dispatch_once_t onceToken;
 
     // clientPhoneNumber is the local user's phone number and should never change.
-    static void (^updateCachedClientPhoneNumber)(void);
-    updateCachedClientPhoneNumber = ^(void) {
+    void (^updateCachedClientPhoneNumber)(void) = ^(void) {
         NSNumber *localCallingCode = [[PhoneNumber phoneNumberFromE164:clientPhoneNumber] getCountryCode];
         if (localCallingCode != nil) {
             NSString *localCallingCodePrefix = [NSString stringWithFormat:@"+%@", localCallingCode];
@@ -249,7 +300,11 @@ static NSString *const RPDefaultsKeyPhoneNumberCanonical = @"RPDefaultsKeyPhoneN
     // For performance, we want to cache this result, but it breaks tests since local number
     // can change.
     if (CurrentAppContext().isRunningTests) {
-        updateCachedClientPhoneNumber();
+        // Contacts are parsed concurrently.
+        @synchronized(self) {
+            updateCachedClientPhoneNumber();
+            return result;
+        }
     } else {
         dispatch_once(&onceToken, ^{
             updateCachedClientPhoneNumber();
@@ -517,6 +572,11 @@ static NSString *const RPDefaultsKeyPhoneNumberCanonical = @"RPDefaultsKeyPhoneN
         }
     }
 
+    if ((NSUInteger)outputLength == inputString.length) {
+        // Nothing to remove.
+        return [inputString copy];
+    }
+
     outputString[outputLength] = 0;
     return [NSString stringWithUTF8String:(void *)outputString];
 }
@@ -9,15 +9,6 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
-@interface PhoneNumberUtil ()
-
-@property (nonatomic, readonly) NSMutableDictionary *countryCodesFromCallingCodeCache;
-@property (nonatomic, readonly) NSCache *parsedPhoneNumberCache;
-
-@end
-
-#pragma mark -
-
 @implementation PhoneNumberUtil
 
 + (PhoneNumberUtil *)sharedThreadLocal
@@ -36,41 +27,68 @@ NS_ASSUME_NONNULL_BEGIN
 
     if (self) {
         _nbPhoneNumberUtil = [[NBPhoneNumberUtil alloc] init];
-        _countryCodesFromCallingCodeCache = [NSMutableDictionary new];
-        _parsedPhoneNumberCache = [NSCache new];
     }
 
     return self;
 }
 
+// The parse cache is shared by every thread's instance, so that each thread
+// doesn't parse the same numbers again. NSCache is thread-safe.
+//
+// Values are an NBPhoneNumber, the NSError the parse failed with, or NSNull.
++ (NSCache<NSString *, id> *)parsedPhoneNumberCache
+{
+    static NSCache *cache;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        cache = [NSCache new];
+        // Bound the cache by its approximate size in bytes; see
+        // costForParsedPhoneNumberCacheKey:.
+        cache.totalCostLimit = 2 * 1024 * 1024;
+    });
+    return cache;
+}
+
++ (NSUInteger)costForParsedPhoneNumberCacheKey:(NSString *)cacheKey
+{
+    // The key's characters, plus the value and the cache's bookkeeping.
+    const NSUInteger kEntryOverhead = 256;
+    return cacheKey.length * sizeof(unichar) + kEntryOverhead;
+}
+
 - (nullable NBPhoneNumber *)parse:(NSString *)numberToParse
                     defaultRegion:(NSString *)defaultRegion
                             error:(NSError **)error
 {
-    NSString *hashKey = [NSString stringWithFormat:@"numberToParse:%@defaultRegion:%@", numberToParse, defaultRegion];
-
-    NBPhoneNumber *result = [self.parsedPhoneNumberCache objectForKey:hashKey];
-
-    if (!result) {
-        result = [self.nbPhoneNumberUtil parse:numberToParse defaultRegion:defaultRegion error:error];
-        if (error && *error) {
-            OWSAssertDebug(!result);
-            return nil;
-        }
-
-        OWSAssertDebug(result);
-
-        if (result) {
-            [self.parsedPhoneNumberCache setObject:result forKey:hashKey];
-        } else {
-            [self.parsedPhoneNumberCache setObject:[NSNull null] forKey:hashKey];
-        }
+    // Numbers with a calling code parse the same way in every region,
+    // so they're keyed by the number alone.
+    NSString *cacheKey = ([numberToParse hasPrefix:COUNTRY_CODE_PREFIX]
+            ? numberToParse
+            : [[defaultRegion stringByAppendingString:@":"] stringByAppendingString:numberToParse]);
+
+    NSCache<NSString *, id> *cache = PhoneNumberUtil.parsedPhoneNumberCache;
+    id _Nullable cachedResult = [cache objectForKey:cacheKey];
+    if (cachedResult == nil) {
+        NSError *_Nullable parseError;
+        NBPhoneNumber *_Nullable result = [self.nbPhoneNumberUtil parse:numberToParse
+                                                          defaultRegion:defaultRegion
+                                                                  error:&parseError];
+        OWSAssertDebug(parseError != nil || result != nil);
+        OWSAssertDebug(parseError == nil || result == nil);
+
+        cachedResult = parseError ?: result ?: [NSNull null];
+        [cache setObject:cachedResult forKey:cacheKey cost:[PhoneNumberUtil costForParsedPhoneNumberCacheKey:cacheKey]];
     }
 
-    if ([result class] == [NSNull class]) {
+    if ([cachedResult isKindOfClass:[NSError class]]) {
+        if (error) {
+            *error = cachedResult;
+        }
         return nil;
+    } else if ([cachedResult isKindOfClass:[NBPhoneNumber class]]) {
+        return cachedResult;
     } else {
-        return result;
+        return nil;
     }
 }
 
@@ -431,13 +449,25 @@ NS_ASSUME_NONNULL_BEGIN
     return result;
 }
 
+// Shared by every thread's instance.
++ (NSMutableDictionary<NSString *, NSArray<NSString *> *> *)countryCodesFromCallingCodeCache
+{
+    static NSMutableDictionary *cache;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        cache = [NSMutableDictionary new];
+    });
+    return cache;
+}
+
 - (NSArray<NSString *> *)countryCodesFromCallingCode:(NSString *)callingCode
 {
-    @synchronized(self)
+    NSMutableDictionary<NSString *, NSArray<NSString *> *> *cache = PhoneNumberUtil.countryCodesFromCallingCodeCache;
+    @synchronized(cache)
     {
         OWSAssertDebug(callingCode.length > 0);
 
-        NSArray *result = self.countryCodesFromCallingCodeCache[callingCode];
+        NSArray *result = cache[callingCode];
         if (!result) {
             NSMutableArray *countryCodes = [NSMutableArray new];
             for (NSString *countryCode in [self countryCodesSortedByPopulationDescending]) {
@@ -447,7 +477,7 @@ NS_ASSUME_NONNULL_BEGIN
                 }
             }
             result = [countryCodes copy];
-            self.countryCodesFromCallingCodeCache[callingCode] = result;
+            cache[callingCode] = result;
         }
         return result;
     }
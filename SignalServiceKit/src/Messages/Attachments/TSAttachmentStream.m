@@ -495,28 +495,47 @@ typedef void (^OWSLoadedThumbnailSuccess)(OWSLoadedThumbnail *loadedThumbnail);
 {
     OWSAssertDebug(self.isImage || self.isAnimated);
 
-    BOOL result;
-    BOOL didUpdateCache = NO;
+    [self updateImageMetadataIfNecessary];
+
     @synchronized(self) {
-        if (!self.isValidImageCached) {
-            OWSLogVerbose(@"Updating isValidImageCached.");
-            self.isValidImageCached = @([NSData ows_isValidImageAtPath:self.originalFilePath
-                                                              mimeType:self.contentType]);
-            if (!self.isValidImageCached) {
-                OWSLogWarn(@"Invalid image.");
-            }
-            didUpdateCache = YES;
+        return self.isValidImageCached.boolValue;
+    }
+}
+
+// An image's validity and size both come from its headers, so we probe
+// them once and cache them together.
+- (void)updateImageMetadataIfNecessary
+{
+    OWSAssertDebug(self.isImage || self.isAnimated);
+
+    ImageData *imageData;
+    @synchronized(self) {
+        BOOL hasImageSize = self.cachedImageWidth != nil && self.cachedImageHeight != nil;
+        if (self.isValidImageCached != nil && (!self.isValidImageCached.boolValue || hasImageSize)) {
+            return;
+        }
+
+        OWSLogVerbose(@"Updating isValidImageCached.");
+        imageData = [NSData imageDataWithPath:self.originalFilePath mimeType:self.contentType];
+        if (!imageData.isValid) {
+            OWSLogWarn(@"Invalid image.");
+        }
+        self.isValidImageCached = @(imageData.isValid);
+        if (imageData.isValid) {
+            self.cachedImageWidth = @(imageData.pixelSize.width);
+            self.cachedImageHeight = @(imageData.pixelSize.height);
         }
-        result = self.isValidImageCached.boolValue;
     }
 
-    if (didUpdateCache && self.canAsyncUpdate) {
+    if (self.canAsyncUpdate) {
         [self applyChangeAsyncToLatestCopyWithChangeBlock:^(TSAttachmentStream *latestInstance) {
-            latestInstance.isValidImageCached = @(result);
+            latestInstance.isValidImageCached = @(imageData.isValid);
+            if (imageData.isValid) {
+                latestInstance.cachedImageWidth = @(imageData.pixelSize.width);
+                latestInstance.cachedImageHeight = @(imageData.pixelSize.height);
+            }
         }];
     }
-
-    return result;
 }
 
 - (BOOL)canAsyncUpdate
@@ -636,19 +655,14 @@ typedef void (^OWSLoadedThumbnailSuccess)(OWSLoadedThumbnail *loadedThumbnail);
     }
 }
 
-- (CGSize)calculateImageSize
+- (CGSize)calculateVideoSize
 {
-    if ([self isVideo]) {
-        if (![self isValidVideo]) {
-            return CGSizeZero;
-        }
-        return [self videoStillImage].size;
-    } else if ([self isImage] || [self isAnimated]) {
-        // imageSizeForFilePath checks validity.
-        return [NSData imageSizeForFilePath:self.originalFilePath mimeType:self.contentType];
-    } else {
+    OWSAssertDebug(self.isVideo);
+
+    if (![self isValidVideo]) {
         return CGSizeZero;
     }
+    return [self videoStillImage].size;
 }
 
 - (BOOL)shouldHaveImageSize
@@ -663,13 +677,19 @@ typedef void (^OWSLoadedThumbnailSuccess)(OWSLoadedThumbnail *loadedThumbnail);
         return CGSizeZero;
     }
 
+    if (!self.isVideo) {
+        // The size is probed along with the validity.
+        [self updateImageMetadataIfNecessary];
+        return self.cachedMediaSize;
+    }
+
     @synchronized(self)
     {
         if (self.cachedImageWidth && self.cachedImageHeight) {
             return CGSizeMake(self.cachedImageWidth.floatValue, self.cachedImageHeight.floatValue);
         }
 
-        CGSize imageSize = [self calculateImageSize];
+        CGSize imageSize = [self calculateVideoSize];
         if (imageSize.width <= 0 || imageSize.height <= 0) {
             return CGSizeZero;
         }
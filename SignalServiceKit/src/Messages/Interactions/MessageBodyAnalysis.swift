@@ -0,0 +1,291 @@
+//
+//  Copyright (c) 2020 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+
+// The parts of a message body's display that are expensive to compute:
+// filtering, language detection, emoji counting and link detection.
+//
+// We analyze the body once, when the message is inserted, and store the
+// result keyed by the message's uniqueId so that building the message's
+// view doesn't need the linguistic tagger, data detectors or regexes.
+// Messages inserted without an analysis, e.g. by the YDB-to-GRDB
+// migration, are analyzed when they're first displayed.
+@objc
+public class MessageBodyAnalysis: NSObject {
+
+    // nil if filtering the body for display didn't change it.
+    private let filteredText: String?
+
+    @objc
+    public let naturalAlignment: NSTextAlignment
+
+    @objc
+    public let jumbomojiCount: UInt
+
+    @objc
+    public let shouldAllowLinkification: Bool
+
+    @objc
+    public static let kMaxJumbomojiCount: UInt = 5
+
+    // This value is a bit arbitrary since we don't need to be 100% correct about
+    // rendering "Jumbomoji".  It allows us to place an upper bound on worst-case
+    // performacne.
+    @objc
+    public static let kMaxCharactersPerEmojiCount: UInt = 10
+
+    private init(filteredText: String?,
+                 naturalAlignment: NSTextAlignment,
+                 jumbomojiCount: UInt,
+                 shouldAllowLinkification: Bool) {
+        self.filteredText = filteredText
+        self.naturalAlignment = naturalAlignment
+        self.jumbomojiCount = jumbomojiCount
+        self.shouldAllowLinkification = shouldAllowLinkification
+    }
+
+    @objc
+    public func filteredText(body: String) -> String {
+        return filteredText ?? body
+    }
+
+    // MARK: - Analysis
+
+    @objc(analyzeBody:)
+    public class func analyze(body: String) -> MessageBodyAnalysis {
+        let filteredText = body.filterStringForDisplay()
+
+        return MessageBodyAnalysis(filteredText: filteredText == body ? nil : filteredText,
+                                   naturalAlignment: filteredText.naturalTextAlignment,
+                                   jumbomojiCount: jumbomojiCount(in: filteredText),
+                                   shouldAllowLinkification: shouldAllowLinkification(text: filteredText))
+    }
+
+    // If the string is...
+    //
+    // * Non-empty
+    // * Only contains emoji
+    // * Contains <= kMaxJumbomojiCount emoji
+    //
+    // ...return the number of emoji (to be treated as "Jumbomoji") in the string.
+    @objc(jumbomojiCountInText:)
+    public class func jumbomojiCount(in string: String) -> UInt {
+        if string == "" {
+            return 0
+        }
+        if string.count > Int(kMaxJumbomojiCount * kMaxCharactersPerEmojiCount) {
+            return 0
+        }
+        guard string.containsOnlyEmoji else {
+            return 0
+        }
+        let emojiCount = string.glyphCount
+        if UInt(emojiCount) > kMaxJumbomojiCount {
+            return 0
+        }
+        return UInt(emojiCount)
+    }
+
+    // For perf we use a static linkDetector. It doesn't change and building DataDetectors is
+    // surprisingly expensive. This should be fine, since NSDataDetector is an NSRegularExpression
+    // and NSRegularExpressions are thread safe.
+    private static let linkDetector: NSDataDetector? = {
+        return try? NSDataDetector(types: NSTextCheckingResult.CheckingType.link.rawValue)
+    }()
+
+    private static let hostRegex: NSRegularExpression? = {
+        let pattern = "^(?:https?:\\/\\/)?([^:\\/\\s]+)(.*)?$"
+        return try? NSRegularExpression(pattern: pattern)
+    }()
+
+    private class func links(in text: String) -> [NSTextCheckingResult] {
+        guard let linkDetector = self.linkDetector else {
+            owsFailDebug("linkDetector was unexpectedly nil")
+            return []
+        }
+        return linkDetector.matches(in: text, options: [], range: NSRange(location: 0, length: text.utf16.count)).filter {
+            $0.url != nil
+        }
+    }
+
+    @objc(shouldAllowLinkificationForText:)
+    public class func shouldAllowLinkification(text: String) -> Bool {
+        return shouldAllowLinkification(links: links(in: text), in: text)
+    }
+
+    private class func shouldAllowLinkification(links: [NSTextCheckingResult], in text: String) -> Bool {
+        guard linkDetector != nil else {
+            return false
+        }
+
+        func isValidLink(linkText: String) -> Bool {
+            guard let hostRegex = self.hostRegex else {
+                owsFailDebug("hostRegex was unexpectedly nil")
+                return false
+            }
+
+            guard let hostText = hostRegex.parseFirstMatch(inText: linkText) else {
+                owsFailDebug("hostText was unexpectedly nil")
+                return false
+            }
+
+            let strippedHost = hostText.replacingOccurrences(of: ".", with: "") as NSString
+
+            if strippedHost.isOnlyASCII {
+                return true
+            } else if strippedHost.hasAnyASCII {
+                // mix of ascii and non-ascii is invalid
+                return false
+            } else {
+                // IDN
+                return true
+            }
+        }
+
+        for link in links {
+            // We extract the exact text from the `text` rather than use match.url.host
+            // because match.url.host actually escapes non-ascii domains into puny-code.
+            //
+            // But what we really want is to check the text which will ultimately be presented to
+            // the user.
+            let rawTextOfMatch = (text as NSString).substring(with: link.range)
+            guard isValidLink(linkText: rawTextOfMatch) else {
+                return false
+            }
+        }
+        return true
+    }
+
+    // MARK: - Serialization
+
+    // version, flags, alignment and jumbomoji count, then the filtered
+    // text if it differs from the body. Version 1 also stored link ranges,
+    // which nothing read; those analyses are ignored and redone.
+    private static let serializationVersion: UInt8 = 2
+
+    private struct Flags: OptionSet {
+        let rawValue: UInt8
+
+        static let hasFilteredText = Flags(rawValue: 1 << 0)
+        static let shouldAllowLinkification = Flags(rawValue: 1 << 1)
+    }
+
+    public func serialize() -> Data {
+        var flags: Flags = []
+        if filteredText != nil {
+            flags.insert(.hasFilteredText)
+        }
+        if shouldAllowLinkification {
+            flags.insert(.shouldAllowLinkification)
+        }
+
+        var data = Data(capacity: 4 + (filteredText?.utf8.count ?? 0))
+        data.append(MessageBodyAnalysis.serializationVersion)
+        data.append(flags.rawValue)
+        data.append(UInt8(clamping: naturalAlignment.rawValue))
+        data.append(UInt8(clamping: jumbomojiCount))
+        if let filteredText = filteredText {
+            data.append(contentsOf: filteredText.utf8)
+        }
+        return data
+    }
+
+    public class func parse(_ data: Data) -> MessageBodyAnalysis? {
+        let bytes = [UInt8](data)
+        guard bytes.count >= 1 else {
+            owsFailDebug("Invalid data.")
+            return nil
+        }
+        guard bytes[0] == serializationVersion else {
+            Logger.warn("Unknown version: \(bytes[0]).")
+            return nil
+        }
+        guard bytes.count >= 4 else {
+            owsFailDebug("Invalid data.")
+            return nil
+        }
+        let flags = Flags(rawValue: bytes[1])
+        guard let naturalAlignment = NSTextAlignment(rawValue: Int(bytes[2])) else {
+            owsFailDebug("Invalid alignment.")
+            return nil
+        }
+        let jumbomojiCount = UInt(bytes[3])
+
+        var filteredText: String?
+        if flags.contains(.hasFilteredText) {
+            guard let text = String(bytes: bytes[4...], encoding: .utf8) else {
+                owsFailDebug("Invalid filtered text.")
+                return nil
+            }
+            filteredText = text
+        }
+
+        return MessageBodyAnalysis(filteredText: filteredText,
+                                   naturalAlignment: naturalAlignment,
+                                   jumbomojiCount: jumbomojiCount,
+                                   shouldAllowLinkification: flags.contains(.shouldAllowLinkification))
+    }
+
+    // MARK: - Storage
+
+    private static let keyValueStore = SDSKeyValueStore(collection: "MessageBodyAnalysis")
+
+    @objc(fetchAnalysisForMessageId:transaction:)
+    public class func fetch(messageId: String, transaction: SDSAnyReadTransaction) -> MessageBodyAnalysis? {
+        guard let data = keyValueStore.getData(messageId, transaction: transaction) else {
+            return nil
+        }
+        return parse(data)
+    }
+
+    @objc(saveForMessageId:transaction:)
+    public func save(messageId: String, transaction: SDSAnyWriteTransaction) {
+        MessageBodyAnalysis.keyValueStore.setData(serialize(), key: messageId, transaction: transaction)
+    }
+
+    @objc(removeAnalysisForMessageId:transaction:)
+    public class func remove(messageId: String, transaction: SDSAnyWriteTransaction) {
+        keyValueStore.removeValue(forKey: messageId, transaction: transaction)
+    }
+
+    // MARK: - Backfill
+
+    // Analyses of displayed messages that had none, keyed by message id.
+    // They're saved in one write, rather than one write per message.
+    private static var pendingBackfills = [String: MessageBodyAnalysis]()
+
+    @objc(backfillForMessageId:)
+    public func backfill(messageId: String) {
+        let shouldScheduleWrite: Bool = {
+            objc_sync_enter(MessageBodyAnalysis.self)
+            defer { objc_sync_exit(MessageBodyAnalysis.self) }
+
+            let shouldScheduleWrite = MessageBodyAnalysis.pendingBackfills.isEmpty
+            MessageBodyAnalysis.pendingBackfills[messageId] = self
+            return shouldScheduleWrite
+        }()
+        guard shouldScheduleWrite else {
+            return
+        }
+
+        SDSDatabaseStorage.shared.asyncWrite { transaction in
+            let backfills: [String: MessageBodyAnalysis] = {
+                objc_sync_enter(MessageBodyAnalysis.self)
+                defer { objc_sync_exit(MessageBodyAnalysis.self) }
+
+                let backfills = MessageBodyAnalysis.pendingBackfills
+                MessageBodyAnalysis.pendingBackfills = [:]
+                return backfills
+            }()
+            for (messageId, analysis) in backfills {
+                // The message may have been deleted since it was displayed.
+                guard TSInteraction.anyExists(uniqueId: messageId, transaction: transaction) else {
+                    continue
+                }
+                analysis.save(messageId: messageId, transaction: transaction)
+            }
+        }
+    }
+}
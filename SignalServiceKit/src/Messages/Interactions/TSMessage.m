@@ -7,6 +7,8 @@
 #import "MIMETypeUtil.h"
 #import "OWSContact.h"
 #import "OWSDisappearingMessagesConfiguration.h"
+#import "SSKEnvironment.h"
+#import "StorageCoordinator.h"
 #import "TSAttachment.h"
 #import "TSAttachmentStream.h"
 #import "TSQuotedMessage.h"
@@ -551,6 +553,14 @@ static const NSUInteger OWSMessageSchemaVersion = 4;
     [super anyDidInsertWithTransaction:transaction];
 
     [self ensurePerConversationExpirationWithTransaction:transaction];
+
+    // The YDB-to-GRDB migration inserts every message. Rather than analyze
+    // them all up front, their analyses are backfilled as they're displayed.
+    BOOL isMigrating
+        = SSKEnvironment.shared.storageCoordinator.state == StorageCoordinatorStateDuringYDBToGRDBMigration;
+    if (self.body.length > 0 && !isMigrating) {
+        [self updateBodyAnalysisWithTransaction:transaction];
+    }
 }
 
 - (void)anyWillUpdateWithTransaction:(SDSAnyWriteTransaction *)transaction
@@ -586,6 +596,17 @@ static const NSUInteger OWSMessageSchemaVersion = 4;
                                                              transaction:transaction];
 }
 
+// We analyze the body once, as the message is saved, so that
+// rendering the message doesn't need to.
+- (void)updateBodyAnalysisWithTransaction:(SDSAnyWriteTransaction *)transaction
+{
+    if (self.body.length > 0) {
+        [[MessageBodyAnalysis analyzeBody:self.body] saveForMessageId:self.uniqueId transaction:transaction];
+    } else {
+        [MessageBodyAnalysis removeAnalysisForMessageId:self.uniqueId transaction:transaction];
+    }
+}
+
 - (void)updateStoredShouldStartExpireTimer
 {
     _storedShouldStartExpireTimer = [self shouldStartExpireTimer];
@@ -612,7 +633,8 @@ static const NSUInteger OWSMessageSchemaVersion = 4;
     [super anyDidRemoveWithTransaction:transaction];
 
     [self removeAllAttachmentsWithTransaction:transaction];
-    
+    [MessageBodyAnalysis removeAnalysisForMessageId:self.uniqueId transaction:transaction];
+
     NSError *error;
     [self removeAllReactionsWithTransaction:transaction error:&error];
     if (error) {
@@ -724,6 +746,7 @@ static const NSUInteger OWSMessageSchemaVersion = 4;
                                     block:^(TSMessage *message) {
                                         message.body = messageBody;
                                     }];
+    [self updateBodyAnalysisWithTransaction:transaction];
 }
 
 #endif
@@ -765,6 +788,7 @@ static const NSUInteger OWSMessageSchemaVersion = 4;
                                         message.attachmentIds = [NSMutableArray new];
                                         OWSAssertDebug(!message.hasRenderableContent);
                                     }];
+    [MessageBodyAnalysis removeAnalysisForMessageId:self.uniqueId transaction:transaction];
 }
 
 @end
@@ -0,0 +1,143 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+
+@objc
+public enum MessageIngestStage: UInt, CaseIterable {
+    // OWSMessageReceiver was handed the envelope.
+    case received
+    // SSKMessageDecryptOperation began decrypting the envelope.
+    case decryptStarted
+    // The decrypted envelope was durably enqueued for processing.
+    case decrypted
+    // OWSBatchMessageProcessor began processing the envelope.
+    case processStarted
+    // The envelope's processing transaction committed.
+    case processed
+}
+
+// MARK: -
+
+// Records when each inbound envelope reaches each stage of the message
+// pipeline, so that benchmarks can break ingest latency down by stage.
+//
+// Tracing is disabled by default, in which case recording is a no-op and
+// envelope data isn't parsed. Envelopes are identified by their timestamp,
+// so a traced envelope stream should not reuse timestamps.
+@objc
+public class MessageIngestTrace: NSObject {
+
+    @objc
+    public static let shared = MessageIngestTrace()
+
+    // Checked before touching serialQueue, so that recording is cheap
+    // when tracing is disabled.
+    private let _isEnabled = AtomicBool(false)
+
+    // Should only be accessed on serialQueue.
+    private var stageTimes = [UInt64: [MessageIngestStage: CFTimeInterval]]()
+
+    private let serialQueue = DispatchQueue(label: "org.signal.messageIngestTrace")
+
+    @objc
+    public override init() {
+        super.init()
+    }
+
+    // MARK: -
+
+    @objc
+    public var isEnabled: Bool {
+        get {
+            return _isEnabled.get()
+        }
+        set {
+            _isEnabled.set(newValue)
+        }
+    }
+
+    @objc
+    public func reset() {
+        serialQueue.sync {
+            stageTimes.removeAll()
+        }
+    }
+
+    // Must be called on serialQueue.
+    private func record(stage: MessageIngestStage, envelopeTimestamp: UInt64, time: CFTimeInterval) {
+        stageTimes[envelopeTimestamp, default: [:]][stage] = time
+    }
+
+    @objc(recordStage:envelope:)
+    public func record(stage: MessageIngestStage, envelope: SSKProtoEnvelope) {
+        guard isEnabled else {
+            return
+        }
+        let time = CACurrentMediaTime()
+        let envelopeTimestamp = envelope.timestamp
+        // The accessors below sync on serialQueue, so they see this record.
+        serialQueue.async {
+            self.record(stage: stage, envelopeTimestamp: envelopeTimestamp, time: time)
+        }
+    }
+
+    @objc(recordStage:envelopeData:)
+    public func record(stage: MessageIngestStage, envelopeData: Data) {
+        guard isEnabled else {
+            return
+        }
+        do {
+            record(stage: stage, envelope: try SSKProtoEnvelope.parseData(envelopeData))
+        } catch {
+            owsFailDebug("Error: \(error)")
+        }
+    }
+
+    // Records the stage once the transaction has committed, since that's
+    // when the envelope's new state becomes visible to the next stage.
+    @objc(recordStage:envelope:transaction:)
+    public func record(stage: MessageIngestStage, envelope: SSKProtoEnvelope, transaction: SDSAnyWriteTransaction) {
+        guard isEnabled else {
+            return
+        }
+        let envelopeTimestamp = envelope.timestamp
+        transaction.addCompletion(queue: serialQueue) {
+            self.record(stage: stage, envelopeTimestamp: envelopeTimestamp, time: CACurrentMediaTime())
+        }
+    }
+
+    // MARK: -
+
+    public func count(stage: MessageIngestStage) -> Int {
+        return serialQueue.sync {
+            stageTimes.values.filter { $0[stage] != nil }.count
+        }
+    }
+
+    // The time each envelope took to get from one stage to another, for
+    // the envelopes which have reached both.
+    public func latencies(from fromStage: MessageIngestStage, to toStage: MessageIngestStage) -> [CFTimeInterval] {
+        return serialQueue.sync {
+            stageTimes.values.compactMap { times in
+                guard let fromTime = times[fromStage], let toTime = times[toStage] else {
+                    return nil
+                }
+                return toTime - fromTime
+            }
+        }
+    }
+
+    // The time between the first envelope reaching one stage and the
+    // last envelope reaching another.
+    public func span(from fromStage: MessageIngestStage, to toStage: MessageIngestStage) -> CFTimeInterval {
+        return serialQueue.sync {
+            guard let firstTime = stageTimes.values.compactMap({ $0[fromStage] }).min(),
+                let lastTime = stageTimes.values.compactMap({ $0[toStage] }).max() else {
+                    return 0
+            }
+            return lastTime - firstTime
+        }
+    }
+}
@@ -316,10 +316,14 @@ NS_ASSUME_NONNULL_BEGIN
             if (!envelope) {
                 reportFailure(transaction);
             } else {
+                [MessageIngestTrace.shared recordStage:MessageIngestStageProcessStarted envelope:envelope];
                 [self.messageManager throws_processEnvelope:envelope
                                               plaintextData:job.plaintextData
                                             wasReceivedByUD:job.wasReceivedByUD
                                                 transaction:transaction];
+                [MessageIngestTrace.shared recordStage:MessageIngestStageProcessed
+                                              envelope:envelope
+                                           transaction:transaction];
             }
         } @catch (NSException *exception) {
             OWSFailDebug(@"Received an invalid envelope: %@", exception.debugDescription);
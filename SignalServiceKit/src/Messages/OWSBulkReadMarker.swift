@@ -0,0 +1,182 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+import GRDB
+
+// The side effects of marking a range of interactions as read, for
+// OWSReadReceiptManager to apply once per range rather than per message.
+@objc
+public class OWSBulkReadResult: NSObject {
+    @objc
+    public let markedCount: Int
+
+    // The timestamps of the newly read incoming messages, by author.
+    @objc
+    public let messageTimestampsByAuthor: [SignalServiceAddress: [NSNumber]]
+
+    // The newest of the newly read incoming messages, if any.
+    @objc
+    public let latestMessageAuthor: SignalServiceAddress?
+    @objc
+    public let latestMessageTimestamp: UInt64
+
+    // The soonest that a message whose expiration we started will expire.
+    @objc
+    public let nextExpirationDate: Date?
+
+    init(markedCount: Int,
+         messageTimestampsByAuthor: [SignalServiceAddress: [NSNumber]],
+         latestMessageAuthor: SignalServiceAddress?,
+         latestMessageTimestamp: UInt64,
+         nextExpirationDate: Date?) {
+        self.markedCount = markedCount
+        self.messageTimestampsByAuthor = messageTimestampsByAuthor
+        self.latestMessageAuthor = latestMessageAuthor
+        self.latestMessageTimestamp = latestMessageTimestamp
+        self.nextExpirationDate = nextExpirationDate
+    }
+}
+
+// MARK: -
+
+// Marks every unread interaction in a thread up to a sortId as read with
+// a single UPDATE over index_interactions_on_threadId_read_and_id, rather
+// than loading and saving each message. Expiration timers of incoming
+// disappearing messages are started by the same statement.
+//
+// This bypasses the model update hooks, so the caller is responsible for
+// read receipts, for scheduling the disappearing messages job and for
+// touching the thread.
+@objc
+public class OWSBulkReadMarker: NSObject {
+
+    @objc
+    public class func hasUnreadInteractions(threadUniqueId: String,
+                                            beforeSortId sortId: UInt64,
+                                            transaction: SDSAnyReadTransaction) -> Bool {
+        do {
+            let finder = InteractionFinder(threadUniqueId: threadUniqueId)
+            guard let oldestUnreadInteraction = try finder.oldestUnseenInteraction(transaction: transaction) else {
+                return false
+            }
+            return oldestUnreadInteraction.sortId <= sortId
+        } catch {
+            owsFailDebug("Error: \(error)")
+            return false
+        }
+    }
+
+    // Returns nil if the transaction doesn't support bulk updates, in
+    // which case the messages should be marked as read individually.
+    @objc
+    public class func markAsRead(threadUniqueId: String,
+                                 beforeSortId sortId: UInt64,
+                                 readTimestamp: UInt64,
+                                 transaction: SDSAnyWriteTransaction) -> OWSBulkReadResult? {
+        switch transaction.writeTransaction {
+        case .yapWrite:
+            return nil
+        case .grdbWrite(let grdbWrite):
+            do {
+                return try markAsRead(threadUniqueId: threadUniqueId,
+                                      beforeSortId: sortId,
+                                      readTimestamp: readTimestamp,
+                                      transaction: grdbWrite)
+            } catch {
+                owsFailDebug("Error: \(error.grdbErrorForLogging)")
+                return nil
+            }
+        }
+    }
+
+    private class func markAsRead(threadUniqueId: String,
+                                  beforeSortId sortId: UInt64,
+                                  readTimestamp: UInt64,
+                                  transaction: GRDBWriteTransaction) throws -> OWSBulkReadResult {
+        let database = transaction.database
+        let whereClause = """
+            WHERE \(interactionColumn: .threadUniqueId) = ?
+            AND \(GRDBInteractionFinderAdapter.sqlClauseForAllUnreadInteractions)
+            AND \(interactionColumn: .id) <= ?
+        """
+        let whereArguments: StatementArguments = [threadUniqueId, Int64(sortId)]
+
+        // Expiration only starts on read for incoming messages; other
+        // interactions which expire started expiring when they were saved.
+        let startsExpirationClause = """
+            \(interactionColumn: .recordType) = \(SDSRecordType.incomingMessage.rawValue)
+            AND \(interactionColumn: .expiresInSeconds) > 0
+            AND (\(interactionColumn: .expireStartedAt) = 0 OR \(interactionColumn: .expireStartedAt) > \(readTimestamp))
+        """
+
+        // Collect what we need for receipts before the rows stop matching.
+        var messageTimestampsByAuthor = [SignalServiceAddress: [NSNumber]]()
+        var latestMessageAuthor: SignalServiceAddress?
+        var latestMessageTimestamp: UInt64 = 0
+        var nextExpiresAt: UInt64?
+        let selectSql = """
+            SELECT
+                \(interactionColumn: .timestamp),
+                \(interactionColumn: .authorPhoneNumber),
+                \(interactionColumn: .authorUUID),
+                CASE WHEN \(startsExpirationClause)
+                    THEN \(interactionColumn: .expiresInSeconds)
+                    ELSE 0
+                END
+            FROM \(InteractionRecord.databaseTableName)
+            \(whereClause)
+            AND \(interactionColumn: .recordType) = \(SDSRecordType.incomingMessage.rawValue)
+            ORDER BY \(interactionColumn: .id)
+        """
+        let cursor = try Row.fetchCursor(database, sql: selectSql, arguments: whereArguments)
+        while let row = try cursor.next() {
+            let timestamp: UInt64 = row[0]
+            let authorPhoneNumber: String? = row[1]
+            let authorUUID: String? = row[2]
+            let expiresInSeconds: UInt64 = row[3]
+
+            let author = SignalServiceAddress(uuidString: authorUUID, phoneNumber: authorPhoneNumber)
+            guard author.isValid else {
+                owsFailDebug("Invalid author.")
+                continue
+            }
+            messageTimestampsByAuthor[author, default: []].append(NSNumber(value: timestamp))
+            latestMessageAuthor = author
+            latestMessageTimestamp = timestamp
+
+            if expiresInSeconds > 0 {
+                let expiresAt = readTimestamp + expiresInSeconds * 1000
+                nextExpiresAt = min(nextExpiresAt ?? expiresAt, expiresAt)
+            }
+        }
+
+        // SQLite evaluates every SET expression against the row's old values.
+        let updateSql = """
+            UPDATE \(InteractionRecord.databaseTableName)
+            SET
+                \(interactionColumn: .read) = 1,
+                \(interactionColumn: .storedShouldStartExpireTimer) = CASE WHEN \(startsExpirationClause)
+                    THEN 1
+                    ELSE \(interactionColumn: .storedShouldStartExpireTimer)
+                END,
+                \(interactionColumn: .expiresAt) = CASE WHEN \(startsExpirationClause)
+                    THEN \(readTimestamp) + \(interactionColumn: .expiresInSeconds) * 1000
+                    ELSE \(interactionColumn: .expiresAt)
+                END,
+                \(interactionColumn: .expireStartedAt) = CASE WHEN \(startsExpirationClause)
+                    THEN \(readTimestamp)
+                    ELSE \(interactionColumn: .expireStartedAt)
+                END
+            \(whereClause)
+        """
+        try database.execute(sql: updateSql, arguments: whereArguments)
+
+        return OWSBulkReadResult(markedCount: database.changesCount,
+                                 messageTimestampsByAuthor: messageTimestampsByAuthor,
+                                 latestMessageAuthor: latestMessageAuthor,
+                                 latestMessageTimestamp: latestMessageTimestamp,
+                                 nextExpirationDate: nextExpiresAt.map { NSDate.ows_date(withMillisecondsSince1970: $0) })
+    }
+}
@@ -48,6 +48,10 @@ NS_ASSUME_NONNULL_BEGIN
 - (void)cleanupMessagesWhichFailedToStartExpiringWithTransaction:(SDSAnyWriteTransaction *)transaction;
 - (void)schedulePass;
 
+// Schedules a run for when a message whose expiration was started
+// outside of startAnyExpirationForMessage: will expire.
+- (void)scheduleRunByDate:(NSDate *)date;
+
 #ifdef TESTABLE_BUILD
 - (void)syncPassForTests;
 #endif
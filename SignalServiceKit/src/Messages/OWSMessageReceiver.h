@@ -71,6 +71,10 @@ NS_SWIFT_NAME(init(grdbId:uniqueId:createdAt:envelopeData:));
 
 - (void)handleReceivedEnvelopeData:(NSData *)envelopeData;
 
+// Enqueues a batch of envelopes in a single write transaction. The
+// envelopes have been durably enqueued when this method returns.
+- (void)handleReceivedEnvelopeDataBatch:(NSArray<NSData *> *)envelopeDataBatch;
+
 @end
 
 NS_ASSUME_NONNULL_END
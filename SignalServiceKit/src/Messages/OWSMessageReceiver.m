@@ -517,6 +517,11 @@ NSString *const OWSMessageDecryptJobFinderExtensionGroup = @"OWSMessageProcessin
     return SSKEnvironment.shared.storageCoordinator;
 }
 
+- (SDSDatabaseStorage *)databaseStorage
+{
+    return SDSDatabaseStorage.shared;
+}
+
 #pragma mark - class methods
 
 + (NSString *)databaseExtensionName
@@ -532,10 +537,56 @@ NSString *const OWSMessageDecryptJobFinderExtensionGroup = @"OWSMessageProcessin
 #pragma mark - instance methods
 
 - (void)handleReceivedEnvelopeData:(NSData *)envelopeData
+{
+    if (![self isValidEnvelopeData:envelopeData]) {
+        return;
+    }
+
+    [MessageIngestTrace.shared recordStage:MessageIngestStageReceived envelopeData:envelopeData];
+
+    if (StorageCoordinator.dataStoreForUI == DataStoreYdb) {
+        [self.yapProcessingQueue enqueueEnvelopeData:envelopeData];
+        [self.yapProcessingQueue drainQueue];
+    } else {
+        // We *could* use this processing Queue for Yap *and* GRDB
+        [self.messageDecryptJobQueue enqueueEnvelopeData:envelopeData];
+    }
+}
+
+- (void)handleReceivedEnvelopeDataBatch:(NSArray<NSData *> *)envelopeDataBatch
+{
+    NSMutableArray<NSData *> *validEnvelopeDatas = [NSMutableArray new];
+    for (NSData *envelopeData in envelopeDataBatch) {
+        if ([self isValidEnvelopeData:envelopeData]) {
+            [MessageIngestTrace.shared recordStage:MessageIngestStageReceived envelopeData:envelopeData];
+            [validEnvelopeDatas addObject:envelopeData];
+        }
+    }
+    if (validEnvelopeDatas.count < 1) {
+        return;
+    }
+
+    BOOL isYdb = StorageCoordinator.dataStoreForUI == DataStoreYdb;
+    [self.databaseStorage writeWithBlock:^(SDSAnyWriteTransaction *transaction) {
+        for (NSData *envelopeData in validEnvelopeDatas) {
+            if (isYdb) {
+                [self.yapProcessingQueue.finder addJobForEnvelopeData:envelopeData transaction:transaction];
+            } else {
+                [self.messageDecryptJobQueue enqueueEnvelopeData:envelopeData transaction:transaction];
+            }
+        }
+    }];
+
+    if (isYdb) {
+        [self.yapProcessingQueue drainQueue];
+    }
+}
+
+- (BOOL)isValidEnvelopeData:(NSData *)envelopeData
 {
     if (envelopeData.length < 1) {
         OWSFailDebug(@"Empty envelope.");
-        return;
+        return NO;
     }
 
     // Drop any too-large messages on the floor. Well behaving clients should never send them.
@@ -543,7 +594,7 @@ NSString *const OWSMessageDecryptJobFinderExtensionGroup = @"OWSMessageProcessin
     if (envelopeData.length > kMaxEnvelopeByteCount) {
         OWSProdError([OWSAnalyticsEvents messageReceiverErrorOversizeMessage]);
         OWSFailDebug(@"Oversize message.");
-        return;
+        return NO;
     }
 
     // Take note of any messages larger than we expect, but still process them.
@@ -554,13 +605,7 @@ NSString *const OWSMessageDecryptJobFinderExtensionGroup = @"OWSMessageProcessin
         OWSFailDebug(@"Unexpectedly large message.");
     }
 
-    if (StorageCoordinator.dataStoreForUI == DataStoreYdb) {
-        [self.yapProcessingQueue enqueueEnvelopeData:envelopeData];
-        [self.yapProcessingQueue drainQueue];
-    } else {
-        // We *could* use this processing Queue for Yap *and* GRDB
-        [self.messageDecryptJobQueue enqueueEnvelopeData:envelopeData];
-    }
+    return YES;
 }
 
 @end
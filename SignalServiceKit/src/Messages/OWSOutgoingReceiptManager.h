@@ -25,6 +25,10 @@ NS_ASSUME_NONNULL_BEGIN
                            timestamp:(uint64_t)timestamp
                          transaction:(SDSAnyWriteTransaction *)transaction;
 
+- (void)enqueueReadReceiptsForAddress:(SignalServiceAddress *)messageAuthorAddress
+                           timestamps:(NSArray<NSNumber *> *)timestamps
+                          transaction:(SDSAnyWriteTransaction *)transaction;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -6,6 +6,7 @@
 #import "AppReadiness.h"
 #import "OWSError.h"
 #import "OWSMessageSender.h"
+#import "OWSQueues.h"
 #import "OWSReceiptsForSenderMessage.h"
 #import "SSKEnvironment.h"
 #import "TSContactThread.h"
@@ -15,17 +16,36 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
-typedef NS_ENUM(NSUInteger, OWSReceiptType) {
-    OWSReceiptType_Delivery,
-    OWSReceiptType_Read,
-};
+// Receipts are flushed after a short delay so that receipts for several
+// messages from the same sender can share a message. While receipts keep
+// arriving (e.g. while catching up on a backlog) the delay backs off, up
+// to kMaxFlushIntervalSeconds, so that they aggregate into fewer sends.
+static const NSTimeInterval kMinFlushIntervalSeconds = 1.0;
+static const NSTimeInterval kMaxFlushIntervalSeconds = 8.0;
+// Enqueuing more than this many receipts within a flush interval
+// counts as a burst.
+static const NSUInteger kBurstReceiptCount = 20;
+// Flush right away once this many receipts are pending, however busy we are.
+static const NSUInteger kMaxPendingReceiptCount = 500;
+// Bounds the size of each receipt message and of each processing pass.
+static const NSInteger kMaxTimestampsPerMessage = 100;
+static const NSInteger kMaxMessagesPerPass = 50;
+// After a pass in which any send fails, we retry after a delay that
+// doubles with each consecutive failing pass.
+static const NSTimeInterval kMinRetryIntervalSeconds = 3.0;
+static const NSTimeInterval kMaxRetryIntervalSeconds = 5 * 60.0;
 
 @interface OWSOutgoingReceiptManager ()
 
 @property (nonatomic) Reachability *reachability;
+@property (nonatomic, readonly) OWSOutgoingReceiptStore *receiptStore;
 
-// This property should only be accessed on the serialQueue.
+// These properties should only be accessed on the serialQueue.
 @property (nonatomic) BOOL isProcessing;
+@property (nonatomic) BOOL isProcessingScheduled;
+@property (nonatomic) NSTimeInterval flushInterval;
+@property (nonatomic) NSTimeInterval retryInterval;
+@property (nonatomic) NSUInteger enqueuedReceiptCount;
 
 @end
 
@@ -44,12 +64,12 @@ typedef NS_ENUM(NSUInteger, OWSReceiptType) {
 
 + (SDSKeyValueStore *)deliveryReceiptStore
 {
-    return [[SDSKeyValueStore alloc] initWithCollection:@"kOutgoingDeliveryReceiptManagerCollection"];
+    return OWSOutgoingReceiptStore.deliveryReceiptStore;
 }
 
 + (SDSKeyValueStore *)readReceiptStore
 {
-    return [[SDSKeyValueStore alloc] initWithCollection:@"kOutgoingReadReceiptManagerCollection"];
+    return OWSOutgoingReceiptStore.readReceiptStore;
 }
 
 #pragma mark -
@@ -70,6 +90,9 @@ typedef NS_ENUM(NSUInteger, OWSReceiptType) {
     }
 
     self.reachability = [Reachability reachabilityForInternetConnection];
+    _receiptStore = [OWSOutgoingReceiptStore new];
+    _flushInterval = kMinFlushIntervalSeconds;
+    _retryInterval = kMinRetryIntervalSeconds;
 
     OWSSingletonAssert();
 
@@ -80,7 +103,11 @@ typedef NS_ENUM(NSUInteger, OWSReceiptType) {
 
     // Start processing.
     [AppReadiness runNowOrWhenAppDidBecomeReady:^{
-        [self process];
+        dispatch_async(self.serialQueue, ^{
+            [self.receiptStore migrateLegacyReceiptsIfNecessary];
+
+            [self processOnSerialQueue];
+        });
     }];
 
     return self;
@@ -113,146 +140,197 @@ typedef NS_ENUM(NSUInteger, OWSReceiptType) {
     return _serialQueue;
 }
 
-// Schedules a processing pass, unless one is already scheduled.
-- (void)process {
-    OWSAssertDebug(AppReadiness.isAppReady);
-
+- (void)didEnqueueReceipts:(NSUInteger)count
+{
     dispatch_async(self.serialQueue, ^{
-        if (self.isProcessing) {
-            return;
+        self.enqueuedReceiptCount += count;
+
+        if (self.enqueuedReceiptCount >= kMaxPendingReceiptCount) {
+            [self processOnSerialQueue];
+        } else {
+            [self scheduleProcessingAfterInterval:self.flushInterval];
         }
+    });
+}
 
-        OWSLogVerbose(@"Processing outbound receipts.");
+- (void)scheduleProcessingAfterInterval:(NSTimeInterval)interval
+{
+    AssertOnDispatchQueue(self.serialQueue);
 
-        self.isProcessing = YES;
+    if (self.isProcessingScheduled) {
+        return;
+    }
+    self.isProcessingScheduled = YES;
 
-        if (!self.reachability.isReachable) {
-            // No network availability; abort.
-            self.isProcessing = NO;
-            return;
-        }
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(interval * NSEC_PER_SEC)), self.serialQueue, ^{
+        self.isProcessingScheduled = NO;
 
-        NSMutableArray<AnyPromise *> *sendPromises = [NSMutableArray array];
-        [sendPromises addObjectsFromArray:[self sendReceiptsForReceiptType:OWSReceiptType_Delivery]];
-        [sendPromises addObjectsFromArray:[self sendReceiptsForReceiptType:OWSReceiptType_Read]];
+        [self processOnSerialQueue];
+    });
+}
 
-        if (sendPromises.count < 1) {
-            // No work to do; abort.
-            self.isProcessing = NO;
-            return;
-        }
+// Processes pending receipts, unless a processing pass is already underway.
+- (void)process {
+    OWSAssertDebug(AppReadiness.isAppReady);
 
-        AnyPromise *completionPromise = PMKJoin(sendPromises);
-        completionPromise.ensure(^() {
-            // Wait N seconds before conducting another pass.
-            // This allows time for a batch to accumulate.
-            //
-            // We want a value high enough to allow us to effectively de-duplicate
-            // receipts without being so high that we incur so much latency that
-            // the user notices.
-            const CGFloat kProcessingFrequencySeconds = 3.f;
-            dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kProcessingFrequencySeconds * NSEC_PER_SEC)),
-                self.serialQueue,
-                ^{
-                    self.isProcessing = NO;
-
-                    [self process];
-                });
-        });
-        [completionPromise retainUntilComplete];
+    dispatch_async(self.serialQueue, ^{
+        [self processOnSerialQueue];
     });
 }
 
-- (NSArray<AnyPromise *> *)sendReceiptsForReceiptType:(OWSReceiptType)receiptType {
-    SDSKeyValueStore *store = [self storeForReceiptType:receiptType];
+- (void)processOnSerialQueue
+{
+    AssertOnDispatchQueue(self.serialQueue);
 
-    NSMutableDictionary<NSString *, NSSet<NSNumber *> *> *queuedReceiptMap = [NSMutableDictionary new];
+    if (self.isProcessing) {
+        return;
+    }
+    if (!AppReadiness.isAppReady) {
+        // We'll process once the app is ready.
+        return;
+    }
+
+    OWSLogVerbose(@"Processing outbound receipts.");
+
+    self.isProcessing = YES;
+
+    // Adapt the flush interval to how many receipts arrived since the last pass.
+    if (self.enqueuedReceiptCount > kBurstReceiptCount) {
+        self.flushInterval = MIN(kMaxFlushIntervalSeconds, self.flushInterval * 2);
+    } else {
+        self.flushInterval = kMinFlushIntervalSeconds;
+    }
+    self.enqueuedReceiptCount = 0;
+
+    if (!self.reachability.isReachable) {
+        // No network availability; abort.
+        self.isProcessing = NO;
+        return;
+    }
+
+    __block NSArray<OWSOutgoingReceiptBatch *> *batches;
     [self.databaseStorage readWithBlock:^(SDSAnyReadTransaction *transaction) {
-        [store enumerateKeysAndObjectsWithTransaction:transaction
-                                                block:^(NSString *key, id object, BOOL *stop) {
-                                                    NSString *recipientId = key;
-                                                    NSSet<NSNumber *> *timestamps = object;
-                                                    queuedReceiptMap[recipientId] = [timestamps copy];
-                                                }];
+        batches = [self.receiptStore pendingBatchesWithMaxTimestampsPerBatch:kMaxTimestampsPerMessage
+                                                               maxBatchCount:kMaxMessagesPerPass
+                                                                 transaction:transaction];
     }];
 
     NSMutableArray<AnyPromise *> *sendPromises = [NSMutableArray array];
+    for (OWSOutgoingReceiptBatch *batch in batches) {
+        AnyPromise *_Nullable sendPromise = [self sendReceiptBatch:batch];
+        if (sendPromise != nil) {
+            [sendPromises addObject:sendPromise];
+        }
+    }
 
-    for (NSString *identifier in queuedReceiptMap) {
-        // The identifier could be either a UUID or a phone number,
-        // check if it's a valid UUID. If not, assume it's a phone number.
+    if (sendPromises.count < 1) {
+        // No work to do; abort.
+        self.isProcessing = NO;
+        return;
+    }
 
-        SignalServiceAddress *address;
-        NSUUID *_Nullable uuid = [[NSUUID alloc] initWithUUIDString:identifier];
-        if (uuid) {
-            address = [[SignalServiceAddress alloc] initWithUuid:uuid phoneNumber:nil];
-        } else {
-            address = [[SignalServiceAddress alloc] initWithPhoneNumber:identifier];
-        }
+    BOOL mayHaveMoreReceipts = batches.count >= kMaxMessagesPerPass;
+    AnyPromise *completionPromise = PMKWhen(sendPromises);
+    completionPromise.thenOn(self.serialQueue, ^(NSArray *results) {
+        self.isProcessing = NO;
 
-        if (!address.isValid) {
-            OWSFailDebug(@"Unexpected identifier.");
-            continue;
+        BOOL didAnySendFail = NO;
+        for (NSNumber *didSucceed in results) {
+            if (!didSucceed.boolValue) {
+                didAnySendFail = YES;
+                break;
+            }
         }
 
-        NSSet<NSNumber *> *timestamps = queuedReceiptMap[identifier];
-        if (timestamps.count < 1) {
-            OWSFailDebug(@"Missing timestamps.");
-            continue;
+        if (didAnySendFail) {
+            // Don't loop while sends are failing (e.g. while the service
+            // is unavailable); back off and try again.
+            NSTimeInterval retryInterval = self.retryInterval;
+            self.retryInterval = MIN(kMaxRetryIntervalSeconds, self.retryInterval * 2);
+            [self scheduleProcessingAfterInterval:retryInterval];
+            return;
         }
+        self.retryInterval = kMinRetryIntervalSeconds;
 
-        TSThread *thread = [TSContactThread getOrCreateThreadWithContactAddress:address];
-        OWSReceiptsForSenderMessage *message;
-        NSString *receiptName;
-        switch (receiptType) {
-            case OWSReceiptType_Delivery:
-                message =
-                    [OWSReceiptsForSenderMessage deliveryReceiptsForSenderMessageWithThread:thread
-                                                                          messageTimestamps:timestamps.allObjects];
-                receiptName = @"Delivery";
-                break;
-            case OWSReceiptType_Read:
-                message = [OWSReceiptsForSenderMessage readReceiptsForSenderMessageWithThread:thread
-                                                                            messageTimestamps:timestamps.allObjects];
-                receiptName = @"Read";
-                break;
+        if (mayHaveMoreReceipts) {
+            [self processOnSerialQueue];
+        } else if (self.enqueuedReceiptCount > 0) {
+            [self scheduleProcessingAfterInterval:self.flushInterval];
         }
+    });
+    [completionPromise retainUntilComplete];
+}
 
-        AnyPromise *sendPromise = [AnyPromise promiseWithResolverBlock:^(PMKResolver resolve) {
-            [self.messageSender sendMessage:message.asPreparer
-                success:^{
-                    OWSLogInfo(
-                        @"Successfully sent %lu %@ receipts to sender.", (unsigned long)timestamps.count, receiptName);
+- (nullable AnyPromise *)sendReceiptBatch:(OWSOutgoingReceiptBatch *)batch
+{
+    SignalServiceAddress *address = batch.address;
+    if (!address.isValid) {
+        OWSFailDebug(@"Unexpected identifier.");
+        return nil;
+    }
 
-                    // DURABLE CLEANUP - we could replace the custom durability logic in this class
-                    // with a durable JobQueue.
-                    [self dequeueReceiptsForAddress:address timestamps:timestamps receiptType:receiptType];
+    NSArray<NSNumber *> *timestamps = batch.timestampNumbers;
+    if (timestamps.count < 1) {
+        OWSFailDebug(@"Missing timestamps.");
+        return nil;
+    }
 
-                    // The value doesn't matter, we just need any non-NSError value.
-                    resolve(@(1));
-                }
-                failure:^(NSError *error) {
-                    OWSLogError(@"Failed to send %@ receipts to sender with error: %@", receiptName, error);
-
-                    if (error.domain == OWSSignalServiceKitErrorDomain
-                        && error.code == OWSErrorCodeNoSuchSignalRecipient) {
-                        [self dequeueReceiptsForAddress:address timestamps:timestamps receiptType:receiptType];
-                    }
-
-                    resolve(error);
-                }];
-        }];
-        [sendPromises addObject:sendPromise];
+    TSThread *thread = [TSContactThread getOrCreateThreadWithContactAddress:address];
+    OWSReceiptsForSenderMessage *message;
+    NSString *receiptName;
+    switch (batch.receiptType) {
+        case OWSOutgoingReceiptTypeDelivery:
+            message = [OWSReceiptsForSenderMessage deliveryReceiptsForSenderMessageWithThread:thread
+                                                                            messageTimestamps:timestamps];
+            receiptName = @"Delivery";
+            break;
+        case OWSOutgoingReceiptTypeRead:
+            message = [OWSReceiptsForSenderMessage readReceiptsForSenderMessageWithThread:thread
+                                                                        messageTimestamps:timestamps];
+            receiptName = @"Read";
+            break;
     }
 
-    return [sendPromises copy];
+    return [AnyPromise promiseWithResolverBlock:^(PMKResolver resolve) {
+        [self.messageSender sendMessage:message.asPreparer
+            success:^{
+                OWSLogInfo(
+                    @"Successfully sent %lu %@ receipts to sender.", (unsigned long)timestamps.count, receiptName);
+
+                // DURABLE CLEANUP - we could replace the custom durability logic in this class
+                // with a durable JobQueue.
+                //
+                // Resolve once the receipts are dequeued, so that the next pass doesn't resend them.
+                [self dequeueReceiptBatch:batch
+                               completion:^{
+                                   resolve(@(YES));
+                               }];
+            }
+            failure:^(NSError *error) {
+                OWSLogError(@"Failed to send %@ receipts to sender with error: %@", receiptName, error);
+
+                // Failures resolve with NO rather than rejecting, so that
+                // the pass waits for every send and knows whether to retry.
+                if (error.domain == OWSSignalServiceKitErrorDomain
+                    && error.code == OWSErrorCodeNoSuchSignalRecipient) {
+                    // There's nothing to retry.
+                    [self dequeueReceiptBatch:batch
+                                   completion:^{
+                                       resolve(@(YES));
+                                   }];
+                    return;
+                }
+
+                resolve(@(NO));
+            }];
+    }];
 }
 
 - (void)enqueueDeliveryReceiptForEnvelope:(SSKProtoEnvelope *)envelope transaction:(SDSAnyWriteTransaction *)transaction
 {
     [self enqueueReceiptForAddress:envelope.sourceAddress
                          timestamp:envelope.timestamp
-                       receiptType:OWSReceiptType_Delivery
+                       receiptType:OWSOutgoingReceiptTypeDelivery
                        transaction:transaction];
 }
 
@@ -260,108 +338,53 @@ typedef NS_ENUM(NSUInteger, OWSReceiptType) {
                            timestamp:(uint64_t)timestamp
                          transaction:(SDSAnyWriteTransaction *)transaction
 {
-    [self enqueueReceiptForAddress:address timestamp:timestamp receiptType:OWSReceiptType_Read transaction:transaction];
+    [self enqueueReceiptForAddress:address
+                         timestamp:timestamp
+                       receiptType:OWSOutgoingReceiptTypeRead
+                       transaction:transaction];
 }
 
-- (void)enqueueReceiptForAddress:(SignalServiceAddress *)address
-                       timestamp:(uint64_t)timestamp
-                     receiptType:(OWSReceiptType)receiptType
-                     transaction:(SDSAnyWriteTransaction *)transaction
+- (void)enqueueReadReceiptsForAddress:(SignalServiceAddress *)address
+                           timestamps:(NSArray<NSNumber *> *)timestamps
+                          transaction:(SDSAnyWriteTransaction *)transaction
 {
-    SDSKeyValueStore *store = [self storeForReceiptType:receiptType];
-
-    OWSAssertDebug(address.isValid);
-    if (timestamp < 1) {
-        OWSFailDebug(@"Invalid timestamp.");
+    if (timestamps.count < 1) {
         return;
     }
 
-    NSString *identifier = address.uuidString ?: address.phoneNumber;
+    [self.receiptStore enqueueReceiptsWithAddress:address
+                                       timestamps:timestamps
+                                      receiptType:OWSOutgoingReceiptTypeRead
+                                      transaction:transaction];
 
-    NSSet<NSNumber *> *_Nullable oldUUIDTimestamps;
-    if (address.uuidString) {
-        oldUUIDTimestamps = [store getObject:address.uuidString transaction:transaction];
-    }
-
-    NSSet<NSNumber *> *_Nullable oldPhoneNumberTimestamps;
-    if (address.phoneNumber) {
-        oldPhoneNumberTimestamps = [store getObject:address.phoneNumber transaction:transaction];
-    }
-
-    NSSet<NSNumber *> *_Nullable oldTimestamps;
-
-    // Unexpectedly have entries both on phone number and UUID, defer to UUID
-    if (oldUUIDTimestamps && oldPhoneNumberTimestamps) {
-        oldTimestamps = [oldUUIDTimestamps setByAddingObjectsFromSet:oldPhoneNumberTimestamps];
-        [store removeValueForKey:address.phoneNumber transaction:transaction];
-
-        // If we have timestamps only under phone number, but know the UUID, migrate them lazily
-    } else if (oldPhoneNumberTimestamps && address.uuidString) {
-        oldTimestamps = oldPhoneNumberTimestamps;
-        [store removeValueForKey:address.phoneNumber transaction:transaction];
-    } else {
-        oldTimestamps = oldUUIDTimestamps ?: oldPhoneNumberTimestamps;
-    }
-
-    NSMutableSet<NSNumber *> *newTimestamps = (oldTimestamps ? [oldTimestamps mutableCopy] : [NSMutableSet new]);
-    [newTimestamps addObject:@(timestamp)];
+    NSUInteger count = timestamps.count;
+    [transaction addCompletionWithBlock:^{
+        [self didEnqueueReceipts:count];
+    }];
+}
 
-    [store setObject:newTimestamps key:identifier transaction:transaction];
+- (void)enqueueReceiptForAddress:(SignalServiceAddress *)address
+                       timestamp:(uint64_t)timestamp
+                     receiptType:(OWSOutgoingReceiptType)receiptType
+                     transaction:(SDSAnyWriteTransaction *)transaction
+{
+    [self.receiptStore enqueueReceiptWithAddress:address
+                                       timestamp:timestamp
+                                     receiptType:receiptType
+                                     transaction:transaction];
 
     [transaction addCompletionWithBlock:^{
-        [self process];
+        [self didEnqueueReceipts:1];
     }];
 }
 
-- (void)dequeueReceiptsForAddress:(SignalServiceAddress *)address
-                       timestamps:(NSSet<NSNumber *> *)timestamps
-                      receiptType:(OWSReceiptType)receiptType
+- (void)dequeueReceiptBatch:(OWSOutgoingReceiptBatch *)batch completion:(dispatch_block_t)completion
 {
-    SDSKeyValueStore *store = [self storeForReceiptType:receiptType];
-
-    OWSAssertDebug(address.isValid);
-    if (timestamps.count < 1) {
-        OWSFailDebug(@"Invalid timestamps.");
-        return;
+    [self.databaseStorage asyncCoalescedWriteWithBlock:^(SDSAnyWriteTransaction *transaction) {
+        [self.receiptStore removeBatch:batch transaction:transaction];
     }
-    [self.databaseStorage asyncWriteWithBlock:^(SDSAnyWriteTransaction *transaction) {
-        NSString *identifier = address.uuidString ?: address.phoneNumber;
-
-        NSSet<NSNumber *> *_Nullable oldUUIDTimestamps;
-        if (address.uuidString) {
-            oldUUIDTimestamps = [store getObject:address.uuidString transaction:transaction];
-        }
-
-        NSSet<NSNumber *> *_Nullable oldPhoneNumberTimestamps;
-        if (address.phoneNumber) {
-            oldPhoneNumberTimestamps = [store getObject:address.phoneNumber transaction:transaction];
-        }
-
-        NSSet<NSNumber *> *_Nullable oldTimestamps = oldUUIDTimestamps;
-
-        // Unexpectedly have entries both on phone number and UUID, defer to UUID
-        if (oldUUIDTimestamps && oldPhoneNumberTimestamps) {
-            [store removeValueForKey:address.phoneNumber transaction:transaction];
-
-            // If we have timestamps only under phone number, but know the UUID, migrate them lazily
-        } else if (oldPhoneNumberTimestamps && address.uuidString) {
-            oldTimestamps = oldPhoneNumberTimestamps;
-            [store removeValueForKey:address.phoneNumber transaction:transaction];
-
-            // We don't know the UUID, just use the phone number timestamps.
-        } else if (oldPhoneNumberTimestamps) {
-            oldTimestamps = oldPhoneNumberTimestamps;
-        }
-
-        NSMutableSet<NSNumber *> *newTimestamps = (oldTimestamps ? [oldTimestamps mutableCopy] : [NSMutableSet new]);
-        [newTimestamps minusSet:timestamps];
-
-        if (newTimestamps.count > 0) {
-            [store setObject:newTimestamps key:identifier transaction:transaction];
-        } else {
-            [store removeValueForKey:identifier transaction:transaction];
-        }
-    }];
+                                       completionQueue:self.serialQueue
+                                            completion:completion];
 }
 
 - (void)reachabilityChanged
@@ -371,16 +394,6 @@ typedef NS_ENUM(NSUInteger, OWSReceiptType) {
     [self process];
 }
 
-- (SDSKeyValueStore *)storeForReceiptType:(OWSReceiptType)receiptType
-{
-    switch (receiptType) {
-        case OWSReceiptType_Delivery:
-            return OWSOutgoingReceiptManager.deliveryReceiptStore;
-        case OWSReceiptType_Read:
-            return OWSOutgoingReceiptManager.readReceiptStore;
-    }
-}
-
 @end
 
 NS_ASSUME_NONNULL_END
@@ -0,0 +1,433 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+import GRDB
+
+@objc
+public enum OWSOutgoingReceiptType: Int {
+    case delivery = 0
+    case read = 1
+}
+
+// MARK: -
+
+// The timestamps of one receipt message for one recipient.
+@objc
+public class OWSOutgoingReceiptBatch: NSObject {
+    @objc
+    public let recipientIdentifier: String
+    @objc
+    public let receiptType: OWSOutgoingReceiptType
+    @objc
+    public let timestamps: [UInt64]
+
+    init(recipientIdentifier: String, receiptType: OWSOutgoingReceiptType, timestamps: [UInt64]) {
+        self.recipientIdentifier = recipientIdentifier
+        self.receiptType = receiptType
+        self.timestamps = timestamps
+    }
+
+    // The identifier could be either a UUID or a phone number,
+    // check if it's a valid UUID. If not, assume it's a phone number.
+    @objc
+    public var address: SignalServiceAddress {
+        if let uuid = UUID(uuidString: recipientIdentifier) {
+            return SignalServiceAddress(uuid: uuid, phoneNumber: nil)
+        } else {
+            return SignalServiceAddress(phoneNumber: recipientIdentifier)
+        }
+    }
+
+    @objc
+    public var timestampNumbers: [NSNumber] {
+        return timestamps.map { NSNumber(value: $0) }
+    }
+}
+
+// MARK: -
+
+struct OutgoingReceiptRecord: Codable, FetchableRecord, PersistableRecord {
+    static let databaseTableName = "pending_outgoing_receipts"
+
+    var id: Int64?
+    let recipientIdentifier: String
+    let receiptType: Int
+    let timestamp: Int64
+}
+
+// MARK: -
+
+// Persists the receipts OWSOutgoingReceiptManager has yet to send.
+//
+// With GRDB, each pending receipt is a row in an indexed table, so
+// enqueuing a receipt is a single insert rather than a rewrite of every
+// pending timestamp for that recipient. YDB keeps using the per-type
+// key-value collections of timestamp sets.
+//
+// A pending read receipt supersedes a pending delivery receipt for the
+// same message, so only the read receipt is sent.
+@objc
+public class OWSOutgoingReceiptStore: NSObject {
+
+    @objc
+    public static let deliveryReceiptStore = SDSKeyValueStore(collection: "kOutgoingDeliveryReceiptManagerCollection")
+    @objc
+    public static let readReceiptStore = SDSKeyValueStore(collection: "kOutgoingReadReceiptManagerCollection")
+
+    private static func keyValueStore(for receiptType: OWSOutgoingReceiptType) -> SDSKeyValueStore {
+        switch receiptType {
+        case .delivery:
+            return deliveryReceiptStore
+        case .read:
+            return readReceiptStore
+        }
+    }
+
+    // Should only be accessed within write transactions.
+    private var hasMigratedLegacyReceipts = false
+
+    // MARK: - Dependencies
+
+    private var databaseStorage: SDSDatabaseStorage {
+        return SDSDatabaseStorage.shared
+    }
+
+    // MARK: - Enqueue
+
+    @objc
+    public func enqueueReceipt(address: SignalServiceAddress,
+                               timestamp: UInt64,
+                               receiptType: OWSOutgoingReceiptType,
+                               transaction: SDSAnyWriteTransaction) {
+        enqueueReceipts(address: address, timestamps: [timestamp], receiptType: receiptType, transaction: transaction)
+    }
+
+    // Enqueues receipts for several messages from the same sender, e.g.
+    // when a range of messages is marked as read at once.
+    @objc
+    public func enqueueReceipts(address: SignalServiceAddress,
+                                timestamps: [UInt64],
+                                receiptType: OWSOutgoingReceiptType,
+                                transaction: SDSAnyWriteTransaction) {
+        owsAssertDebug(address.isValid)
+        let validTimestamps = timestamps.filter { $0 > 0 }
+        if validTimestamps.count != timestamps.count {
+            owsFailDebug("Invalid timestamp.")
+        }
+        guard !validTimestamps.isEmpty else {
+            return
+        }
+        guard let identifier = address.uuidString ?? address.phoneNumber else {
+            owsFailDebug("Missing identifier.")
+            return
+        }
+
+        switch transaction.writeTransaction {
+        case .yapWrite:
+            for timestamp in validTimestamps {
+                enqueueLegacyReceipt(address: address, identifier: identifier, timestamp: timestamp, receiptType: receiptType, transaction: transaction)
+            }
+            if receiptType == .read {
+                removeLegacyReceipts(address: address, timestamps: Set(validTimestamps), receiptType: .delivery, transaction: transaction)
+            }
+        case .grdbWrite(let grdbWrite):
+            do {
+                try migrateLegacyReceiptsIfNecessary(transaction: transaction)
+                try migrateReceiptsToUUIDIfNecessary(address: address, transaction: grdbWrite)
+                for timestamp in validTimestamps {
+                    try enqueueReceipt(identifier: identifier, timestamp: timestamp, receiptType: receiptType, transaction: grdbWrite)
+                }
+            } catch {
+                owsFailDebug("Error: \(error.grdbErrorForLogging)")
+            }
+        }
+    }
+
+    // If we have receipts under the phone number but know the UUID, migrate them lazily.
+    private func migrateReceiptsToUUIDIfNecessary(address: SignalServiceAddress,
+                                                  transaction: GRDBWriteTransaction) throws {
+        guard let uuidString = address.uuidString, let phoneNumber = address.phoneNumber else {
+            return
+        }
+        let database = transaction.database
+        try database.execute(sql: """
+            UPDATE OR IGNORE \(OutgoingReceiptRecord.databaseTableName)
+            SET recipientIdentifier = ?
+            WHERE recipientIdentifier = ?
+            """,
+                             arguments: [uuidString, phoneNumber])
+        try database.execute(sql: "DELETE FROM \(OutgoingReceiptRecord.databaseTableName) WHERE recipientIdentifier = ?",
+                             arguments: [phoneNumber])
+    }
+
+    private func enqueueReceipt(identifier: String,
+                                timestamp: UInt64,
+                                receiptType: OWSOutgoingReceiptType,
+                                transaction: GRDBWriteTransaction) throws {
+        let database = transaction.database
+
+        switch receiptType {
+        case .delivery:
+            let hasReadReceipt = try Bool.fetchOne(database,
+                                                   sql: """
+                SELECT EXISTS (
+                    SELECT 1 FROM \(OutgoingReceiptRecord.databaseTableName)
+                    WHERE recipientIdentifier = ? AND receiptType = ? AND timestamp = ?
+                )
+                """,
+                                                   arguments: [identifier, OWSOutgoingReceiptType.read.rawValue, Int64(timestamp)]) ?? false
+            guard !hasReadReceipt else {
+                return
+            }
+        case .read:
+            try database.execute(sql: """
+                DELETE FROM \(OutgoingReceiptRecord.databaseTableName)
+                WHERE recipientIdentifier = ? AND receiptType = ? AND timestamp = ?
+                """,
+                                 arguments: [identifier, OWSOutgoingReceiptType.delivery.rawValue, Int64(timestamp)])
+        }
+
+        try database.execute(sql: """
+            INSERT OR IGNORE INTO \(OutgoingReceiptRecord.databaseTableName)
+            (recipientIdentifier, receiptType, timestamp)
+            VALUES (?, ?, ?)
+            """,
+                             arguments: [identifier, receiptType.rawValue, Int64(timestamp)])
+    }
+
+    // MARK: - Batches
+
+    // Returns up to maxBatchCount batches of at most maxTimestampsPerBatch
+    // timestamps, oldest receipts first. Every recipient's receipts of a
+    // given type are merged into as few batches as possible.
+    @objc
+    public func pendingBatches(maxTimestampsPerBatch: Int,
+                               maxBatchCount: Int,
+                               transaction: SDSAnyReadTransaction) -> [OWSOutgoingReceiptBatch] {
+        owsAssertDebug(maxTimestampsPerBatch > 0)
+        owsAssertDebug(maxBatchCount > 0)
+
+        struct BatchKey: Hashable {
+            let identifier: String
+            let receiptType: OWSOutgoingReceiptType
+        }
+        var orderedKeys = [BatchKey]()
+        var pendingTimestamps = [BatchKey: [UInt64]]()
+        func add(identifier: String, receiptType: OWSOutgoingReceiptType, timestamp: UInt64) {
+            let key = BatchKey(identifier: identifier, receiptType: receiptType)
+            if pendingTimestamps[key] == nil {
+                orderedKeys.append(key)
+            }
+            pendingTimestamps[key, default: []].append(timestamp)
+        }
+
+        switch transaction.readTransaction {
+        case .yapRead:
+            for receiptType in [OWSOutgoingReceiptType.read, OWSOutgoingReceiptType.delivery] {
+                let store = OWSOutgoingReceiptStore.keyValueStore(for: receiptType)
+                store.enumerateKeysAndObjects(transaction: transaction) { identifier, object, _ in
+                    guard let timestamps = object as? Set<NSNumber> else {
+                        owsFailDebug("Unexpected object: \(type(of: object))")
+                        return
+                    }
+                    for timestamp in timestamps {
+                        add(identifier: identifier, receiptType: receiptType, timestamp: timestamp.uint64Value)
+                    }
+                }
+            }
+        case .grdbRead(let grdbRead):
+            let sql = """
+                SELECT * FROM \(OutgoingReceiptRecord.databaseTableName)
+                ORDER BY id
+                LIMIT ?
+            """
+            do {
+                let cursor = try OutgoingReceiptRecord.fetchCursor(grdbRead.database,
+                                                                   sql: sql,
+                                                                   arguments: [maxTimestampsPerBatch * maxBatchCount])
+                while let record = try cursor.next() {
+                    guard let receiptType = OWSOutgoingReceiptType(rawValue: record.receiptType) else {
+                        owsFailDebug("Invalid receipt type: \(record.receiptType)")
+                        continue
+                    }
+                    add(identifier: record.recipientIdentifier, receiptType: receiptType, timestamp: UInt64(record.timestamp))
+                }
+            } catch {
+                owsFailDebug("Error: \(error.grdbErrorForLogging)")
+            }
+        }
+
+        var batches = [OWSOutgoingReceiptBatch]()
+        for key in orderedKeys {
+            guard let timestamps = pendingTimestamps[key] else {
+                owsFailDebug("Missing timestamps.")
+                continue
+            }
+            for startIndex in stride(from: 0, to: timestamps.count, by: maxTimestampsPerBatch) {
+                guard batches.count < maxBatchCount else {
+                    return batches
+                }
+                let endIndex = min(timestamps.count, startIndex + maxTimestampsPerBatch)
+                batches.append(OWSOutgoingReceiptBatch(recipientIdentifier: key.identifier,
+                                                       receiptType: key.receiptType,
+                                                       timestamps: Array(timestamps[startIndex..<endIndex])))
+            }
+        }
+        return batches
+    }
+
+    @objc
+    public func removeBatch(_ batch: OWSOutgoingReceiptBatch, transaction: SDSAnyWriteTransaction) {
+        guard !batch.timestamps.isEmpty else {
+            owsFailDebug("Invalid timestamps.")
+            return
+        }
+
+        switch transaction.writeTransaction {
+        case .yapWrite:
+            removeLegacyReceipts(address: batch.address,
+                                 timestamps: Set(batch.timestamps),
+                                 receiptType: batch.receiptType,
+                                 transaction: transaction)
+        case .grdbWrite(let grdbWrite):
+            let timestampList = batch.timestamps.map { "\($0)" }.joined(separator: ",")
+            let sql = """
+                DELETE FROM \(OutgoingReceiptRecord.databaseTableName)
+                WHERE recipientIdentifier = ? AND receiptType = ? AND timestamp IN (\(timestampList))
+            """
+            do {
+                try grdbWrite.database.execute(sql: sql, arguments: [batch.recipientIdentifier, batch.receiptType.rawValue])
+            } catch {
+                owsFailDebug("Error: \(error.grdbErrorForLogging)")
+            }
+        }
+    }
+
+    // MARK: - Legacy
+
+    // Receipts enqueued before the table existed, or copied over by the
+    // YDB-to-GRDB migration, live in the key-value collections.
+    //
+    // OWSOutgoingReceiptManager calls this on launch, since pendingBatches
+    // only reads the table. Otherwise the legacy receipts wouldn't be sent
+    // until some new receipt was enqueued.
+    @objc
+    public func migrateLegacyReceiptsIfNecessary() {
+        var hasLegacyReceipts = false
+        databaseStorage.read { transaction in
+            guard case .grdbRead = transaction.readTransaction else {
+                return
+            }
+            hasLegacyReceipts = [OWSOutgoingReceiptType.delivery, OWSOutgoingReceiptType.read].contains { receiptType in
+                OWSOutgoingReceiptStore.keyValueStore(for: receiptType).numberOfKeys(transaction: transaction) > 0
+            }
+        }
+        guard hasLegacyReceipts else {
+            return
+        }
+
+        databaseStorage.write { transaction in
+            do {
+                try self.migrateLegacyReceiptsIfNecessary(transaction: transaction)
+            } catch {
+                owsFailDebug("Error: \(error.grdbErrorForLogging)")
+            }
+        }
+    }
+
+    private func migrateLegacyReceiptsIfNecessary(transaction: SDSAnyWriteTransaction) throws {
+        guard !hasMigratedLegacyReceipts else {
+            return
+        }
+        hasMigratedLegacyReceipts = true
+
+        guard case .grdbWrite(let grdbWrite) = transaction.writeTransaction else {
+            owsFailDebug("Unexpected transaction.")
+            return
+        }
+
+        for receiptType in [OWSOutgoingReceiptType.delivery, OWSOutgoingReceiptType.read] {
+            let store = OWSOutgoingReceiptStore.keyValueStore(for: receiptType)
+            guard store.numberOfKeys(transaction: transaction) > 0 else {
+                continue
+            }
+            var legacyReceipts = [(String, Set<NSNumber>)]()
+            store.enumerateKeysAndObjects(transaction: transaction) { identifier, object, _ in
+                guard let timestamps = object as? Set<NSNumber> else {
+                    owsFailDebug("Unexpected object: \(type(of: object))")
+                    return
+                }
+                legacyReceipts.append((identifier, timestamps))
+            }
+            Logger.info("Migrating legacy receipts for \(legacyReceipts.count) recipients.")
+            for (identifier, timestamps) in legacyReceipts {
+                for timestamp in timestamps {
+                    try enqueueReceipt(identifier: identifier,
+                                       timestamp: timestamp.uint64Value,
+                                       receiptType: receiptType,
+                                       transaction: grdbWrite)
+                }
+            }
+            store.removeAll(transaction: transaction)
+        }
+    }
+
+    private func legacyTimestamps(address: SignalServiceAddress,
+                                  store: SDSKeyValueStore,
+                                  transaction: SDSAnyWriteTransaction) -> Set<NSNumber>? {
+        var oldUUIDTimestamps: Set<NSNumber>?
+        if let uuidString = address.uuidString {
+            oldUUIDTimestamps = store.getObject(uuidString, transaction: transaction) as? Set<NSNumber>
+        }
+
+        var oldPhoneNumberTimestamps: Set<NSNumber>?
+        if let phoneNumber = address.phoneNumber {
+            oldPhoneNumberTimestamps = store.getObject(phoneNumber, transaction: transaction) as? Set<NSNumber>
+        }
+
+        if let oldUUIDTimestamps = oldUUIDTimestamps, let oldPhoneNumberTimestamps = oldPhoneNumberTimestamps {
+            // Unexpectedly have entries both on phone number and UUID, defer to UUID
+            store.removeValue(forKey: address.phoneNumber!, transaction: transaction)
+            return oldUUIDTimestamps.union(oldPhoneNumberTimestamps)
+        } else if let oldPhoneNumberTimestamps = oldPhoneNumberTimestamps, address.uuidString != nil {
+            // If we have timestamps only under phone number, but know the UUID, migrate them lazily
+            store.removeValue(forKey: address.phoneNumber!, transaction: transaction)
+            return oldPhoneNumberTimestamps
+        } else {
+            return oldUUIDTimestamps ?? oldPhoneNumberTimestamps
+        }
+    }
+
+    private func enqueueLegacyReceipt(address: SignalServiceAddress,
+                                      identifier: String,
+                                      timestamp: UInt64,
+                                      receiptType: OWSOutgoingReceiptType,
+                                      transaction: SDSAnyWriteTransaction) {
+        let store = OWSOutgoingReceiptStore.keyValueStore(for: receiptType)
+        var timestamps = legacyTimestamps(address: address, store: store, transaction: transaction) ?? Set()
+        timestamps.insert(NSNumber(value: timestamp))
+        store.setObject(timestamps, key: identifier, transaction: transaction)
+    }
+
+    private func removeLegacyReceipts(address: SignalServiceAddress,
+                                      timestamps: Set<UInt64>,
+                                      receiptType: OWSOutgoingReceiptType,
+                                      transaction: SDSAnyWriteTransaction) {
+        guard let identifier = address.uuidString ?? address.phoneNumber else {
+            owsFailDebug("Missing identifier.")
+            return
+        }
+        let store = OWSOutgoingReceiptStore.keyValueStore(for: receiptType)
+        guard var newTimestamps = legacyTimestamps(address: address, store: store, transaction: transaction) else {
+            return
+        }
+        newTimestamps.subtract(timestamps.map { NSNumber(value: $0) })
+        if newTimestamps.isEmpty {
+            store.removeValue(forKey: identifier, transaction: transaction)
+        } else {
+            store.setObject(newTimestamps, key: identifier, transaction: transaction)
+        }
+    }
+}
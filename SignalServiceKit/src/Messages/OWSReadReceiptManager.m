@@ -4,6 +4,7 @@
 
 #import "OWSReadReceiptManager.h"
 #import "AppReadiness.h"
+#import "OWSDisappearingMessagesJob.h"
 #import "OWSLinkedDeviceReadReceipt.h"
 #import "OWSMessageSender.h"
 #import "OWSOutgoingReceiptManager.h"
@@ -334,20 +335,23 @@ NSString *const OWSReadReceiptManagerAreReadReceiptsEnabled = @"areReadReceiptsE
 
     dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
         uint64_t readTimestamp = [NSDate ows_millisecondTimeStamp];
-        __block NSArray<id<OWSReadTracking>> *unreadMessages;
+        __block BOOL hasUnreadMessages;
         [self.databaseStorage readWithBlock:^(SDSAnyReadTransaction *transaction) {
-            unreadMessages = [self unreadMessagesBeforeSortId:sortId
-                                                       thread:thread
-                                                readTimestamp:readTimestamp
-                                                  transaction:transaction];
+            hasUnreadMessages = [OWSBulkReadMarker hasUnreadInteractionsWithThreadUniqueId:thread.uniqueId
+                                                                              beforeSortId:sortId
+                                                                               transaction:transaction];
         }];
-        if (unreadMessages.count < 1) {
+        if (!hasUnreadMessages) {
             // Avoid unnecessary writes.
             dispatch_async(dispatch_get_main_queue(), completion);
             return;
         }
         [self.databaseStorage writeWithBlock:^(SDSAnyWriteTransaction *transaction) {
-            [self markMessagesAsRead:unreadMessages readTimestamp:readTimestamp wasLocal:YES transaction:transaction];
+            [self markAsReadBeforeSortId:sortId
+                                  thread:thread
+                           readTimestamp:readTimestamp
+                                wasLocal:YES
+                             transaction:transaction];
         }];
         dispatch_async(dispatch_get_main_queue(), completion);
     });
@@ -355,28 +359,12 @@ NSString *const OWSReadReceiptManagerAreReadReceiptsEnabled = @"areReadReceiptsE
 
 - (void)messageWasReadLocally:(TSIncomingMessage *)message transaction:(SDSAnyWriteTransaction *)transaction
 {
-    NSString *threadUniqueId = message.uniqueThreadId;
-    OWSAssertDebug(threadUniqueId.length > 0);
-
     SignalServiceAddress *messageAuthorAddress = message.authorAddress;
     OWSAssertDebug(messageAuthorAddress.isValid);
 
-    OWSLinkedDeviceReadReceipt *newReadReceipt =
-        [[OWSLinkedDeviceReadReceipt alloc] initWithSenderAddress:messageAuthorAddress
-                                               messageIdTimestamp:message.timestamp
-                                                    readTimestamp:[NSDate ows_millisecondTimeStamp]];
-
-    @synchronized(self) {
-        OWSLinkedDeviceReadReceipt *_Nullable oldReadReceipt = self.toLinkedDevicesReadReceiptMap[threadUniqueId];
-        if (oldReadReceipt && oldReadReceipt.messageIdTimestamp > newReadReceipt.messageIdTimestamp) {
-            // If there's an existing "linked device" read receipt for the same thread with
-            // a newer timestamp, discard this "linked device" read receipt.
-            OWSLogVerbose(@"Ignoring redundant read receipt for linked devices.");
-        } else {
-            OWSLogVerbose(@"Enqueuing read receipt for linked devices.");
-            self.toLinkedDevicesReadReceiptMap[threadUniqueId] = newReadReceipt;
-        }
-    }
+    [self enqueueLinkedDeviceReadReceiptForThreadUniqueId:message.uniqueThreadId
+                                     messageAuthorAddress:messageAuthorAddress
+                                         messageTimestamp:message.timestamp];
 
     if (message.authorAddress.isLocalAddress) {
         OWSLogVerbose(@"Ignoring read receipt for self-sender.");
@@ -395,6 +383,30 @@ NSString *const OWSReadReceiptManagerAreReadReceiptsEnabled = @"areReadReceiptsE
     }];
 }
 
+- (void)enqueueLinkedDeviceReadReceiptForThreadUniqueId:(NSString *)threadUniqueId
+                                   messageAuthorAddress:(SignalServiceAddress *)messageAuthorAddress
+                                       messageTimestamp:(uint64_t)messageTimestamp
+{
+    OWSAssertDebug(threadUniqueId.length > 0);
+
+    OWSLinkedDeviceReadReceipt *newReadReceipt =
+        [[OWSLinkedDeviceReadReceipt alloc] initWithSenderAddress:messageAuthorAddress
+                                               messageIdTimestamp:messageTimestamp
+                                                    readTimestamp:[NSDate ows_millisecondTimeStamp]];
+
+    @synchronized(self) {
+        OWSLinkedDeviceReadReceipt *_Nullable oldReadReceipt = self.toLinkedDevicesReadReceiptMap[threadUniqueId];
+        if (oldReadReceipt && oldReadReceipt.messageIdTimestamp > newReadReceipt.messageIdTimestamp) {
+            // If there's an existing "linked device" read receipt for the same thread with
+            // a newer timestamp, discard this "linked device" read receipt.
+            OWSLogVerbose(@"Ignoring redundant read receipt for linked devices.");
+        } else {
+            OWSLogVerbose(@"Enqueuing read receipt for linked devices.");
+            self.toLinkedDevicesReadReceiptMap[threadUniqueId] = newReadReceipt;
+        }
+    }
+}
+
 #pragma mark - Read Receipts From Recipient
 
 - (void)processReadReceiptsFromRecipient:(SignalServiceAddress *)address
@@ -409,7 +421,7 @@ NSString *const OWSReadReceiptManagerAreReadReceiptsEnabled = @"areReadReceiptsE
         return;
     }
 
-    [self.databaseStorage asyncWriteWithBlock:^(SDSAnyWriteTransaction *transaction) {
+    [self.databaseStorage asyncCoalescedWriteWithBlock:^(SDSAnyWriteTransaction *transaction) {
         for (NSNumber *nsSentTimestamp in sentTimestamps) {
             UInt64 sentTimestamp = [nsSentTimestamp unsignedLongLongValue];
 
@@ -579,6 +591,15 @@ NSString *const OWSReadReceiptManagerAreReadReceiptsEnabled = @"areReadReceiptsE
     OWSAssertDebug(thread);
     OWSAssertDebug(transaction);
 
+    OWSBulkReadResult *_Nullable bulkReadResult = [OWSBulkReadMarker markAsReadWithThreadUniqueId:thread.uniqueId
+                                                                                     beforeSortId:sortId
+                                                                                    readTimestamp:readTimestamp
+                                                                                      transaction:transaction];
+    if (bulkReadResult != nil) {
+        [self didMarkAsReadInBulk:bulkReadResult thread:thread wasLocal:wasLocal transaction:transaction];
+        return;
+    }
+
     NSArray<id<OWSReadTracking>> *unreadMessages =
         [self unreadMessagesBeforeSortId:sortId thread:thread readTimestamp:readTimestamp transaction:transaction];
     if (unreadMessages.count < 1) {
@@ -588,6 +609,64 @@ NSString *const OWSReadReceiptManagerAreReadReceiptsEnabled = @"areReadReceiptsE
     [self markMessagesAsRead:unreadMessages readTimestamp:readTimestamp wasLocal:wasLocal transaction:transaction];
 }
 
+// Applies the side effects that markAsReadAtTimestamp:sendReadReceipt:transaction:
+// would have had for each message, once for the whole range.
+- (void)didMarkAsReadInBulk:(OWSBulkReadResult *)bulkReadResult
+                     thread:(TSThread *)thread
+                   wasLocal:(BOOL)wasLocal
+                transaction:(SDSAnyWriteTransaction *)transaction
+{
+    if (bulkReadResult.markedCount < 1) {
+        return;
+    }
+
+    if (wasLocal) {
+        OWSLogInfo(@"Marked %lu messages as read locally.", (unsigned long)bulkReadResult.markedCount);
+    } else {
+        OWSLogInfo(@"Marked %lu messages as read by linked device.", (unsigned long)bulkReadResult.markedCount);
+    }
+
+    [self.databaseStorage touchThread:thread transaction:transaction];
+
+    NSDate *_Nullable nextExpirationDate = bulkReadResult.nextExpirationDate;
+    if (nextExpirationDate != nil) {
+        [transaction addCompletionWithBlock:^{
+            [OWSDisappearingMessagesJob.sharedJob scheduleRunByDate:nextExpirationDate];
+        }];
+    }
+
+    if (!wasLocal) {
+        return;
+    }
+
+    SignalServiceAddress *_Nullable latestMessageAuthor = bulkReadResult.latestMessageAuthor;
+    if (latestMessageAuthor == nil) {
+        // None of the newly read interactions were incoming messages.
+        return;
+    }
+    [self enqueueLinkedDeviceReadReceiptForThreadUniqueId:thread.uniqueId
+                                     messageAuthorAddress:latestMessageAuthor
+                                         messageTimestamp:bulkReadResult.latestMessageTimestamp];
+
+    if ([self areReadReceiptsEnabled]) {
+        [bulkReadResult.messageTimestampsByAuthor
+            enumerateKeysAndObjectsUsingBlock:^(SignalServiceAddress *address, NSArray<NSNumber *> *timestamps, BOOL *stop) {
+                if (address.isLocalAddress) {
+                    OWSLogVerbose(@"Ignoring read receipt for self-sender.");
+                    return;
+                }
+                OWSLogVerbose(@"Enqueuing %lu read receipts for sender.", (unsigned long)timestamps.count);
+                [self.outgoingReceiptManager enqueueReadReceiptsForAddress:address
+                                                                timestamps:timestamps
+                                                               transaction:transaction];
+            }];
+    }
+
+    [transaction addCompletionWithBlock:^{
+        [self scheduleProcessing];
+    }];
+}
+
 - (void)markMessagesAsRead:(NSArray<id<OWSReadTracking>> *)unreadMessages
              readTimestamp:(uint64_t)readTimestamp
                   wasLocal:(BOOL)wasLocal
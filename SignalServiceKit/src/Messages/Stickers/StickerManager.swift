@@ -72,7 +72,9 @@ public class StickerManager: NSObject {
     private static let operationQueue: OperationQueue = {
         let operationQueue = OperationQueue()
         operationQueue.name = "org.signal.StickerManager"
-        operationQueue.maxConcurrentOperationCount = 4
+        // StickerPackInstaller limits how many of its downloads are
+        // enqueued at a time.
+        operationQueue.maxConcurrentOperationCount = StickerPackInstaller.maxWindowSize
         return operationQueue
     }()
 
@@ -81,6 +83,9 @@ public class StickerManager: NSObject {
 
     private static let serialQueue = DispatchQueue(label: "org.signal.stickers")
 
+    // This should only be accessed on serialQueue.
+    private static var packInstallers = [String: StickerPackInstaller]()
+
     @objc
     public enum InstallMode: Int {
         case doNotInstall
@@ -103,6 +108,9 @@ public class StickerManager: NSObject {
             // Warm the caches.
             StickerManager.shared.warmIsStickerSendEnabled()
             StickerManager.shared.warmTooltipState()
+            StickerManager.shared.suggestionIndexQueue.async {
+                StickerManager.shared.warmSuggestionIndex()
+            }
         }
         AppReadiness.runNowOrWhenAppDidBecomeReady {
             StickerManager.cleanupOrphans()
@@ -154,7 +162,7 @@ public class StickerManager: NSObject {
         }
     }
 
-    private class func stickerUrl(stickerInfo: StickerInfo) -> URL {
+    internal class func stickerUrl(stickerInfo: StickerInfo) -> URL {
 
         let uniqueId = InstalledSticker.uniqueId(for: stickerInfo)
 
@@ -403,22 +411,57 @@ public class StickerManager: NSObject {
     private class func installStickerPackContents(stickerPack: StickerPack,
                                                   transaction: SDSAnyReadTransaction,
                                                   onlyInstallCover: Bool = false) -> Promise<Void> {
-        // Note: It's safe to kick off downloads of stickers that are already installed.
-
-        var fetches = [Promise<Void>]()
+        // The cover, then the stickers.
+        var items = [stickerPack.cover]
+        if !onlyInstallCover {
+            items += stickerPack.items
+        }
 
-        // The cover.
-        fetches.append(tryToDownloadAndInstallSticker(stickerPack: stickerPack, item: stickerPack.cover, transaction: transaction))
+        let allInstalledUniqueIds = Set(InstalledSticker.anyAllUniqueIds(transaction: transaction))
+        var stickerInfos = [StickerInfo]()
+        var stickerInfoKeys = Set<String>()
+        for item in items {
+            let stickerInfo = item.stickerInfo(with: stickerPack)
+            // The cover is usually also one of the stickers.
+            guard !stickerInfoKeys.contains(stickerInfo.asKey()) else {
+                continue
+            }
+            stickerInfoKeys.insert(stickerInfo.asKey())
+            guard !allInstalledUniqueIds.contains(InstalledSticker.uniqueId(for: stickerInfo)) else {
+                // Skipping redundant sticker install.
+                continue
+            }
+            stickerInfos.append(stickerInfo)
+        }
+        guard !stickerInfos.isEmpty else {
+            return Promise.value(())
+        }
 
-        guard !onlyInstallCover else {
-            return when(fulfilled: fetches)
+        let installerKey = stickerPack.info.asKey() + (onlyInstallCover ? ".cover" : "")
+        return serialQueue.sync { () -> Promise<Void> in
+            if let installer = packInstallers[installerKey] {
+                // This pack is already being installed.
+                return installer.install()
+            }
+            let installer = StickerPackInstaller(stickerPack: stickerPack,
+                                                 stickerInfos: stickerInfos) { stickerInfo in
+                                                    self.tryToDownloadSticker(stickerPack: stickerPack, stickerInfo: stickerInfo)
+            }
+            packInstallers[installerKey] = installer
+            return installer.install().ensure(on: DispatchQueue.global()) {
+                self.serialQueue.sync {
+                    _ = self.packInstallers.removeValue(forKey: installerKey)
+                }
+            }
         }
+    }
 
-        // The stickers.
-        for item in stickerPack.items {
-            fetches.append(tryToDownloadAndInstallSticker(stickerPack: stickerPack, item: item, transaction: transaction))
+    // Returns the progress of the pack's sticker downloads, if they are
+    // in progress.
+    public class func installProgress(forStickerPack stickerPackInfo: StickerPackInfo) -> Progress? {
+        return serialQueue.sync {
+            return packInstallers[stickerPackInfo.asKey()]?.progress
         }
-        return when(fulfilled: fetches)
     }
 
     private class func tryToDownloadDefaultStickerPacks(shouldInstall: Bool) {
@@ -639,21 +682,22 @@ public class StickerManager: NSObject {
         }
     }
 
-    private class func tryToDownloadAndInstallSticker(stickerPack: StickerPack,
-                                                      item: StickerPackItem,
-                                                      transaction: SDSAnyReadTransaction) -> Promise<Void> {
-        let stickerInfo: StickerInfo = item.stickerInfo(with: stickerPack)
-        let emojiString = item.emojiString
-
-        guard !self.isStickerInstalled(stickerInfo: stickerInfo, transaction: transaction) else {
-            // Skipping redundant sticker install.
-            return Promise.value(())
+    // Installs stickers whose data has already been written to disk,
+    // updating the emoji map once for the whole batch.
+    internal class func installStickers(_ installedStickers: [InstalledSticker],
+                                        transaction: SDSAnyWriteTransaction) {
+        var newStickers = [InstalledSticker]()
+        for installedSticker in installedStickers {
+            guard !isStickerInstalled(stickerInfo: installedSticker.info, transaction: transaction) else {
+                // Skipping redundant sticker install.
+                continue
+            }
+            Logger.verbose("Installing sticker: \(installedSticker.info).")
+            installedSticker.anyInsert(transaction: transaction)
+            newStickers.append(installedSticker)
         }
 
-        return tryToDownloadSticker(stickerPack: stickerPack, stickerInfo: stickerInfo)
-            .done(on: DispatchQueue.global()) { (stickerData) in
-                self.installSticker(stickerInfo: stickerInfo, stickerData: stickerData, emojiString: emojiString)
-            }
+        addStickersToEmojiMap(newStickers, transaction: transaction)
     }
 
     // This method is public so that we can download "transient" (uninstalled) stickers.
@@ -690,18 +734,40 @@ public class StickerManager: NSObject {
 
     private class func addStickerToEmojiMap(_ installedSticker: InstalledSticker,
                                             transaction: SDSAnyWriteTransaction) {
+        addStickersToEmojiMap([installedSticker], transaction: transaction)
+    }
 
-        guard let emojiString = installedSticker.emojiString else {
+    private class func addStickersToEmojiMap(_ installedStickers: [InstalledSticker],
+                                             transaction: SDSAnyWriteTransaction) {
+
+        // Many stickers in a pack share an emoji, so update each emoji's
+        // entry once.
+        var stickerIdsByEmoji = [String: [String]]()
+        var emojiOrder = [String]()
+        for installedSticker in installedStickers {
+            guard let emojiString = installedSticker.emojiString else {
+                continue
+            }
+            for emoji in allEmoji(inEmojiString: emojiString) {
+                if stickerIdsByEmoji[emoji] == nil {
+                    emojiOrder.append(emoji)
+                }
+                stickerIdsByEmoji[emoji, default: []].append(installedSticker.uniqueId)
+            }
+        }
+        guard !emojiOrder.isEmpty else {
             return
         }
-        let stickerId = installedSticker.uniqueId
-        for emoji in allEmoji(inEmojiString: emojiString) {
+        for emoji in emojiOrder {
             emojiMapStore.appendToStringSet(key: emoji,
-                                            value: stickerId,
+                                            values: stickerIdsByEmoji[emoji] ?? [],
                                             transaction: transaction)
         }
 
-        shared.clearSuggestedStickersCache()
+        // Only apply the change once it has been committed.
+        transaction.addCompletion(queue: shared.suggestionIndexQueue) {
+            shared.suggestionIndex.addStickers(installedStickers)
+        }
     }
 
     private class func removeStickerFromEmojiMap(_ installedSticker: InstalledSticker,
@@ -716,31 +782,63 @@ public class StickerManager: NSObject {
                                               transaction: transaction)
         }
 
-        shared.clearSuggestedStickersCache()
+        // Only apply the change once it has been committed.
+        transaction.addCompletion(queue: shared.suggestionIndexQueue) {
+            shared.suggestionIndex.removeSticker(installedSticker)
+        }
     }
 
-    private static let cacheQueue = DispatchQueue(label: "stickerManager.cacheQueue")
-    // This cache shoud only be accessed on cacheQueue.
-    private var suggestedStickersCache = NSCache<NSString, NSArray>()
+    private let suggestionIndex = StickerSuggestionIndex()
+
+    // Changes to the suggestion index are applied in order on this queue,
+    // after their transactions commit. The index is also warmed here.
+    let suggestionIndexQueue = DispatchQueue(label: "org.signal.stickerSuggestionIndex")
 
-    // We clear the cache every time we install or uninstall a sticker.
-    private func clearSuggestedStickersCache() {
-        StickerManager.cacheQueue.sync {
-            self.suggestedStickersCache.removeAllObjects()
+    private func warmSuggestionIndex() {
+        while !suggestionIndex.isLoaded {
+            let changeCount = suggestionIndex.currentChangeCount
+            var stickerIdsByEmoji = [String: [String]]()
+            var stickers = [InstalledSticker]()
+            databaseStorage.read { transaction in
+                for emoji in StickerManager.emojiMapStore.allKeys(transaction: transaction) {
+                    stickerIdsByEmoji[emoji] = StickerManager.emojiMapStore.stringSet(forKey: emoji, transaction: transaction)
+                }
+                InstalledSticker.anyEnumerate(transaction: transaction) { (sticker, _) in
+                    stickers.append(sticker)
+                }
+            }
+            if !suggestionIndex.load(stickerIdsByEmoji: stickerIdsByEmoji,
+                                     stickers: stickers,
+                                     changeCountBeforeRead: changeCount) {
+                Logger.verbose("Stickers changed while loading the suggestion index; retrying.")
+            }
         }
     }
 
+    // The composer calls this on every keystroke; it uses the in-memory
+    // suggestion index rather than the database.
     @objc
     public func suggestedStickers(forTextInput textInput: String) -> [InstalledSticker] {
-        return StickerManager.cacheQueue.sync {
-            if let suggestions = suggestedStickersCache.object(forKey: textInput as NSString) as? [InstalledSticker] {
-                return suggestions
-            }
+        guard let emoji = StickerManager.singleEmoji(inTextInput: textInput) else {
+            return []
+        }
+        if !suggestionIndex.isLoaded {
+            // The index is normally warmed before the composer is shown.
+            warmSuggestionIndex()
+        }
+        return suggestionIndex.stickers(forEmoji: emoji)
+    }
 
-            let suggestions = StickerManager.suggestedStickers(forTextInput: textInput)
-            suggestedStickersCache.setObject(suggestions as NSArray, forKey: textInput as NSString)
-            return suggestions
+    private class func singleEmoji(inTextInput textInput: String) -> String? {
+        guard let emoji = firstEmoji(inEmojiString: textInput) else {
+            // Text input contains no emoji.
+            return nil
+        }
+        guard emoji == textInput else {
+            // Text input contains more than just a single emoji.
+            return nil
         }
+        return emoji
     }
 
     internal class func suggestedStickers(forTextInput textInput: String) -> [InstalledSticker] {
@@ -753,12 +851,7 @@ public class StickerManager: NSObject {
 
     internal class func suggestedStickers(forTextInput textInput: String,
                                           transaction: SDSAnyReadTransaction) -> [InstalledSticker] {
-        guard let emoji = firstEmoji(inEmojiString: textInput) else {
-            // Text input contains no emoji.
-            return []
-        }
-        guard emoji == textInput else {
-            // Text input contains more than just a single emoji.
+        guard let emoji = singleEmoji(inTextInput: textInput) else {
             return []
         }
         let stickerIds = emojiMapStore.stringSet(forKey: emoji, transaction: transaction)
@@ -1200,7 +1293,7 @@ public class StickerManager: NSObject {
 
     private var stickersOrPacksDidChangeTimer: Timer?
 
-    private func fireStickersOrPacksDidChange() {
+    internal func fireStickersOrPacksDidChange() {
         AssertIsOnMainThread()
 
         guard stickersOrPacksDidChangeTimer == nil else {
@@ -1274,11 +1367,22 @@ extension SDSKeyValueStore {
                            value: String,
                            transaction: SDSAnyWriteTransaction,
                            maxCount: Int? = nil) {
-        // Prepend value to ensure descending order of recency.
-        var stringSet = [value]
+        appendToStringSet(key: key, values: [value], transaction: transaction, maxCount: maxCount)
+    }
+
+    // The last of values is treated as the most recent.
+    func appendToStringSet(key: String,
+                           values: [String],
+                           transaction: SDSAnyWriteTransaction,
+                           maxCount: Int? = nil) {
+        // Prepend values to ensure descending order of recency.
+        var stringSet = [String]()
+        for value in values.reversed() where !stringSet.contains(value) {
+            stringSet.append(value)
+        }
         if let storedValue = getObject(key, transaction: transaction) as? [String] {
             stringSet += storedValue.filter {
-                $0 != value
+                !values.contains($0)
             }
         }
         if let maxCount = maxCount {
@@ -0,0 +1,179 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+import PromiseKit
+
+// Installs the stickers of a sticker pack as a unit.
+//
+// Stickers are fetched a window at a time. The window grows while
+// downloads succeed and shrinks when they fail, so that a healthy
+// connection fills up quickly without a flaky one piling up retries.
+// Each sticker is written to disk as soon as it arrives, but none are
+// installed until the pack is done: the InstalledSticker rows and emoji
+// map updates for the whole pack are committed in a single write
+// transaction, rather than one per sticker.
+//
+// Stickers that fail to download are skipped; those that succeeded are
+// still installed, and the promise is rejected so that the caller can
+// retry later.
+class StickerPackInstaller {
+
+    // MARK: - Dependencies
+
+    private var databaseStorage: SDSDatabaseStorage {
+        return SDSDatabaseStorage.shared
+    }
+
+    // MARK: -
+
+    typealias FetchSticker = (StickerInfo) -> Promise<Data>
+
+    private struct PendingSticker {
+        let stickerInfo: StickerInfo
+        let emojiString: String?
+    }
+
+    static let minWindowSize: Int = 2
+    static let maxWindowSize: Int = 8
+    static let initialWindowSize: Int = 4
+
+    let stickerPackInfo: StickerPackInfo
+    let progress: Progress
+
+    private let fetchSticker: FetchSticker
+    private let promise: Promise<Void>
+    private let resolver: Resolver<Void>
+
+    // Should only be accessed on serialQueue.
+    private var pendingStickers: [PendingSticker]
+    private var fetchingCount: Int = 0
+    private(set) var windowSize: Int = StickerPackInstaller.initialWindowSize
+    private var downloadedStickers = [InstalledSticker]()
+    private var firstError: Error?
+    private var hasStarted = false
+
+    private let serialQueue = DispatchQueue(label: "org.signal.stickerPackInstaller")
+
+    // stickerInfos should not include stickers that are already installed.
+    init(stickerPack: StickerPack,
+         stickerInfos: [StickerInfo],
+         fetchSticker: @escaping FetchSticker) {
+        self.stickerPackInfo = stickerPack.info
+        self.fetchSticker = fetchSticker
+
+        var emojiStrings = [String: String]()
+        for item in [stickerPack.cover] + stickerPack.items {
+            emojiStrings[item.stickerInfo(with: stickerPack).asKey()] = item.emojiString
+        }
+        self.pendingStickers = stickerInfos.map { stickerInfo in
+            PendingSticker(stickerInfo: stickerInfo, emojiString: emojiStrings[stickerInfo.asKey()])
+        }
+        self.progress = Progress(totalUnitCount: Int64(stickerInfos.count))
+        let (promise, resolver) = Promise<Void>.pending()
+        self.promise = promise
+        self.resolver = resolver
+    }
+
+    func install() -> Promise<Void> {
+        serialQueue.async {
+            guard !self.hasStarted else {
+                return
+            }
+            self.hasStarted = true
+
+            Logger.verbose("Installing \(self.pendingStickers.count) stickers: \(self.stickerPackInfo).")
+
+            self.fetchNextStickersIfNecessary()
+        }
+        return promise
+    }
+
+    // MARK: - Fetch
+
+    // Should only be called on serialQueue.
+    private func fetchNextStickersIfNecessary() {
+        while fetchingCount < windowSize, !pendingStickers.isEmpty {
+            let pendingSticker = pendingStickers.removeFirst()
+            fetchingCount += 1
+
+            fetchSticker(pendingSticker.stickerInfo)
+                .done(on: DispatchQueue.global()) { stickerData in
+                    let didWrite = self.writeStickerData(stickerData, stickerInfo: pendingSticker.stickerInfo)
+                    self.serialQueue.async {
+                        if didWrite {
+                            self.downloadedStickers.append(InstalledSticker(info: pendingSticker.stickerInfo,
+                                                                            emojiString: pendingSticker.emojiString))
+                        }
+                        self.stickerDidComplete(error: didWrite ? nil : StickerError.assertionFailure)
+                    }
+                }.catch(on: serialQueue) { error in
+                    Logger.warn("Could not download sticker: \(error)")
+                    self.stickerDidComplete(error: error)
+                }.retainUntilComplete()
+        }
+
+        if fetchingCount == 0, pendingStickers.isEmpty {
+            commit()
+        }
+    }
+
+    // Should only be called on serialQueue.
+    private func stickerDidComplete(error: Error?) {
+        fetchingCount -= 1
+        progress.completedUnitCount += 1
+
+        if let error = error {
+            firstError = firstError ?? error
+            windowSize = max(StickerPackInstaller.minWindowSize, windowSize / 2)
+        } else {
+            windowSize = min(StickerPackInstaller.maxWindowSize, windowSize + 1)
+        }
+
+        fetchNextStickersIfNecessary()
+    }
+
+    private func writeStickerData(_ stickerData: Data, stickerInfo: StickerInfo) -> Bool {
+        guard stickerData.count > 0 else {
+            owsFailDebug("Empty sticker data.")
+            return false
+        }
+        let url = StickerManager.stickerUrl(stickerInfo: stickerInfo)
+        do {
+            try stickerData.write(to: url, options: .atomic)
+            return true
+        } catch {
+            owsFailDebug("File write failed: \(error)")
+            return false
+        }
+    }
+
+    // MARK: - Commit
+
+    // Should only be called on serialQueue.
+    private func commit() {
+        let downloadedStickers = self.downloadedStickers
+        let firstError = self.firstError
+
+        DispatchQueue.global().async {
+            if !downloadedStickers.isEmpty {
+                self.databaseStorage.write { transaction in
+                    StickerManager.installStickers(downloadedStickers, transaction: transaction)
+                }
+
+                DispatchQueue.main.async {
+                    StickerManager.shared.fireStickersOrPacksDidChange()
+                }
+            }
+
+            Logger.verbose("Installed \(downloadedStickers.count) stickers: \(self.stickerPackInfo).")
+
+            if let error = firstError {
+                self.resolver.reject(error)
+            } else {
+                self.resolver.fulfill(())
+            }
+        }
+    }
+}
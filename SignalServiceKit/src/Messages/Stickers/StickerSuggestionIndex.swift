@@ -0,0 +1,125 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+
+// An in-memory copy of the emoji map, i.e. the installed stickers for
+// each emoji, in descending order of recency.
+//
+// The composer looks up sticker suggestions on every keystroke, so
+// lookups only take a lock around a dictionary lookup; they never wait
+// on a queue or read from the database. The index is loaded once and
+// then kept up to date as stickers are installed and uninstalled.
+class StickerSuggestionIndex {
+
+    // Should only be accessed while synchronized on self.
+    private var stickerIdsByEmoji = [String: [String]]()
+    private var stickersById = [String: InstalledSticker]()
+    private var _isLoaded = false
+    // Incremented by every change, so that a load can tell whether it
+    // raced with a change.
+    private var changeCount: UInt64 = 0
+
+    var isLoaded: Bool {
+        objc_sync_enter(self)
+        defer { objc_sync_exit(self) }
+
+        return _isLoaded
+    }
+
+    // Loads the index if it isn't loaded yet. If the contents were read
+    // before a concurrent change, they may be stale and are discarded;
+    // returns false in that case so that the caller can read them again.
+    func load(stickerIdsByEmoji: [String: [String]],
+              stickers: [InstalledSticker],
+              changeCountBeforeRead: UInt64) -> Bool {
+        var stickersById = [String: InstalledSticker]()
+        for sticker in stickers {
+            stickersById[sticker.uniqueId] = sticker
+        }
+
+        objc_sync_enter(self)
+        defer { objc_sync_exit(self) }
+
+        guard !_isLoaded else {
+            return true
+        }
+        guard changeCount == changeCountBeforeRead else {
+            return false
+        }
+        self.stickerIdsByEmoji = stickerIdsByEmoji
+        self.stickersById = stickersById
+        _isLoaded = true
+        return true
+    }
+
+    var currentChangeCount: UInt64 {
+        objc_sync_enter(self)
+        defer { objc_sync_exit(self) }
+
+        return changeCount
+    }
+
+    // MARK: - Changes
+
+    // Mirrors SDSKeyValueStore.appendToStringSet(): the stickers are
+    // prepended to each of their emoji's lists, so that the last of
+    // stickers becomes the most recent.
+    func addStickers(_ stickers: [InstalledSticker]) {
+        objc_sync_enter(self)
+        defer { objc_sync_exit(self) }
+
+        changeCount += 1
+        guard _isLoaded else {
+            return
+        }
+
+        for sticker in stickers {
+            stickersById[sticker.uniqueId] = sticker
+            for emoji in StickerManager.allEmoji(inEmojiString: sticker.emojiString) {
+                var stickerIds = stickerIdsByEmoji[emoji] ?? []
+                stickerIds.removeAll { $0 == sticker.uniqueId }
+                stickerIds.insert(sticker.uniqueId, at: 0)
+                stickerIdsByEmoji[emoji] = stickerIds
+            }
+        }
+    }
+
+    func removeSticker(_ sticker: InstalledSticker) {
+        objc_sync_enter(self)
+        defer { objc_sync_exit(self) }
+
+        changeCount += 1
+        guard _isLoaded else {
+            return
+        }
+
+        stickersById.removeValue(forKey: sticker.uniqueId)
+        for emoji in StickerManager.allEmoji(inEmojiString: sticker.emojiString) {
+            guard var stickerIds = stickerIdsByEmoji[emoji] else {
+                continue
+            }
+            stickerIds.removeAll { $0 == sticker.uniqueId }
+            stickerIdsByEmoji[emoji] = stickerIds.isEmpty ? nil : stickerIds
+        }
+    }
+
+    // MARK: - Lookup
+
+    func stickers(forEmoji emoji: String) -> [InstalledSticker] {
+        objc_sync_enter(self)
+        defer { objc_sync_exit(self) }
+
+        guard let stickerIds = stickerIdsByEmoji[emoji] else {
+            return []
+        }
+        return stickerIds.compactMap { stickerId in
+            guard let sticker = stickersById[stickerId] else {
+                owsFailDebug("Missing installed sticker.")
+                return nil
+            }
+            return sticker
+        }
+    }
+}
@@ -82,12 +82,21 @@ public class OWSUDAccess: NSObject {
     @objc
     func setUnidentifiedAccessMode(_ mode: UnidentifiedAccessMode, address: SignalServiceAddress)
 
+    @objc
+    func setUnidentifiedAccessMode(_ mode: UnidentifiedAccessMode,
+                                   address: SignalServiceAddress,
+                                   transaction: SDSAnyWriteTransaction)
+
     @objc
     func unidentifiedAccessMode(forAddress address: SignalServiceAddress) -> UnidentifiedAccessMode
 
     @objc
     func udAccessKey(forAddress address: SignalServiceAddress) -> SMKUDAccessKey?
 
+    @objc
+    func udAccessKey(forAddress address: SignalServiceAddress,
+                     transaction: SDSAnyReadTransaction) -> SMKUDAccessKey?
+
     @objc
     func udAccess(forAddress address: SignalServiceAddress,
                   requireSyncAccess: Bool) -> OWSUDAccess?
@@ -292,19 +301,26 @@ public class OWSUDManagerImpl: NSObject, OWSUDManager {
         }
 
         databaseStorage.write { (transaction) in
-            let oldMode = self.unidentifiedAccessMode(forAddress: address, transaction: transaction)
+            self.setUnidentifiedAccessMode(mode, address: address, transaction: transaction)
+        }
+    }
 
-            if let uuidString = address.uuidString {
-                self.uuidAccessStore.setInt(mode.rawValue, key: uuidString, transaction: transaction)
-            }
+    @objc
+    public func setUnidentifiedAccessMode(_ mode: UnidentifiedAccessMode,
+                                          address: SignalServiceAddress,
+                                          transaction: SDSAnyWriteTransaction) {
+        let oldMode = unidentifiedAccessMode(forAddress: address, transaction: transaction)
 
-            if let phoneNumber = address.phoneNumber {
-                self.phoneNumberAccessStore.setInt(mode.rawValue, key: phoneNumber, transaction: transaction)
-            }
+        if let uuidString = address.uuidString {
+            uuidAccessStore.setInt(mode.rawValue, key: uuidString, transaction: transaction)
+        }
 
-            if mode != oldMode {
-                Logger.info("Setting UD access mode for \(address): \(string(forUnidentifiedAccessMode: oldMode)) ->  \(string(forUnidentifiedAccessMode: mode))")
-            }
+        if let phoneNumber = address.phoneNumber {
+            phoneNumberAccessStore.setInt(mode.rawValue, key: phoneNumber, transaction: transaction)
+        }
+
+        if mode != oldMode {
+            Logger.info("Setting UD access mode for \(address): \(string(forUnidentifiedAccessMode: oldMode)) ->  \(string(forUnidentifiedAccessMode: mode))")
         }
     }
 
@@ -312,10 +328,15 @@ public class OWSUDManagerImpl: NSObject, OWSUDManager {
     // if we have a valid profile key for them.
     @objc
     public func udAccessKey(forAddress address: SignalServiceAddress) -> SMKUDAccessKey? {
-        let profileKeyData = databaseStorage.read { transaction in
-            return self.profileManager.profileKeyData(for: address,
-                                                      transaction: transaction)
+        return databaseStorage.read { transaction in
+            return self.udAccessKey(forAddress: address, transaction: transaction)
         }
+    }
+
+    @objc
+    public func udAccessKey(forAddress address: SignalServiceAddress,
+                            transaction: SDSAnyReadTransaction) -> SMKUDAccessKey? {
+        let profileKeyData = profileManager.profileKeyData(for: address, transaction: transaction)
         guard let profileKey = profileKeyData else {
             // Mark as "not a UD recipient".
             return nil
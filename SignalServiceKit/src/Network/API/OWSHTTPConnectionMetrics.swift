@@ -0,0 +1,172 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+
+// Tracks how often REST requests to the Signal service reuse an existing
+// connection, and how many TLS handshakes we pay for, periodically
+// logging a summary.
+@objc
+public class OWSHTTPConnectionMetrics: NSObject {
+
+    @objc
+    public static let shared = OWSHTTPConnectionMetrics()
+
+    private static let reportingInterval: TimeInterval = 60
+
+    private let serialQueue = DispatchQueue(label: "org.signal.http-connection-metrics")
+
+    // Should only be accessed on serialQueue.
+    private var windowStartTime = CACurrentMediaTime()
+    private var requestCount: UInt = 0
+    private var reusedConnectionCount: UInt = 0
+    private var newConnectionCount: UInt = 0
+    private var tlsHandshakeCount: UInt = 0
+    private var sessionsCreatedCount: UInt = 0
+    private var sessionsExpiredCount: UInt = 0
+
+    // MARK: -
+
+    @objc
+    public func record(taskMetrics: URLSessionTaskMetrics) {
+        var reusedConnectionCount: UInt = 0
+        var newConnectionCount: UInt = 0
+        var tlsHandshakeCount: UInt = 0
+        for transactionMetrics in taskMetrics.transactionMetrics {
+            guard transactionMetrics.resourceFetchType == .networkLoad else {
+                continue
+            }
+            if transactionMetrics.isReusedConnection {
+                reusedConnectionCount += 1
+            } else {
+                newConnectionCount += 1
+                if transactionMetrics.secureConnectionStartDate != nil {
+                    tlsHandshakeCount += 1
+                }
+            }
+        }
+
+        serialQueue.async {
+            self.requestCount += 1
+            self.reusedConnectionCount += reusedConnectionCount
+            self.newConnectionCount += newConnectionCount
+            self.tlsHandshakeCount += tlsHandshakeCount
+            self.reportIfNecessary()
+        }
+    }
+
+    @objc
+    public func recordSessionCreated() {
+        serialQueue.async {
+            self.sessionsCreatedCount += 1
+        }
+    }
+
+    @objc
+    public func recordSessionsExpired(count: Int) {
+        serialQueue.async {
+            self.sessionsExpiredCount += UInt(count)
+        }
+    }
+
+    private func reportIfNecessary() {
+        let now = CACurrentMediaTime()
+        let elapsed = now - windowStartTime
+        guard elapsed >= OWSHTTPConnectionMetrics.reportingInterval else {
+            return
+        }
+
+        let connectionCount = reusedConnectionCount + newConnectionCount
+        let reuseRate = Double(reusedConnectionCount) / Double(max(1, connectionCount))
+        let tlsHandshakesPerMinute = 60 * Double(tlsHandshakeCount) / elapsed
+        Logger.info(String(format: "requests: %lu, connection reuse rate: %.2f, TLS handshakes/min: %.1f, sessions created: %lu, sessions expired: %lu",
+                           requestCount,
+                           reuseRate,
+                           tlsHandshakesPerMinute,
+                           sessionsCreatedCount,
+                           sessionsExpiredCount))
+
+        windowStartTime = now
+        requestCount = 0
+        reusedConnectionCount = 0
+        newConnectionCount = 0
+        tlsHandshakeCount = 0
+        sessionsCreatedCount = 0
+        sessionsExpiredCount = 0
+    }
+}
+
+// MARK: -
+
+// Sizes a REST session pool from its observed request concurrency.
+//
+// We retain as many idle sessions as the peak number of concurrent
+// requests seen over the current and previous windows, so that bursts
+// reuse warm connections while the pool shrinks again once load drops.
+//
+// Not thread-safe; the session pool only uses it on NetworkManagerQueue.
+@objc
+public class OWSSessionPoolSizer: NSObject {
+
+    @objc
+    public static let minIdleCount: Int = 2
+    @objc
+    public static let maxIdleCount: Int = 12
+
+    static let windowDuration: TimeInterval = 60
+
+    private let currentTime: () -> TimeInterval
+
+    private var windowStartTime: TimeInterval
+    private var previousWindowPeak = 0
+    private var currentWindowPeak = 0
+
+    @objc
+    public private(set) var inFlightCount = 0
+
+    @objc
+    public convenience override init() {
+        self.init(currentTime: { CACurrentMediaTime() })
+    }
+
+    init(currentTime: @escaping () -> TimeInterval) {
+        self.currentTime = currentTime
+        self.windowStartTime = currentTime()
+
+        super.init()
+    }
+
+    @objc
+    public func didCheckOut() {
+        rollWindowIfNecessary()
+        inFlightCount += 1
+        currentWindowPeak = max(currentWindowPeak, inFlightCount)
+    }
+
+    @objc
+    public func didCheckIn() {
+        rollWindowIfNecessary()
+        owsAssertDebug(inFlightCount > 0)
+        inFlightCount = max(0, inFlightCount - 1)
+    }
+
+    @objc
+    public var targetIdleCount: Int {
+        rollWindowIfNecessary()
+        let peak = max(previousWindowPeak, currentWindowPeak)
+        return min(OWSSessionPoolSizer.maxIdleCount, max(OWSSessionPoolSizer.minIdleCount, peak))
+    }
+
+    private func rollWindowIfNecessary() {
+        let now = currentTime()
+        let elapsed = now - windowStartTime
+        guard elapsed >= OWSSessionPoolSizer.windowDuration else {
+            return
+        }
+        // If more than one window has passed, the previous window was idle.
+        previousWindowPeak = elapsed < 2 * OWSSessionPoolSizer.windowDuration ? currentWindowPeak : inFlightCount
+        currentWindowPeak = inFlightCount
+        windowStartTime = now
+    }
+}
@@ -42,6 +42,8 @@ dispatch_queue_t NetworkManagerQueue()
 
 @property (nonatomic, readonly) AFHTTPSessionManager *sessionManager;
 @property (nonatomic, readonly) NSDictionary *defaultHeaders;
+// When this session manager was last returned to the pool.
+@property (nonatomic) CFTimeInterval lastUsedTime;
 
 @end
 
@@ -179,9 +181,18 @@ dispatch_queue_t NetworkManagerQueue()
 // codebase, since the stakes are high. The session managers aren't expensive. IMO
 // better to use a pool and not re-use a session manager until its request succeeds
 // or fails.
+//
+// Each session manager has its own NSURLSession and therefore its own keep-alive
+// connections, so discarding one throws away a warm TLS connection. UD and non-UD
+// requests use separate pools, so that a sealed sender request never rides a
+// connection that carried the user's credentials. Within each pool, the number of
+// idle session managers we retain tracks that pool's observed concurrency, and idle
+// session managers expire once their connections would likely have been closed anyway.
 @interface OWSSessionManagerPool : NSObject
 
+// Most recently used last.
 @property (nonatomic) NSMutableArray<OWSSessionManager *> *pool;
+@property (nonatomic, readonly) OWSSessionPoolSizer *sizer;
 
 @end
 
@@ -197,6 +208,7 @@ dispatch_queue_t NetworkManagerQueue()
     }
 
     self.pool = [NSMutableArray new];
+    _sizer = [OWSSessionPoolSizer new];
 
     return self;
 }
@@ -205,13 +217,19 @@ dispatch_queue_t NetworkManagerQueue()
 {
     AssertOnDispatchQueue(NetworkManagerQueue());
 
+    [self discardExpiredSessionManagers];
+
+    // Prefer the most recently used session manager; its connection is the most
+    // likely to still be open.
     OWSSessionManager *_Nullable sessionManager = [self.pool lastObject];
     if (sessionManager) {
         [self.pool removeLastObject];
     } else {
         sessionManager = [OWSSessionManager new];
+        [OWSHTTPConnectionMetrics.shared recordSessionCreated];
     }
     OWSAssertDebug(sessionManager);
+    [self.sizer didCheckOut];
     return sessionManager;
 }
 
@@ -220,14 +238,41 @@ dispatch_queue_t NetworkManagerQueue()
     AssertOnDispatchQueue(NetworkManagerQueue());
 
     OWSAssertDebug(sessionManager);
-    const NSUInteger kMaxPoolSize = 3;
-    if (self.pool.count >= kMaxPoolSize) {
+    [self.sizer didCheckIn];
+    sessionManager.lastUsedTime = CACurrentMediaTime();
+
+    if (self.pool.count >= (NSUInteger)self.sizer.targetIdleCount) {
         // Discard
+        [sessionManager.sessionManager invalidateSessionCancelingTasks:NO];
         return;
     }
     [self.pool addObject:sessionManager];
 }
 
+- (void)discardExpiredSessionManagers
+{
+    AssertOnDispatchQueue(NetworkManagerQueue());
+
+    // NSURLSession closes idle connections after roughly this long.
+    const CFTimeInterval kIdleExpirySeconds = 90;
+    CFTimeInterval now = CACurrentMediaTime();
+
+    // The pool is ordered by lastUsedTime, so expired session managers are at the front.
+    NSUInteger expiredCount = 0;
+    for (OWSSessionManager *sessionManager in self.pool) {
+        if (now - sessionManager.lastUsedTime < kIdleExpirySeconds) {
+            break;
+        }
+        [sessionManager.sessionManager invalidateSessionCancelingTasks:NO];
+        expiredCount++;
+    }
+    if (expiredCount < 1) {
+        return;
+    }
+    [self.pool removeObjectsInRange:NSMakeRange(0, expiredCount)];
+    [OWSHTTPConnectionMetrics.shared recordSessionsExpiredWithCount:(NSInteger)expiredCount];
+}
+
 @end
 
 #pragma mark -
@@ -34,6 +34,31 @@ NSString *const kNSNotificationName_IsCensorshipCircumventionActiveDidChange =
 
 #pragma mark -
 
+// Reports connection reuse and TLS handshakes for REST requests
+// to the Signal service.
+@interface OWSSignalServiceSessionManager : AFHTTPSessionManager
+
+@end
+
+#pragma mark -
+
+@implementation OWSSignalServiceSessionManager
+
+- (void)URLSession:(NSURLSession *)session
+                          task:(NSURLSessionTask *)task
+    didFinishCollectingMetrics:(NSURLSessionTaskMetrics *)metrics
+{
+    [OWSHTTPConnectionMetrics.shared recordWithTaskMetrics:metrics];
+
+    if ([AFHTTPSessionManager instancesRespondToSelector:_cmd]) {
+        [super URLSession:session task:task didFinishCollectingMetrics:metrics];
+    }
+}
+
+@end
+
+#pragma mark -
+
 @implementation OWSSignalService
 
 #pragma mark - Dependencies
@@ -216,7 +241,7 @@ NSString *const kNSNotificationName_IsCensorshipCircumventionActiveDidChange =
     OWSAssertDebug(baseURL);
     NSURLSessionConfiguration *sessionConf = NSURLSessionConfiguration.ephemeralSessionConfiguration;
     AFHTTPSessionManager *sessionManager =
-        [[AFHTTPSessionManager alloc] initWithBaseURL:baseURL sessionConfiguration:sessionConf];
+        [[OWSSignalServiceSessionManager alloc] initWithBaseURL:baseURL sessionConfiguration:sessionConf];
 
     sessionManager.securityPolicy = [OWSHTTPSecurityPolicy sharedPolicy];
     sessionManager.requestSerializer = [AFJSONRequestSerializer serializer];
@@ -235,7 +260,7 @@ NSString *const kNSNotificationName_IsCensorshipCircumventionActiveDidChange =
     NSURL *frontingURL = censorshipConfiguration.domainFrontBaseURL;
     NSURL *baseURL = [frontingURL URLByAppendingPathComponent:TSConstants.serviceCensorshipPrefix];
     AFHTTPSessionManager *sessionManager =
-        [[AFHTTPSessionManager alloc] initWithBaseURL:baseURL sessionConfiguration:sessionConf];
+        [[OWSSignalServiceSessionManager alloc] initWithBaseURL:baseURL sessionConfiguration:sessionConf];
 
     sessionManager.securityPolicy = censorshipConfiguration.domainFrontSecurityPolicy;
 
@@ -0,0 +1,271 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+
+// A size-bounded cache of downloaded proxied content which persists
+// across launches, so that GIFs and link preview images aren't
+// re-downloaded every time they're shown.
+//
+// Entries are files named for the SHA-256 hash of their URL, so the
+// cache folder doesn't reveal which URLs were requested. When the cache
+// grows past its byte budget, the least recently used entries are
+// evicted. A file's modification date records when it was last used.
+//
+// Cached files are hard-linked in and out of the cache, so consumers
+// can keep using (and deleting) their copy after it has been evicted.
+public class ProxiedContentDiskCache: NSObject {
+
+    public struct Metrics {
+        public let hitCount: UInt
+        public let missCount: UInt
+        // The size of the assets served from the cache, i.e. the
+        // downloads the cache has saved.
+        public let bytesSaved: UInt64
+    }
+
+    private struct Entry {
+        let fileName: String
+        let byteCount: UInt64
+        var lastAccessDate: Date
+    }
+
+    private let folderPath: String
+    public let maxByteCount: UInt64
+
+    // Should only be accessed on serialQueue.
+    private var entries: [String: Entry]?
+    private var totalByteCount: UInt64 = 0
+    private var hitCount: UInt = 0
+    private var missCount: UInt = 0
+    private var bytesSaved: UInt64 = 0
+
+    private let serialQueue = DispatchQueue(label: "org.signal.proxiedContentDiskCache")
+
+    public init(folderPath: String, maxByteCount: UInt64) {
+        self.folderPath = folderPath
+        self.maxByteCount = maxByteCount
+
+        super.init()
+    }
+
+    // MARK: -
+
+    public var metrics: Metrics {
+        return serialQueue.sync {
+            Metrics(hitCount: hitCount, missCount: missCount, bytesSaved: bytesSaved)
+        }
+    }
+
+    public var byteCount: UInt64 {
+        return serialQueue.sync {
+            _ = loadEntriesIfNecessary()
+            return totalByteCount
+        }
+    }
+
+    private func cacheKey(url: NSURL) -> String? {
+        guard let urlString = url.absoluteString,
+            let urlData = urlString.data(using: .utf8),
+            let digest = Cryptography.computeSHA256Digest(urlData) else {
+                owsFailDebug("Could not hash url.")
+                return nil
+        }
+        return digest.hexadecimalString
+    }
+
+    private func filePath(entry: Entry) -> String {
+        return (folderPath as NSString).appendingPathComponent(entry.fileName)
+    }
+
+    // Must be called on serialQueue.
+    private func loadEntriesIfNecessary() -> [String: Entry] {
+        if let entries = entries {
+            return entries
+        }
+
+        var entries = [String: Entry]()
+        totalByteCount = 0
+
+        OWSFileSystem.ensureDirectoryExists(folderPath)
+        // Don't back up cached content.
+        OWSFileSystem.protectFileOrFolder(atPath: folderPath)
+
+        let resourceKeys: [URLResourceKey] = [.fileSizeKey, .contentModificationDateKey, .isRegularFileKey]
+        let folderUrl = URL(fileURLWithPath: folderPath)
+        do {
+            let fileUrls = try FileManager.default.contentsOfDirectory(at: folderUrl,
+                                                                       includingPropertiesForKeys: resourceKeys,
+                                                                       options: [])
+            for fileUrl in fileUrls {
+                guard !fileUrl.lastPathComponent.hasPrefix(ProxiedContentDiskCache.stagingFilePrefix) else {
+                    // Left behind by an interrupted storeAsset.
+                    OWSFileSystem.deleteFileIfExists(fileUrl.path)
+                    continue
+                }
+                let resourceValues = try fileUrl.resourceValues(forKeys: Set(resourceKeys))
+                guard resourceValues.isRegularFile == true,
+                    let fileSize = resourceValues.fileSize,
+                    let modificationDate = resourceValues.contentModificationDate else {
+                        continue
+                }
+                let fileName = fileUrl.lastPathComponent
+                let key = (fileName as NSString).deletingPathExtension
+                entries[key] = Entry(fileName: fileName,
+                                     byteCount: UInt64(fileSize),
+                                     lastAccessDate: modificationDate)
+                totalByteCount += UInt64(fileSize)
+            }
+        } catch {
+            owsFailDebug("Could not load cache entries: \(error)")
+        }
+
+        self.entries = entries
+        evictIfNecessary()
+        return self.entries ?? [:]
+    }
+
+    // Must be called on serialQueue.
+    private func evictIfNecessary() {
+        guard totalByteCount > maxByteCount, var entries = entries else {
+            return
+        }
+        let entriesByAge = entries.sorted { $0.value.lastAccessDate < $1.value.lastAccessDate }
+        for (key, entry) in entriesByAge {
+            guard totalByteCount > maxByteCount else {
+                break
+            }
+            OWSFileSystem.deleteFileIfExists(filePath(entry: entry))
+            entries.removeValue(forKey: key)
+            totalByteCount -= entry.byteCount
+        }
+        self.entries = entries
+    }
+
+    // MARK: -
+
+    // Links the cached asset for url, if any, to filePath. Returns true
+    // on a cache hit.
+    //
+    // This may block on another thread's storeAsset, so it shouldn't be
+    // called on the main thread.
+    public func linkCachedAsset(url: NSURL, toFilePath filePath: String) -> Bool {
+        guard let key = cacheKey(url: url) else {
+            return false
+        }
+        return serialQueue.sync {
+            guard var entry = loadEntriesIfNecessary()[key] else {
+                missCount += 1
+                return false
+            }
+            let entryFilePath = self.filePath(entry: entry)
+            guard ProxiedContentDiskCache.linkOrCopyItem(atPath: entryFilePath, toPath: filePath) else {
+                // The entry is unusable, e.g. its file was removed.
+                OWSFileSystem.deleteFileIfExists(entryFilePath)
+                entries?.removeValue(forKey: key)
+                totalByteCount -= entry.byteCount
+                missCount += 1
+                return false
+            }
+
+            let now = Date()
+            entry.lastAccessDate = now
+            entries?[key] = entry
+            do {
+                try FileManager.default.setAttributes([.modificationDate: now], ofItemAtPath: entryFilePath)
+            } catch {
+                Logger.warn("Could not update access date: \(error)")
+            }
+
+            hitCount += 1
+            bytesSaved += entry.byteCount
+            return true
+        }
+    }
+
+    // Adds the asset at filePath to the cache, replacing any existing
+    // entry for url, then evicts entries to stay within budget.
+    public func storeAsset(url: NSURL, filePath: String) {
+        guard let key = cacheKey(url: url) else {
+            return
+        }
+        let byteCount: UInt64
+        do {
+            let attributes = try FileManager.default.attributesOfItem(atPath: filePath)
+            guard let fileSize = attributes[.size] as? NSNumber else {
+                owsFailDebug("Missing file size.")
+                return
+            }
+            byteCount = fileSize.uint64Value
+        } catch {
+            owsFailDebug("Could not read file attributes: \(error)")
+            return
+        }
+        guard byteCount <= maxByteCount else {
+            Logger.verbose("Asset too large to cache: \(byteCount)")
+            return
+        }
+
+        // Ensure the folder exists.
+        serialQueue.sync {
+            _ = loadEntriesIfNecessary()
+        }
+
+        // Linking can fall back to copying, so we stage the file in the
+        // cache folder without holding serialQueue, then move it into
+        // place.
+        let stagingFilePath = (folderPath as NSString).appendingPathComponent(ProxiedContentDiskCache.stagingFilePrefix + UUID().uuidString)
+        guard ProxiedContentDiskCache.linkOrCopyItem(atPath: filePath, toPath: stagingFilePath) else {
+            return
+        }
+
+        serialQueue.sync {
+            _ = loadEntriesIfNecessary()
+
+            var fileName = key
+            let fileExtension = (filePath as NSString).pathExtension
+            if !fileExtension.isEmpty, let fileNameWithExtension = (key as NSString).appendingPathExtension(fileExtension) {
+                fileName = fileNameWithExtension
+            }
+            let entry = Entry(fileName: fileName, byteCount: byteCount, lastAccessDate: Date())
+            let entryFilePath = self.filePath(entry: entry)
+
+            if let oldEntry = entries?.removeValue(forKey: key) {
+                OWSFileSystem.deleteFileIfExists(self.filePath(entry: oldEntry))
+                totalByteCount -= oldEntry.byteCount
+            }
+            do {
+                try FileManager.default.moveItem(atPath: stagingFilePath, toPath: entryFilePath)
+            } catch {
+                Logger.warn("Could not move file: \(error)")
+                OWSFileSystem.deleteFileIfExists(stagingFilePath)
+                return
+            }
+            entries?[key] = entry
+            totalByteCount += byteCount
+            evictIfNecessary()
+        }
+    }
+
+    private static let stagingFilePrefix = ".staging-"
+
+    // Hard links are free and leave each path independently deletable;
+    // fall back to copying if the paths are on different volumes.
+    private class func linkOrCopyItem(atPath srcPath: String, toPath dstPath: String) -> Bool {
+        let fileManager = FileManager.default
+        do {
+            try fileManager.linkItem(atPath: srcPath, toPath: dstPath)
+            return true
+        } catch {
+            Logger.warn("Could not link file, copying instead: \(error)")
+        }
+        do {
+            try fileManager.copyItem(atPath: srcPath, toPath: dstPath)
+            return true
+        } catch {
+            Logger.warn("Could not copy file: \(error)")
+            return false
+        }
+    }
+}
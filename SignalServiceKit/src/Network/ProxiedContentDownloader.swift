@@ -53,6 +53,78 @@ public enum ProxiedContentAssetSegmentState: UInt {
 
 // MARK: -
 
+// The file an asset is downloaded into. It's preallocated to the asset's
+// content length, and each segment writes its data directly at its own
+// offset, so segments can complete in any order.
+class ProxiedContentAssetFile: NSObject {
+
+    let filePath: String
+
+    // This state should only be accessed while synchronized on self.
+    private var fileHandle: FileHandle?
+
+    init?(filePath: String, contentLength: UInt) {
+        self.filePath = filePath
+
+        guard FileManager.default.createFile(atPath: filePath, contents: nil, attributes: nil),
+            let fileHandle = FileHandle(forWritingAtPath: filePath) else {
+                owsFailDebug("could not create asset file: \(filePath)")
+                return nil
+        }
+        fileHandle.truncateFile(atOffset: UInt64(contentLength))
+        self.fileHandle = fileHandle
+
+        super.init()
+    }
+
+    deinit {
+        fileHandle?.closeFile()
+    }
+
+    // Safe to call from any thread.
+    func write(data: Data, offset: UInt) -> Bool {
+        objc_sync_enter(self)
+        defer { objc_sync_exit(self) }
+
+        guard let fileHandle = fileHandle else {
+            // The file has already been closed, e.g. because the request
+            // was cancelled.
+            return false
+        }
+        let fileDescriptor = fileHandle.fileDescriptor
+        var bytesWritten = 0
+        while bytesWritten < data.count {
+            let result = data.withUnsafeBytes { (buffer: UnsafeRawBufferPointer) -> Int in
+                return pwrite(fileDescriptor,
+                              buffer.baseAddress! + bytesWritten,
+                              data.count - bytesWritten,
+                              off_t(offset) + off_t(bytesWritten))
+            }
+            guard result > 0 else {
+                owsFailDebug("could not write asset file: \(errno)")
+                return false
+            }
+            bytesWritten += result
+        }
+        return true
+    }
+
+    func close() {
+        objc_sync_enter(self)
+        defer { objc_sync_exit(self) }
+
+        fileHandle?.closeFile()
+        fileHandle = nil
+    }
+
+    func discard() {
+        close()
+        OWSFileSystem.deleteFileIfExists(filePath)
+    }
+}
+
+// MARK: -
+
 public class ProxiedContentAssetSegment: NSObject {
 
     public let index: UInt
@@ -60,6 +132,7 @@ public class ProxiedContentAssetSegment: NSObject {
     public let segmentLength: UInt
     // The amount of the segment that is overlap.  
     // The overlap lies in the _first_ n bytes of the segment data.
+    // Overlapping bytes are identical, so they're simply written twice.
     public let redundantLength: UInt
 
     // This state should only be accessed on the main thread.
@@ -69,11 +142,13 @@ public class ProxiedContentAssetSegment: NSObject {
         }
     }
 
+    private let assetFile: ProxiedContentAssetFile
+
     // This state is accessed off the main thread.
     //
     // * During downloads it will be accessed on the task delegate queue.
     // * After downloads it will be accessed on a worker queue. 
-    private var segmentData = Data()
+    private var bytesReceived: UInt = 0
 
     // This state should only be accessed on the main thread.
     public weak var task: URLSessionDataTask?
@@ -81,15 +156,17 @@ public class ProxiedContentAssetSegment: NSObject {
     init(index: UInt,
          segmentStart: UInt,
          segmentLength: UInt,
-         redundantLength: UInt) {
+         redundantLength: UInt,
+         assetFile: ProxiedContentAssetFile) {
         self.index = index
         self.segmentStart = segmentStart
         self.segmentLength = segmentLength
         self.redundantLength = redundantLength
+        self.assetFile = assetFile
     }
 
     public func totalDataSize() -> UInt {
-        return UInt(segmentData.count)
+        return bytesReceived
     }
 
     public func append(data: Data) {
@@ -98,30 +175,19 @@ public class ProxiedContentAssetSegment: NSObject {
             return
         }
 
-        segmentData.append(data)
-    }
-
-    public func mergeData(assetData: inout Data) -> Bool {
-        guard state == .complete else {
-            owsFailDebug("merging data in invalid state: \(state)")
-            return false
-        }
-        guard UInt(segmentData.count) == segmentLength else {
-            owsFailDebug("segment data length: \(segmentData.count) doesn't match expected length: \(segmentLength)")
-            return false
+        let dataLength = UInt(data.count)
+        guard bytesReceived + dataLength <= segmentLength else {
+            // Don't write past the end of the segment. The segment will
+            // fail its length check.
+            owsFailDebug("segment received too much data.")
+            bytesReceived += dataLength
+            return
         }
-
-        // In some cases the last two segments will overlap.
-        // In that case, we only want to append the non-overlapping
-        // tail of the segment data.
-        let bytesToIgnore = Int(redundantLength)
-        if bytesToIgnore > 0 {
-            let subdata = segmentData.subdata(in: bytesToIgnore..<Int(segmentLength))
-            assetData.append(subdata)
-        } else {
-            assetData.append(segmentData)
+        guard assetFile.write(data: data, offset: segmentStart + bytesReceived) else {
+            // The segment will fail its length check.
+            return
         }
-        return true
+        bytesReceived += dataLength
     }
 }
 
@@ -158,7 +224,7 @@ public class ProxiedContentAssetRequest: NSObject {
 
     var wasCancelled = false
     // This property is an internal implementation detail of the download process.
-    var assetFilePath: String?
+    private var assetFile: ProxiedContentAssetFile?
 
     // This state should only be accessed on the main thread.
     private var segments = [ProxiedContentAssetSegment]()
@@ -184,7 +250,11 @@ public class ProxiedContentAssetRequest: NSObject {
         super.init()
     }
 
-    private func segmentSize() -> UInt {
+    var host: String? {
+        return assetDescription.url.host
+    }
+
+    private func segmentSize(linkEstimator: ProxiedContentLinkEstimator) -> UInt {
         AssertIsOnMainThread()
 
         let contentLength = UInt(self.contentLength)
@@ -194,6 +264,11 @@ public class ProxiedContentAssetRequest: NSObject {
             return 0
         }
 
+        if let segmentSize = linkEstimator.segmentSize(host: host, contentLength: contentLength) {
+            return segmentSize
+        }
+
+        // The host hasn't been measured yet.
         let k1MB: UInt = 1024 * 1024
         let k500KB: UInt = 500 * 1024
         let k100KB: UInt = 100 * 1024
@@ -208,20 +283,31 @@ public class ProxiedContentAssetRequest: NSObject {
         return contentLength
     }
 
-    fileprivate func createSegments(withInitialData initialData: Data) {
+    // Returns false if the asset file couldn't be created.
+    fileprivate func createSegments(withInitialData initialData: Data,
+                                    downloadFolderPath: String,
+                                    linkEstimator: ProxiedContentLinkEstimator) -> Bool {
         AssertIsOnMainThread()
 
-        let segmentLength = segmentSize()
+        let segmentLength = segmentSize(linkEstimator: linkEstimator)
         guard segmentLength > 0 else {
-            return
+            return true
         }
         let contentLength = UInt(self.contentLength)
 
+        let fileName = (NSUUID().uuidString as NSString).appendingPathExtension(assetDescription.fileExtension)!
+        let filePath = (downloadFolderPath as NSString).appendingPathComponent(fileName)
+        guard let assetFile = ProxiedContentAssetFile(filePath: filePath, contentLength: contentLength) else {
+            return false
+        }
+        self.assetFile = assetFile
+
         // Make the initial segment.
         let assetSegment = ProxiedContentAssetSegment(index: 0,
                                                       segmentStart: 0,
                                                       segmentLength: UInt(initialData.count),
-                                                      redundantLength: 0)
+                                                      redundantLength: 0,
+                                                      assetFile: assetFile)
         // "Download" the initial segment using the initialData.
         assetSegment.state = .downloading
         assetSegment.append(data: initialData)
@@ -243,11 +329,13 @@ public class ProxiedContentAssetRequest: NSObject {
             let assetSegment = ProxiedContentAssetSegment(index: index,
                                                  segmentStart: segmentStart,
                                                  segmentLength: segmentLength,
-                                                 redundantLength: redundantLength)
+                                                 redundantLength: redundantLength,
+                                                 assetFile: assetFile)
             segments.append(assetSegment)
             nextSegmentStart = segmentStart + segmentLength
             index += 1
         }
+        return true
     }
 
     private func firstSegmentWithState(state: ProxiedContentAssetSegmentState) -> ProxiedContentAssetSegment? {
@@ -298,48 +386,45 @@ public class ProxiedContentAssetRequest: NSObject {
         return true
     }
 
-    public func writeAssetToFile(downloadFolderPath: String) -> ProxiedContentAsset? {
-
-        var assetData = Data()
+    public func completeAssetFile() -> ProxiedContentAsset? {
+        guard let assetFile = assetFile else {
+            owsFailDebug("missing asset file.")
+            return nil
+        }
+        guard !segments.isEmpty else {
+            owsFailDebug("asset has no segments.")
+            return nil
+        }
         for segment in segments {
             guard segment.state == .complete else {
                 owsFailDebug("unexpected incomplete segment.")
                 return nil
             }
-            guard segment.totalDataSize() > 0 else {
-                owsFailDebug("could not merge empty segment.")
-                return nil
-            }
-            guard segment.mergeData(assetData: &assetData) else {
-                owsFailDebug("failed to merge segment data.")
+            guard segment.totalDataSize() == segment.segmentLength else {
+                owsFailDebug("segment data length: \(segment.totalDataSize()) doesn't match expected length: \(segment.segmentLength)")
                 return nil
             }
         }
 
-        guard assetData.count == contentLength else {
-            owsFailDebug("asset data has unexpected length.")
-            return nil
-        }
+        assetFile.close()
 
-        guard assetData.count > 0 else {
-            owsFailDebug("could not write empty asset to disk.")
-            return nil
+        let filePath = assetFile.filePath
+        Logger.verbose("filePath: \(filePath).")
+
+        guard let fileSize = OWSFileSystem.fileSize(ofPath: filePath),
+            fileSize.intValue == contentLength else {
+                owsFailDebug("asset file has unexpected length.")
+                return nil
         }
 
-        let fileExtension = assetDescription.fileExtension
-        let fileName = (NSUUID().uuidString as NSString).appendingPathExtension(fileExtension)!
-        let filePath = (downloadFolderPath as NSString).appendingPathComponent(fileName)
+        return ProxiedContentAsset(assetDescription: assetDescription, filePath: filePath)
+    }
 
-        Logger.verbose("filePath: \(filePath).")
+    func discardAssetFile() {
+        AssertIsOnMainThread()
 
-        do {
-            try assetData.write(to: NSURL.fileURL(withPath: filePath), options: .atomicWrite)
-            let asset = ProxiedContentAsset(assetDescription: assetDescription, filePath: filePath)
-            return asset
-        } catch let error as NSError {
-            owsFailDebug("file write failed: \(filePath), \(error)")
-            return nil
-        }
+        assetFile?.discard()
+        assetFile = nil
     }
 
     public func cancel() {
@@ -352,6 +437,11 @@ public class ProxiedContentAssetRequest: NSObject {
             segment.task?.cancel()
             segment.task = nil
         }
+        // Once complete, the asset file is finished off the main thread;
+        // the downloader discards it when that's done.
+        if state != .complete {
+            discardAssetFile()
+        }
 
         // Don't call the callbacks if the request is cancelled.
         clearCallbacks()
@@ -376,6 +466,8 @@ public class ProxiedContentAssetRequest: NSObject {
     public func requestDidFail() {
         AssertIsOnMainThread()
 
+        discardAssetFile()
+
         failure?(self)
 
         // Only one of the callbacks should be called, and only once.
@@ -446,6 +538,10 @@ extension URLSessionTask {
 
 // MARK: -
 
+// GIFs are usually less than 3 MB, so this holds a few dozen of them
+// alongside their stills.
+private let kMaxDiskCacheByteCount: UInt64 = 100 * 1024 * 1024
+
 @objc
 open class ProxiedContentDownloader: NSObject, URLSessionTaskDelegate, URLSessionDataDelegate {
 
@@ -455,12 +551,24 @@ open class ProxiedContentDownloader: NSObject, URLSessionTaskDelegate, URLSessio
 
     private var downloadFolderPath: String?
 
+    // Assets evicted from assetMap, or downloaded during a previous
+    // launch, are served from here rather than downloaded again.
+    private let diskCache: ProxiedContentDiskCache
+
+    // Measured from every request, and used to size segments and limit
+    // the requests in flight to each host.
+    let linkEstimator = ProxiedContentLinkEstimator()
+
     // Force usage as a singleton
     public required init(downloadFolderName: String) {
         AssertIsOnMainThread()
 
         self.downloadFolderName = downloadFolderName
 
+        let diskCacheFolderPath = (OWSFileSystem.cachesDirectoryPath() as NSString).appendingPathComponent(downloadFolderName)
+        self.diskCache = ProxiedContentDiskCache(folderPath: diskCacheFolderPath,
+                                                 maxByteCount: kMaxDiskCacheByteCount)
+
         super.init()
 
         SwiftSingletons.register(self)
@@ -478,6 +586,8 @@ open class ProxiedContentDownloader: NSObject, URLSessionTaskDelegate, URLSessio
         let configuration = ContentProxy.sessionConfiguration()
 
         // Don't use any caching to protect privacy of these requests.
+        // Downloaded assets are cached in diskCache, which doesn't
+        // record their URLs.
         configuration.urlCache = nil
         configuration.requestCachePolicy = .reloadIgnoringCacheData
 
@@ -500,6 +610,61 @@ open class ProxiedContentDownloader: NSObject, URLSessionTaskDelegate, URLSessio
     // list.
     private var assetRequestQueue = [ProxiedContentAssetRequest]()
 
+    public var diskCacheMetrics: ProxiedContentDiskCache.Metrics {
+        return diskCache.metrics
+    }
+
+    // Requests whose disk cache lookup is underway.
+    // This state should only be accessed on the main thread.
+    private var diskCacheLookupRequests = [ProxiedContentAssetRequest]()
+
+    // Serves the request from the disk cache if possible. Otherwise
+    // queues it for download.
+    private func lookUpInDiskCache(assetRequest: ProxiedContentAssetRequest) {
+        AssertIsOnMainThread()
+
+        guard let downloadFolderPath = downloadFolderPath else {
+            enqueue(assetRequest: assetRequest)
+            return
+        }
+        let assetDescription = assetRequest.assetDescription
+
+        diskCacheLookupRequests.append(assetRequest)
+        DispatchQueue.global(qos: .userInitiated).async {
+            let fileName = (NSUUID().uuidString as NSString).appendingPathExtension(assetDescription.fileExtension)!
+            let filePath = (downloadFolderPath as NSString).appendingPathComponent(fileName)
+            let isHit = self.diskCache.linkCachedAsset(url: assetDescription.url, toFilePath: filePath)
+
+            DispatchQueue.main.async {
+                self.diskCacheLookupRequests = self.diskCacheLookupRequests.filter { $0 != assetRequest }
+
+                guard isHit else {
+                    Logger.verbose("asset cache miss: \(assetDescription.url)")
+                    if !assetRequest.wasCancelled {
+                        self.enqueue(assetRequest: assetRequest)
+                    }
+                    return
+                }
+
+                Logger.verbose("asset disk cache hit: \(assetDescription.url)")
+                let asset = ProxiedContentAsset(assetDescription: assetDescription, filePath: filePath)
+                self.assetMap.set(key: assetDescription.url, value: asset)
+                if !assetRequest.wasCancelled {
+                    assetRequest.state = .complete
+                    assetRequest.requestDidSucceed(asset: asset)
+                }
+            }
+        }
+    }
+
+    private func enqueue(assetRequest: ProxiedContentAssetRequest) {
+        AssertIsOnMainThread()
+
+        // Asset requests are done queued and performed asynchronously.
+        assetRequestQueue.append(assetRequest)
+        processRequestQueueAsync()
+    }
+
     // The success and failure callbacks are always called on main queue.
     //
     // The success callbacks may be called synchronously on cache hit, in
@@ -517,20 +682,17 @@ open class ProxiedContentDownloader: NSObject, URLSessionTaskDelegate, URLSessio
             return nil
         }
 
-        // Cache miss.
+        // Memory cache miss.
         //
-        // Asset requests are done queued and performed asynchronously.
-        Logger.verbose("asset cache miss: \(assetDescription.url)")
+        // The disk cache lookup, and the download if that misses, are
+        // asynchronous, so that the caller has time to store a reference
+        // to the asset request returned by this method before its
+        // success/failure handler is called.
         let assetRequest = ProxiedContentAssetRequest(assetDescription: assetDescription,
                                              priority: priority,
                                              success: success,
                                              failure: failure)
-        assetRequestQueue.append(assetRequest)
-        // Process the queue (which may start this request)
-        // asynchronously so that the caller has time to store
-        // a reference to the asset request returned by this
-        // method before its success/failure handler is called.
-        processRequestQueueAsync()
+        lookUpInDiskCache(assetRequest: assetRequest)
         return assetRequest
     }
 
@@ -541,6 +703,8 @@ open class ProxiedContentDownloader: NSObject, URLSessionTaskDelegate, URLSessio
 
         self.assetRequestQueue.forEach { $0.cancel() }
         self.assetRequestQueue = []
+        self.diskCacheLookupRequests.forEach { $0.cancel() }
+        self.diskCacheLookupRequests = []
     }
 
     private func segmentRequestDidSucceed(assetRequest: ProxiedContentAssetRequest, assetSegment: ProxiedContentAssetSegment) {
@@ -565,13 +729,9 @@ open class ProxiedContentDownloader: NSObject, URLSessionTaskDelegate, URLSessio
         // try to write the asset to file.
         assetRequest.state = .complete
 
-        // Move write off main thread.
+        // Move file operations off main thread.
         DispatchQueue.global().async {
-            guard let downloadFolderPath = self.downloadFolderPath else {
-                owsFailDebug("Missing downloadFolderPath")
-                return
-            }
-            guard let asset = assetRequest.writeAssetToFile(downloadFolderPath: downloadFolderPath) else {
+            guard let asset = assetRequest.completeAssetFile() else {
                 self.segmentRequestDidFail(assetRequest: assetRequest)
                 return
             }
@@ -582,7 +742,23 @@ open class ProxiedContentDownloader: NSObject, URLSessionTaskDelegate, URLSessio
 
     private func assetRequestDidSucceed(assetRequest: ProxiedContentAssetRequest, asset: ProxiedContentAsset) {
         DispatchQueue.main.async {
+            guard !assetRequest.wasCancelled else {
+                // The request was cancelled while its file was being completed.
+                assetRequest.discardAssetFile()
+                self.removeAssetRequestFromQueue(assetRequest: assetRequest)
+                return
+            }
+            guard OWSFileSystem.fileOrFolderExists(atPath: asset.filePath) else {
+                owsFailDebug("Missing asset file.")
+                assetRequest.state = .failed
+                self.assetRequestDidFail(assetRequest: assetRequest)
+                return
+            }
+
             self.assetMap.set(key: assetRequest.assetDescription.url, value: asset)
+            DispatchQueue.global().async {
+                self.diskCache.storeAsset(url: assetRequest.assetDescription.url, filePath: asset.filePath)
+            }
             self.removeAssetRequestFromQueue(assetRequest: assetRequest)
             assetRequest.requestDidSucceed(asset: asset)
         }
@@ -613,7 +789,11 @@ open class ProxiedContentDownloader: NSObject, URLSessionTaskDelegate, URLSessio
         AssertIsOnMainThread()
 
         guard assetRequestQueue.contains(assetRequest) else {
-            Logger.warn("could not remove asset request from queue: \(assetRequest.assetDescription.url)")
+            // Cancelled requests are discarded as soon as they're found,
+            // so their in-flight tasks may complete after they're gone.
+            if !assetRequest.wasCancelled {
+                Logger.warn("could not remove asset request from queue: \(assetRequest.assetDescription.url)")
+            }
             return
         }
 
@@ -783,8 +963,20 @@ open class ProxiedContentDownloader: NSObject, URLSessionTaskDelegate, URLSessio
         }
 
         DispatchQueue.main.async {
+            guard let downloadFolderPath = self.downloadFolderPath else {
+                owsFailDebug("Missing downloadFolderPath")
+                assetRequest.state = .failed
+                self.assetRequestDidFail(assetRequest: assetRequest)
+                return
+            }
             assetRequest.contentLength = contentLength
-            assetRequest.createSegments(withInitialData: data)
+            guard assetRequest.createSegments(withInitialData: data,
+                                              downloadFolderPath: downloadFolderPath,
+                                              linkEstimator: self.linkEstimator) else {
+                assetRequest.state = .failed
+                self.assetRequestDidFail(assetRequest: assetRequest)
+                return
+            }
             assetRequest.state = .active
 
             if !self.tryToCompleteRequest(assetRequest: assetRequest) {
@@ -795,53 +987,60 @@ open class ProxiedContentDownloader: NSObject, URLSessionTaskDelegate, URLSessio
 
     // Return the first asset request for which we either:
     //
+    // * Need to discard it, because it was cancelled.
     // * Need to download the content length.
     // * Need to download at least one of its segments.
     private func popNextAssetRequest() -> ProxiedContentAssetRequest? {
         AssertIsOnMainThread()
 
-        let kMaxAssetRequestCount: UInt = 3
-        let kMaxAssetRequestsPerAssetCount: UInt = kMaxAssetRequestCount - 1
+        // Discard cancelled requests first, e.g. for cells which have
+        // scrolled off screen, so that they don't hold up visible ones.
+        if let cancelledAssetRequest = assetRequestQueue.first(where: { $0.wasCancelled }) {
+            return cancelledAssetRequest
+        }
+
+        // Count the requests in flight to each host.
+        var activeRequestCounts = [String: UInt]()
+        for assetRequest in assetRequestQueue {
+            let host = assetRequest.host ?? ""
+            switch assetRequest.state {
+            case .requestingSize:
+                activeRequestCounts[host, default: 0] += 1
+            case .active:
+                activeRequestCounts[host, default: 0] += assetRequest.downloadingSegmentsCount()
+            case .waiting, .complete, .failed:
+                break
+            }
+        }
 
         // Prefer the first "high" priority request;
         // fall back to the first "low" priority request.
-        var activeAssetRequestsCount: UInt = 0
         for priority in [ProxiedContentRequestPriority.high, ProxiedContentRequestPriority.low] {
             for assetRequest in assetRequestQueue where assetRequest.priority == priority {
+                let maxRequestCount = linkEstimator.maxConcurrentRequests(host: assetRequest.host)
+                // Ensure that only N requests are active per host at a time.
+                guard activeRequestCounts[assetRequest.host ?? "", default: 0] < maxRequestCount else {
+                    continue
+                }
+
                 switch assetRequest.state {
                 case .waiting:
                     // This asset request needs its content length.
                     return assetRequest
-                case .requestingSize:
-                    activeAssetRequestsCount += 1
-                    // Ensure that only N requests are active at a time.
-                    guard activeAssetRequestsCount < kMaxAssetRequestCount else {
-                        return nil
-                    }
-                    continue
                 case .active:
-                    break
-                case .complete:
-                    continue
-                case .failed:
-                    continue
-                }
-
-                let downloadingSegmentsCount = assetRequest.downloadingSegmentsCount()
-                activeAssetRequestsCount += downloadingSegmentsCount
-                // Ensure that only N segment requests are active per asset at a time.
-                guard downloadingSegmentsCount < kMaxAssetRequestsPerAssetCount else {
-                    continue
-                }
-                // Ensure that only N requests are active at a time.
-                guard activeAssetRequestsCount < kMaxAssetRequestCount else {
-                    return nil
-                }
-                guard assetRequest.firstWaitingSegment() != nil else {
-                    /// Asset request does not have a waiting segment.
+                    // Ensure that only N-1 segment requests are active per asset at a time.
+                    let maxRequestsPerAssetCount = max(1, maxRequestCount - 1)
+                    guard assetRequest.downloadingSegmentsCount() < maxRequestsPerAssetCount else {
+                        continue
+                    }
+                    guard assetRequest.firstWaitingSegment() != nil else {
+                        /// Asset request does not have a waiting segment.
+                        continue
+                    }
+                    return assetRequest
+                case .requestingSize, .complete, .failed:
                     continue
                 }
-                return assetRequest
             }
         }
 
@@ -907,6 +1106,21 @@ open class ProxiedContentDownloader: NSObject, URLSessionTaskDelegate, URLSessio
         segmentRequestDidSucceed(assetRequest: assetRequest, assetSegment: assetSegment)
     }
 
+    public func urlSession(_ session: URLSession, task: URLSessionTask, didFinishCollecting metrics: URLSessionTaskMetrics) {
+        guard let host = task.originalRequest?.url?.host,
+            let transactionMetrics = metrics.transactionMetrics.last,
+            let requestStartDate = transactionMetrics.requestStartDate,
+            let responseStartDate = transactionMetrics.responseStartDate,
+            let responseEndDate = transactionMetrics.responseEndDate else {
+                return
+        }
+        linkEstimator.recordRoundTrip(host: host,
+                                      duration: responseStartDate.timeIntervalSince(requestStartDate))
+        linkEstimator.recordTransfer(host: host,
+                                     byteCount: task.countOfBytesReceived,
+                                     duration: responseEndDate.timeIntervalSince(responseStartDate))
+    }
+
     weak var delegate: ProxiedContentDownloaderDelegate?
     public func urlSession(_ session: URLSession, task: URLSessionTask, willPerformHTTPRedirection response: HTTPURLResponse, newRequest request: URLRequest, completionHandler: @escaping (URLRequest?) -> Void) {
         guard let delegate = delegate else {
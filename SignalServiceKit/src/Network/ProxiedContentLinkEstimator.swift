@@ -0,0 +1,120 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+
+// Estimates the round trip time and per-request throughput of each host
+// from completed proxied content requests, so that the downloader can size
+// segments and pick a request concurrency that suits the link.
+//
+// Until a host has been measured, the downloader falls back to its
+// defaults.
+public class ProxiedContentLinkEstimator: NSObject {
+
+    public struct Estimate {
+        public let roundTripTime: TimeInterval
+        // Bytes per second, for a single request.
+        public let throughput: Double
+    }
+
+    public static let defaultMaxConcurrentRequests: UInt = 3
+
+    // The weight of each new sample in the moving averages.
+    private let kSmoothingFactor: Double = 0.25
+
+    // Smaller transfers are dominated by latency, so they say little about
+    // throughput.
+    private let kMinThroughputSampleByteCount: Int64 = 16 * 1024
+
+    private let kMinSegmentSize: UInt = 16 * 1024
+    private let kMaxSegmentSize: UInt = 1024 * 1024
+
+    private let kMinConcurrentRequests: UInt = 2
+    private let kMaxConcurrentRequests: UInt = 6
+
+    // Should only be accessed while synchronized on self.
+    private var roundTripTimes = [String: TimeInterval]()
+    private var throughputs = [String: Double]()
+
+    // MARK: - Samples
+
+    private func smooth(_ oldValue: Double?, _ sample: Double) -> Double {
+        guard let oldValue = oldValue else {
+            return sample
+        }
+        return oldValue + (sample - oldValue) * kSmoothingFactor
+    }
+
+    // The time from sending a request to receiving the first byte of its
+    // response.
+    public func recordRoundTrip(host: String, duration: TimeInterval) {
+        guard duration > 0 else {
+            return
+        }
+
+        objc_sync_enter(self)
+        roundTripTimes[host] = smooth(roundTripTimes[host], duration)
+        objc_sync_exit(self)
+    }
+
+    // The time from receiving the first byte of a response to receiving
+    // its last byte.
+    public func recordTransfer(host: String, byteCount: Int64, duration: TimeInterval) {
+        guard byteCount >= kMinThroughputSampleByteCount, duration > 0 else {
+            return
+        }
+
+        objc_sync_enter(self)
+        throughputs[host] = smooth(throughputs[host], Double(byteCount) / duration)
+        objc_sync_exit(self)
+    }
+
+    public func estimate(host: String?) -> Estimate? {
+        guard let host = host else {
+            return nil
+        }
+
+        objc_sync_enter(self)
+        defer { objc_sync_exit(self) }
+
+        guard let roundTripTime = roundTripTimes[host],
+            let throughput = throughputs[host] else {
+                return nil
+        }
+        return Estimate(roundTripTime: roundTripTime, throughput: throughput)
+    }
+
+    // MARK: - Policy
+
+    // Segments should take about four round trips to transfer, so that
+    // per-request overhead stays small, but no more than a second, so that
+    // a slow link shows progress and a stalled segment costs little.
+    //
+    // Returns nil if the host hasn't been measured yet.
+    public func segmentSize(host: String?, contentLength: UInt) -> UInt? {
+        guard let estimate = estimate(host: host) else {
+            return nil
+        }
+        let targetDuration = min(max(4 * estimate.roundTripTime, 0.25), 1.0)
+        let segmentSize = UInt(estimate.throughput * targetDuration)
+        let kilobyte: UInt = 1024
+        let roundedSegmentSize = min(max(segmentSize, kMinSegmentSize), kMaxSegmentSize) / kilobyte * kilobyte
+        return min(roundedSegmentSize, contentLength)
+    }
+
+    // Each request is idle for a round trip before its data arrives, so
+    // the more data a request could receive in that time (the bandwidth-
+    // delay product) the more requests it takes to keep the link busy. On
+    // a slow link, extra requests just split the bandwidth and delay every
+    // asset.
+    public func maxConcurrentRequests(host: String?) -> UInt {
+        guard let estimate = estimate(host: host) else {
+            return ProxiedContentLinkEstimator.defaultMaxConcurrentRequests
+        }
+        let bandwidthDelayProduct = estimate.throughput * estimate.roundTripTime
+        let kRequestWindowSize: Double = 64 * 1024
+        let requestCount = UInt((Double(kMinConcurrentRequests) + bandwidthDelayProduct / kRequestWindowSize).rounded())
+        return min(max(requestCount, kMinConcurrentRequests), kMaxConcurrentRequests)
+    }
+}
@@ -141,6 +141,7 @@ public class SSKMessageDecryptOperation: OWSOperation, DurableOperation {
 
             let envelope = try SSKProtoEnvelope.parseData(envelopeData)
             let wasReceivedByUD = self.wasReceivedByUD(envelope: envelope)
+            MessageIngestTrace.shared.record(stage: .decryptStarted, envelope: envelope)
             messageDecrypter.decryptEnvelope(envelope,
                                              envelopeData: envelopeData,
                                              successBlock: { (result: OWSMessageDecryptResult, transaction: SDSAnyWriteTransaction) in
@@ -154,6 +155,9 @@ public class SSKMessageDecryptOperation: OWSOperation, DurableOperation {
                                                                                                plaintextData: result.plaintextData,
                                                                                                wasReceivedByUD: wasReceivedByUD,
                                                                                                transaction: transaction)
+                                                MessageIngestTrace.shared.record(stage: .decrypted,
+                                                                                 envelope: envelope,
+                                                                                 transaction: transaction)
                                                 DispatchQueue.global().async {
                                                     self.reportSuccess()
                                                 }
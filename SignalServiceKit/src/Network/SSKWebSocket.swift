@@ -93,7 +93,13 @@ public class SSKWebSocketManager: NSObject {
 
     @objc
     public class func buildSocket(request: URLRequest) -> SSKWebSocket {
-        return SSKWebSocketImpl(request: request)
+        return SSKWebSocketImpl(request: request, callbackQueue: .main)
+    }
+
+    // Delegate methods are invoked on callbackQueue.
+    @objc
+    public class func buildSocket(request: URLRequest, callbackQueue: DispatchQueue) -> SSKWebSocket {
+        return SSKWebSocketImpl(request: request, callbackQueue: callbackQueue)
     }
 }
 
@@ -101,8 +107,9 @@ class SSKWebSocketImpl: SSKWebSocket {
 
     private let socket: Starscream.WebSocket
 
-    init(request: URLRequest) {
+    init(request: URLRequest, callbackQueue: DispatchQueue) {
         let socket = WebSocket(request: request)
+        socket.callbackQueue = callbackQueue
 
         socket.disableSSLCertValidation = true
         socket.socketSecurityLevel = StreamSocketSecurityLevel.tlSv1_2
@@ -0,0 +1,87 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+
+@objc
+public protocol OWSSocketRequest: AnyObject {
+    var requestId: UInt64 { get }
+
+    func timeoutIfNecessary()
+}
+
+// MARK: -
+
+// Tracks the requests OWSWebSocket has in flight and times them out.
+//
+// All state is confined to a serial queue. Registration is async, so
+// senders never block on the registry, and a single timing wheel on the
+// same queue handles every request's timeout.
+@objc
+public class OWSSocketRequestRegistry: NSObject {
+
+    static let timeoutTickInterval: TimeInterval = 0.25
+    // 16 seconds per rotation comfortably covers the socket timeout.
+    static let timeoutSlotCount = 64
+
+    private let serialQueue = DispatchQueue(label: "org.signal.socket-request-registry")
+
+    // Should only be accessed on serialQueue.
+    private var requests = [UInt64: OWSSocketRequest]()
+    private var timeoutWheel: TimingWheel<UInt64>!
+
+    @objc
+    public override init() {
+        super.init()
+
+        timeoutWheel = TimingWheel(queue: serialQueue,
+                                   tickInterval: OWSSocketRequestRegistry.timeoutTickInterval,
+                                   slotCount: OWSSocketRequestRegistry.timeoutSlotCount) { [weak self] requestId in
+                                    self?.didTimeout(requestId: requestId)
+        }
+    }
+
+    // MARK: -
+
+    // The request must be added before it is sent, so that its
+    // registration is ordered before the removal of its response.
+    @objc(addRequest:timeout:)
+    public func add(request: OWSSocketRequest, timeout: TimeInterval) {
+        serialQueue.async {
+            owsAssertDebug(self.requests[request.requestId] == nil)
+
+            self.requests[request.requestId] = request
+            self.timeoutWheel.schedule(key: request.requestId, timeout: timeout)
+        }
+    }
+
+    @objc(removeRequestWithId:)
+    public func removeRequest(requestId: UInt64) -> OWSSocketRequest? {
+        return serialQueue.sync {
+            guard let request = requests.removeValue(forKey: requestId) else {
+                return nil
+            }
+            timeoutWheel.cancel(key: requestId)
+            return request
+        }
+    }
+
+    @objc
+    public func removeAllRequests() -> [OWSSocketRequest] {
+        return serialQueue.sync {
+            let result = Array(requests.values)
+            requests.removeAll()
+            timeoutWheel.cancelAll()
+            return result
+        }
+    }
+
+    private func didTimeout(requestId: UInt64) {
+        guard let request = requests.removeValue(forKey: requestId) else {
+            owsFailDebug("Missing request.")
+            return
+        }
+        request.timeoutIfNecessary()
+    }
+}
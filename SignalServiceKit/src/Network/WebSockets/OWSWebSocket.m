@@ -13,6 +13,7 @@
 #import "OWSError.h"
 #import "OWSMessageManager.h"
 #import "OWSMessageReceiver.h"
+#import "OWSQueues.h"
 #import "OWSSignalService.h"
 #import "SSKEnvironment.h"
 #import "TSAccountManager.h"
@@ -41,9 +42,15 @@ static const NSTimeInterval kKeepAliveDuration_MakeRequestInBackground = 20.f;
 // d) It has just received the response to a request.
 static const NSTimeInterval kKeepAliveDuration_ReceiveResponse = 5.f;
 
+static const NSTimeInterval kSocketRequestTimeoutSeconds = 10.f;
+
+// Received messages extend the keep alive at most this often, so that
+// draining a large queue doesn't hop to the main thread for every frame.
+static const CFTimeInterval kReceiveMessageKeepAliveThrottleSeconds = 1.f;
+
 NSString *const kNSNotification_OWSWebSocketStateDidChange = @"kNSNotification_OWSWebSocketStateDidChange";
 
-@interface TSSocketMessage : NSObject
+@interface TSSocketMessage : NSObject <OWSSocketRequest>
 
 @property (nonatomic, readonly) UInt64 requestId;
 @property (nonatomic, nullable) TSSocketMessageSuccess success;
@@ -150,7 +157,10 @@ NSString *const kNSNotification_OWSWebSocketStateDidChange = @"kNSNotification_O
 //
 // The first tier is the actual websocket and the timers used
 // to keep it alive and connected.
-@property (nonatomic, nullable) id<SSKWebSocket> websocket;
+//
+// The websocket is only mutated on the main thread but is also read
+// on the socket queue, where its frames are handled.
+@property (atomic, nullable) id<SSKWebSocket> websocket;
 @property (nonatomic, nullable) NSTimer *heartbeatTimer;
 @property (nonatomic, nullable) NSTimer *reconnectTimer;
 
@@ -193,11 +203,14 @@ NSString *const kNSNotification_OWSWebSocketStateDidChange = @"kNSNotification_O
 
 @property (nonatomic) BOOL hasObservedNotifications;
 
-// This property should only be accessed while synchronized on the socket manager.
-@property (nonatomic, readonly) NSMutableDictionary<NSNumber *, TSSocketMessage *> *socketMessageMap;
+@property (nonatomic, readonly) OWSSocketRequestRegistry *requestRegistry;
 
 @property (atomic) BOOL canMakeRequests;
 
+// These properties should only be accessed on the socket queue.
+@property (nonatomic, readonly) OWSWebSocketEnvelopeBatcher *envelopeBatcher;
+@property (nonatomic) CFTimeInterval lastReceiveMessageKeepAliveTime;
+
 @end
 
 #pragma mark -
@@ -215,7 +228,16 @@ NSString *const kNSNotification_OWSWebSocketStateDidChange = @"kNSNotification_O
     OWSAssertIsOnMainThread();
 
     _state = OWSWebSocketStateClosed;
-    _socketMessageMap = [NSMutableDictionary new];
+    _requestRegistry = [OWSSocketRequestRegistry new];
+
+    __weak OWSWebSocket *weakSelf = self;
+    _envelopeBatcher = [[OWSWebSocketEnvelopeBatcher alloc] initWithSocketQueue:self.serialQueue
+        persistBlock:^(NSArray<NSData *> *envelopes, NSInteger undecryptableCount) {
+            [weakSelf persistEnvelopes:envelopes undecryptableCount:undecryptableCount];
+        }
+        ackBlock:^(NSArray<WebSocketProtoWebSocketRequestMessage *> *requests) {
+            [weakSelf sendWebSocketMessageAcknowledgements:requests];
+        }];
 
     return self;
 }
@@ -423,7 +445,8 @@ NSString *const kNSNotification_OWSWebSocketStateDidChange = @"kNSNotification_O
             NSURL *webSocketConnectURL = [NSURL URLWithString:webSocketConnect];
             NSMutableURLRequest *request = [[NSMutableURLRequest alloc] initWithURL:webSocketConnectURL];
 
-            id<SSKWebSocket> socket = [SSKWebSocketManager buildSocketWithRequest:request];
+            id<SSKWebSocket> socket = [SSKWebSocketManager buildSocketWithRequest:request
+                                                                    callbackQueue:self.serialQueue];
             socket.delegate = self;
 
             [self setWebsocket:socket];
@@ -497,10 +520,6 @@ NSString *const kNSNotification_OWSWebSocketStateDidChange = @"kNSNotification_O
                                                                         success:success
                                                                         failure:failure];
 
-    @synchronized(self) {
-        self.socketMessageMap[@(socketMessage.requestId)] = socketMessage;
-    }
-
     NSURL *requestUrl = request.URL;
     NSString *requestPath = [@"/" stringByAppendingString:requestUrl.path];
 
@@ -558,25 +577,21 @@ NSString *const kNSNotification_OWSWebSocketStateDidChange = @"kNSNotification_O
         return;
     }
 
+    // Register the request before sending it so that its response
+    // can't arrive first.
+    [self.requestRegistry addRequest:socketMessage timeout:kSocketRequestTimeoutSeconds];
+
     [self.websocket writeData:messageData];
     OWSLogInfo(@"making request: %llu, %@: %@, jsonData.length: %zd",
         socketMessage.requestId,
         request.HTTPMethod,
         requestPath,
         jsonData.length);
-
-    const int64_t kSocketTimeoutSeconds = 10;
-    __weak TSSocketMessage *weakSocketMessage = socketMessage;
-    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, kSocketTimeoutSeconds * NSEC_PER_SEC),
-        dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0),
-        ^{
-            [weakSocketMessage timeoutIfNecessary];
-        });
 }
 
 - (void)processWebSocketResponseMessage:(WebSocketProtoWebSocketResponseMessage *)message
 {
-    OWSAssertIsOnMainThread();
+    AssertOnDispatchQueue(self.serialQueue);
     OWSAssertDebug(message);
 
     dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
@@ -619,11 +634,7 @@ NSString *const kNSNotification_OWSWebSocketStateDidChange = @"kNSNotification_O
         }
     }
 
-    TSSocketMessage *_Nullable socketMessage;
-    @synchronized(self) {
-        socketMessage = self.socketMessageMap[@(requestId)];
-        [self.socketMessageMap removeObjectForKey:@(requestId)];
-    }
+    TSSocketMessage *_Nullable socketMessage = (TSSocketMessage *)[self.requestRegistry removeRequestWithId:requestId];
 
     if (!socketMessage) {
         OWSLogError(@"received response to unknown request.");
@@ -662,11 +673,7 @@ NSString *const kNSNotification_OWSWebSocketStateDidChange = @"kNSNotification_O
 
 - (void)failAllPendingSocketMessages
 {
-    NSArray<TSSocketMessage *> *socketMessages;
-    @synchronized(self) {
-        socketMessages = self.socketMessageMap.allValues;
-        [self.socketMessageMap removeAllObjects];
-    }
+    NSArray<TSSocketMessage *> *socketMessages = (NSArray<TSSocketMessage *> *)[self.requestRegistry removeAllRequests];
 
     OWSLogInfo(@"failAllPendingSocketMessages: %zd.", socketMessages.count);
 
@@ -678,6 +685,15 @@ NSString *const kNSNotification_OWSWebSocketStateDidChange = @"kNSNotification_O
 #pragma mark - SSKWebSocketDelegate
 
 - (void)websocketDidConnectWithSocket:(id<SSKWebSocket>)websocket
+{
+    AssertOnDispatchQueue(self.serialQueue);
+
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [self handleWebsocketDidConnect:websocket];
+    });
+}
+
+- (void)handleWebsocketDidConnect:(id<SSKWebSocket>)websocket
 {
     OWSAssertIsOnMainThread();
     OWSAssertDebug(websocket);
@@ -695,6 +711,15 @@ NSString *const kNSNotification_OWSWebSocketStateDidChange = @"kNSNotification_O
 }
 
 - (void)websocketDidDisconnectWithSocket:(id<SSKWebSocket>)websocket error:(nullable NSError *)error
+{
+    AssertOnDispatchQueue(self.serialQueue);
+
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [self handleWebsocketDidDisconnect:websocket error:error];
+    });
+}
+
+- (void)handleWebsocketDidDisconnect:(id<SSKWebSocket>)websocket error:(nullable NSError *)error
 {
     OWSAssertIsOnMainThread();
     OWSAssertDebug(websocket);
@@ -720,7 +745,7 @@ NSString *const kNSNotification_OWSWebSocketStateDidChange = @"kNSNotification_O
 
 - (void)websocket:(id<SSKWebSocket>)websocket didReceiveMessage:(WebSocketProtoWebSocketMessage *)message
 {
-    OWSAssertIsOnMainThread();
+    AssertOnDispatchQueue(self.serialQueue);
     OWSAssertDebug(websocket);
 
     if (websocket != self.websocket) {
@@ -744,6 +769,7 @@ NSString *const kNSNotification_OWSWebSocketStateDidChange = @"kNSNotification_O
 
 #pragma mark -
 
+// Websocket frames are decoded, dispatched and acknowledged on this queue.
 - (dispatch_queue_t)serialQueue
 {
     static dispatch_queue_t _serialQueue;
@@ -757,78 +783,103 @@ NSString *const kNSNotification_OWSWebSocketStateDidChange = @"kNSNotification_O
 
 - (void)processWebSocketRequestMessage:(WebSocketProtoWebSocketRequestMessage *)message
 {
-    OWSAssertIsOnMainThread();
+    AssertOnDispatchQueue(self.serialQueue);
 
     OWSLogInfo(@"Got message with verb: %@ and path: %@", message.verb, message.path);
 
     // If we receive a message over the socket while the app is in the background,
     // prolong how long the socket stays open.
-    [self requestSocketAliveForAtLeastSeconds:kKeepAliveDuration_ReceiveMessage];
+    [self requestSocketAliveForReceivedMessage];
 
     if ([message.path isEqualToString:@"/api/v1/message"] && [message.verb isEqualToString:@"PUT"]) {
+        NSData *_Nullable decryptedPayload;
+        @try {
+            BOOL useSignalingKey = [message.headers containsObject:@"X-Signal-Key: true"];
+            if (useSignalingKey) {
+                NSString *_Nullable signalingKey = self.tsAccountManager.storedSignalingKey;
+                OWSAssertDebug(signalingKey);
+                decryptedPayload = [Cryptography decryptAppleMessagePayload:message.body withSignalingKey:signalingKey];
+            } else {
+                OWSAssertDebug([message.headers containsObject:@"X-Signal-Key: false"]);
 
-        __block OWSBackgroundTask *_Nullable backgroundTask =
-            [OWSBackgroundTask backgroundTaskWithLabelStr:__PRETTY_FUNCTION__];
-
-        dispatch_async(self.serialQueue, ^{
-            BOOL success = NO;
-            @try {
-                BOOL useSignalingKey = [message.headers containsObject:@"X-Signal-Key: true"];
-                NSData *_Nullable decryptedPayload;
-                if (useSignalingKey) {
-                    NSString *_Nullable signalingKey = self.tsAccountManager.storedSignalingKey;
-                    OWSAssertDebug(signalingKey);
-                    decryptedPayload =
-                        [Cryptography decryptAppleMessagePayload:message.body withSignalingKey:signalingKey];
-                } else {
-                    OWSAssertDebug([message.headers containsObject:@"X-Signal-Key: false"]);
-
-                    decryptedPayload = message.body;
-                }
-
-                if (!decryptedPayload) {
-                    OWSLogWarn(@"Failed to decrypt incoming payload or bad HMAC");
-                } else {
-                    [self.messageReceiver handleReceivedEnvelopeData:decryptedPayload];
-                    success = YES;
-                }
-            } @catch (NSException *exception) {
-                OWSFailDebug(@"Received an invalid envelope: %@", exception.debugDescription);
-                // TODO: Add analytics.
-            }
-
-            if (!success) {
-                [self.databaseStorage writeWithBlock:^(SDSAnyWriteTransaction *transaction) {
-                    ThreadlessErrorMessage *errorMessage = [ThreadlessErrorMessage corruptedMessageInUnknownThread];
-                    [self.notificationsManager notifyUserForThreadlessErrorMessage:errorMessage
-                                                                       transaction:transaction];
-                }];
+                decryptedPayload = message.body;
             }
+        } @catch (NSException *exception) {
+            OWSFailDebug(@"Received an invalid envelope: %@", exception.debugDescription);
+            // TODO: Add analytics.
+            decryptedPayload = nil;
+        }
 
-            dispatch_async(dispatch_get_main_queue(), ^{
-                [self sendWebSocketMessageAcknowledgement:message];
-                OWSAssertDebug(backgroundTask);
-                backgroundTask = nil;
-            });
-        });
+        if (!decryptedPayload) {
+            OWSLogWarn(@"Failed to decrypt incoming payload or bad HMAC");
+            [self.envelopeBatcher enqueueUndecryptableRequest:message];
+        } else {
+            // The ack is sent once the envelope has been durably enqueued.
+            [self.envelopeBatcher enqueueEnvelopeData:decryptedPayload request:message];
+        }
     } else if ([message.path isEqualToString:@"/api/v1/queue/empty"]) {
         // Queue is drained.
 
-        [self sendWebSocketMessageAcknowledgement:message];
+        [self.envelopeBatcher enqueueAckForRequest:message];
     } else {
         OWSLogWarn(@"Unsupported WebSocket Request");
 
-        [self sendWebSocketMessageAcknowledgement:message];
+        [self.envelopeBatcher enqueueAckForRequest:message];
     }
 }
 
-- (void)sendWebSocketMessageAcknowledgement:(WebSocketProtoWebSocketRequestMessage *)request
+- (void)requestSocketAliveForReceivedMessage
 {
-    OWSAssertIsOnMainThread();
-    NSError *error;
-    BOOL didSucceed = [self.websocket sendResponseForRequest:request status:200 message:@"OK" error:&error];
-    if (!didSucceed) {
-        OWSFailDebug(@"failure: %@", error);
+    AssertOnDispatchQueue(self.serialQueue);
+
+    CFTimeInterval now = CACurrentMediaTime();
+    if (self.lastReceiveMessageKeepAliveTime > 0
+        && now - self.lastReceiveMessageKeepAliveTime < kReceiveMessageKeepAliveThrottleSeconds) {
+        return;
+    }
+    self.lastReceiveMessageKeepAliveTime = now;
+
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [self requestSocketAliveForAtLeastSeconds:kKeepAliveDuration_ReceiveMessage];
+    });
+}
+
+// Invoked by the envelope batcher on its persistence queue.
+- (void)persistEnvelopes:(NSArray<NSData *> *)envelopes undecryptableCount:(NSInteger)undecryptableCount
+{
+    NSInteger failureCount = undecryptableCount;
+    if (envelopes.count > 0) {
+        @try {
+            [self.messageReceiver handleReceivedEnvelopeDataBatch:envelopes];
+        } @catch (NSException *exception) {
+            OWSFailDebug(@"Received an invalid envelope: %@", exception.debugDescription);
+            // TODO: Add analytics.
+            failureCount += (NSInteger)envelopes.count;
+        }
+    }
+
+    if (failureCount > 0) {
+        [self.databaseStorage writeWithBlock:^(SDSAnyWriteTransaction *transaction) {
+            for (NSInteger i = 0; i < failureCount; i++) {
+                ThreadlessErrorMessage *errorMessage = [ThreadlessErrorMessage corruptedMessageInUnknownThread];
+                [self.notificationsManager notifyUserForThreadlessErrorMessage:errorMessage
+                                                                   transaction:transaction];
+            }
+        }];
+    }
+}
+
+- (void)sendWebSocketMessageAcknowledgements:(NSArray<WebSocketProtoWebSocketRequestMessage *> *)requests
+{
+    AssertOnDispatchQueue(self.serialQueue);
+
+    id<SSKWebSocket> _Nullable websocket = self.websocket;
+    for (WebSocketProtoWebSocketRequestMessage *request in requests) {
+        NSError *error;
+        BOOL didSucceed = [websocket sendResponseForRequest:request status:200 message:@"OK" error:&error];
+        if (!didSucceed) {
+            OWSFailDebug(@"failure: %@", error);
+        }
     }
 }
 
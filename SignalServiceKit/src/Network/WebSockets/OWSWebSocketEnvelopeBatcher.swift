@@ -0,0 +1,190 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+import SignalCoreKit
+
+// Persists envelopes received over the websocket in batches and only
+// acknowledges them once they are durable.
+//
+// Requests are enqueued on the socket queue in the order they were
+// received. Envelopes that arrive while the previous batch is still
+// committing accrue into the next batch, so batches grow with load and
+// frame parsing never waits on the database. Acks are sent back on the
+// socket queue in receive order once the batch that covers them has
+// been persisted.
+@objc
+public class OWSWebSocketEnvelopeBatcher: NSObject {
+
+    public typealias PersistBlock = (_ envelopes: [Data], _ undecryptableCount: Int) -> Void
+    public typealias AckBlock = (_ requests: [WebSocketProtoWebSocketRequestMessage]) -> Void
+
+    // A lone envelope waits at most this long for company.
+    static let coalescingWindow: TimeInterval = 0.005
+
+    // Bound the length of each write transaction.
+    static let maxBatchSize = 64
+
+    private let socketQueue: DispatchQueue
+    private let persistQueue = DispatchQueue(label: "org.signal.websocket.persist")
+    private let persistBlock: PersistBlock
+    private let ackBlock: AckBlock
+
+    private struct PendingRequest {
+        let request: WebSocketProtoWebSocketRequestMessage
+        let envelopeData: Data?
+        let isUndecryptable: Bool
+    }
+
+    // Should only be accessed on socketQueue.
+    private var pendingRequests = [PendingRequest]()
+    private var pendingBackgroundTask: OWSBackgroundTask?
+    private var isFlushScheduled = false
+    private var isPersisting = false
+    private var metrics = Metrics()
+
+    @objc
+    public init(socketQueue: DispatchQueue,
+                persistBlock: @escaping PersistBlock,
+                ackBlock: @escaping AckBlock) {
+        self.socketQueue = socketQueue
+        self.persistBlock = persistBlock
+        self.ackBlock = ackBlock
+
+        super.init()
+    }
+
+    // MARK: - Enqueue
+
+    @objc(enqueueEnvelopeData:request:)
+    public func enqueue(envelopeData: Data, request: WebSocketProtoWebSocketRequestMessage) {
+        assertOnQueue(socketQueue)
+
+        enqueue(PendingRequest(request: request, envelopeData: envelopeData, isUndecryptable: false))
+    }
+
+    // The request's ack is deferred so that acks stay in order, but a
+    // corrupt message error is persisted in lieu of the envelope.
+    @objc(enqueueUndecryptableRequest:)
+    public func enqueueUndecryptable(request: WebSocketProtoWebSocketRequestMessage) {
+        assertOnQueue(socketQueue)
+
+        enqueue(PendingRequest(request: request, envelopeData: nil, isUndecryptable: true))
+    }
+
+    // Requests with nothing to persist (e.g. "queue empty") are acked
+    // after the envelopes that preceded them.
+    @objc(enqueueAckForRequest:)
+    public func enqueueAck(request: WebSocketProtoWebSocketRequestMessage) {
+        assertOnQueue(socketQueue)
+
+        enqueue(PendingRequest(request: request, envelopeData: nil, isUndecryptable: false))
+    }
+
+    private func enqueue(_ pendingRequest: PendingRequest) {
+        pendingRequests.append(pendingRequest)
+
+        if pendingBackgroundTask == nil {
+            pendingBackgroundTask = OWSBackgroundTask(label: "\(#function)")
+        }
+
+        guard !isPersisting else {
+            // The batch will be flushed when the in-flight batch completes.
+            return
+        }
+        if pendingRequests.count >= OWSWebSocketEnvelopeBatcher.maxBatchSize {
+            flush()
+        } else if !isFlushScheduled {
+            isFlushScheduled = true
+            socketQueue.asyncAfter(deadline: .now() + OWSWebSocketEnvelopeBatcher.coalescingWindow) { [weak self] in
+                guard let self = self else { return }
+                self.isFlushScheduled = false
+                self.flush()
+            }
+        }
+    }
+
+    // MARK: - Flush
+
+    private func flush() {
+        assertOnQueue(socketQueue)
+
+        guard !isPersisting, !pendingRequests.isEmpty else {
+            return
+        }
+
+        let batchSize = min(pendingRequests.count, OWSWebSocketEnvelopeBatcher.maxBatchSize)
+        let batch = pendingRequests.prefix(batchSize)
+        pendingRequests.removeFirst(batchSize)
+
+        let requests = batch.map { $0.request }
+        let envelopes = batch.compactMap { $0.envelopeData }
+        let undecryptableCount = batch.filter { $0.isUndecryptable }.count
+
+        var backgroundTask = pendingBackgroundTask
+        pendingBackgroundTask = nil
+        if !pendingRequests.isEmpty {
+            pendingBackgroundTask = OWSBackgroundTask(label: "\(#function)")
+        }
+
+        isPersisting = true
+        let startTime = CACurrentMediaTime()
+        persistQueue.async {
+            if envelopes.count > 0 || undecryptableCount > 0 {
+                self.persistBlock(envelopes, undecryptableCount)
+            }
+
+            self.socketQueue.async {
+                self.ackBlock(requests)
+                owsAssertDebug(backgroundTask != nil)
+                backgroundTask = nil
+
+                self.metrics.record(requestCount: requests.count, duration: CACurrentMediaTime() - startTime)
+                self.isPersisting = false
+                self.flushIfNecessary()
+            }
+        }
+    }
+
+    private func flushIfNecessary() {
+        guard !pendingRequests.isEmpty else {
+            return
+        }
+        if pendingRequests.count >= OWSWebSocketEnvelopeBatcher.maxBatchSize || !isFlushScheduled {
+            // Requests that accrued during the last commit have already
+            // waited at least as long as the coalescing window would.
+            flush()
+        }
+    }
+}
+
+// MARK: - Metrics
+
+extension OWSWebSocketEnvelopeBatcher {
+    struct Metrics {
+        static let reportingInterval: TimeInterval = 60
+
+        private var windowStartTime = CACurrentMediaTime()
+        private var batchCount: UInt = 0
+        private var requestCount: UInt = 0
+        private var maxDuration: TimeInterval = 0
+
+        mutating func record(requestCount: Int, duration: TimeInterval) {
+            self.batchCount += 1
+            self.requestCount += UInt(requestCount)
+            self.maxDuration = max(self.maxDuration, duration)
+
+            let now = CACurrentMediaTime()
+            let elapsed = now - windowStartTime
+            guard elapsed >= Metrics.reportingInterval else {
+                return
+            }
+            Logger.info(String(format: "acks/sec: %.1f, acks/batch: %.1f, max persist latency: %.1fms",
+                               Double(self.requestCount) / elapsed,
+                               Double(self.requestCount) / Double(max(1, batchCount)),
+                               1000 * maxDuration))
+            self = Metrics()
+        }
+    }
+}
@@ -147,6 +147,9 @@ NS_ASSUME_NONNULL_BEGIN
 
 - (void)warmCaches;
 
+// Warms caches which aren't needed to present the app, in the background.
+- (void)warmDeferredCaches;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -6,6 +6,7 @@
 #import "AppContext.h"
 #import "OWSBlockingManager.h"
 #import "OWSPrimaryStorage.h"
+#import "OWSReadReceiptManager.h"
 #import "TSAccountManager.h"
 #import <SignalServiceKit/ProfileManagerProtocol.h>
 #import <SignalServiceKit/SignalServiceKit-Swift.h>
@@ -44,6 +45,7 @@ static SSKEnvironment *sharedSSKEnvironment;
 @property (nonatomic) SDSDatabaseStorage *databaseStorage;
 @property (nonatomic) StorageCoordinator *storageCoordinator;
 @property (nonatomic) SSKPreferences *sskPreferences;
+@property (nonatomic, nullable) WarmCacheScheduler *warmCacheScheduler;
 
 @end
 
@@ -254,6 +256,46 @@ static SSKEnvironment *sharedSSKEnvironment;
     }
 }
 
+- (WarmCacheScheduler *)ensureWarmCacheScheduler
+{
+    @synchronized(self) {
+        if (self.warmCacheScheduler != nil) {
+            return self.warmCacheScheduler;
+        }
+
+        // These caches are independent of each other, so are warmed concurrently.
+        __weak SSKEnvironment *weakSelf = self;
+        WarmCacheScheduler *scheduler = [WarmCacheScheduler new];
+        [scheduler addWarmupWithName:@"Blocking manager"
+                            priority:WarmCachePriorityCritical
+                               block:^{
+                                   [weakSelf.blockingManager warmCaches];
+                               }];
+        [scheduler addWarmupWithName:@"Profile manager"
+                            priority:WarmCachePriorityCritical
+                               block:^{
+                                   [weakSelf.profileManager warmCaches];
+                               }];
+        [scheduler addWarmupWithName:@"Account manager"
+                            priority:WarmCachePriorityCritical
+                               block:^{
+                                   [weakSelf.tsAccountManager warmCaches];
+                               }];
+        [scheduler addWarmupWithName:@"Key backup service"
+                            priority:WarmCachePriorityCritical
+                               block:^{
+                                   [OWSKeyBackupService warmCaches];
+                               }];
+        [scheduler addWarmupWithName:@"Read receipt manager"
+                            priority:WarmCachePriorityDeferred
+                               block:^{
+                                   [weakSelf.readReceiptManager prepareCachedValues];
+                               }];
+        self.warmCacheScheduler = scheduler;
+        return scheduler;
+    }
+}
+
 - (void)warmCaches
 {
     // Pre-heat caches to avoid sneaky transactions during the YDB->GRDB migrations.
@@ -261,10 +303,12 @@ static SSKEnvironment *sharedSSKEnvironment;
     //
     // We need to do as few writes as possible here, to avoid conflicts
     // with the migrations which haven't run yet.
-    [self.blockingManager warmCaches];
-    [self.profileManager warmCaches];
-    [self.tsAccountManager warmCaches];
-    [OWSKeyBackupService warmCaches];
+    [[self ensureWarmCacheScheduler] warmCriticalCaches];
+}
+
+- (void)warmDeferredCaches
+{
+    [[self ensureWarmCacheScheduler] warmDeferredCaches];
 }
 
 - (nullable OWSPrimaryStorage *)primaryStorage
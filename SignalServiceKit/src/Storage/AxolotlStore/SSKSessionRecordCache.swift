@@ -0,0 +1,157 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+import GRDB
+
+// Caches decoded SessionRecords for SSKSessionStore, keyed by
+// (accountId, deviceId), so that decrypting a backlog from one sender or
+// sending to a large group doesn't unarchive the same sessions repeatedly.
+//
+// Session records are mutable and the ratchet is advanced in place, so
+// the cache is careful to only ever hold committed state:
+//
+// * Only GRDB write transactions use the cache. They are serialized, so
+//   no two transactions can share a cached record. Reads bypass it.
+// * Loading a record for mutation checks it out of the cache. A record
+//   that is loaded (and possibly mutated) but never stored is dropped.
+// * Storing a record writes it through to the cache. If the transaction,
+//   or a savepoint within it, is rolled back, the cache is cleared.
+// * The cache is shared by every SSKSessionStore in the process, so a
+//   store made outside SSKEnvironment can't leave another's cache stale.
+// * Writes by other processes clear the cache. We detect them with
+//   SQLite's data_version on the writer connection, which only changes
+//   when another connection commits, and also clear the cache whenever
+//   SDSCrossProcess reports a write.
+@objc
+public class SSKSessionRecordCache: NSObject {
+
+    @objc
+    public static let shared = SSKSessionRecordCache()
+
+    static let maxRecordCount = 256
+
+    private let cache = NSCache<NSString, SessionRecord>()
+
+    // Should only be accessed within write transactions.
+    private var lastDataVersion: Int64?
+    // data_version is per connection, so we also clear the cache if the
+    // storage is reopened (e.g. between tests).
+    private weak var lastDatabase: Database?
+
+    private override init() {
+        cache.countLimit = SSKSessionRecordCache.maxRecordCount
+
+        super.init()
+
+        NotificationCenter.default.addObserver(self,
+                                               selector: #selector(didDetectCrossProcessWrite),
+                                               name: SDSDatabaseStorage.didDetectCrossProcessWriteNotification,
+                                               object: nil)
+    }
+
+    deinit {
+        NotificationCenter.default.removeObserver(self)
+    }
+
+    // MARK: -
+
+    private func cacheKey(accountId: String, deviceId: Int32) -> NSString {
+        return "\(accountId).\(deviceId)" as NSString
+    }
+
+    // Returns nil if the cache can't be used for this transaction.
+    private func grdbTransactionIfCacheable(_ transaction: SDSAnyReadTransaction) -> GRDBWriteTransaction? {
+        guard let writeTransaction = transaction as? SDSAnyWriteTransaction else {
+            return nil
+        }
+        switch writeTransaction.writeTransaction {
+        case .yapWrite:
+            return nil
+        case .grdbWrite(let grdbWrite):
+            invalidateIfChangedByOtherProcess(grdbWrite: grdbWrite)
+            return grdbWrite
+        }
+    }
+
+    private func invalidateIfChangedByOtherProcess(grdbWrite: GRDBWriteTransaction) {
+        let dataVersion: Int64?
+        do {
+            dataVersion = try Int64.fetchOne(grdbWrite.database, sql: "PRAGMA data_version")
+        } catch {
+            owsFailDebug("Error: \(error.grdbErrorForLogging)")
+            dataVersion = nil
+        }
+        let database = grdbWrite.database
+        guard dataVersion == nil || dataVersion != lastDataVersion || database !== lastDatabase else {
+            return
+        }
+        if lastDataVersion != nil {
+            Logger.verbose("Database changed by another process.")
+        }
+        cache.removeAllObjects()
+        lastDataVersion = dataVersion
+        lastDatabase = database
+    }
+
+    // MARK: -
+
+    // The caller may mutate the record and should store it if it does.
+    @objc
+    public func checkOutRecord(accountId: String,
+                               deviceId: Int32,
+                               transaction: SDSAnyReadTransaction) -> SessionRecord? {
+        guard grdbTransactionIfCacheable(transaction) != nil else {
+            return nil
+        }
+        let key = cacheKey(accountId: accountId, deviceId: deviceId)
+        guard let record = cache.object(forKey: key) else {
+            return nil
+        }
+        cache.removeObject(forKey: key)
+        return record
+    }
+
+    // The caller must not mutate the record.
+    @objc
+    public func peekRecord(accountId: String,
+                           deviceId: Int32,
+                           transaction: SDSAnyReadTransaction) -> SessionRecord? {
+        guard grdbTransactionIfCacheable(transaction) != nil else {
+            return nil
+        }
+        return cache.object(forKey: cacheKey(accountId: accountId, deviceId: deviceId))
+    }
+
+    @objc
+    public func didStore(record: SessionRecord,
+                         accountId: String,
+                         deviceId: Int32,
+                         transaction: SDSAnyWriteTransaction) {
+        let key = cacheKey(accountId: accountId, deviceId: deviceId)
+        guard let grdbWrite = grdbTransactionIfCacheable(transaction) else {
+            cache.removeObject(forKey: key)
+            return
+        }
+        cache.setObject(record, forKey: key)
+        grdbWrite.addRollbackBlock(forKey: "SSKSessionRecordCache") { [weak self] in
+            self?.removeAll()
+        }
+    }
+
+    @objc
+    public func didRemove(accountId: String, deviceId: Int32) {
+        cache.removeObject(forKey: cacheKey(accountId: accountId, deviceId: deviceId))
+    }
+
+    @objc
+    public func removeAll() {
+        cache.removeAllObjects()
+    }
+
+    @objc
+    func didDetectCrossProcessWrite() {
+        removeAll()
+    }
+}
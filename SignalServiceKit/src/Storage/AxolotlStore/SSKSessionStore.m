@@ -10,9 +10,20 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+// Sessions used to be stored as one dictionary per account (deviceId -> SessionRecord),
+// so every store re-archived and rewrote the sessions for all of the account's devices.
+// They are now stored in one row per device, alongside an index of each account's
+// deviceIds. Legacy dictionaries are migrated lazily, the first time an account's
+// sessions are modified.
 @interface SSKSessionStore ()
 
-@property (nonatomic, readonly) SDSKeyValueStore *keyValueStore;
+// accountId -> NSDictionary<NSNumber *, SessionRecord *>
+@property (nonatomic, readonly) SDSKeyValueStore *legacyKeyValueStore;
+// "accountId.deviceId" -> SessionRecord
+@property (nonatomic, readonly) SDSKeyValueStore *deviceSessionStore;
+// accountId -> NSArray<NSNumber *> of deviceIds
+@property (nonatomic, readonly) SDSKeyValueStore *deviceIdStore;
+@property (nonatomic, readonly) SSKSessionRecordCache *recordCache;
 
 @end
 
@@ -27,7 +38,10 @@ NS_ASSUME_NONNULL_BEGIN
         return self;
     }
 
-    _keyValueStore = [[SDSKeyValueStore alloc] initWithCollection:@"TSStorageManagerSessionStoreCollection"];
+    _legacyKeyValueStore = [[SDSKeyValueStore alloc] initWithCollection:@"TSStorageManagerSessionStoreCollection"];
+    _deviceSessionStore = [[SDSKeyValueStore alloc] initWithCollection:@"SSKSessionStoreDeviceSessionCollection"];
+    _deviceIdStore = [[SDSKeyValueStore alloc] initWithCollection:@"SSKSessionStoreDeviceIdCollection"];
+    _recordCache = SSKSessionRecordCache.shared;
 
     return self;
 }
@@ -37,6 +51,91 @@ NS_ASSUME_NONNULL_BEGIN
     return [OWSAccountIdFinder new];
 }
 
+#pragma mark - Storage
+
+- (NSString *)deviceSessionKeyForAccountId:(NSString *)accountId deviceId:(int)deviceId
+{
+    return [NSString stringWithFormat:@"%@.%d", accountId, deviceId];
+}
+
+- (nullable NSDictionary *)legacySessionsForAccountId:(NSString *)accountId
+                                          transaction:(SDSAnyReadTransaction *)transaction
+{
+    id _Nullable object = [self.legacyKeyValueStore getObject:accountId transaction:transaction];
+    if (object != nil && ![object isKindOfClass:[NSDictionary class]]) {
+        OWSFailDebug(@"Unexpected type: %@ in collection.", [object class]);
+        return nil;
+    }
+    return object;
+}
+
+- (NSArray<NSNumber *> *)deviceIdsForAccountId:(NSString *)accountId transaction:(SDSAnyReadTransaction *)transaction
+{
+    NSArray<NSNumber *> *_Nullable deviceIds = [self.deviceIdStore getObject:accountId transaction:transaction];
+    if (deviceIds != nil) {
+        return deviceIds;
+    }
+    // The account's sessions may not have been migrated yet.
+    NSDictionary *_Nullable legacySessions = [self legacySessionsForAccountId:accountId transaction:transaction];
+    return legacySessions.allKeys ?: @[];
+}
+
+- (nullable SessionRecord *)fetchSessionForAccountId:(NSString *)accountId
+                                            deviceId:(int)deviceId
+                                         transaction:(SDSAnyReadTransaction *)transaction
+{
+    NSString *key = [self deviceSessionKeyForAccountId:accountId deviceId:deviceId];
+    SessionRecord *_Nullable record = [self.deviceSessionStore getObject:key transaction:transaction];
+    if (record != nil) {
+        return record;
+    }
+    // The account's sessions may not have been migrated yet.
+    NSDictionary *_Nullable legacySessions = [self legacySessionsForAccountId:accountId transaction:transaction];
+    return legacySessions[@(deviceId)];
+}
+
+- (void)migrateLegacySessionsIfNecessaryForAccountId:(NSString *)accountId
+                                         transaction:(SDSAnyWriteTransaction *)transaction
+{
+    NSDictionary *_Nullable legacySessions = [self legacySessionsForAccountId:accountId transaction:transaction];
+    if (legacySessions == nil) {
+        return;
+    }
+
+    NSMutableOrderedSet<NSNumber *> *deviceIds = [NSMutableOrderedSet new];
+    [deviceIds addObjectsFromArray:[self.deviceIdStore getObject:accountId transaction:transaction] ?: @[]];
+    for (NSNumber *deviceId in legacySessions) {
+        SessionRecord *record = legacySessions[deviceId];
+        if (![record isKindOfClass:[SessionRecord class]]) {
+            OWSFailDebug(@"Unexpected object in session dict: %@", [record class]);
+            continue;
+        }
+        NSString *key = [self deviceSessionKeyForAccountId:accountId deviceId:deviceId.intValue];
+        [self.deviceSessionStore setObject:record key:key transaction:transaction];
+        [deviceIds addObject:deviceId];
+    }
+    [self.deviceIdStore setObject:deviceIds.array key:accountId transaction:transaction];
+    [self.legacyKeyValueStore removeValueForKey:accountId transaction:transaction];
+}
+
+- (void)writeSession:(SessionRecord *)session
+        forAccountId:(NSString *)accountId
+            deviceId:(int)deviceId
+         transaction:(SDSAnyWriteTransaction *)transaction
+{
+    [self migrateLegacySessionsIfNecessaryForAccountId:accountId transaction:transaction];
+
+    NSString *key = [self deviceSessionKeyForAccountId:accountId deviceId:deviceId];
+    [self.deviceSessionStore setObject:session key:key transaction:transaction];
+
+    NSArray<NSNumber *> *deviceIds = [self.deviceIdStore getObject:accountId transaction:transaction] ?: @[];
+    if (![deviceIds containsObject:@(deviceId)]) {
+        [self.deviceIdStore setObject:[deviceIds arrayByAddingObject:@(deviceId)] key:accountId transaction:transaction];
+    }
+
+    [self.recordCache didStoreWithRecord:session accountId:accountId deviceId:deviceId transaction:transaction];
+}
+
 #pragma mark -
 
 - (SessionRecord *)loadSession:(NSString *)contactIdentifier
@@ -70,12 +169,11 @@ NS_ASSUME_NONNULL_BEGIN
     OWSAssertDebug(deviceId > 0);
     OWSAssertDebug([transaction isKindOfClass:[SDSAnyReadTransaction class]]);
 
-    NSDictionary *_Nullable dictionary = [self.keyValueStore getObject:accountId transaction:transaction];
-
-    SessionRecord *record;
-
-    if (dictionary) {
-        record = [dictionary objectForKey:@(deviceId)];
+    SessionRecord *_Nullable record = [self.recordCache checkOutRecordWithAccountId:accountId
+                                                                           deviceId:deviceId
+                                                                        transaction:transaction];
+    if (record == nil) {
+        record = [self fetchSessionForAccountId:accountId deviceId:deviceId transaction:transaction];
     }
 
     if (record == nil) {
@@ -115,9 +213,7 @@ NS_ASSUME_NONNULL_BEGIN
     // If we are going to start using it I'd want to re-verify it works as intended.
     OWSFailDebug(@"subDevicesSessions is deprecated");
 
-    NSDictionary *_Nullable dictionary = [self.keyValueStore getObject:accountId transaction:transaction];
-
-    return dictionary ? dictionary.allKeys : @[];
+    return [self deviceIdsForAccountId:accountId transaction:transaction];
 }
 #pragma clang diagnostic pop
 
@@ -161,14 +257,7 @@ NS_ASSUME_NONNULL_BEGIN
     // NOTE: this may no longer be necessary now that we have a non-caching session db connection.
     [session markAsUnFresh];
 
-    NSDictionary *immutableDictionary = [self.keyValueStore getObject:accountId transaction:transaction];
-
-    NSMutableDictionary *dictionary
-        = (immutableDictionary ? [immutableDictionary mutableCopy] : [NSMutableDictionary new]);
-
-    [dictionary setObject:session forKey:@(deviceId)];
-
-    [self.keyValueStore setObject:[dictionary copy] key:accountId transaction:transaction];
+    [self writeSession:session forAccountId:accountId deviceId:deviceId transaction:transaction];
 }
 
 - (BOOL)containsSession:(NSString *)contactIdentifier
@@ -201,8 +290,14 @@ NS_ASSUME_NONNULL_BEGIN
     OWSAssertDebug(accountId.length > 0);
     OWSAssertDebug(deviceId >= 0);
 
-    return
-        [self loadSessionForAccountId:accountId deviceId:deviceId transaction:transaction].sessionState.hasSenderChain;
+    // We only inspect the record, so we don't need to check it out of the cache.
+    SessionRecord *_Nullable record = [self.recordCache peekRecordWithAccountId:accountId
+                                                                       deviceId:deviceId
+                                                                    transaction:transaction];
+    if (record == nil) {
+        record = [self fetchSessionForAccountId:accountId deviceId:deviceId transaction:transaction];
+    }
+    return record.sessionState.hasSenderChain;
 }
 
 - (void)deleteSessionForContact:(NSString *)contactIdentifier
@@ -238,14 +333,19 @@ NS_ASSUME_NONNULL_BEGIN
 
     OWSLogInfo(@"deleting session for contact: %@ device: %d", accountId, deviceId);
 
-    NSDictionary *immutableDictionary = [self.keyValueStore getObject:accountId transaction:transaction];
+    [self migrateLegacySessionsIfNecessaryForAccountId:accountId transaction:transaction];
 
-    NSMutableDictionary *dictionary
-        = (immutableDictionary ? [immutableDictionary mutableCopy] : [NSMutableDictionary new]);
+    NSString *key = [self deviceSessionKeyForAccountId:accountId deviceId:deviceId];
+    [self.deviceSessionStore removeValueForKey:key transaction:transaction];
 
-    [dictionary removeObjectForKey:@(deviceId)];
+    NSArray<NSNumber *> *deviceIds = [self.deviceIdStore getObject:accountId transaction:transaction];
+    if ([deviceIds containsObject:@(deviceId)]) {
+        NSMutableArray<NSNumber *> *remainingDeviceIds = [deviceIds mutableCopy];
+        [remainingDeviceIds removeObject:@(deviceId)];
+        [self.deviceIdStore setObject:[remainingDeviceIds copy] key:accountId transaction:transaction];
+    }
 
-    [self.keyValueStore setObject:[dictionary copy] key:accountId transaction:transaction];
+    [self.recordCache didRemoveWithAccountId:accountId deviceId:deviceId];
 }
 
 - (void)deleteAllSessionsForContact:(NSString *)contactIdentifier
@@ -273,7 +373,13 @@ NS_ASSUME_NONNULL_BEGIN
 
     OWSLogInfo(@"deleting all sessions for contact: %@", accountId);
 
-    [self.keyValueStore removeValueForKey:accountId transaction:transaction];
+    for (NSNumber *deviceId in [self deviceIdsForAccountId:accountId transaction:transaction]) {
+        NSString *key = [self deviceSessionKeyForAccountId:accountId deviceId:deviceId.intValue];
+        [self.deviceSessionStore removeValueForKey:key transaction:transaction];
+        [self.recordCache didRemoveWithAccountId:accountId deviceId:deviceId.intValue];
+    }
+    [self.deviceIdStore removeValueForKey:accountId transaction:transaction];
+    [self.legacyKeyValueStore removeValueForKey:accountId transaction:transaction];
 }
 
 - (void)archiveAllSessionsForContact:(NSString *)contactIdentifier
@@ -301,21 +407,23 @@ NS_ASSUME_NONNULL_BEGIN
 
     OWSLogInfo(@"archiving all sessions for contact: %@", accountId);
 
-    __block NSDictionary<NSNumber *, SessionRecord *> *sessionRecords = [self.keyValueStore getObject:accountId
-                                                                                          transaction:transaction];
+    [self migrateLegacySessionsIfNecessaryForAccountId:accountId transaction:transaction];
 
-    for (id deviceId in sessionRecords) {
-        id object = sessionRecords[deviceId];
-        if (![object isKindOfClass:[SessionRecord class]]) {
-            OWSFailDebug(@"Unexpected object in session dict: %@", [object class]);
+    for (NSNumber *deviceId in [self deviceIdsForAccountId:accountId transaction:transaction]) {
+        SessionRecord *_Nullable sessionRecord = [self.recordCache checkOutRecordWithAccountId:accountId
+                                                                                      deviceId:deviceId.intValue
+                                                                                   transaction:transaction];
+        if (sessionRecord == nil) {
+            sessionRecord = [self fetchSessionForAccountId:accountId deviceId:deviceId.intValue transaction:transaction];
+        }
+        if (![sessionRecord isKindOfClass:[SessionRecord class]]) {
+            OWSFailDebug(@"Unexpected object in session collection: %@", [sessionRecord class]);
             continue;
         }
 
-        SessionRecord *sessionRecord = (SessionRecord *)object;
         [sessionRecord archiveCurrentState];
+        [self writeSession:sessionRecord forAccountId:accountId deviceId:deviceId.intValue transaction:transaction];
     }
-
-    [self.keyValueStore setObject:sessionRecords key:accountId transaction:transaction];
 }
 
 #pragma mark - debug
@@ -326,43 +434,39 @@ NS_ASSUME_NONNULL_BEGIN
 
     OWSLogWarn(@"resetting session store");
 
-    [self.keyValueStore removeAllWithTransaction:transaction];
+    [self.legacyKeyValueStore removeAllWithTransaction:transaction];
+    [self.deviceSessionStore removeAllWithTransaction:transaction];
+    [self.deviceIdStore removeAllWithTransaction:transaction];
+    [self.recordCache removeAll];
 }
 
 - (void)printAllSessionsWithTransaction:(SDSAnyReadTransaction *)transaction
 {
     OWSLogDebug(@"All Sessions.");
-    [self.keyValueStore
-        enumerateKeysAndObjectsWithTransaction:transaction
-                                         block:^(NSString *key, id value, BOOL *stop) {
-                                             if (![value isKindOfClass:[NSDictionary class]]) {
-                                                 OWSFailDebug(@"Unexpected type: %@ in collection.", [value class]);
-                                                 return;
-                                             }
-                                             NSDictionary *deviceSessions = (NSDictionary *)value;
-
-                                             OWSLogDebug(@"     Sessions for recipient: %@", key);
-                                             [deviceSessions enumerateKeysAndObjectsUsingBlock:^(id _Nonnull key,
-                                                 id _Nonnull sessionRecordObject,
-                                                 BOOL *_Nonnull stop) {
-                                                 if (![sessionRecordObject isKindOfClass:[SessionRecord class]]) {
-                                                     OWSFailDebug(@"Unexpected type: %@ in collection.",
-                                                         [sessionRecordObject class]);
-                                                     return;
-                                                 }
-                                                 SessionRecord *sessionRecord = (SessionRecord *)sessionRecordObject;
-                                                 SessionState *activeState = [sessionRecord sessionState];
-                                                 NSArray<SessionState *> *previousStates =
-                                                     [sessionRecord previousSessionStates];
-                                                 OWSLogDebug(
-                                                     @"         Device: %@ SessionRecord: %@ activeSessionState: "
-                                                     @"%@ previousSessionStates: %@",
-                                                     key,
-                                                     sessionRecord,
-                                                     activeState,
-                                                     previousStates);
-                                             }];
-                                         }];
+    NSMutableSet<NSString *> *accountIds = [NSMutableSet new];
+    [accountIds addObjectsFromArray:[self.deviceIdStore allKeysWithTransaction:transaction]];
+    [accountIds addObjectsFromArray:[self.legacyKeyValueStore allKeysWithTransaction:transaction]];
+
+    for (NSString *accountId in accountIds) {
+        OWSLogDebug(@"     Sessions for recipient: %@", accountId);
+        for (NSNumber *deviceId in [self deviceIdsForAccountId:accountId transaction:transaction]) {
+            SessionRecord *_Nullable sessionRecord = [self fetchSessionForAccountId:accountId
+                                                                           deviceId:deviceId.intValue
+                                                                        transaction:transaction];
+            if (![sessionRecord isKindOfClass:[SessionRecord class]]) {
+                OWSFailDebug(@"Unexpected type: %@ in collection.", [sessionRecord class]);
+                continue;
+            }
+            SessionState *activeState = [sessionRecord sessionState];
+            NSArray<SessionState *> *previousStates = [sessionRecord previousSessionStates];
+            OWSLogDebug(@"         Device: %@ SessionRecord: %@ activeSessionState: "
+                        @"%@ previousSessionStates: %@",
+                deviceId,
+                sessionRecord,
+                activeState,
+                previousStates);
+        }
+    }
 }
 
 @end
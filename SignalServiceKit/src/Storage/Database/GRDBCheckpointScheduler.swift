@@ -0,0 +1,227 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+import GRDB
+
+// Keeps the WAL and database file from growing without bound.
+//
+// * Once writes have been idle for a short while, we run a passive
+//   checkpoint on a background queue. Passive checkpoints never block
+//   readers or writers.
+// * Passive checkpoints can't reset the WAL while the UI database
+//   snapshot holds its long-running read transaction. When the WAL
+//   grows past a threshold we escalate to a truncating checkpoint.
+//   UIDatabaseObserver truncates between closing the snapshot's read
+//   transaction and reopening it, as it fast-forwards the snapshot.
+// * When free pages pile up (e.g. after large deletions) we run a
+//   bounded incremental vacuum.
+class GRDBCheckpointScheduler {
+
+    // Writes must be idle for this long before we checkpoint.
+    static let idleInterval: TimeInterval = 1.0
+
+    static let truncateThresholdBytes: UInt64 = 4 * 1024 * 1024
+
+    // Only vacuum when at least this many pages are free and
+    // they make up at least this fraction of the database.
+    static let vacuumMinFreePages: Int = 1024
+    static let vacuumMinFreePageRatio: Double = 0.2
+    // Bound the length of each vacuum's write transaction.
+    static let vacuumMaxPagesPerPass: Int = 2048
+
+    private let pool: DatabasePool
+    private let walFilePath: String
+
+    private let serialQueue = DispatchQueue(label: "org.signal.checkpoint-scheduler", qos: .utility)
+
+    // Should only be accessed on serialQueue.
+    private var lastWriteTime: TimeInterval = 0
+    private var isIdleCheckpointScheduled = false
+    private var metrics = Metrics()
+    private var hasLoggedVacuumUnavailable = false
+
+    private let needsTruncatingCheckpoint = AtomicBool(false)
+
+    init(pool: DatabasePool, walFilePath: String) {
+        self.pool = pool
+        self.walFilePath = walFilePath
+    }
+
+    // MARK: - Scheduling
+
+    func didCommitWrite() {
+        serialQueue.async {
+            self.lastWriteTime = CACurrentMediaTime()
+            guard !self.isIdleCheckpointScheduled else {
+                return
+            }
+            self.isIdleCheckpointScheduled = true
+            self.scheduleIdleCheckpoint(after: GRDBCheckpointScheduler.idleInterval)
+        }
+    }
+
+    private func scheduleIdleCheckpoint(after delay: TimeInterval) {
+        serialQueue.asyncAfter(deadline: .now() + delay) {
+            let idleTime = CACurrentMediaTime() - self.lastWriteTime
+            guard idleTime >= GRDBCheckpointScheduler.idleInterval else {
+                // Writes are ongoing; wait until they go idle.
+                self.scheduleIdleCheckpoint(after: GRDBCheckpointScheduler.idleInterval - idleTime)
+                return
+            }
+            self.isIdleCheckpointScheduled = false
+            self.performIdleMaintenance()
+        }
+    }
+
+    // Set by GRDBDatabaseStorageAdapter while it has a UIDatabaseObserver.
+    let hasUIDatabaseSnapshot = AtomicBool(false)
+
+    private func performIdleMaintenance() {
+        do {
+            try checkpoint(mode: .passive)
+        } catch {
+            owsFailDebug("Error: \(error)")
+        }
+
+        if walFileSize > GRDBCheckpointScheduler.truncateThresholdBytes {
+            if hasUIDatabaseSnapshot.get() {
+                // The UI snapshot's read transaction would block a truncating
+                // checkpoint; defer to UIDatabaseObserver.
+                needsTruncatingCheckpoint.set(true)
+            } else {
+                do {
+                    try checkpoint(mode: .truncate)
+                } catch {
+                    owsFailDebug("Error: \(error)")
+                }
+            }
+        }
+
+        do {
+            try incrementalVacuumIfNecessary()
+        } catch {
+            owsFailDebug("Error: \(error)")
+        }
+    }
+
+    // MARK: - Snapshot Window
+
+    // Called by UIDatabaseObserver on the main thread each time it
+    // fast-forwards its snapshot. If this returns true, the observer
+    // calls truncate() after closing its read transaction, the only
+    // long-lived one using the WAL, and before opening the next one.
+    func takeTruncatingCheckpointRequest() -> Bool {
+        do {
+            try needsTruncatingCheckpoint.transition(from: true, to: false)
+            return true
+        } catch {
+            // No truncation needed.
+            return false
+        }
+    }
+
+    func truncate() {
+        AssertIsOnMainThread()
+
+        do {
+            try checkpoint(mode: .truncate)
+        } catch {
+            owsFailDebug("Error: \(error)")
+        }
+    }
+
+    // MARK: - Checkpoints
+
+    private var walFileSize: UInt64 {
+        guard let fileSize = OWSFileSystem.fileSize(ofPath: walFilePath) else {
+            // The WAL doesn't always exist.
+            return 0
+        }
+        return fileSize.uint64Value
+    }
+
+    private func checkpoint(mode: Database.CheckpointMode) throws {
+        let walFileSizeBefore = walFileSize
+        let startTime = CACurrentMediaTime()
+        let result = try GRDBDatabaseStorageAdapter.checkpoint(pool: pool, mode: mode)
+        let duration = CACurrentMediaTime() - startTime
+
+        if mode == .passive {
+            Logger.verbose("walSizePages: \(result.walSizePages), pagesCheckpointed: \(result.pagesCheckpointed), duration: \(duration)")
+        } else {
+            Logger.info("mode: \(mode), walFileSize: \(walFileSizeBefore) -> \(walFileSize), duration: \(duration)")
+        }
+
+        serialQueue.async {
+            self.metrics.record(mode: mode, duration: duration, walFileSize: walFileSizeBefore)
+            if mode != .passive {
+                Logger.info("\(self.metrics)")
+            }
+        }
+    }
+
+    // MARK: - Vacuum
+
+    private func incrementalVacuumIfNecessary() throws {
+        let (autoVacuum, freePageCount, pageCount) = try pool.read { db in
+            return (try Int.fetchOne(db, sql: "PRAGMA auto_vacuum") ?? 0,
+                    try Int.fetchOne(db, sql: "PRAGMA freelist_count") ?? 0,
+                    try Int.fetchOne(db, sql: "PRAGMA page_count") ?? 0)
+        }
+
+        guard freePageCount >= GRDBCheckpointScheduler.vacuumMinFreePages,
+            Double(freePageCount) >= Double(pageCount) * GRDBCheckpointScheduler.vacuumMinFreePageRatio else {
+                return
+        }
+
+        // Databases created before we enabled incremental auto-vacuum
+        // would need a full VACUUM, which is too expensive to run here.
+        let kAutoVacuumIncremental = 2
+        guard autoVacuum == kAutoVacuumIncremental else {
+            if !hasLoggedVacuumUnavailable {
+                hasLoggedVacuumUnavailable = true
+                Logger.info("Skipping vacuum; auto_vacuum: \(autoVacuum), freePageCount: \(freePageCount), pageCount: \(pageCount).")
+            }
+            return
+        }
+
+        let pagesToVacuum = min(freePageCount, GRDBCheckpointScheduler.vacuumMaxPagesPerPass)
+        try Bench(title: "Incremental vacuum: \(pagesToVacuum) pages", logIfLongerThan: 0.01, logInProduction: true) {
+            try pool.writeWithoutTransaction { db in
+                try db.execute(sql: "PRAGMA incremental_vacuum(\(pagesToVacuum))")
+            }
+        }
+        Logger.info("Vacuumed \(pagesToVacuum) of \(freePageCount) free pages.")
+    }
+}
+
+// MARK: - Metrics
+
+extension GRDBCheckpointScheduler {
+    struct Metrics: CustomStringConvertible {
+        private(set) var passiveCount: UInt = 0
+        private(set) var truncateCount: UInt = 0
+        private(set) var totalDuration: TimeInterval = 0
+        private(set) var maxDuration: TimeInterval = 0
+        private(set) var maxWalFileSize: UInt64 = 0
+
+        mutating func record(mode: Database.CheckpointMode, duration: TimeInterval, walFileSize: UInt64) {
+            if mode == .passive {
+                passiveCount += 1
+            } else {
+                truncateCount += 1
+            }
+            totalDuration += duration
+            maxDuration = max(maxDuration, duration)
+            maxWalFileSize = max(maxWalFileSize, walFileSize)
+        }
+
+        var description: String {
+            let checkpointCount = passiveCount + truncateCount
+            let averageDuration = checkpointCount > 0 ? totalDuration / Double(checkpointCount) : 0
+            return "checkpoints passive: \(passiveCount), truncate: \(truncateCount), average duration: \(averageDuration), max duration: \(maxDuration), max WAL file size: \(maxWalFileSize)"
+        }
+    }
+}
@@ -38,12 +38,16 @@ public class GRDBDatabaseStorageAdapter: NSObject {
         return storage.pool
     }
 
+    let checkpointScheduler: GRDBCheckpointScheduler
+
     init(baseDir: URL) throws {
         databaseUrl = GRDBDatabaseStorageAdapter.databaseFileUrl(baseDir: baseDir)
 
         try GRDBDatabaseStorageAdapter.ensureDatabaseKeySpecExists(baseDir: baseDir)
 
         storage = try GRDBStorage(dbURL: databaseUrl, keyspec: GRDBDatabaseStorageAdapter.keyspec)
+        checkpointScheduler = GRDBCheckpointScheduler(pool: storage.pool,
+                                                      walFilePath: databaseUrl.path + "-wal")
 
         super.init()
 
@@ -119,7 +123,7 @@ public class GRDBDatabaseStorageAdapter: NSObject {
         // UIDatabaseObserver is a general purpose observer, whose delegates
         // are notified when things change, but are not given any specific details
         // about the changes.
-        let uiDatabaseObserver = try UIDatabaseObserver(pool: pool)
+        let uiDatabaseObserver = try UIDatabaseObserver(pool: pool, checkpointScheduler: checkpointScheduler)
         self.uiDatabaseObserver = uiDatabaseObserver
 
         // ConversationListDatabaseObserver is built on top of UIDatabaseObserver
@@ -151,6 +155,8 @@ public class GRDBDatabaseStorageAdapter: NSObject {
             db.add(transactionObserver: uiDatabaseObserver, extent: Database.TransactionObservationExtent.observerLifetime)
         }
 
+        checkpointScheduler.hasUIDatabaseSnapshot.set(true)
+
         SDSDatabaseStorage.shared.observation.set(grdbStorage: self)
     }
 
@@ -163,6 +169,7 @@ public class GRDBDatabaseStorageAdapter: NSObject {
         self.conversationViewDatabaseObserver = nil
         self.mediaGalleryDatabaseObserver = nil
         self.genericDatabaseObserver = nil
+        checkpointScheduler.hasUIDatabaseSnapshot.set(false)
     }
 
     func setup() throws {
@@ -347,12 +354,19 @@ extension GRDBDatabaseStorageAdapter: SDSDatabaseStorageAdapter {
         }
 
         var transaction: GRDBWriteTransaction!
-        try pool.write { database in
-            autoreleasepool {
-                transaction = GRDBWriteTransaction(database: database)
-                block(transaction)
+        do {
+            try pool.write { database in
+                autoreleasepool {
+                    transaction = GRDBWriteTransaction(database: database)
+                    block(transaction)
+                }
             }
+        } catch {
+            // The whole transaction was rolled back.
+            transaction?.didRollBack()
+            throw error
         }
+        checkpointScheduler.didCommitWrite()
         for (queue, block) in transaction.completions {
             queue.async(execute: block)
         }
@@ -415,7 +429,7 @@ private struct GRDBStorage {
             }
         }
         configuration.label = "Modern (GRDB) Storage"      // Useful when your app opens multiple databases
-        configuration.maximumReaderCount = 10   // The default is 5
+        configuration.maximumReaderCount = SDSReadPool.maxReaderCount   // The default is 5
         configuration.busyMode = .callback({ (retryCount: Int) -> Bool in
             // sleep N milliseconds
             let millis = 25
@@ -446,6 +460,12 @@ private struct GRDBStorage {
         pool = try DatabasePool(path: dbURL.path, configuration: configuration)
         Logger.debug("dbURL: \(dbURL)")
 
+        // Only takes effect for new databases, before any tables are created.
+        // This lets GRDBCheckpointScheduler reclaim free pages incrementally.
+        try pool.writeWithoutTransaction { db in
+            try db.execute(sql: "PRAGMA auto_vacuum = INCREMENTAL")
+        }
+
         OWSFileSystem.protectFileOrFolder(atPath: dbURL.path)
     }
 }
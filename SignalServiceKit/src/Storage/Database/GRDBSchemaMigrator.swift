@@ -51,6 +51,7 @@ public class GRDBSchemaMigrator: NSObject {
         case dedupeSignalRecipients
         case indexMediaGallery2
         case unreadThreadInteractions
+        case createPendingOutgoingReceipts
         // NOTE: Every time we add a migration id, consider
         // incrementing grdbSchemaVersionLatest.
         // We only need to do this for breaking changes.
@@ -229,6 +230,23 @@ public class GRDBSchemaMigrator: NSObject {
                           unique: true)
         }
 
+        migrator.registerMigration(MigrationId.createPendingOutgoingReceipts.rawValue) { db in
+            try db.create(table: "pending_outgoing_receipts") { table in
+                table.autoIncrementedPrimaryKey("id")
+                    .notNull()
+                table.column("recipientIdentifier", .text)
+                    .notNull()
+                table.column("receiptType", .integer)
+                    .notNull()
+                table.column("timestamp", .integer)
+                    .notNull()
+            }
+            try db.create(index: "index_pending_outgoing_receipts_on_recipientIdentifier_and_receiptType_and_timestamp",
+                          on: "pending_outgoing_receipts",
+                          columns: ["recipientIdentifier", "receiptType", "timestamp"],
+                          unique: true)
+        }
+
         return migrator
     }()
 }
@@ -980,7 +980,7 @@ struct GRDBInteractionFinderAdapter: InteractionFinderAdapter {
             SELECT *
             FROM \(InteractionRecord.databaseTableName)
             WHERE \(interactionColumn: .threadUniqueId) = ?
-            AND \(sqlClauseForAllUnreadInteractions)
+            AND \(GRDBInteractionFinderAdapter.sqlClauseForAllUnreadInteractions)
         """
         let arguments: StatementArguments = [threadUniqueId]
         let cursor = TSInteraction.grdbFetchCursor(sql: sql, arguments: arguments, transaction: transaction)
@@ -1001,7 +1001,7 @@ struct GRDBInteractionFinderAdapter: InteractionFinderAdapter {
         SELECT *
         FROM \(InteractionRecord.databaseTableName)
         WHERE \(interactionColumn: .threadUniqueId) = ?
-        AND \(sqlClauseForAllUnreadInteractions)
+        AND \(GRDBInteractionFinderAdapter.sqlClauseForAllUnreadInteractions)
         ORDER BY \(interactionColumn: .id)
         """
         let cursor = TSInteraction.grdbFetchCursor(sql: sql, arguments: [threadUniqueId], transaction: transaction)
@@ -1081,7 +1081,7 @@ struct GRDBInteractionFinderAdapter: InteractionFinderAdapter {
 
     // MARK: - Unseen & Unread
 
-    private let sqlClauseForAllUnreadInteractions: String = {
+    static let sqlClauseForAllUnreadInteractions: String = {
         // The nomenclature we've inherited from our YDB database views is confusing.
         //
         // * "Unseen" refers to "all unread interactions".
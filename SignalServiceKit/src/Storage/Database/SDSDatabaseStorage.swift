@@ -29,6 +29,12 @@ public class SDSDatabaseStorage: SDSTransactable {
 
     let observation = SDSDatabaseStorageObservation()
 
+    private let writeMetrics = SDSWriteMetrics()
+
+    private let readPool = SDSReadPool(configuration: .default)
+
+    private lazy var writeCoalescer = SDSWriteCoalescer(databaseStorage: self)
+
     // MARK: - Initialization / Setup
 
     @objc
@@ -80,6 +86,10 @@ public class SDSDatabaseStorage: SDSTransactable {
         }
         // Cross process writes
         crossProcess.callback = { [weak self] in
+            // In-memory caches of database state must be invalidated
+            // right away, not when the app next becomes active.
+            NotificationCenter.default.post(name: SDSDatabaseStorage.didDetectCrossProcessWriteNotification, object: nil)
+
             DispatchQueue.main.async {
                 self?.handleCrossProcessWrite()
             }
@@ -236,16 +246,10 @@ public class SDSDatabaseStorage: SDSTransactable {
                     return
                 }
 
-                if let conversationViewDatabaseObserver = grdbStorage.conversationViewDatabaseObserver {
-                    conversationViewDatabaseObserver.didTouch(interaction: interaction, transaction: grdb)
+                if let uiDatabaseObserver = grdbStorage.uiDatabaseObserver {
+                    uiDatabaseObserver.didTouch(interaction: interaction, transaction: grdb)
                 } else if AppReadiness.isAppReady() {
-                    owsFailDebug("conversationViewDatabaseObserver was unexpectedly nil")
-                }
-                if let genericDatabaseObserver = grdbStorage.genericDatabaseObserver {
-                    genericDatabaseObserver.didTouch(interaction: interaction,
-                                                     transaction: grdb)
-                } else if AppReadiness.isAppReady() {
-                    owsFailDebug("genericDatabaseObserver was unexpectedly nil")
+                    owsFailDebug("uiDatabaseObserver was unexpectedly nil")
                 }
                 GRDBFullTextSearchFinder.modelWasUpdated(model: interaction, transaction: grdb)
             }
@@ -263,20 +267,10 @@ public class SDSDatabaseStorage: SDSTransactable {
                     return
                 }
 
-                if let conversationListDatabaseObserver = grdbStorage.conversationListDatabaseObserver {
-                    conversationListDatabaseObserver.didTouch(thread: thread, transaction: grdb)
+                if let uiDatabaseObserver = grdbStorage.uiDatabaseObserver {
+                    uiDatabaseObserver.didTouch(thread: thread, transaction: grdb)
                 } else if AppReadiness.isAppReady() {
-                    owsFailDebug("conversationListDatabaseObserver was unexpectedly nil")
-                }
-                if let conversationViewDatabaseObserver = grdbStorage.conversationViewDatabaseObserver {
-                    conversationViewDatabaseObserver.didTouch(thread: thread, transaction: grdb)
-                } else if AppReadiness.isAppReady() {
-                    owsFailDebug("conversationViewDatabaseObserver was unexpectedly nil")
-                }
-                if let genericDatabaseObserver = grdbStorage.genericDatabaseObserver {
-                    genericDatabaseObserver.didTouchThread(transaction: grdb)
-                } else if AppReadiness.isAppReady() {
-                    owsFailDebug("genericDatabaseObserver was unexpectedly nil")
+                    owsFailDebug("uiDatabaseObserver was unexpectedly nil")
                 }
                 GRDBFullTextSearchFinder.modelWasUpdated(model: thread, transaction: grdb)
             }
@@ -317,6 +311,12 @@ public class SDSDatabaseStorage: SDSTransactable {
     @objc
     public static let didReceiveCrossProcessNotification = Notification.Name("didReceiveCrossProcessNotification")
 
+    // Unlike didReceiveCrossProcessNotification, this is posted
+    // synchronously on the main thread as soon as a write by another
+    // process is detected, even if the app is inactive.
+    @objc
+    public static let didDetectCrossProcessWriteNotification = Notification.Name("didDetectCrossProcessWriteNotification")
+
     private func postCrossProcessNotification() {
         Logger.info("")
 
@@ -362,30 +362,82 @@ public class SDSDatabaseStorage: SDSTransactable {
 
     @objc
     public override func read(block: @escaping (SDSAnyReadTransaction) -> Void) {
-        switch dataStoreForReads {
-        case .grdb:
-            do {
-                try grdbStorage.read { transaction in
+        readPool.userInitiatedRead { didStart in
+            switch dataStoreForReads {
+            case .grdb:
+                do {
+                    try grdbStorage.read { transaction in
+                        didStart()
+                        block(transaction.asAnyRead)
+                    }
+                } catch {
+                    owsFail("error: \(error.grdbErrorForLogging)")
+                }
+            case .ydb:
+                yapStorage.read { transaction in
+                    didStart()
                     block(transaction.asAnyRead)
                 }
-            } catch {
-                owsFail("error: \(error.grdbErrorForLogging)")
             }
-        case .ydb:
-            yapStorage.read { transaction in
-                block(transaction.asAnyRead)
+        }
+    }
+
+    // Long scans should use .background so that they never delay
+    // reads the user is waiting on. See SDSReadPool.
+    @objc
+    public func read(priority: SDSReadPriority, block: @escaping (SDSAnyReadTransaction) -> Void) {
+        guard priority == .background else {
+            read(block: block)
+            return
+        }
+
+        readPool.backgroundRead { didStart in
+            switch dataStoreForReads {
+            case .grdb:
+                do {
+                    try grdbStorage.read { transaction in
+                        didStart()
+                        block(transaction.asAnyRead)
+                    }
+                } catch {
+                    owsFail("error: \(error.grdbErrorForLogging)")
+                }
+            case .ydb:
+                let connection = readPool.checkoutYdbConnection(storage: yapPrimaryStorage)
+                defer {
+                    readPool.checkinYdbConnection(connection)
+                }
+                connection.read { transaction in
+                    didStart()
+                    block(transaction.asAnyRead)
+                }
             }
         }
     }
 
+    public func asyncRead(priority: SDSReadPriority,
+                          block: @escaping (SDSAnyReadTransaction) -> Void,
+                          completion: @escaping () -> Void) {
+        DispatchQueue.global().async {
+            self.read(priority: priority, block: block)
+
+            DispatchQueue.main.async(execute: completion)
+        }
+    }
+
     @objc
     public override func write(block: @escaping (SDSAnyWriteTransaction) -> Void) {
+        write(coalescedWriteCount: 1, block: block)
+    }
+
+    func write(coalescedWriteCount: Int, block: @escaping (SDSAnyWriteTransaction) -> Void) {
         if OWSIsDebugBuild() &&
             Thread.isMainThread &&
             AppReadiness.isAppReady() {
             Logger.verbose("Database write on main thread.")
         }
 
+        let startTime = CACurrentMediaTime()
         switch dataStoreForWrites {
         case .grdb:
             do {
@@ -404,9 +456,50 @@ public class SDSDatabaseStorage: SDSTransactable {
                 }
             }
         }
+        writeMetrics.record(latency: CACurrentMediaTime() - startTime, writeCount: coalescedWriteCount)
         crossProcess.notifyChangedAsync()
     }
 
+    // MARK: - Coalesced Writes
+
+    // Performs the write asynchronously, possibly in the same transaction
+    // as other coalesced writes submitted at around the same time. Use
+    // this for small, latency-tolerant, fire-and-forget writes on hot
+    // paths, e.g. receipts, typing indicators and touches.
+    //
+    // Each write can wait out the coalescing window before it runs, so
+    // don't use this for writes that gate further work, such as claiming
+    // the next job, or that must be durable before an operation finishes.
+    //
+    // If `block` throws, its database changes are rolled back without
+    // affecting the other writes in the transaction, and the error is
+    // passed to `completion`.
+    public func asyncCoalescedWrite(block: @escaping (SDSAnyWriteTransaction) throws -> Void,
+                                    completionQueue: DispatchQueue = .main,
+                                    completion: @escaping (Error?) -> Void) {
+        writeCoalescer.enqueue(block: block, completionQueue: completionQueue, completion: completion)
+    }
+
+    @objc
+    public func asyncCoalescedWrite(block: @escaping (SDSAnyWriteTransaction) -> Void) {
+        writeCoalescer.enqueue(block: block, completionQueue: .global()) { _ in }
+    }
+
+    @objc
+    public func asyncCoalescedWrite(block: @escaping (SDSAnyWriteTransaction) -> Void,
+                                    completion: @escaping () -> Void) {
+        asyncCoalescedWrite(block: block, completionQueue: .main, completion: completion)
+    }
+
+    @objc
+    public func asyncCoalescedWrite(block: @escaping (SDSAnyWriteTransaction) -> Void,
+                                    completionQueue: DispatchQueue,
+                                    completion: @escaping () -> Void) {
+        writeCoalescer.enqueue(block: block, completionQueue: completionQueue) { _ in
+            completion()
+        }
+    }
+
     public func uiReadThrows(block: @escaping (SDSAnyReadTransaction) throws -> Void) throws {
         switch dataStoreForReads {
         case .grdb:
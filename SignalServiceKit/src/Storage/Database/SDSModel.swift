@@ -83,6 +83,8 @@ public extension SDSModel {
                 WHERE uniqueId == ?
             """
             grdbTransaction.executeWithCachedStatement(sql: sql, arguments: [uniqueId])
+
+            SDSDatabaseStorage.shared.grdbStorage.uiDatabaseObserver?.didRemove(model: self)
         }
 
         anyDidRemove(with: transaction)
@@ -0,0 +1,199 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+
+@objc
+public enum SDSReadPriority: Int {
+    // Reads that a user is waiting on, e.g. loading a page of messages.
+    case userInitiated
+    // Long scans that nobody is waiting on, e.g. orphan data cleanup
+    // or backup export.
+    case background
+}
+
+// MARK: -
+
+// Gates reads by priority class so that long background scans can't
+// exhaust the database's read connections and delay UI work.
+//
+// * GRDB: background reads may only occupy a fraction of the
+//   DatabasePool's readers; the rest are left for user-initiated reads.
+// * YDB: all reads used to share a single read connection. Background
+//   reads now check out one of a handful of dedicated connections so
+//   that they don't serialize with user-initiated reads.
+//
+// User-initiated reads are never gated, but for both classes we
+// aggregate how long each read waited before its block started, so
+// that the periodic report shows whether background scans are
+// delaying the reads the user is waiting on.
+class SDSReadPool {
+
+    // Should match GRDB's Configuration.maximumReaderCount.
+    static let maxReaderCount = 10
+
+    struct Configuration {
+        // At least one reader is always left for user-initiated reads.
+        var maxConcurrentBackgroundReads: Int
+        // Waits longer than this are counted as slow in the periodic report.
+        var slowWaitThreshold: TimeInterval
+
+        static let `default` = Configuration(maxConcurrentBackgroundReads: 3, slowWaitThreshold: 0.05)
+    }
+
+    let configuration: Configuration
+
+    private let backgroundSemaphore: DispatchSemaphore
+
+    private let serialQueue = DispatchQueue(label: "org.signal.read-pool")
+
+    // Should only be accessed on serialQueue.
+    private var idleYdbConnections = [YapDatabaseConnection]()
+
+    // Should only be accessed while synchronized on self.
+    private var metrics = Metrics()
+
+    init(configuration: Configuration = .default) {
+        var configuration = configuration
+        if configuration.maxConcurrentBackgroundReads < 1
+            || configuration.maxConcurrentBackgroundReads >= SDSReadPool.maxReaderCount {
+            owsFailDebug("Invalid maxConcurrentBackgroundReads: \(configuration.maxConcurrentBackgroundReads)")
+            configuration.maxConcurrentBackgroundReads = Configuration.default.maxConcurrentBackgroundReads
+        }
+        self.configuration = configuration
+        self.backgroundSemaphore = DispatchSemaphore(value: configuration.maxConcurrentBackgroundReads)
+    }
+
+    // MARK: - Gating
+
+    // The number of background read slots held by the current thread.
+    // A background read nested in another one already holds a slot, so
+    // it mustn't wait on the semaphore: with every slot taken by outer
+    // reads, it would never be signaled.
+    private static let heldSlotCountKey: String = "SDSReadPool.heldSlotCountKey"
+    private static var heldSlotCount: UInt {
+        get {
+            return Thread.current.threadDictionary[heldSlotCountKey] as? UInt ?? 0
+        }
+        set {
+            Thread.current.threadDictionary[heldSlotCountKey] = newValue
+        }
+    }
+
+    // User-initiated reads aren't gated; we only sample their wait.
+    func userInitiatedRead(performRead: (_ didStart: @escaping () -> Void) -> Void) {
+        guard SDSReadPool.heldSlotCount == 0 else {
+            // Nested in a background read.
+            performRead({})
+            return
+        }
+
+        let startTime = CACurrentMediaTime()
+        performRead({
+            self.record(waitTime: CACurrentMediaTime() - startTime, priority: .userInitiated)
+        })
+    }
+
+    func backgroundRead(performRead: (_ didStart: @escaping () -> Void) -> Void) {
+        guard SDSReadPool.heldSlotCount == 0 else {
+            SDSReadPool.heldSlotCount += 1
+            defer {
+                SDSReadPool.heldSlotCount -= 1
+            }
+            performRead({})
+            return
+        }
+
+        let startTime = CACurrentMediaTime()
+        let didStart = {
+            self.record(waitTime: CACurrentMediaTime() - startTime, priority: .background)
+        }
+
+        backgroundSemaphore.wait()
+        SDSReadPool.heldSlotCount += 1
+        defer {
+            SDSReadPool.heldSlotCount -= 1
+            backgroundSemaphore.signal()
+        }
+        performRead(didStart)
+    }
+
+    // MARK: - YDB Connections
+
+    func checkoutYdbConnection(storage: OWSPrimaryStorage) -> YapDatabaseConnection {
+        return serialQueue.sync {
+            if let connection = idleYdbConnections.popLast() {
+                return connection
+            }
+            return storage.newDatabaseConnection()
+        }
+    }
+
+    func checkinYdbConnection(_ connection: YapDatabaseConnection) {
+        serialQueue.async {
+            self.idleYdbConnections.append(connection)
+        }
+    }
+
+    // MARK: - Metrics
+
+    private func record(waitTime: TimeInterval, priority: SDSReadPriority) {
+        let isSlow = waitTime > configuration.slowWaitThreshold
+
+        objc_sync_enter(self)
+        switch priority {
+        case .userInitiated:
+            metrics.userInitiated.record(waitTime: waitTime, isSlow: isSlow)
+        case .background:
+            metrics.background.record(waitTime: waitTime, isSlow: isSlow)
+        }
+        guard metrics.shouldReport else {
+            objc_sync_exit(self)
+            return
+        }
+        let report = metrics
+        metrics = Metrics()
+        objc_sync_exit(self)
+
+        Logger.info("Read wait: \(report)")
+    }
+
+    private struct Metrics: CustomStringConvertible {
+        static let reportingInterval: TimeInterval = 60
+
+        struct ClassMetrics: CustomStringConvertible {
+            private(set) var readCount: UInt = 0
+            private(set) var slowReadCount: UInt = 0
+            private(set) var totalWaitTime: TimeInterval = 0
+            private(set) var maxWaitTime: TimeInterval = 0
+
+            mutating func record(waitTime: TimeInterval, isSlow: Bool) {
+                readCount += 1
+                if isSlow {
+                    slowReadCount += 1
+                }
+                totalWaitTime += waitTime
+                maxWaitTime = max(maxWaitTime, waitTime)
+            }
+
+            var description: String {
+                let averageWaitMs = 1000 * totalWaitTime / Double(max(1, readCount))
+                return String(format: "reads: %lu, slow: %lu, average wait: %.1fms, max wait: %.1fms",
+                              readCount, slowReadCount, averageWaitMs, 1000 * maxWaitTime)
+            }
+        }
+
+        let windowStartTime = CACurrentMediaTime()
+        var userInitiated = ClassMetrics()
+        var background = ClassMetrics()
+
+        var shouldReport: Bool {
+            return CACurrentMediaTime() - windowStartTime >= Metrics.reportingInterval
+        }
+
+        var description: String {
+            return "user-initiated: [\(userInitiated)], background: [\(background)]"
+        }
+    }
+}
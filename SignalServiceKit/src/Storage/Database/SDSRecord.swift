@@ -21,6 +21,10 @@ public enum SDSSaveMode {
 
 public extension SDSRecord {
 
+    private var uiDatabaseObserver: UIDatabaseObserver? {
+        return SDSDatabaseStorage.shared.grdbStorage.uiDatabaseObserver
+    }
+
     private var uniqueIdColumnName: String {
         return "uniqueId"
     }
@@ -48,12 +52,18 @@ public extension SDSRecord {
                 var recordCopy = self
                 recordCopy.id = grdbId
                 try recordCopy.update(transaction.database)
+
+                uiDatabaseObserver?.didSave(record: self, rowId: grdbId, saveMode: .update)
             } else {
                 if saveMode == .update {
                     owsFailDebug("Could not update missing record.")
                 }
 
                 try self.insert(transaction.database)
+
+                uiDatabaseObserver?.didSave(record: self,
+                                            rowId: transaction.database.lastInsertedRowID,
+                                            saveMode: .insert)
             }
         } catch {
             owsFail("Write failed: \(error.grdbErrorForLogging)")
@@ -85,7 +95,9 @@ fileprivate extension SDSRecord {
         do {
             let tableName = tableMetadata.tableName
             let sql = "SELECT id FROM \(tableName.quotedDatabaseIdentifier) WHERE \(uniqueIdColumnName.quotedDatabaseIdentifier)=?"
-            guard let value = try Int64.fetchOne(transaction.database, sql: sql, arguments: [uniqueIdColumnValue]) else {
+            // This lookup precedes every save, so reuse a prepared statement.
+            let statement = try transaction.database.cachedSelectStatement(sql: sql)
+            guard let value = try Int64.fetchOne(statement, arguments: [uniqueIdColumnValue]) else {
                 return nil
             }
             return value
@@ -36,6 +36,24 @@ public class GRDBWriteTransaction: GRDBReadTransaction {
     public func addCompletion(queue: DispatchQueue, block: @escaping () -> Void) {
         completions.append((queue, block))
     }
+
+    // In-memory caches that are written through during the transaction
+    // register here so that they can discard their changes if the
+    // transaction, or part of it (e.g. a failed coalesced write), is
+    // rolled back.
+    private var rollbackBlocks: [String: () -> Void] = [:]
+
+    public func addRollbackBlock(forKey key: String, block: @escaping () -> Void) {
+        rollbackBlocks[key] = block
+    }
+
+    func didRollBack() {
+        let blocks = rollbackBlocks.values
+        rollbackBlocks = [:]
+        for block in blocks {
+            block()
+        }
+    }
 }
 
 // MARK: -
@@ -0,0 +1,196 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+import GRDB
+
+// Many hot paths perform tiny writes, each of which pays for its own
+// WAL commit and cross-process notification. SDSWriteCoalescer batches
+// writes submitted within a short window into a single transaction
+// ("group commit").
+//
+// Each write runs within its own savepoint, so a write that throws
+// only rolls back its own database changes and only its own completion
+// sees the error. Note that in-memory side effects of a failed write
+// (e.g. model caches) are not rolled back.
+class SDSWriteCoalescer {
+
+    typealias WriteBlock = (SDSAnyWriteTransaction) throws -> Void
+    typealias Completion = (Error?) -> Void
+
+    // Writes submitted within this window are committed together.
+    static let coalescingWindow: TimeInterval = 0.01
+
+    // Bound the length of group transactions.
+    static let maxWritesPerTransaction = 64
+
+    private struct PendingWrite {
+        let block: WriteBlock
+        let completionQueue: DispatchQueue
+        let completion: Completion
+    }
+
+    private weak var databaseStorage: SDSDatabaseStorage?
+
+    // Guards pendingWrites and isFlushScheduled.
+    private let serialQueue = DispatchQueue(label: "org.signal.write-coalescer")
+    // Flushes are performed one at a time, so new writes accrue while
+    // the previous group is committing.
+    private let flushQueue = DispatchQueue(label: "org.signal.write-coalescer.flush")
+
+    private var pendingWrites = [PendingWrite]()
+    private var isFlushScheduled = false
+
+    init(databaseStorage: SDSDatabaseStorage) {
+        self.databaseStorage = databaseStorage
+    }
+
+    func enqueue(block: @escaping WriteBlock,
+                 completionQueue: DispatchQueue,
+                 completion: @escaping Completion) {
+        serialQueue.sync {
+            pendingWrites.append(PendingWrite(block: block,
+                                              completionQueue: completionQueue,
+                                              completion: completion))
+            guard !isFlushScheduled else {
+                return
+            }
+            isFlushScheduled = true
+            if pendingWrites.count >= SDSWriteCoalescer.maxWritesPerTransaction {
+                flushQueue.async { self.flush() }
+            } else {
+                flushQueue.asyncAfter(deadline: .now() + SDSWriteCoalescer.coalescingWindow) { self.flush() }
+            }
+        }
+    }
+
+    private func flush() {
+        let writes: [PendingWrite] = serialQueue.sync {
+            let writes = Array(pendingWrites.prefix(SDSWriteCoalescer.maxWritesPerTransaction))
+            pendingWrites.removeFirst(writes.count)
+            if pendingWrites.isEmpty {
+                isFlushScheduled = false
+            } else {
+                // Leave isFlushScheduled set; the remainder is flushed immediately.
+                flushQueue.async { self.flush() }
+            }
+            return writes
+        }
+        guard !writes.isEmpty else {
+            return
+        }
+        guard let databaseStorage = databaseStorage else {
+            owsFailDebug("Missing databaseStorage.")
+            return
+        }
+
+        var errors = [Error?](repeating: nil, count: writes.count)
+        databaseStorage.write(coalescedWriteCount: writes.count) { transaction in
+            for (index, write) in writes.enumerated() {
+                errors[index] = SDSWriteCoalescer.perform(write: write, transaction: transaction)
+            }
+        }
+
+        for (index, write) in writes.enumerated() {
+            let error = errors[index]
+            write.completionQueue.async {
+                write.completion(error)
+            }
+        }
+    }
+
+    private static func perform(write: PendingWrite, transaction: SDSAnyWriteTransaction) -> Error? {
+        switch transaction.writeTransaction {
+        case .yapWrite:
+            // YDB has no savepoints; the write can't be isolated.
+            do {
+                try write.block(transaction)
+                return nil
+            } catch {
+                Logger.warn("Coalesced write failed: \(error)")
+                return error
+            }
+        case .grdbWrite(let grdbTransaction):
+            let uiDatabaseObserver = SDSDatabaseStorage.shared.grdbStorage.uiDatabaseObserver
+            var blockError: Error?
+            uiDatabaseObserver?.willBeginSavepoint()
+            do {
+                try grdbTransaction.database.inSavepoint {
+                    do {
+                        try write.block(transaction)
+                        return .commit
+                    } catch {
+                        blockError = error
+                        return .rollback
+                    }
+                }
+            } catch {
+                owsFailDebug("Savepoint failed: \(error.grdbErrorForLogging)")
+                uiDatabaseObserver?.didRollBackSavepoint()
+                grdbTransaction.didRollBack()
+                return error.grdbErrorForLogging
+            }
+            if let error = blockError {
+                Logger.warn("Rolled back coalesced write: \(error)")
+                uiDatabaseObserver?.didRollBackSavepoint()
+                grdbTransaction.didRollBack()
+            } else {
+                uiDatabaseObserver?.didReleaseSavepoint()
+            }
+            return blockError
+        }
+    }
+}
+
+// MARK: -
+
+// Tracks write throughput and commit latency for SDSDatabaseStorage,
+// periodically logging a summary.
+class SDSWriteMetrics {
+
+    private static let reportingInterval: TimeInterval = 60
+
+    private let serialQueue = DispatchQueue(label: "org.signal.write-metrics")
+
+    private var windowStartTime = CACurrentMediaTime()
+    private var transactionCount: UInt = 0
+    private var writeCount: UInt = 0
+    private var totalLatency: TimeInterval = 0
+    private var maxLatency: TimeInterval = 0
+
+    // `writeCount` is the number of callers whose writes were
+    // committed by the transaction: 1 unless it was coalesced.
+    func record(latency: TimeInterval, writeCount: Int) {
+        serialQueue.async {
+            self.transactionCount += 1
+            self.writeCount += UInt(writeCount)
+            self.totalLatency += latency
+            self.maxLatency = max(self.maxLatency, latency)
+
+            let now = CACurrentMediaTime()
+            let elapsed = now - self.windowStartTime
+            guard elapsed >= SDSWriteMetrics.reportingInterval else {
+                return
+            }
+            self.logAndReset(elapsed: elapsed, now: now)
+        }
+    }
+
+    private func logAndReset(elapsed: TimeInterval, now: TimeInterval) {
+        let transactionsPerSecond = Double(transactionCount) / elapsed
+        let writesPerTransaction = Double(writeCount) / Double(max(1, transactionCount))
+        let averageLatencyMs = 1000 * totalLatency / Double(max(1, transactionCount))
+        Logger.info(String(format: "transactions/sec: %.2f, writes/transaction: %.2f, average commit latency: %.1fms, max commit latency: %.1fms",
+                           transactionsPerSecond,
+                           writesPerTransaction,
+                           averageLatencyMs,
+                           1000 * maxLatency))
+
+        windowStartTime = now
+        transactionCount = 0
+        writeCount = 0
+        totalLatency = 0
+        maxLatency = 0
+    }
+}
@@ -0,0 +1,330 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+import GRDB
+
+public struct DatabaseRowChange {
+    public typealias Kind = DatabaseEvent.Kind
+
+    public let tableName: String
+    public let rowId: Int64
+    public let kind: Kind
+    public let uniqueId: String?
+    // Only populated for interactions.
+    public let threadUniqueId: String?
+}
+
+// MARK: -
+
+/// An immutable description of the rows changed by a single committed
+/// write transaction. UIDatabaseObserver builds one change set per commit
+/// and hands the same instance to every DatabaseSnapshotDelegate, so
+/// delegates never need to query the database to learn what changed.
+public final class DatabaseChangeSet {
+
+    public typealias RowId = Int64
+
+    public let tableNames: Set<String>
+
+    private let rowChangesByTableName: [String: [RowId: DatabaseRowChange]]
+
+    init(tableNames: Set<String>, rowChangesByTableName: [String: [RowId: DatabaseRowChange]]) {
+        self.tableNames = tableNames
+        self.rowChangesByTableName = rowChangesByTableName
+    }
+
+    public static let empty = DatabaseChangeSet(tableNames: Set(), rowChangesByTableName: [:])
+
+    public var isEmpty: Bool {
+        return tableNames.isEmpty
+    }
+
+    public func rowIds(tableName: String) -> Set<RowId> {
+        guard let rowChanges = rowChangesByTableName[tableName] else {
+            return Set()
+        }
+        return Set(rowChanges.keys)
+    }
+
+    /// Throws DatabaseObserverError.changeTooLarge if too many rows changed
+    /// for delegates to apply the change incrementally.
+    public func rowChanges(tableName: String) throws -> [DatabaseRowChange] {
+        guard let rowChanges = rowChangesByTableName[tableName] else {
+            return []
+        }
+        guard rowChanges.count < UIDatabaseObserver.kMaxIncrementalRowChanges else {
+            throw DatabaseObserverError.changeTooLarge
+        }
+        return Array(rowChanges.values)
+    }
+
+    /// The uniqueIds of rows inserted or updated in the given table.
+    public func updatedUniqueIds(tableName: String) throws -> Set<String> {
+        var result = Set<String>()
+        for rowChange in try rowChanges(tableName: tableName) where rowChange.kind != .delete {
+            guard let uniqueId = rowChange.uniqueId else {
+                // We only resolve uniqueIds for some tables.
+                owsFailDebug("Missing uniqueId for row in \(tableName).")
+                continue
+            }
+            result.insert(uniqueId)
+        }
+        return result
+    }
+
+    /// The uniqueIds of rows deleted from the given table.
+    ///
+    /// Deletes aren't subject to kMaxIncrementalRowChanges since their
+    /// uniqueIds are captured as they happen. Rows deleted with raw SQL
+    /// can't be resolved after the fact, so this throws
+    /// DatabaseObserverError.changeTooLarge and delegates reset.
+    public func deletedUniqueIds(tableName: String) throws -> Set<String> {
+        guard let rowChanges = rowChangesByTableName[tableName] else {
+            return Set()
+        }
+        var result = Set<String>()
+        for rowChange in rowChanges.values where rowChange.kind == .delete {
+            guard let uniqueId = rowChange.uniqueId else {
+                throw DatabaseObserverError.changeTooLarge
+            }
+            result.insert(uniqueId)
+        }
+        return result
+    }
+}
+
+// MARK: -
+
+/// Accrues row-level changes while a write transaction is in flight.
+///
+/// Changes are reported from three sources: GRDB's DatabaseEvents (which
+/// only know the rowId), the SDS save/remove path (which also knows the
+/// uniqueId) and touches. Only rows whose uniqueId is still unknown at
+/// commit time are resolved, with a single query per table.
+class DatabaseChangeCollector {
+
+    typealias RowId = Int64
+
+    // We only resolve uniqueIds for the tables our snapshot delegates need.
+    static let resolvedTableNames: Set<String> = [
+        ThreadRecord.databaseTableName,
+        InteractionRecord.databaseTableName,
+        AttachmentRecord.databaseTableName
+    ]
+
+    private struct PendingRowChange {
+        var kind: DatabaseRowChange.Kind
+        var uniqueId: String?
+        var threadUniqueId: String?
+    }
+
+    private var tableNames = Set<String>()
+    private var pendingChanges = [String: [RowId: PendingRowChange]]()
+
+    // GRDB only notifies the DatabaseEvents of a savepoint once it is
+    // released, but the SDS layer reports its changes as they happen.
+    // We journal the changes made within each open savepoint so that
+    // they can be undone if the savepoint is rolled back.
+    private struct JournalEntry {
+        let tableName: String
+        let rowId: RowId
+        let previousChange: PendingRowChange?
+        let didAddTableName: Bool
+    }
+
+    private var savepointJournals = [[JournalEntry]]()
+
+    func didChange(event: DatabaseEvent) {
+        AssertIsOnUIDatabaseObserverSerialQueue()
+
+        record(tableName: event.tableName, rowId: event.rowID, kind: event.kind)
+    }
+
+    func didSave(tableName: String,
+                 rowId: RowId,
+                 uniqueId: String,
+                 threadUniqueId: String?,
+                 kind: DatabaseRowChange.Kind) {
+        AssertIsOnUIDatabaseObserverSerialQueue()
+
+        record(tableName: tableName, rowId: rowId, kind: kind, uniqueId: uniqueId, threadUniqueId: threadUniqueId)
+    }
+
+    func didRemove(tableName: String, rowId: RowId, uniqueId: String, threadUniqueId: String?) {
+        AssertIsOnUIDatabaseObserverSerialQueue()
+
+        record(tableName: tableName, rowId: rowId, kind: .delete, uniqueId: uniqueId, threadUniqueId: threadUniqueId)
+    }
+
+    func didTouch(tableName: String, rowId: RowId, uniqueId: String, threadUniqueId: String? = nil) {
+        AssertIsOnUIDatabaseObserverSerialQueue()
+
+        // A touch never downgrades an insert or delete.
+        let kind = pendingChanges[tableName]?[rowId]?.kind ?? .update
+        record(tableName: tableName, rowId: rowId, kind: kind, uniqueId: uniqueId, threadUniqueId: threadUniqueId)
+    }
+
+    func reset() {
+        AssertIsOnUIDatabaseObserverSerialQueue()
+
+        tableNames = Set()
+        pendingChanges = [:]
+        savepointJournals = []
+    }
+
+    // MARK: - Savepoints
+
+    func willBeginSavepoint() {
+        AssertIsOnUIDatabaseObserverSerialQueue()
+
+        savepointJournals.append([])
+    }
+
+    func didReleaseSavepoint() {
+        AssertIsOnUIDatabaseObserverSerialQueue()
+
+        guard let journal = savepointJournals.popLast() else {
+            owsFailDebug("No open savepoint.")
+            return
+        }
+        // The changes can still be rolled back with an enclosing savepoint.
+        if !savepointJournals.isEmpty {
+            savepointJournals[savepointJournals.count - 1].append(contentsOf: journal)
+        }
+    }
+
+    func didRollBackSavepoint() {
+        AssertIsOnUIDatabaseObserverSerialQueue()
+
+        guard let journal = savepointJournals.popLast() else {
+            owsFailDebug("No open savepoint.")
+            return
+        }
+        for entry in journal.reversed() {
+            pendingChanges[entry.tableName]?[entry.rowId] = entry.previousChange
+            if entry.didAddTableName {
+                tableNames.remove(entry.tableName)
+                pendingChanges[entry.tableName] = nil
+            }
+        }
+    }
+
+    private func record(tableName: String,
+                        rowId: RowId,
+                        kind: DatabaseRowChange.Kind,
+                        uniqueId: String? = nil,
+                        threadUniqueId: String? = nil) {
+        let didAddTableName = tableNames.insert(tableName).inserted
+        let previousChange = pendingChanges[tableName]?[rowId]
+        if !savepointJournals.isEmpty {
+            savepointJournals[savepointJournals.count - 1].append(JournalEntry(tableName: tableName,
+                                                                               rowId: rowId,
+                                                                               previousChange: previousChange,
+                                                                               didAddTableName: didAddTableName))
+        }
+
+        // Mutate in place; copying the table's changes on every
+        // statement would be quadratic for large transactions.
+        if var pendingChange = previousChange {
+            pendingChange.kind = DatabaseChangeCollector.merge(kind: pendingChange.kind, withLaterKind: kind)
+            pendingChange.uniqueId = uniqueId ?? pendingChange.uniqueId
+            pendingChange.threadUniqueId = threadUniqueId ?? pendingChange.threadUniqueId
+            pendingChanges[tableName, default: [:]][rowId] = pendingChange
+        } else {
+            pendingChanges[tableName, default: [:]][rowId] = PendingRowChange(kind: kind,
+                                                                               uniqueId: uniqueId,
+                                                                               threadUniqueId: threadUniqueId)
+        }
+    }
+
+    static func merge(kind: DatabaseRowChange.Kind,
+                      withLaterKind laterKind: DatabaseRowChange.Kind) -> DatabaseRowChange.Kind {
+        switch (kind, laterKind) {
+        case (.insert, .update):
+            // Still a new row from the point of view of the last snapshot.
+            return .insert
+        case (.delete, .insert):
+            // The rowId was reused within the transaction.
+            return .update
+        default:
+            return laterKind
+        }
+    }
+
+    // MARK: - Commit
+
+    /// Builds the immutable change set for the transaction that just
+    /// committed and resets the collector.
+    func commit(db: Database) -> DatabaseChangeSet {
+        AssertIsOnUIDatabaseObserverSerialQueue()
+
+        defer {
+            reset()
+        }
+
+        var rowChangesByTableName = [String: [RowId: DatabaseRowChange]]()
+        for (tableName, tableChanges) in pendingChanges {
+            var resolved = [RowId: (uniqueId: String, threadUniqueId: String?)]()
+            if DatabaseChangeCollector.resolvedTableNames.contains(tableName),
+                tableChanges.count < UIDatabaseObserver.kMaxIncrementalRowChanges {
+                let unresolvedRowIds = tableChanges.compactMap { (rowId, pendingChange) -> RowId? in
+                    guard pendingChange.kind != .delete,
+                        pendingChange.uniqueId == nil else {
+                            return nil
+                    }
+                    return rowId
+                }
+                do {
+                    resolved = try resolveUniqueIds(rowIds: unresolvedRowIds, tableName: tableName, db: db)
+                } catch {
+                    owsFailDebug("error: \(error)")
+                }
+            }
+
+            var rowChanges = [RowId: DatabaseRowChange]()
+            for (rowId, pendingChange) in tableChanges {
+                let resolvedIds = resolved[rowId]
+                rowChanges[rowId] = DatabaseRowChange(tableName: tableName,
+                                                      rowId: rowId,
+                                                      kind: pendingChange.kind,
+                                                      uniqueId: pendingChange.uniqueId ?? resolvedIds?.uniqueId,
+                                                      threadUniqueId: pendingChange.threadUniqueId ?? resolvedIds?.threadUniqueId)
+            }
+            rowChangesByTableName[tableName] = rowChanges
+        }
+
+        return DatabaseChangeSet(tableNames: tableNames, rowChangesByTableName: rowChangesByTableName)
+    }
+
+    private func resolveUniqueIds(rowIds: [RowId],
+                                  tableName: String,
+                                  db: Database) throws -> [RowId: (uniqueId: String, threadUniqueId: String?)] {
+        guard rowIds.count > 0 else {
+            return [:]
+        }
+
+        let isInteractionTable = tableName == InteractionRecord.databaseTableName
+        let commaSeparatedRowIds = rowIds.map { String($0) }.joined(separator: ", ")
+        let rowIdsSQL = "(\(commaSeparatedRowIds))"
+        let columnsSQL = (isInteractionTable
+            ? "rowid, uniqueId, \(interactionColumn: .threadUniqueId)"
+            : "rowid, uniqueId")
+        let sql = """
+            SELECT \(columnsSQL)
+            FROM \(tableName)
+            WHERE rowid IN \(rowIdsSQL)
+        """
+
+        var result = [RowId: (uniqueId: String, threadUniqueId: String?)]()
+        let cursor = try Row.fetchCursor(db, sql: sql)
+        while let row = try cursor.next() {
+            let rowId: RowId = row[0]
+            let uniqueId: String = row[1]
+            let threadUniqueId: String? = isInteractionTable ? row[2] : nil
+            result[rowId] = (uniqueId: uniqueId, threadUniqueId: threadUniqueId)
+        }
+        return result
+    }
+}
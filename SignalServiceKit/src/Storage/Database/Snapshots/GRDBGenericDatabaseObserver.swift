@@ -33,47 +33,6 @@ public class GRDBGenericDatabaseObserver: NSObject {
         _snapshotDelegates = _snapshotDelegates.filter { $0.value != nil} + [Weak(value: snapshotDelegate)]
     }
 
-    private struct PendingChanges {
-        var collections: Set<String> = Set()
-        var tableNames: Set<String> = Set()
-        var interactionRowIds: Set<Int64> = Set()
-    }
-
-    private var _pendingChanges = PendingChanges()
-    private var pendingChanges: PendingChanges {
-        get {
-            AssertIsOnUIDatabaseObserverSerialQueue()
-
-            return _pendingChanges
-        }
-        set {
-            AssertIsOnUIDatabaseObserverSerialQueue()
-
-            _pendingChanges = newValue
-        }
-    }
-
-    private struct CommittedChanges {
-        let collections: Set<String>
-        let interactionRowIds: Set<Int64>
-    }
-
-    private typealias CollectionName = String
-    private var _committedChanges: CommittedChanges?
-    private var committedChanges: CommittedChanges? {
-        get {
-            AssertIsOnMainThread()
-
-            return _committedChanges
-        }
-
-        set {
-            AssertIsOnMainThread()
-
-            _committedChanges = newValue
-        }
-    }
-
     private lazy var tableNameToCollectionMap: [String: String] = {
         var result = [String: String]()
         for table in GRDBDatabaseStorageAdapter.tables {
@@ -83,19 +42,10 @@ public class GRDBGenericDatabaseObserver: NSObject {
         return result
     }()
 
-    private func committedChanges(forPendingChanges pendingChanges: PendingChanges, db: Database) throws -> CommittedChanges {
-        return CommittedChanges(collections: collections(forPendingChanges: pendingChanges, db: db),
-                                interactionRowIds: pendingChanges.interactionRowIds)
-    }
-
-    private func collections(forPendingChanges pendingChanges: PendingChanges, db: Database) -> Set<String> {
-        guard pendingChanges.tableNames.count > 0 else {
-            return pendingChanges.collections
-        }
-
-        // If necessary, convert GRDB table names to "collections".
-        var allCollections = pendingChanges.collections
-        for tableName in pendingChanges.tableNames {
+    private func collections(forChanges changes: DatabaseChangeSet) -> Set<String> {
+        // Convert GRDB table names to "collections".
+        var allCollections = Set<String>()
+        for tableName in changes.tableNames {
             guard !tableName.hasPrefix(GRDBFullTextSearchFinder.databaseTableName) else {
                 owsFailDebug("should not have been notified for changes to FTS tables")
                 continue
@@ -108,71 +58,12 @@ public class GRDBGenericDatabaseObserver: NSObject {
         }
         return allCollections
     }
-
-    private typealias RowId = Int64
-
-    // internal - should only be called by DatabaseStorage
-    func didTouchThread(transaction: GRDBWriteTransaction) {
-        // Note: We don't actually use the `transaction` param, but touching must happen within
-        // a write transaction in order for the touch machinery to notify it's observers
-        // in the expected way.
-        AssertIsOnUIDatabaseObserverSerialQueue()
-        pendingChanges.tableNames.insert(TSThread.table.tableName)
-    }
-
-    // internal - should only be called by DatabaseStorage
-    func didTouch(interaction: TSInteraction, transaction: GRDBWriteTransaction) {
-        // Note: We don't actually use the `transaction` param, but touching must happen within
-        // a write transaction in order for the touch machinery to notify it's observers
-        // in the expected way.
-        AssertIsOnUIDatabaseObserverSerialQueue()
-        let rowId = RowId(interaction.sortId)
-        assert(rowId > 0)
-        pendingChanges.interactionRowIds.insert(rowId)
-        pendingChanges.tableNames.insert(TSInteraction.table.tableName)
-    }
 }
 
 // MARK: -
 
 extension GRDBGenericDatabaseObserver: DatabaseSnapshotDelegate {
 
-    // MARK: - Transaction Lifecycle
-
-    public func snapshotTransactionDidChange(with event: DatabaseEvent) {
-        AssertIsOnUIDatabaseObserverSerialQueue()
-
-        _ = pendingChanges.tableNames.insert(event.tableName)
-
-        if event.tableName == InteractionRecord.databaseTableName {
-            _ = pendingChanges.interactionRowIds.insert(event.rowID)
-        }
-    }
-
-    public func snapshotTransactionDidCommit(db: Database) {
-        AssertIsOnUIDatabaseObserverSerialQueue()
-
-        do {
-            let pendingChanges = self.pendingChanges
-            self.pendingChanges = PendingChanges()
-
-            let committedChanges = try self.committedChanges(forPendingChanges: pendingChanges, db: db)
-            DispatchQueue.main.async {
-                self.committedChanges = committedChanges
-            }
-        } catch {
-            DispatchQueue.main.async {
-                self.committedChanges = nil
-            }
-        }
-    }
-
-    public func snapshotTransactionDidRollback(db: Database) {
-        owsFailDebug("test this if we ever use it")
-        AssertIsOnUIDatabaseObserverSerialQueue()
-        pendingChanges = PendingChanges()
-    }
-
     // MARK: - Snapshot LifeCycle (Post Commit)
 
     public func databaseSnapshotWillUpdate() {
@@ -183,24 +74,14 @@ extension GRDBGenericDatabaseObserver: DatabaseSnapshotDelegate {
         }
     }
 
-    public func databaseSnapshotDidUpdate() {
+    public func databaseSnapshotDidUpdate(changes: DatabaseChangeSet) {
         AssertIsOnMainThread()
 
-        do {
-            guard let committedChanges = self.committedChanges else {
-                throw OWSErrorMakeAssertionError("committedChanges was unexpectedly nil")
-            }
-            self.committedChanges = nil
-
-            for delegate in snapshotDelegates {
-                delegate.genericDatabaseSnapshotDidUpdate(updatedCollections: committedChanges.collections,
-                                                          updatedInteractionRowIds: committedChanges.interactionRowIds)
-            }
-        } catch {
-            owsFailDebug("unknown error: \(error)")
-            for delegate in snapshotDelegates {
-                delegate.genericDatabaseSnapshotDidReset()
-            }
+        let updatedCollections = collections(forChanges: changes)
+        let updatedInteractionRowIds = changes.rowIds(tableName: InteractionRecord.databaseTableName)
+        for delegate in snapshotDelegates {
+            delegate.genericDatabaseSnapshotDidUpdate(updatedCollections: updatedCollections,
+                                                      updatedInteractionRowIds: updatedInteractionRowIds)
         }
     }
 
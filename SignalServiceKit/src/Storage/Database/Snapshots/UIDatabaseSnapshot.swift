@@ -5,25 +5,18 @@
 import Foundation
 import GRDB
 
-/// Anything 
+/// Anything that wants to be notified of changes to the UI database snapshot.
 public protocol DatabaseSnapshotDelegate: AnyObject {
 
-    // MARK: - Transaction Lifecycle
-
-    /// Called on the DatabaseSnapshotSerial queue durign the transaction
-    /// so the DatabaseSnapshotDelegate can accrue information about changes
-    /// as they occur.
-
-    func snapshotTransactionDidChange(with event: DatabaseEvent)
-    func snapshotTransactionDidCommit(db: Database)
-    func snapshotTransactionDidRollback(db: Database)
-
     // MARK: - Snapshot LifeCycle (Post Commit)
 
-    /// Called on the Main Thread after the transaction has committed
+    /// Called on the Main Thread after the transaction has committed.
+    ///
+    /// Every delegate receives the same immutable change set, which
+    /// UIDatabaseObserver accrues during the write transaction.
 
     func databaseSnapshotWillUpdate()
-    func databaseSnapshotDidUpdate()
+    func databaseSnapshotDidUpdate(changes: DatabaseChangeSet)
     func databaseSnapshotDidUpdateExternally()
 }
 
@@ -82,14 +75,20 @@ public class UIDatabaseObserver: NSObject {
 
     let pool: DatabasePool
 
+    private let checkpointScheduler: GRDBCheckpointScheduler
+
+    // Should only be accessed within UIDatabaseObserver.serializedSync
+    private let changeCollector = DatabaseChangeCollector()
+
     internal var latestSnapshot: DatabaseSnapshot {
         didSet {
             AssertIsOnMainThread()
         }
     }
 
-    init(pool: DatabasePool) throws {
+    init(pool: DatabasePool, checkpointScheduler: GRDBCheckpointScheduler) throws {
         self.pool = pool
+        self.checkpointScheduler = checkpointScheduler
         self.latestSnapshot = try pool.makeSnapshot()
         super.init()
 
@@ -110,139 +109,200 @@ public class UIDatabaseObserver: NSObject {
     }
 }
 
-extension UIDatabaseObserver: TransactionObserver {
+// MARK: - Change Capture
 
-    public func observes(eventsOfKind eventKind: DatabaseEventKind) -> Bool {
-        guard !eventKind.tableName.hasPrefix(GRDBFullTextSearchFinder.databaseTableName) else {
-            // Ignore updates to the GRDB FTS table(s)
-            return false
+extension UIDatabaseObserver {
+
+    // The methods below are internal and should only be called by the SDS
+    // layer, within a write transaction, so that the uniqueIds of changed
+    // rows are known without querying the database after the commit.
+
+    func didSave(record: SDSRecord, rowId: Int64, saveMode: SDSSaveMode) {
+        let tableName = record.tableMetadata.tableName
+        guard observes(tableName: tableName) else {
+            return
         }
+        let threadUniqueId = (record as? InteractionRecord)?.threadUniqueId
+        UIDatabaseObserver.serializedSync {
+            changeCollector.didSave(tableName: tableName,
+                                    rowId: rowId,
+                                    uniqueId: record.uniqueId,
+                                    threadUniqueId: threadUniqueId,
+                                    kind: saveMode == .insert ? .insert : .update)
+        }
+    }
 
-        guard !nonModelTables.contains(eventKind.tableName) else {
-            // Ignore updates to non-model tables
-            return false
+    func didRemove(model: SDSModel) {
+        guard observes(tableName: model.sdsTableName) else {
+            return
         }
+        guard let grdbId = model.grdbId else {
+            // Without a rowId we fall back to the DatabaseEvent,
+            // whose uniqueId can't be resolved after the delete.
+            return
+        }
+        let threadUniqueId = (model as? TSInteraction)?.uniqueThreadId
+        UIDatabaseObserver.serializedSync {
+            changeCollector.didRemove(tableName: model.sdsTableName,
+                                      rowId: grdbId.int64Value,
+                                      uniqueId: model.uniqueId,
+                                      threadUniqueId: threadUniqueId)
+        }
+    }
+
+    // Should only be called within UIDatabaseObserver.serializedSync
+    func didTouch(interaction: TSInteraction, transaction: GRDBWriteTransaction) {
+        // Note: We don't actually use the `transaction` param, but touching must happen within
+        // a write transaction in order for the touch machinery to notify it's observers
+        // in the expected way.
+        AssertIsOnUIDatabaseObserverSerialQueue()
+
+        let rowId = Int64(interaction.sortId)
+        assert(rowId > 0)
+        changeCollector.didTouch(tableName: InteractionRecord.databaseTableName,
+                                 rowId: rowId,
+                                 uniqueId: interaction.uniqueId,
+                                 threadUniqueId: interaction.uniqueThreadId)
+    }
+
+    // Should only be called within UIDatabaseObserver.serializedSync
+    func didTouch(thread: TSThread, transaction: GRDBWriteTransaction) {
+        AssertIsOnUIDatabaseObserverSerialQueue()
+
+        guard let grdbId = thread.grdbId else {
+            owsFailDebug("Missing grdbId.")
+            return
+        }
+        changeCollector.didTouch(tableName: ThreadRecord.databaseTableName,
+                                 rowId: grdbId.int64Value,
+                                 uniqueId: thread.uniqueId)
+    }
+
+    // Savepoints must be reported so that the changes made within a
+    // savepoint which is rolled back can be dropped from the change set.
+    func willBeginSavepoint() {
+        UIDatabaseObserver.serializedSync {
+            changeCollector.willBeginSavepoint()
+        }
+    }
+
+    func didReleaseSavepoint() {
+        UIDatabaseObserver.serializedSync {
+            changeCollector.didReleaseSavepoint()
+        }
+    }
+
+    func didRollBackSavepoint() {
+        UIDatabaseObserver.serializedSync {
+            changeCollector.didRollBackSavepoint()
+        }
+    }
+
+    private func observes(tableName: String) -> Bool {
+        return (!tableName.hasPrefix(GRDBFullTextSearchFinder.databaseTableName) &&
+            !nonModelTables.contains(tableName))
+    }
+}
+
+// MARK: -
+
+extension UIDatabaseObserver: TransactionObserver {
 
-        return true
+    public func observes(eventsOfKind eventKind: DatabaseEventKind) -> Bool {
+        // Ignore updates to the GRDB FTS table(s) and to non-model tables.
+        return observes(tableName: eventKind.tableName)
     }
 
     public func databaseDidChange(with event: DatabaseEvent) {
         UIDatabaseObserver.serializedSync {
-            for snapshotDelegate in snapshotDelegates {
-                snapshotDelegate.snapshotTransactionDidChange(with: event)
-            }
+            changeCollector.didChange(event: event)
         }
     }
 
     public func databaseDidCommit(_ db: Database) {
+        var changes = DatabaseChangeSet.empty
         UIDatabaseObserver.serializedSync {
-            for snapshotDelegate in snapshotDelegates {
-                snapshotDelegate.snapshotTransactionDidCommit(db: db)
-            }
+            changes = changeCollector.commit(db: db)
         }
 
         DispatchQueue.main.async { [weak self] in
-            guard let self = self else { return }
-            Logger.verbose("databaseSnapshotWillUpdate")
-            for delegate in self.snapshotDelegates {
-                delegate.databaseSnapshotWillUpdate()
-            }
-
-            self.latestSnapshot.read { db in
-                do {
-                    try self.fastForwardDatabaseSnapshot(db: db)
-                } catch {
-                    owsFailDebug("\(error)")
-                }
-            }
-
-            Logger.verbose("databaseSnapshotDidUpdate")
-            for delegate in self.snapshotDelegates {
-                delegate.databaseSnapshotDidUpdate()
-            }
+            self?.updateSnapshot(changes: changes)
         }
     }
 
     public func databaseDidRollback(_ db: Database) {
         UIDatabaseObserver.serializedSync {
-            for snapshotDelegate in snapshotDelegates {
-                snapshotDelegate.snapshotTransactionDidRollback(db: db)
-            }
+            changeCollector.reset()
         }
     }
 
-    // Currently GRDB offers no built in way to fast-forward a
-    // database snapshot.
-    // See: https://github.com/groue/GRDB.swift/issues/619
-    func fastForwardDatabaseSnapshot(db: Database) throws {
+    private func updateSnapshot(changes: DatabaseChangeSet) {
         AssertIsOnMainThread()
-        // [1] end the old transaction from the old db state
-        try db.commit()
 
-        // [2] Checkpoint the WAL
         // Checkpointing is the process of moving data from the WAL back into the main database file.
         // Without it, the WAL will grow indefinitely.
         //
-        // Checkpointing has several flavors, including `passive` which opportunistically checkpoints
-        // what it can without requiring blocking of reads or writes.
-        //
-        // SQLite's default auto-checkpointing uses `passive` checkpointing, but because our
-        // DatabaseSnapshot maintains a long running read transaction, passive checkpointing can
-        // never successfully truncate the WAL (because there is at least the one read transaction
-        // using it).
-        //
-        // The only time the long-lived read transaction is *not* reading the database is
-        // *right here*, between committing the last transaction and starting the next one.
-        //
-        // Solution:
-        //   Perform an explicit passive checkpoint sync after every write.
-        //   It will probably not succeed often in truncating the database, but
-        //   we only need it to succeed periodically. This might have an
-        //   unacceptable perf cost, and it might not succeed often enough.
+        // GRDBCheckpointScheduler runs passive checkpoints in the background once writes are idle.
+        // Passive checkpoints never block, but because our DatabaseSnapshot maintains a long running
+        // read transaction, they can never reset or truncate the WAL.
         //
-        //   We periodically try to perform a restart checkpoint which
-        //   can limit WAL size when truncation isn't possible.
-        do {
-            try self.checkpoint()
-        } catch {
-            owsFailDebug("error \(error)")
+        // So once the WAL has grown too large, we truncate it here, between ending the snapshot's
+        // old read transaction and opening the new one. This happens synchronously so that main
+        // thread reads never see the database outside of a snapshot; the truncation uses a short
+        // busy timeout, so it can't block the main thread for long.
+        let shouldTruncate = checkpointScheduler.takeTruncatingCheckpointRequest()
+
+        notifySnapshotDelegates(changes: changes) { db in
+            guard shouldTruncate else {
+                try self.fastForwardDatabaseSnapshot(db: db)
+                return
+            }
+            // End the old transaction from the old db state.
+            try db.commit()
+            self.checkpointScheduler.truncate()
+            try self.openSnapshotTransaction(db: db)
         }
-
-        // [3] open a new transaction from the current db state
-        try db.beginTransaction(.deferred)
-
-        // [4] do *any* read to acquire non-deferred read lock
-        _ = try Row.fetchCursor(db, sql: "SELECT rootpage FROM sqlite_master LIMIT 1").next()
     }
 
-    private static let isRunningCheckpoint = AtomicBool(false)
+    private func notifySnapshotDelegates(changes: DatabaseChangeSet, updateSnapshot: (Database) throws -> Void) {
+        AssertIsOnMainThread()
 
-    func checkpoint() throws {
-        do {
-            try UIDatabaseObserver.isRunningCheckpoint.transition(from: false, to: true)
-        } catch {
-            Logger.warn("Skipping checkpoint; already running checkpoint.")
-            return
+        Logger.verbose("databaseSnapshotWillUpdate")
+        for delegate in snapshotDelegates {
+            delegate.databaseSnapshotWillUpdate()
         }
-        defer {
-            UIDatabaseObserver.isRunningCheckpoint.set(false)
+
+        latestSnapshot.read { db in
+            do {
+                try updateSnapshot(db)
+            } catch {
+                owsFailDebug("\(error)")
+            }
         }
 
-        // Try to restart after every Nth write.
-        let restartFrequency: UInt32 = 100
-        let shouldTryToRestart = arc4random_uniform(restartFrequency) == 0
-        let mode: Database.CheckpointMode = shouldTryToRestart ? .restart : .passive
+        Logger.verbose("databaseSnapshotDidUpdate")
+        for delegate in snapshotDelegates {
+            delegate.databaseSnapshotDidUpdate(changes: changes)
+        }
+    }
+
+    // Currently GRDB offers no built in way to fast-forward a
+    // database snapshot.
+    // See: https://github.com/groue/GRDB.swift/issues/619
+    func fastForwardDatabaseSnapshot(db: Database) throws {
+        AssertIsOnMainThread()
+        // [1] end the old transaction from the old db state
+        try db.commit()
+
+        try openSnapshotTransaction(db: db)
+    }
 
-        let result = try GRDBDatabaseStorageAdapter.checkpoint(pool: pool, mode: mode)
+    private func openSnapshotTransaction(db: Database) throws {
+        AssertIsOnMainThread()
+        // [2] open a new transaction from the current db state
+        try db.beginTransaction(.deferred)
 
-        let pageSize: Int32 = 4 * 1024
-        let walFileSizeBytes = result.walSizePages * pageSize
-        let maxWalFileSizeBytes = 4 * 1024 * 1024
-        if walFileSizeBytes > maxWalFileSizeBytes {
-            Logger.info("walFileSizeBytes: \(walFileSizeBytes).")
-            Logger.info("walSizePages: \(result.walSizePages), pagesCheckpointed: \(result.pagesCheckpointed).")
-        } else {
-            Logger.verbose("walSizePages: \(result.walSizePages), pagesCheckpointed: \(result.pagesCheckpointed).")
-        }
+        // [3] do *any* read to acquire non-deferred read lock
+        _ = try Row.fetchCursor(db, sql: "SELECT rootpage FROM sqlite_master LIMIT 1").next()
     }
 }
@@ -61,6 +61,31 @@ public class FullTextSearchFinder: NSObject {
             GRDBFullTextSearchFinder.allModelsWereRemoved(collection: collection, transaction: grdbWrite)
         }
     }
+
+    // MARK: - Deferred Indexing
+
+    // Toggle to skip FTS indexing of inserts and updates. Useful for large
+    // migrations, which can build the index in a single post-pass using
+    // removeAllIndexEntries() and indexModel().
+    private static let isIndexingDeferred = AtomicBool(false)
+
+    public class func setIsIndexingDeferred(_ value: Bool) {
+        isIndexingDeferred.set(value)
+    }
+
+    class var shouldDeferIndexing: Bool {
+        return isIndexingDeferred.get()
+    }
+
+    public class func removeAllIndexEntries(transaction: GRDBWriteTransaction) {
+        GRDBFullTextSearchFinder.removeAllIndexEntries(transaction: transaction)
+    }
+
+    public class func indexModel(_ model: SDSModel, transaction: GRDBWriteTransaction) {
+        assert(type(of: model).shouldBeIndexedForFTS)
+
+        GRDBFullTextSearchFinder.indexModel(model, transaction: transaction)
+    }
 }
 
 // MARK: - Normalization
@@ -310,6 +335,13 @@ class GRDBFullTextSearchFinder: NSObject {
     }
 
     public class func modelWasInserted(model: SDSModel, transaction: GRDBWriteTransaction) {
+        guard !FullTextSearchFinder.shouldDeferIndexing else {
+            return
+        }
+        indexModel(model, transaction: transaction)
+    }
+
+    class func indexModel(_ model: SDSModel, transaction: GRDBWriteTransaction) {
         let uniqueId = model.uniqueId
         let collection = self.collection(forModel: model)
         let ftsContent = AnySearchIndexer.indexContent(object: model, transaction: transaction.asAnyRead) ?? ""
@@ -331,6 +363,10 @@ class GRDBFullTextSearchFinder: NSObject {
     }
 
     public class func modelWasUpdated(model: SDSModel, transaction: GRDBWriteTransaction) {
+        guard !FullTextSearchFinder.shouldDeferIndexing else {
+            return
+        }
+
         let uniqueId = model.uniqueId
         let collection = self.collection(forModel: model)
         let ftsContent = AnySearchIndexer.indexContent(object: model, transaction: transaction.asAnyRead) ?? ""
@@ -397,6 +433,18 @@ class GRDBFullTextSearchFinder: NSObject {
             transaction: transaction)
     }
 
+    class func removeAllIndexEntries(transaction: GRDBWriteTransaction) {
+
+        serialQueue.sync {
+            ftsCache.removeAllObjects()
+        }
+
+        executeUpdate(
+            sql: "DELETE FROM \(databaseTableName)",
+            arguments: [],
+            transaction: transaction)
+    }
+
     private static let disableFTS = false
 
     private class func executeUpdate(sql: String,
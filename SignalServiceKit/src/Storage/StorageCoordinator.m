@@ -299,17 +299,25 @@ NSString *NSStringForDataStore(DataStore value)
                 self.state = StorageCoordinatorStateYDB;
             } else {
                 if (SSKFeatureFlags.storageMode == StorageModeGrdbThrowawayIfMigrating) {
-                    // Clear flag to force migration.
+                    // Clear flags to force migration.
                     [SSKPreferences setIsYdbMigrated:NO];
+                    [SSKPreferences setIsYdbMigrationResumable:NO];
                 }
 
                 if (hasUnmigratedYdbFile) {
                     self.state = StorageCoordinatorStateBeforeYDBToGRDBMigration;
 
-                    // We might want to delete any existing GRDB database
-                    // files here, since they represent an incomplete
-                    // previous migration and might cause problems.
-                    [self.databaseStorage deleteGrdbFiles];
+                    if (SSKPreferences.isYdbMigrationResumable) {
+                        // The GRDB database files represent an incomplete
+                        // previous migration whose progress was checkpointed;
+                        // preserve them so that the migration can resume.
+                        OWSLogInfo(@"Resuming YDB-to-GRDB migration.");
+                    } else {
+                        // We might want to delete any existing GRDB database
+                        // files here, since they represent an incomplete
+                        // previous migration and might cause problems.
+                        [self.databaseStorage deleteGrdbFiles];
+                    }
                 } else {
                     self.state = StorageCoordinatorStateGRDB;
 
@@ -8,6 +8,7 @@
 #import "OWSBatchMessageProcessor.h"
 #import "OWSBlockingManager.h"
 #import "OWSDisappearingMessagesJob.h"
+#import "OWSFakeAttachmentDownloads.h"
 #import "OWSFakeCallMessageHandler.h"
 #import "OWSFakeContactsUpdater.h"
 #import "OWSFakeMessageSender.h"
@@ -92,7 +93,7 @@ NS_ASSUME_NONNULL_BEGIN
     id<SSKReachabilityManager> reachabilityManager = [SSKReachabilityManagerImpl new];
     id<SyncManagerProtocol> syncManager = [[OWSMockSyncManager alloc] init];
     id<OWSTypingIndicators> typingIndicators = [[OWSTypingIndicatorsImpl alloc] init];
-    OWSAttachmentDownloads *attachmentDownloads = [[OWSAttachmentDownloads alloc] init];
+    OWSAttachmentDownloads *attachmentDownloads = [OWSFakeAttachmentDownloads new];
     StickerManager *stickerManager = [[StickerManager alloc] init];
     SignalServiceAddressCache *signalServiceAddressCache = [SignalServiceAddressCache new];
     AccountServiceClient *accountServiceClient = [FakeAccountServiceClient new];
@@ -0,0 +1,19 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+#import "OWSAttachmentDownloads.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+#ifdef TESTABLE_BUILD
+
+// Ignores download requests, so that tests which receive attachment
+// pointers don't touch the network.
+@interface OWSFakeAttachmentDownloads : OWSAttachmentDownloads
+
+@end
+
+#endif
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,43 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+#import "OWSFakeAttachmentDownloads.h"
+#import "TSAttachmentPointer.h"
+#import "TSMessage.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+#ifdef TESTABLE_BUILD
+
+@implementation OWSFakeAttachmentDownloads
+
+- (void)downloadBodyAttachmentsForMessage:(TSMessage *)message
+                              transaction:(SDSAnyReadTransaction *)transaction
+                                  success:(void (^)(NSArray<TSAttachmentStream *> *attachmentStreams))success
+                                  failure:(void (^)(NSError *error))failure
+{
+    OWSLogInfo(@"[OWSFakeAttachmentDownloads] Ignoring body attachment download for message: %llu", message.timestamp);
+}
+
+- (void)downloadAllAttachmentsForMessage:(TSMessage *)message
+                             transaction:(SDSAnyReadTransaction *)transaction
+                                 success:(void (^)(NSArray<TSAttachmentStream *> *attachmentStreams))success
+                                 failure:(void (^)(NSError *error))failure
+{
+    OWSLogInfo(@"[OWSFakeAttachmentDownloads] Ignoring attachment download for message: %llu", message.timestamp);
+}
+
+- (void)downloadAttachmentPointer:(TSAttachmentPointer *)attachmentPointer
+                          message:(nullable TSMessage *)message
+                          success:(void (^)(NSArray<TSAttachmentStream *> *attachmentStreams))success
+                          failure:(void (^)(NSError *error))failure
+{
+    OWSLogInfo(@"[OWSFakeAttachmentDownloads] Ignoring attachment pointer download: %@", attachmentPointer.uniqueId);
+}
+
+@end
+
+#endif
+
+NS_ASSUME_NONNULL_END
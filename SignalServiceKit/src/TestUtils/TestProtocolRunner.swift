@@ -186,12 +186,21 @@ public struct FakeService {
     }
 
     public func envelopeBuilder(fromSenderClient senderClient: SignalClient, bodyText: String? = nil) throws -> SSKProtoEnvelope.SSKProtoEnvelopeBuilder {
+        return try envelopeBuilder(fromSenderClient: senderClient) { _ in
+            return try self.buildContentData(bodyText: bodyText)
+        }
+    }
+
+    /// Some content must carry the envelope's timestamp, so `buildContentData`
+    /// is passed the timestamp of the envelope being built.
+    public func envelopeBuilder(fromSenderClient senderClient: SignalClient, buildContentData: (UInt64) throws -> Data) throws -> SSKProtoEnvelope.SSKProtoEnvelopeBuilder {
         envelopeId += 1
-        let builder = SSKProtoEnvelope.builder(timestamp: envelopeId)
+        let timestamp = envelopeId
+        let builder = SSKProtoEnvelope.builder(timestamp: timestamp)
         builder.setType(.ciphertext)
         builder.setSourceDevice(senderClient.deviceId)
 
-        let content = try buildEncryptedContentData(fromSenderClient: senderClient, bodyText: bodyText)
+        let content = try buildEncryptedContentData(fromSenderClient: senderClient, plaintext: try buildContentData(timestamp))
         builder.setContent(content)
 
         // builder.setServerTimestamp(serverTimestamp)
@@ -202,6 +211,10 @@ public struct FakeService {
 
     public func buildEncryptedContentData(fromSenderClient senderClient: SignalClient, bodyText: String?) throws -> Data {
         let plaintext = try buildContentData(bodyText: bodyText)
+        return try buildEncryptedContentData(fromSenderClient: senderClient, plaintext: plaintext)
+    }
+
+    public func buildEncryptedContentData(fromSenderClient senderClient: SignalClient, plaintext: Data) throws -> Data {
         let cipherMessage: CipherMessage = databaseStorage.write { transaction in
             return try! self.runner.encrypt(plaintext: plaintext,
                                             senderClient: senderClient,
@@ -221,8 +234,61 @@ public struct FakeService {
             dataMessageBuilder.setBody(CommonGenerator.paragraph)
         }
 
+        return try buildContentData(dataMessage: try dataMessageBuilder.build())
+    }
+
+    public func buildGroupContentData(groupId: Data, bodyText: String?) throws -> Data {
+        let groupContextBuilder = SSKProtoGroupContext.builder(id: groupId)
+        groupContextBuilder.setType(.deliver)
+
+        let dataMessageBuilder = SSKProtoDataMessage.builder()
+        dataMessageBuilder.setBody(bodyText ?? CommonGenerator.paragraph)
+        dataMessageBuilder.setGroup(try groupContextBuilder.build())
+
+        return try buildContentData(dataMessage: try dataMessageBuilder.build())
+    }
+
+    public func buildAttachmentContentData(contentType: String, byteCount: UInt32, bodyText: String? = nil) throws -> Data {
+        let attachmentPointerBuilder = SSKProtoAttachmentPointer.builder(id: UInt64.random(in: 1..<UInt64(Int64.max)))
+        attachmentPointerBuilder.setContentType(contentType)
+        attachmentPointerBuilder.setKey(Randomness.generateRandomBytes(64))
+        attachmentPointerBuilder.setDigest(Randomness.generateRandomBytes(32))
+        attachmentPointerBuilder.setSize(byteCount)
+
+        let dataMessageBuilder = SSKProtoDataMessage.builder()
+        if let bodyText = bodyText {
+            dataMessageBuilder.setBody(bodyText)
+        }
+        dataMessageBuilder.addAttachments(try attachmentPointerBuilder.build())
+
+        return try buildContentData(dataMessage: try dataMessageBuilder.build())
+    }
+
+    public func buildReceiptContentData(type: SSKProtoReceiptMessageType, messageTimestamps: [UInt64]) throws -> Data {
+        let receiptMessageBuilder = SSKProtoReceiptMessage.builder()
+        receiptMessageBuilder.setType(type)
+        receiptMessageBuilder.setTimestamp(messageTimestamps)
+
+        let contentBuilder = SSKProtoContent.builder()
+        contentBuilder.setReceiptMessage(try receiptMessageBuilder.build())
+
+        return try contentBuilder.buildSerializedData()
+    }
+
+    public func buildTypingContentData(timestamp: UInt64, action: SSKProtoTypingMessageAction, groupId: Data? = nil) throws -> Data {
+        let typingMessageBuilder = SSKProtoTypingMessage.builder(timestamp: timestamp)
+        typingMessageBuilder.setAction(action)
+        typingMessageBuilder.setGroupID(groupId)
+
+        let contentBuilder = SSKProtoContent.builder()
+        contentBuilder.setTypingMessage(try typingMessageBuilder.build())
+
+        return try contentBuilder.buildSerializedData()
+    }
+
+    private func buildContentData(dataMessage: SSKProtoDataMessage) throws -> Data {
         let contentBuilder = SSKProtoContent.builder()
-        contentBuilder.setDataMessage(try dataMessageBuilder.build())
+        contentBuilder.setDataMessage(dataMessage)
 
         return try contentBuilder.buildSerializedData()
     }
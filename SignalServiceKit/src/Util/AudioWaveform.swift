@@ -35,12 +35,44 @@ public class AudioWaveform: NSObject {
 
     // MARK: - Caching
 
+    // Waveforms are cached in a small binary file:
+    //
+    //   bytes 0-3   magic, "OWSW"
+    //   byte  4     format version
+    //   byte  5     sample encoding, see SampleEncoding
+    //   bytes 6-7   reserved, zero
+    //   bytes 8-11  sample count, little-endian UInt32
+    //   bytes 12-   samples, little-endian
+    //
+    // Files written before this format are keyed archives, which are
+    // still read.
+    private static let fileMagic: [UInt8] = Array("OWSW".utf8)
+    private static let fileVersion: UInt8 = 1
+    private static let fileHeaderLength = 12
+
+    private enum SampleEncoding: UInt8 {
+        // Decibels as Float32.
+        case float32 = 0
+        // Decibels quantized to 0...255 across silenceDecibelThreshold...0.
+        case uint8 = 1
+    }
+
     @objc
     public init(contentsOfFile filePath: String) throws {
-        guard let unarchivedSamples = NSKeyedUnarchiver.unarchiveObject(withFile: filePath) as? [Float] else {
-            throw OWSAssertionError("Failed to unarchive decibel samples")
+        let fileURL = URL(fileURLWithPath: filePath)
+        let data = try Data(contentsOf: fileURL, options: .alwaysMapped)
+
+        if data.starts(with: AudioWaveform.fileMagic) {
+            decibelSamples = try AudioWaveform.parseDecibelSamples(data: data)
+        } else if let unarchivedSamples = NSKeyedUnarchiver.unarchiveObject(with: data) as? [Float] {
+            decibelSamples = unarchivedSamples
+        } else {
+            throw OWSAssertionError("Failed to read decibel samples")
         }
-        decibelSamples = unarchivedSamples
+    }
+
+    init(decibelSamples: [Float]) {
+        self.decibelSamples = decibelSamples
     }
 
     @objc
@@ -49,8 +81,72 @@ public class AudioWaveform: NSObject {
             throw OWSAssertionError("can't write incomplete waveform to file \(filePath)")
         }
 
-        let archivedData = NSKeyedArchiver.archivedData(withRootObject: decibelSamples)
-        try archivedData.write(to: URL(fileURLWithPath: filePath), options: atomically ? .atomicWrite : .init())
+        let fileData = AudioWaveform.serialize(decibelSamples: decibelSamples)
+        try fileData.write(to: URL(fileURLWithPath: filePath), options: atomically ? .atomicWrite : .init())
+    }
+
+    // The quantization error is at most 0.1dB, far below what the
+    // waveform can show.
+    static func serialize(decibelSamples: [Float]) -> Data {
+        var data = Data(capacity: fileHeaderLength + decibelSamples.count)
+        data.append(contentsOf: fileMagic)
+        data.append(fileVersion)
+        data.append(SampleEncoding.uint8.rawValue)
+        data.append(contentsOf: [0, 0])
+        var sampleCount = UInt32(decibelSamples.count).littleEndian
+        withUnsafeBytes(of: &sampleCount) { data.append(contentsOf: $0) }
+
+        // Scale to 0...255, round, and clip.
+        var quantizedSamples = [Float](repeating: 0, count: decibelSamples.count)
+        var scale = 255 / -silenceDecibelThreshold
+        var offset: Float = 255.5
+        vDSP_vsmsa(decibelSamples, 1, &scale, &offset, &quantizedSamples, 1, vDSP_Length(decibelSamples.count))
+        var low: Float = 0
+        var high: Float = 255.5
+        vDSP_vclip(quantizedSamples, 1, &low, &high, &quantizedSamples, 1, vDSP_Length(decibelSamples.count))
+        var bytes = [UInt8](repeating: 0, count: decibelSamples.count)
+        vDSP_vfixu8(quantizedSamples, 1, &bytes, 1, vDSP_Length(decibelSamples.count))
+        data.append(contentsOf: bytes)
+
+        return data
+    }
+
+    static func parseDecibelSamples(data: Data) throws -> [Float] {
+        guard data.count >= fileHeaderLength else {
+            throw OWSAssertionError("Waveform file is truncated")
+        }
+        let header = [UInt8](data.prefix(fileHeaderLength))
+        guard header[4] == fileVersion else {
+            throw OWSAssertionError("Unknown waveform file version: \(header[4])")
+        }
+        guard let sampleEncoding = SampleEncoding(rawValue: header[5]) else {
+            throw OWSAssertionError("Unknown waveform sample encoding: \(header[5])")
+        }
+        let sampleCount = Int(UInt32(header[8]) | UInt32(header[9]) << 8 | UInt32(header[10]) << 16 | UInt32(header[11]) << 24)
+        let sampleLength = sampleEncoding == .float32 ? MemoryLayout<Float32>.size : MemoryLayout<UInt8>.size
+        guard data.count == fileHeaderLength + sampleCount * sampleLength else {
+            throw OWSAssertionError("Waveform file has the wrong length")
+        }
+
+        var decibelSamples = [Float](repeating: 0, count: sampleCount)
+        guard sampleCount > 0 else {
+            return decibelSamples
+        }
+        data.withUnsafeBytes { (bytes: UnsafeRawBufferPointer) in
+            let sampleBytes = UnsafeRawBufferPointer(rebasing: bytes[fileHeaderLength...])
+            switch sampleEncoding {
+            case .float32:
+                // iOS is little-endian, so the samples can be copied as is.
+                decibelSamples.withUnsafeMutableBytes { $0.copyMemory(from: sampleBytes) }
+            case .uint8:
+                let quantizedSamples = sampleBytes.baseAddress!.assumingMemoryBound(to: UInt8.self)
+                vDSP_vfltu8(quantizedSamples, 1, &decibelSamples, 1, vDSP_Length(sampleCount))
+                var scale = -silenceDecibelThreshold / 255
+                var offset = silenceDecibelThreshold
+                vDSP_vsmsa(decibelSamples, 1, &scale, &offset, &decibelSamples, 1, vDSP_Length(sampleCount))
+            }
+        }
+        return decibelSamples
     }
 
     // MARK: -
@@ -68,15 +164,54 @@ public class AudioWaveform: NSObject {
             return nil
         }
 
-        // If we're trying to downsample to less samples than exist, just return what we have
-        guard decibelSamples.count > sampleCount else {
-            return decibelSamples.map { 1 - ($0 / AudioWaveform.silenceDecibelThreshold) }
+        // Every cell showing this waveform asks for the same sample
+        // count each time it lays out.
+        if let cachedLevels = cachedNormalizedLevels(sampleCount: sampleCount) {
+            return cachedLevels
         }
 
-        let downSampledData = downsample(samples: decibelSamples, toSampleCount: sampleCount)
+        // If we're trying to downsample to less samples than exist, just return what we have
+        let downSampledData: [Float]
+        if decibelSamples.count > sampleCount {
+            downSampledData = downsample(samples: decibelSamples, toSampleCount: sampleCount)
+        } else {
+            downSampledData = decibelSamples
+        }
 
         // Normalize to a range of 0-1 with 0 being silence.
-        return downSampledData.map { 1 - ($0 / AudioWaveform.silenceDecibelThreshold) }
+        var normalizedLevels = [Float](repeating: 0, count: downSampledData.count)
+        var scale = -1 / AudioWaveform.silenceDecibelThreshold
+        var offset: Float = 1
+        vDSP_vsmsa(downSampledData, 1, &scale, &offset, &normalizedLevels, 1, vDSP_Length(downSampledData.count))
+
+        setCachedNormalizedLevels(normalizedLevels, sampleCount: sampleCount)
+        return normalizedLevels
+    }
+
+    // MARK: - Levels Cache
+
+    // Should only be accessed while synchronized on self.
+    private var normalizedLevelsCache = [Int: [Float]]()
+
+    // A view only asks for a few sample counts over its lifetime, e.g. one
+    // per orientation.
+    private static let maxNormalizedLevelsCacheCount = 4
+
+    private func cachedNormalizedLevels(sampleCount: Int) -> [Float]? {
+        objc_sync_enter(self)
+        defer { objc_sync_exit(self) }
+
+        return normalizedLevelsCache[sampleCount]
+    }
+
+    private func setCachedNormalizedLevels(_ normalizedLevels: [Float], sampleCount: Int) {
+        objc_sync_enter(self)
+        defer { objc_sync_exit(self) }
+
+        if normalizedLevelsCache.count >= AudioWaveform.maxNormalizedLevelsCacheCount {
+            normalizedLevelsCache.removeAll()
+        }
+        normalizedLevelsCache[sampleCount] = normalizedLevels
     }
 
     // MARK: - Sampling
@@ -155,14 +290,17 @@ public class AudioWaveform: NSObject {
             return array
         }()
 
-        // If we can ever gurantee that `samples.count` is always a multiple of `sampleCount`, we should
-        // switch to using the faster `vDSP_desamp`. For now, we can't use it since it only supports the
-        // integer stride lengths. This should be okay, since this should only be operating on already
+        // `vDSP_desamp` only supports integer stride lengths, so each window is
+        // weighted with its own dot product. This only operates on already
         // downsampled data (~100 points) rather than the original millions of points.
-        let result: [Float] = (0..<sampleCount).map { downsampledIndex in
-            let sampleStart = Int(floor(Float(downsampledIndex) * sampleDistribution))
-            return samples[sampleStart..<sampleStart + sampleLength].enumerated().reduce(0) { result, value in
-                return result + distribution[value.offset] * value.element
+        var result = [Float](repeating: 0, count: sampleCount)
+        samples.withUnsafeBufferPointer { samplesPointer in
+            for downsampledIndex in 0..<sampleCount {
+                let sampleStart = min(Int(floor(Float(downsampledIndex) * sampleDistribution)), samples.count - sampleLength)
+                vDSP_dotpr(samplesPointer.baseAddress! + sampleStart, 1,
+                           distribution, 1,
+                           &result[downsampledIndex],
+                           vDSP_Length(sampleLength))
             }
         }
 
@@ -241,22 +379,35 @@ private class AudioWaveformSamplingOperation: Operation {
         guard !isCancelled else { return decibelSamples = nil }
     }
 
+    // Reads the track's samples and reduces each group of them to its RMS
+    // level in decibels.
+    //
+    // Each sample buffer is converted to floats in place and folded into a
+    // running sum of squares, so the track is never held in memory, and no
+    // sample is read more than once.
     private func readDecibels(from assetReader: AVAssetReader) -> [Float] {
-        var outputSamples = [Float]()
-        var readBuffer = Data()
+        guard let trackOutput = assetReader.outputs.first else {
+            owsFailDebug("track output unexpectedly missing")
+            return []
+        }
 
         let samplesToGroup = max(1, sampleCount(from: assetReader) / AudioWaveform.sampleCount)
 
+        // The mean square of each complete group.
+        var meanSquares = [Float]()
+        meanSquares.reserveCapacity(AudioWaveform.sampleCount + 1)
+        var groupSumOfSquares: Float = 0
+        var groupLength = 0
+
+        // Reused across sample buffers.
+        var amplitudes = [Float]()
+        var scratchSamples = [Int16]()
+
         assetReader.startReading()
         while assetReader.status == .reading {
             // Stop reading if the operation is cancelled.
             guard !isCancelled else { break }
 
-            guard let trackOutput = assetReader.outputs.first else {
-                owsFailDebug("track output unexpectedly missing")
-                break
-            }
-
             // Process any newly read data.
             guard let nextSampleBuffer = trackOutput.copyNextSampleBuffer(),
                 let blockBuffer = CMSampleBufferGetDataBuffer(nextSampleBuffer) else {
@@ -264,112 +415,105 @@ private class AudioWaveformSamplingOperation: Operation {
                     break
             }
 
-            var readBufferLength = 0
-            var readBufferPointer: UnsafeMutablePointer<Int8>?
-            CMBlockBufferGetDataPointer(
-                blockBuffer,
-                atOffset: 0,
-                lengthAtOffsetOut: &readBufferLength,
-                totalLengthOut: nil,
-                dataPointerOut: &readBufferPointer
-            )
-            readBuffer.append(UnsafeBufferPointer(start: readBufferPointer, count: readBufferLength))
-            CMSampleBufferInvalidate(nextSampleBuffer)
+            let byteCount = CMBlockBufferGetDataLength(blockBuffer)
+            let readSampleCount = byteCount / MemoryLayout<Int16>.size
+            if amplitudes.count < readSampleCount {
+                amplitudes = [Float](repeating: 0, count: readSampleCount)
+            }
 
-            // Try and process any pending samples, we may not have read enough data yet to do this.
-            let processedSamples = convertToDecibels(fromAmplitudes: readBuffer, from: assetReader, groupSize: samplesToGroup)
-            outputSamples += processedSamples
+            // Convert 16bit int amplitudes to float representation, reading
+            // the block buffer in place if it's contiguous.
+            var dataPointer: UnsafeMutablePointer<Int8>?
+            if CMBlockBufferIsRangeContiguous(blockBuffer, atOffset: 0, length: byteCount),
+                CMBlockBufferGetDataPointer(blockBuffer,
+                                            atOffset: 0,
+                                            lengthAtOffsetOut: nil,
+                                            totalLengthOut: nil,
+                                            dataPointerOut: &dataPointer) == kCMBlockBufferNoErr,
+                let dataPointer = dataPointer {
+                dataPointer.withMemoryRebound(to: Int16.self, capacity: readSampleCount) { samples in
+                    vDSP_vflt16(samples, 1, &amplitudes, 1, vDSP_Length(readSampleCount))
+                }
+            } else {
+                if scratchSamples.count < readSampleCount {
+                    scratchSamples = [Int16](repeating: 0, count: readSampleCount)
+                }
+                CMBlockBufferCopyDataBytes(blockBuffer,
+                                           atOffset: 0,
+                                           dataLength: readSampleCount * MemoryLayout<Int16>.size,
+                                           destination: &scratchSamples)
+                vDSP_vflt16(scratchSamples, 1, &amplitudes, 1, vDSP_Length(readSampleCount))
+            }
+            CMSampleBufferInvalidate(nextSampleBuffer)
 
-            // If we successfully processed samples, remove any processed samples
-            // from the read buffer.
-            if processedSamples.count > 0 {
-                readBuffer.removeFirst(processedSamples.count * samplesToGroup * MemoryLayout<Int16>.size)
+            // Fold the samples into groups. A group may span sample buffers.
+            amplitudes.withUnsafeBufferPointer { amplitudesPointer in
+                var offset = 0
+                while offset < readSampleCount {
+                    let length = min(samplesToGroup - groupLength, readSampleCount - offset)
+                    var sumOfSquares: Float = 0
+                    vDSP_svesq(amplitudesPointer.baseAddress! + offset, 1, &sumOfSquares, vDSP_Length(length))
+                    groupSumOfSquares += sumOfSquares
+                    groupLength += length
+                    offset += length
+
+                    if groupLength == samplesToGroup {
+                        meanSquares.append(groupSumOfSquares / Float(samplesToGroup))
+                        groupSumOfSquares = 0
+                        groupLength = 0
+                    }
+                }
             }
         }
 
-        return outputSamples
+        // Samples that don't fill a group are dropped, as they're a small
+        // fraction of one.
+        return AudioWaveform.convertToDecibels(meanSquares: meanSquares)
     }
 
     private func sampleCount(from assetReader: AVAssetReader) -> Int {
-        let samplesPerChannel = Int(assetReader.asset.duration.value)
+        guard let basicDescription = streamBasicDescription(from: assetReader) else { return 0 }
+
+        let samplesPerChannel = Int(assetReader.asset.duration.seconds * basicDescription.mSampleRate)
 
         // We will read in the samples from each channel, interleaved since
         // we only draw one waveform. This gives us an average of the channels
         // if it is, for example, a stereo audio file.
-        return samplesPerChannel * channelCount(from: assetReader)
+        return samplesPerChannel * Int(basicDescription.mChannelsPerFrame)
     }
 
-    private func channelCount(from assetReader: AVAssetReader) -> Int {
+    private func streamBasicDescription(from assetReader: AVAssetReader) -> AudioStreamBasicDescription? {
         guard let output = assetReader.outputs.first as? AVAssetReaderTrackOutput,
-            let formatDescriptions = output.track.formatDescriptions as? [CMFormatDescription] else { return 0 }
+            let formatDescriptions = output.track.formatDescriptions as? [CMFormatDescription] else { return nil }
 
-        var channelCount = 0
+        var result: AudioStreamBasicDescription?
 
         for description in formatDescriptions {
             guard let basicDescription = CMAudioFormatDescriptionGetStreamBasicDescription(description) else { continue }
-            channelCount = Int(basicDescription.pointee.mChannelsPerFrame)
+            result = basicDescription.pointee
         }
 
-        return channelCount
+        return result
     }
+}
 
-    private func convertToDecibels(fromAmplitudes sampleBuffer: Data, from assetReader: AVAssetReader, groupSize: Int) -> [Float] {
-        var downSampledData = [Float]()
-
-        sampleBuffer.withUnsafeBytes { samples in
-            let sampleLength = sampleBuffer.count / MemoryLayout<Int16>.size
-            var decibelSamples = [Float](repeating: 0.0, count: sampleLength)
-
-            // maximum amplitude storable in Int16 = 0 dB (loudest)
-            var zeroDecibelEquivalent: Float = Float(Int16.max)
-
-            var loudestClipValue: Float = 0.0
-            var quietestClipValue = AudioWaveform.silenceDecibelThreshold
-            let samplesToProcess = vDSP_Length(sampleLength)
-
-            // convert 16bit int amplitudes to float representation
-            vDSP_vflt16([Int16](samples.bindMemory(to: Int16.self)), 1, &decibelSamples, 1, samplesToProcess)
-
-            // take the absolute amplitude value
-            vDSP_vabs(decibelSamples, 1, &decibelSamples, 1, samplesToProcess)
-
-            // convert to dB
-            vDSP_vdbcon(decibelSamples, 1, &zeroDecibelEquivalent, &decibelSamples, 1, samplesToProcess, 1)
-
-            // clip between loudest + quietest
-            vDSP_vclip(decibelSamples, 1, &quietestClipValue, &loudestClipValue, &decibelSamples, 1, samplesToProcess)
-
-            let sampleCount = sampleLength / groupSize
-            downSampledData = downsample(samples: decibelSamples, toSampleCount: sampleCount)
-        }
-
-        return downSampledData
-    }
+extension AudioWaveform {
+    // Converts mean squares of 16bit amplitudes to decibels, clipped
+    // between silenceDecibelThreshold and 0.
+    static func convertToDecibels(meanSquares: [Float]) -> [Float] {
+        let count = vDSP_Length(meanSquares.count)
+        var decibelSamples = [Float](repeating: 0, count: meanSquares.count)
 
-    private func downsample(samples: [Float], toSampleCount sampleCount: Int) -> [Float] {
-        // Do nothing if the number of requested samples is less than 1
-        guard sampleCount > 0 else { return [] }
+        // The maximum amplitude storable in Int16 is 0 dB (loudest). Mean
+        // squares are powers, so are converted with 10 * log10.
+        var zeroDecibelEquivalent = Float(Int16.max) * Float(Int16.max)
+        vDSP_vdbcon(meanSquares, 1, &zeroDecibelEquivalent, &decibelSamples, 1, count, 0)
 
-        // Calculate the number of samples each resulting sample should span.
-        // If samples.count % sampleCount is > 0, that many samples will
-        // be omitted from the resulting array. This is okay, because we don't
-        // remove any unprocessed samples from the read buffer and will include
-        // them in the next group to downsample.
-        let strideLength = samples.count / sampleCount
-
-        // This filter indicates that we should evaluate each sample equally when downsampling.
-        let filter = [Float](repeating: 1.0 / Float(strideLength), count: strideLength)
-        var downSampledData = [Float](repeating: 0.0, count: sampleCount)
-
-        vDSP_desamp(
-            samples,
-            vDSP_Stride(strideLength),
-            filter,
-            &downSampledData,
-            vDSP_Length(sampleCount),
-            vDSP_Length(strideLength)
-        )
+        // Clip between loudest + quietest. Silence converts to -inf.
+        var loudestClipValue: Float = 0.0
+        var quietestClipValue = silenceDecibelThreshold
+        vDSP_vclip(decibelSamples, 1, &quietestClipValue, &loudestClipValue, &decibelSamples, 1, count)
 
-        return downSampledData
+        return decibelSamples
     }
 }
@@ -263,27 +263,33 @@ private class MemoryBencher: MemorySampler {
     @usableFromInline
     func residentMemorySize() -> mach_vm_size_t? {
         Logger.verbose("sampling")
-        var info = mach_task_basic_info()
-        let MACH_TASK_BASIC_INFO_COUNT = MemoryLayout<mach_task_basic_info>.stride/MemoryLayout<natural_t>.stride
-        var count = mach_msg_type_number_t(MACH_TASK_BASIC_INFO_COUNT)
-
-        let kerr: kern_return_t = withUnsafeMutablePointer(to: &info) {
-            $0.withMemoryRebound(to: integer_t.self, capacity: MACH_TASK_BASIC_INFO_COUNT) {
-                task_info(mach_task_self_,
-                          task_flavor_t(MACH_TASK_BASIC_INFO),
-                          $0,
-                          &count)
-            }
-        }
+        return BenchResidentMemorySize()
+    }
+}
 
-        if kerr == KERN_SUCCESS {
-            return info.resident_size
-        } else {
-            let errorString = (String(cString: mach_error_string(kerr), encoding: String.Encoding.ascii) ?? "unknown error")
-            owsFailDebug("error with task_info(): \(errorString)")
-            return nil
+/// The current resident memory size of the process, in bytes, or nil if
+/// it couldn't be determined.
+public func BenchResidentMemorySize() -> mach_vm_size_t? {
+    var info = mach_task_basic_info()
+    let MACH_TASK_BASIC_INFO_COUNT = MemoryLayout<mach_task_basic_info>.stride/MemoryLayout<natural_t>.stride
+    var count = mach_msg_type_number_t(MACH_TASK_BASIC_INFO_COUNT)
+
+    let kerr: kern_return_t = withUnsafeMutablePointer(to: &info) {
+        $0.withMemoryRebound(to: integer_t.self, capacity: MACH_TASK_BASIC_INFO_COUNT) {
+            task_info(mach_task_self_,
+                      task_flavor_t(MACH_TASK_BASIC_INFO),
+                      $0,
+                      &count)
         }
     }
+
+    if kerr == KERN_SUCCESS {
+        return info.resident_size
+    } else {
+        let errorString = (String(cString: mach_error_string(kerr), encoding: String.Encoding.ascii) ?? "unknown error")
+        owsFailDebug("error with task_info(): \(errorString)")
+        return nil
+    }
 }
 
 public extension Bool {
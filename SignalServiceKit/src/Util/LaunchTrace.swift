@@ -0,0 +1,120 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+
+// Records how long each step of app launch takes, so that we can see
+// where cold-start time goes. Each phase is also a Bench event, so it
+// shows up in debug logs as it completes; the full breakdown is logged
+// once the first frame has been presented.
+//
+//     [LaunchTrace.shared startPhase:@"Version migrations"];
+//     ...
+//     [LaunchTrace.shared completePhase:@"Version migrations"];
+@objc
+public class LaunchTrace: NSObject {
+
+    @objc
+    public static let shared = LaunchTrace()
+
+    public struct Phase {
+        public let name: String
+        public let startTime: CFTimeInterval
+        public let duration: CFTimeInterval
+    }
+
+    // Should only be accessed on serialQueue.
+    private var runningPhases = [String: CFTimeInterval]()
+    private var completedPhases = [Phase]()
+    private var hasPresentedFirstFrame = false
+
+    private let serialQueue = DispatchQueue(label: "org.signal.launchTrace")
+
+    @objc
+    public override init() {
+        super.init()
+    }
+
+    // MARK: -
+
+    private func benchEventId(phase: String) -> BenchmarkEventId {
+        return "launch.\(phase)"
+    }
+
+    @objc
+    public func startPhase(_ phase: String) {
+        let startTime = CACurrentMediaTime()
+        let isDuplicate: Bool = serialQueue.sync {
+            guard runningPhases[phase] == nil else {
+                return true
+            }
+            runningPhases[phase] = startTime
+            return false
+        }
+        guard !isDuplicate else {
+            owsFailDebug("Phase already started: \(phase)")
+            return
+        }
+        BenchEventStart(title: "Launch: \(phase)", eventId: benchEventId(phase: phase))
+    }
+
+    @objc
+    public func completePhase(_ phase: String) {
+        let endTime = CACurrentMediaTime()
+        let didComplete: Bool = serialQueue.sync {
+            guard let startTime = runningPhases.removeValue(forKey: phase) else {
+                return false
+            }
+            completedPhases.append(Phase(name: phase, startTime: startTime, duration: endTime - startTime))
+            return true
+        }
+        guard didComplete else {
+            owsFailDebug("Phase not started: \(phase)")
+            return
+        }
+        BenchEventComplete(eventId: benchEventId(phase: phase))
+    }
+
+    @objc
+    public func tracePhase(_ phase: String, block: () -> Void) {
+        startPhase(phase)
+        block()
+        completePhase(phase)
+    }
+
+    public var phases: [Phase] {
+        return serialQueue.sync { completedPhases }
+    }
+
+    @objc
+    public func duration(phase: String) -> CFTimeInterval {
+        return phases.filter { $0.name == phase }.reduce(0) { $0 + $1.duration }
+    }
+
+    // MARK: -
+
+    @objc
+    public func didPresentFirstFrame(launchStartedAt: CFTimeInterval) {
+        let firstFrameTime = CACurrentMediaTime()
+        let phases: [Phase]? = serialQueue.sync {
+            guard !hasPresentedFirstFrame else {
+                return nil
+            }
+            hasPresentedFirstFrame = true
+            return completedPhases
+        }
+        guard let launchPhases = phases else {
+            return
+        }
+
+        Logger.info(String(format: "First frame presented %0.2fms after launch started.",
+                           (firstFrameTime - launchStartedAt) * 1000))
+        for phase in launchPhases.sorted(by: { $0.startTime < $1.startTime }) {
+            Logger.info(String(format: "Launch phase: %@, started: +%0.2fms, duration: %0.2fms",
+                               phase.name,
+                               (phase.startTime - launchStartedAt) * 1000,
+                               phase.duration * 1000))
+        }
+    }
+}
@@ -26,8 +26,10 @@ NSString *NSStringForImageFormat(ImageFormat value);
 // These properties are only set if isValid is true.
 @property (nonatomic) ImageFormat imageFormat;
 @property (nonatomic) CGSize pixelSize;
-
-// TODO: We could add an hasAlpha property.
+@property (nonatomic) BOOL hasAlpha;
+@property (nonatomic) BOOL isAnimated;
+// 0 if the frames couldn't be counted from the image's headers.
+@property (nonatomic) NSUInteger frameCount;
 
 @end
 
@@ -5,8 +5,8 @@
 #import "NSData+Image.h"
 #import "MIMETypeUtil.h"
 #import "OWSFileSystem.h"
+#import "OWSImageProbe.h"
 #import "webp/decode.h"
-#import "webp/demux.h"
 #import <AVFoundation/AVFoundation.h>
 #import <SignalServiceKit/SignalServiceKit-Swift.h>
 #import <YYImage/YYImage.h>
@@ -40,12 +40,15 @@ NSString *NSStringForImageFormat(ImageFormat value)
 
 @implementation ImageData
 
-+ (instancetype)validWithImageFormat:(ImageFormat)imageFormat pixelSize:(CGSize)pixelSize
++ (instancetype)validWithHeader:(OWSImageHeader *)header
 {
     ImageData *imageData = [ImageData new];
     imageData.isValid = YES;
-    imageData.imageFormat = imageFormat;
-    imageData.pixelSize = pixelSize;
+    imageData.imageFormat = header.imageFormat;
+    imageData.pixelSize = header.pixelSize;
+    imageData.hasAlpha = header.hasAlpha;
+    imageData.isAnimated = header.isAnimated;
+    imageData.frameCount = header.frameCount;
     return imageData;
 }
 
@@ -120,7 +123,7 @@ NSString *NSStringForImageFormat(ImageFormat value)
     return YES;
 }
 
-- (nullable NSString *)mimeTypeForImageFormat:(ImageFormat)imageFormat
++ (nullable NSString *)mimeTypeForImageFormat:(ImageFormat)imageFormat
 {
     switch (imageFormat) {
         case ImageFormat_Unknown:
@@ -146,7 +149,7 @@ NSString *NSStringForImageFormat(ImageFormat value)
     return imageFormat == ImageFormat_Gif;
 }
 
-- (BOOL)ows_hasValidImageFormat:(ImageFormat)imageFormat
++ (BOOL)ows_hasValidImageFormatWithHeader:(OWSImageHeader *)header
 {
     // Don't trust the file extension; iOS (e.g. UIKit, Core Graphics) will happily
     // load a .gif with a .png file extension.
@@ -155,11 +158,11 @@ NSString *NSStringForImageFormat(ImageFormat value)
     //
     // If the image has a declared MIME type, ensure that agrees with the
     // deduced image format.
-    switch (imageFormat) {
+    switch (header.imageFormat) {
         case ImageFormat_Unknown:
             return NO;
         case ImageFormat_Gif:
-            return [self ows_hasValidGifSize];
+            return [self ows_hasValidGifSize:header.encodedPixelSize];
         case ImageFormat_Png:
         case ImageFormat_Tiff:
         case ImageFormat_Jpeg:
@@ -169,7 +172,7 @@ NSString *NSStringForImageFormat(ImageFormat value)
     }
 }
 
-- (BOOL)ows_isValidMimeType:(nullable NSString *)mimeType imageFormat:(ImageFormat)imageFormat
++ (BOOL)ows_isValidMimeType:(nullable NSString *)mimeType imageFormat:(ImageFormat)imageFormat
 {
     OWSAssertDebug(mimeType.length > 0);
 
@@ -228,55 +231,18 @@ NSString *NSStringForImageFormat(ImageFormat value)
     return ImageFormat_Unknown;
 }
 
-+ (BOOL)ows_areByteArraysEqual:(NSUInteger)length left:(unsigned char *)left right:(unsigned char *)right
-{
-    for (NSUInteger i = 0; i < length; i++) {
-        if (left[i] != right[i]) {
-            return NO;
-        }
-    }
-    return YES;
-}
-
-// Parse the GIF header to prevent the "GIF of death" issue.
+// The probe has parsed the GIF header; check its size to prevent the
+// "GIF of death" issue.
 //
 // See: https://blog.flanker017.me/cve-2017-2416-gif-remote-exec/
-// See: https://www.w3.org/Graphics/GIF/spec-gif89a.txt
-- (BOOL)ows_hasValidGifSize
++ (BOOL)ows_hasValidGifSize:(CGSize)size
 {
-    const NSUInteger kSignatureLength = 3;
-    const NSUInteger kVersionLength = 3;
-    const NSUInteger kWidthLength = 2;
-    const NSUInteger kHeightLength = 2;
-    const NSUInteger kPrefixLength = kSignatureLength + kVersionLength;
-    const NSUInteger kBufferLength = kSignatureLength + kVersionLength + kWidthLength + kHeightLength;
-
-    if (self.length < kBufferLength) {
-        return NO;
-    }
-
-    unsigned char bytes[kBufferLength];
-    [self getBytes:&bytes range:NSMakeRange(0, kBufferLength)];
-
-    unsigned char kGif87APrefix[kPrefixLength] = {
-        0x47, 0x49, 0x46, 0x38, 0x37, 0x61,
-    };
-    unsigned char kGif89APrefix[kPrefixLength] = {
-        0x47, 0x49, 0x46, 0x38, 0x39, 0x61,
-    };
-    if (![NSData ows_areByteArraysEqual:kPrefixLength left:bytes right:kGif87APrefix]
-        && ![NSData ows_areByteArraysEqual:kPrefixLength left:bytes right:kGif89APrefix]) {
-        return NO;
-    }
-    NSUInteger width = ((NSUInteger)bytes[kPrefixLength + 0]) | (((NSUInteger)bytes[kPrefixLength + 1] << 8));
-    NSUInteger height = ((NSUInteger)bytes[kPrefixLength + 2]) | (((NSUInteger)bytes[kPrefixLength + 3] << 8));
-
     // We need to ensure that the image size is "reasonable".
     // We impose an arbitrary "very large" limit on image size
     // to eliminate harmful values.
-    const NSUInteger kMaxValidSize = 1 << 18;
+    const CGFloat kMaxValidSize = 1 << 18;
 
-    return (width > 0 && width < kMaxValidSize && height > 0 && height < kMaxValidSize);
+    return (size.width > 0 && size.width < kMaxValidSize && size.height > 0 && size.height < kMaxValidSize);
 }
 
 + (CGSize)imageSizeForFilePath:(NSString *)filePath mimeType:(nullable NSString *)mimeType
@@ -288,93 +254,14 @@ NSString *NSStringForImageFormat(ImageFormat value)
     return imageData.pixelSize;
 }
 
-+ (CGSize)applyImageOrientation:(CGImagePropertyOrientation)orientation toImageSize:(CGSize)imageSize
-{
-    // NOTE: UIImageOrientation and CGImagePropertyOrientation values
-    //       DO NOT match.
-    switch (orientation) {
-        case kCGImagePropertyOrientationUp:
-        case kCGImagePropertyOrientationUpMirrored:
-        case kCGImagePropertyOrientationDown:
-        case kCGImagePropertyOrientationDownMirrored:
-            return imageSize;
-        case kCGImagePropertyOrientationLeft:
-        case kCGImagePropertyOrientationLeftMirrored:
-        case kCGImagePropertyOrientationRightMirrored:
-        case kCGImagePropertyOrientationRight:
-            return CGSizeMake(imageSize.height, imageSize.width);
-        default:
-            return imageSize;
-    }
-}
-
 + (BOOL)hasAlphaForValidImageFilePath:(NSString *)filePath
 {
-    if ([self isWebpFilePath:filePath]) {
-        return YES;
-    }
-
-    NSURL *url = [NSURL fileURLWithPath:filePath];
-
-    // With CGImageSource we avoid loading the whole image into memory.
-    CGImageSourceRef source = CGImageSourceCreateWithURL((CFURLRef)url, NULL);
-    if (!source) {
-        OWSFailDebug(@"Could not load image: %@", url);
+    OWSImageHeader *_Nullable header = [OWSImageProbe probeImageAtPath:filePath];
+    if (!header) {
+        OWSFailDebug(@"Could not load image: %@", filePath);
         return NO;
     }
-
-    NSDictionary *options = @{
-        (NSString *)kCGImageSourceShouldCache : @(NO),
-    };
-    NSDictionary *properties
-        = (__bridge_transfer NSDictionary *)CGImageSourceCopyPropertiesAtIndex(source, 0, (CFDictionaryRef)options);
-    BOOL result = NO;
-    if (properties) {
-        NSNumber *_Nullable hasAlpha = properties[(NSString *)kCGImagePropertyHasAlpha];
-        if (hasAlpha) {
-            result = hasAlpha.boolValue;
-        } else {
-            // This is not an error; kCGImagePropertyHasAlpha is an optional
-            // property.
-            OWSLogWarn(@"Could not determine transparency of image: %@", url);
-            result = NO;
-        }
-    }
-    CFRelease(source);
-    return result;
-}
-
-+ (BOOL)isWebpFilePath:(NSString *)filePath
-{
-    NSString *fileExtension = filePath.lastPathComponent.pathExtension.lowercaseString;
-    return [fileExtension isEqualToString:@"webp"];
-}
-
-+ (CGSize)sizeForWebpFilePath:(NSString *)filePath
-{
-    NSError *error = nil;
-    NSData *_Nullable data = [NSData dataWithContentsOfFile:filePath options:NSDataReadingMappedIfSafe error:&error];
-    if (!data || error) {
-        OWSLogError(@"Could not read image data: %@", error);
-        return CGSizeZero;
-    }
-    return [data sizeForWebpData];
-}
-
-- (CGSize)sizeForWebpData
-{
-    WebPData webPData = { 0 };
-    webPData.bytes = self.bytes;
-    webPData.size = self.length;
-    WebPDemuxer *demuxer = WebPDemux(&webPData);
-    if (!demuxer) {
-        return CGSizeZero;
-    }
-
-    uint32_t canvasWidth = WebPDemuxGetI(demuxer, WEBP_FF_CANVAS_WIDTH);
-    uint32_t canvasHeight = WebPDemuxGetI(demuxer, WEBP_FF_CANVAS_HEIGHT);
-    WebPDemuxDelete(demuxer);
-    return CGSizeMake(canvasWidth, canvasHeight);
+    return header.hasAlpha;
 }
 
 - (nullable UIImage *)stillForWebpData
@@ -394,17 +281,21 @@ NSString *NSStringForImageFormat(ImageFormat value)
 
 + (ImageData *)imageDataWithPath:(NSString *)filePath mimeType:(nullable NSString *)mimeType
 {
-    NSError *error = nil;
-    NSData *_Nullable data = [NSData dataWithContentsOfFile:filePath options:NSDataReadingMappedIfSafe error:&error];
-    if (!data || error) {
-        OWSLogError(@"Could not read image data: %@", error);
+    // Only the headers are read, not the whole file.
+    OWSImageHeader *_Nullable header = [OWSImageProbe probeImageAtPath:filePath];
+    if (!header) {
         return ImageData.invalid;
     }
-    // Use memory-mapped NSData instead of a URL-based
-    // CGImageSource. We should usually only be reading
-    // from (a small portion of) the file header,
-    // depending on the file format.
-    return [data imageDataWithPath:filePath mimeType:mimeType];
+    return [self imageDataWithHeader:header filePath:filePath mimeType:mimeType];
+}
+
+- (ImageData *)imageDataWithPath:(nullable NSString *)filePath mimeType:(nullable NSString *)declaredMimeType
+{
+    OWSImageHeader *_Nullable header = [OWSImageProbe probeImageData:self];
+    if (!header) {
+        return ImageData.invalid;
+    }
+    return [NSData imageDataWithHeader:header filePath:filePath mimeType:declaredMimeType];
 }
 
 // If filePath and/or declaredMimeType is supplied, we warn
@@ -413,14 +304,13 @@ NSString *NSStringForImageFormat(ImageFormat value)
 // using magic numbers) to be authoritative.  The file extension
 // and declared MIME type could be wrong, but we can proceed in
 // that case.
-//
-// If maxImageDimension is supplied we enforce the _smaller_ of
-// that value and the per-format max dimension
-- (ImageData *)imageDataWithPath:(nullable NSString *)filePath mimeType:(nullable NSString *)declaredMimeType
++ (ImageData *)imageDataWithHeader:(OWSImageHeader *)header
+                          filePath:(nullable NSString *)filePath
+                          mimeType:(nullable NSString *)declaredMimeType
 {
-    ImageFormat imageFormat = [self ows_guessImageFormat];
+    ImageFormat imageFormat = header.imageFormat;
 
-    if (![self ows_hasValidImageFormat:imageFormat]) {
+    if (![self ows_hasValidImageFormatWithHeader:header]) {
         return ImageData.invalid;
     }
 
@@ -448,95 +338,27 @@ NSString *NSStringForImageFormat(ImageFormat value)
 
     const NSUInteger kMaxFileSize
         = (isAnimated ? OWSMediaUtils.kMaxFileSizeAnimatedImage : OWSMediaUtils.kMaxFileSizeImage);
-    NSUInteger fileSize = self.length;
-    if (fileSize > kMaxFileSize) {
+    if (header.fileSize > kMaxFileSize) {
         OWSLogWarn(@"Oversize image.");
         return ImageData.invalid;
     }
 
-    return [self imageDataWithIsAnimated:isAnimated imageFormat:imageFormat];
-}
-
-- (ImageData *)imageDataWithIsAnimated:(BOOL)isAnimated imageFormat:(ImageFormat)imageFormat
-{
-    if (imageFormat == ImageFormat_Webp) {
-        CGSize imageSize = [self sizeForWebpData];
-        if (![NSData ows_isValidImageDimension:imageSize depthBytes:1 isAnimated:YES]) {
-            return ImageData.invalid;
-        }
-        return [ImageData validWithImageFormat:imageFormat pixelSize:imageSize];
-    }
-
-    CGImageSourceRef imageSource = CGImageSourceCreateWithData((__bridge CFDataRef)self, NULL);
-    if (imageSource == NULL) {
+    if (!header.isRGBOrGray) {
+        OWSLogError(@"Invalid color model.");
         return ImageData.invalid;
     }
-    ImageData *imageData = [NSData imageDataWithImageSource:imageSource imageFormat:imageFormat isAnimated:isAnimated];
-    CFRelease(imageSource);
-    return imageData;
-}
-
-+ (ImageData *)imageDataWithImageSource:(CGImageSourceRef)imageSource
-                            imageFormat:(ImageFormat)imageFormat
-                             isAnimated:(BOOL)isAnimated
-{
-    OWSAssertDebug(imageSource);
 
-    NSDictionary *imageProperties
-        = (__bridge_transfer NSDictionary *)CGImageSourceCopyPropertiesAtIndex(imageSource, 0, NULL);
-
-    if (!imageProperties) {
-        return ImageData.invalid;
-    }
-
-    NSNumber *_Nullable orientationNumber = imageProperties[(__bridge NSString *)kCGImagePropertyOrientation];
-
-    NSNumber *widthNumber = imageProperties[(__bridge NSString *)kCGImagePropertyPixelWidth];
-    if (!widthNumber) {
-        OWSLogError(@"widthNumber was unexpectedly nil");
-        return ImageData.invalid;
-    }
-
-    NSNumber *heightNumber = imageProperties[(__bridge NSString *)kCGImagePropertyPixelHeight];
-    if (!heightNumber) {
-        OWSLogError(@"heightNumber was unexpectedly nil");
-        return ImageData.invalid;
-    }
-
-    CGSize pixelSize = CGSizeMake(widthNumber.floatValue, heightNumber.floatValue);
-    if (orientationNumber != nil) {
-        pixelSize = [self applyImageOrientation:(CGImagePropertyOrientation)orientationNumber.intValue
-                                    toImageSize:pixelSize];
-    }
-
-    /* The number of bits in each color sample of each pixel. The value of this
-     * key is a CFNumberRef. */
-    NSNumber *depthNumber = imageProperties[(__bridge NSString *)kCGImagePropertyDepth];
-    if (!depthNumber) {
-        OWSLogError(@"depthNumber was unexpectedly nil");
-        return ImageData.invalid;
-    }
-    NSUInteger depthBits = depthNumber.unsignedIntegerValue;
     // This should usually be 1.
-    CGFloat depthBytes = (CGFloat)ceil(depthBits / 8.f);
-
-    /* The color model of the image such as "RGB", "CMYK", "Gray", or "Lab".
-     * The value of this key is CFStringRef. */
-    NSString *colorModel = imageProperties[(__bridge NSString *)kCGImagePropertyColorModel];
-    if (!colorModel) {
-        OWSLogError(@"colorModel was unexpectedly nil");
-        return ImageData.invalid;
-    }
-    if (![colorModel isEqualToString:(__bridge NSString *)kCGImagePropertyColorModelRGB]
-        && ![colorModel isEqualToString:(__bridge NSString *)kCGImagePropertyColorModelGray]) {
-        OWSLogError(@"Invalid colorModel: %@", colorModel);
-        return ImageData.invalid;
+    CGFloat depthBytes = (CGFloat)ceil(header.depthBits / 8.f);
+    if (imageFormat == ImageFormat_Webp) {
+        // Any WebP might be animated, so we apply the stricter limit.
+        depthBytes = 1;
+        isAnimated = YES;
     }
-
-    if (![self ows_isValidImageDimension:pixelSize depthBytes:depthBytes isAnimated:isAnimated]) {
+    if (![self ows_isValidImageDimension:header.pixelSize depthBytes:depthBytes isAnimated:isAnimated]) {
         return ImageData.invalid;
     }
-    return [ImageData validWithImageFormat:imageFormat pixelSize:pixelSize];
+    return [ImageData validWithHeader:header];
 }
 
 @end
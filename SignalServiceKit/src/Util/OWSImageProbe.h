@@ -0,0 +1,57 @@
+//
+//  Copyright (c) 2020 Open Whisper Systems. All rights reserved.
+//
+
+#import <ImageIO/ImageIO.h>
+#import <SignalServiceKit/NSData+Image.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+// What an image's headers say about it.
+@interface OWSImageHeader : NSObject
+
+@property (nonatomic, readonly) ImageFormat imageFormat;
+
+// The stored pixel size, before orientation is applied.
+@property (nonatomic, readonly) CGSize encodedPixelSize;
+@property (nonatomic, readonly) CGImagePropertyOrientation orientation;
+// The pixel size with orientation applied.
+@property (nonatomic, readonly) CGSize pixelSize;
+
+// The number of bits in each color sample.
+@property (nonatomic, readonly) NSUInteger depthBits;
+// NO for color models we don't support, e.g. CMYK.
+@property (nonatomic, readonly) BOOL isRGBOrGray;
+@property (nonatomic, readonly) BOOL hasAlpha;
+
+@property (nonatomic, readonly) BOOL isAnimated;
+// 0 if the frames can't be counted from the headers, e.g. for a long GIF.
+@property (nonatomic, readonly) NSUInteger frameCount;
+
+@property (nonatomic, readonly) unsigned long long fileSize;
+
+// The number of bytes read to probe the image.
+@property (nonatomic, readonly) NSUInteger bytesRead;
+
+@end
+
+#pragma mark -
+
+// Parses image headers without decoding or reading the whole image.
+//
+// JPEG, PNG, GIF and WebP headers are parsed directly, seeking past
+// segments that don't describe the image, so a probe typically reads a
+// few KB regardless of file size. Other formats fall back to ImageIO's
+// image properties.
+@interface OWSImageProbe : NSObject
+
+- (instancetype)init NS_UNAVAILABLE;
+
+// Returns nil if the file can't be read or its headers can't be parsed.
++ (nullable OWSImageHeader *)probeImageAtPath:(NSString *)filePath;
+
++ (nullable OWSImageHeader *)probeImageData:(NSData *)data;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,664 @@
+//
+//  Copyright (c) 2020 Open Whisper Systems. All rights reserved.
+//
+
+#import "OWSImageProbe.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Reads are rounded up to this, so that consecutive small reads of
+// neighbouring headers are served by one read of the file.
+static const NSUInteger kReadWindowLength = 4 * 1024;
+
+// Past this, we stop walking frames and leave them uncounted.
+static const NSUInteger kMaxFrameCountReadLength = 64 * 1024;
+
+// Limits on how far we'll look for the headers we need, in case the file
+// is malformed.
+static const NSUInteger kMaxSegmentCount = 512;
+static const NSUInteger kMaxExifReadLength = 16 * 1024;
+
+static uint16_t ReadUInt16BE(const uint8_t *bytes)
+{
+    return (uint16_t)(((uint16_t)bytes[0] << 8) | bytes[1]);
+}
+
+static uint16_t ReadUInt16LE(const uint8_t *bytes)
+{
+    return (uint16_t)(bytes[0] | ((uint16_t)bytes[1] << 8));
+}
+
+static uint32_t ReadUInt24LE(const uint8_t *bytes)
+{
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16);
+}
+
+static uint32_t ReadUInt32BE(const uint8_t *bytes)
+{
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3];
+}
+
+static uint32_t ReadUInt32LE(const uint8_t *bytes)
+{
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static BOOL HasFourCC(const uint8_t *bytes, const char *fourCC)
+{
+    return memcmp(bytes, fourCC, 4) == 0;
+}
+
+#pragma mark -
+
+@interface OWSImageProbeReader : NSObject
+
+@property (nonatomic, readonly) unsigned long long length;
+@property (nonatomic, readonly) NSUInteger bytesRead;
+
+@end
+
+#pragma mark -
+
+@implementation OWSImageProbeReader {
+    NSFileHandle *_Nullable _fileHandle;
+    NSData *_Nullable _data;
+
+    NSData *_Nullable _window;
+    unsigned long long _windowOffset;
+}
+
+- (nullable instancetype)initWithFilePath:(NSString *)filePath
+{
+    NSFileHandle *_Nullable fileHandle = [NSFileHandle fileHandleForReadingAtPath:filePath];
+    if (!fileHandle) {
+        OWSLogError(@"Could not open image file.");
+        return nil;
+    }
+
+    if (self = [super init]) {
+        _fileHandle = fileHandle;
+        _length = [fileHandle seekToEndOfFile];
+    }
+
+    return self;
+}
+
+- (instancetype)initWithData:(NSData *)data
+{
+    if (self = [super init]) {
+        _data = data;
+        _length = data.length;
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_fileHandle closeFile];
+}
+
+// Returns nil if there aren't length bytes at offset.
+- (nullable NSData *)dataAtOffset:(unsigned long long)offset length:(NSUInteger)length
+{
+    if (offset > self.length || length > self.length - offset) {
+        return nil;
+    }
+
+    if (_data != nil) {
+        _bytesRead += length;
+        return [_data subdataWithRange:NSMakeRange((NSUInteger)offset, length)];
+    }
+
+    if (_window != nil && offset >= _windowOffset && offset + length <= _windowOffset + _window.length) {
+        return [_window subdataWithRange:NSMakeRange((NSUInteger)(offset - _windowOffset), length)];
+    }
+
+    NSUInteger readLength = (NSUInteger)MIN(MAX(length, kReadWindowLength), self.length - offset);
+    NSData *window;
+    @try {
+        [_fileHandle seekToFileOffset:offset];
+        window = [_fileHandle readDataOfLength:readLength];
+    } @catch (NSException *exception) {
+        OWSLogError(@"Could not read image file: %@", exception);
+        return nil;
+    }
+    _bytesRead += window.length;
+    if (window.length < length) {
+        return nil;
+    }
+    _window = window;
+    _windowOffset = offset;
+    return [window subdataWithRange:NSMakeRange(0, length)];
+}
+
+@end
+
+#pragma mark -
+
+@interface OWSImageHeader ()
+
+@property (nonatomic) ImageFormat imageFormat;
+@property (nonatomic) CGSize encodedPixelSize;
+@property (nonatomic) CGImagePropertyOrientation orientation;
+@property (nonatomic) NSUInteger depthBits;
+@property (nonatomic) BOOL isRGBOrGray;
+@property (nonatomic) BOOL hasAlpha;
+@property (nonatomic) BOOL isAnimated;
+@property (nonatomic) NSUInteger frameCount;
+@property (nonatomic) unsigned long long fileSize;
+@property (nonatomic) NSUInteger bytesRead;
+
+@end
+
+#pragma mark -
+
+@implementation OWSImageHeader
+
+- (instancetype)initWithImageFormat:(ImageFormat)imageFormat
+{
+    if (self = [super init]) {
+        _imageFormat = imageFormat;
+        _orientation = kCGImagePropertyOrientationUp;
+        _depthBits = 8;
+        _isRGBOrGray = YES;
+        _frameCount = 1;
+    }
+
+    return self;
+}
+
+- (CGSize)pixelSize
+{
+    // NOTE: UIImageOrientation and CGImagePropertyOrientation values
+    //       DO NOT match.
+    switch (self.orientation) {
+        case kCGImagePropertyOrientationLeft:
+        case kCGImagePropertyOrientationLeftMirrored:
+        case kCGImagePropertyOrientationRightMirrored:
+        case kCGImagePropertyOrientationRight:
+            return CGSizeMake(self.encodedPixelSize.height, self.encodedPixelSize.width);
+        default:
+            return self.encodedPixelSize;
+    }
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@: %@, %@, orientation: %d, depth: %lu, alpha: %d, frames: %lu>",
+                     self.class,
+                     NSStringForImageFormat(self.imageFormat),
+                     NSStringFromCGSize(self.encodedPixelSize),
+                     (int)self.orientation,
+                     (unsigned long)self.depthBits,
+                     self.hasAlpha,
+                     (unsigned long)self.frameCount];
+}
+
+@end
+
+#pragma mark -
+
+@implementation OWSImageProbe
+
++ (nullable OWSImageHeader *)probeImageAtPath:(NSString *)filePath
+{
+    OWSImageProbeReader *_Nullable reader = [[OWSImageProbeReader alloc] initWithFilePath:filePath];
+    if (!reader) {
+        return nil;
+    }
+    return [self probeWithReader:reader
+              imageSourceBlock:^{
+                  return CGImageSourceCreateWithURL((__bridge CFURLRef)[NSURL fileURLWithPath:filePath], NULL);
+              }];
+}
+
++ (nullable OWSImageHeader *)probeImageData:(NSData *)data
+{
+    OWSImageProbeReader *reader = [[OWSImageProbeReader alloc] initWithData:data];
+    return [self probeWithReader:reader
+              imageSourceBlock:^{
+                  return CGImageSourceCreateWithData((__bridge CFDataRef)data, NULL);
+              }];
+}
+
++ (nullable OWSImageHeader *)probeWithReader:(OWSImageProbeReader *)reader
+                            imageSourceBlock:(CGImageSourceRef _Nullable (^)(void))imageSourceBlock
+{
+    NSData *_Nullable signature = [reader dataAtOffset:0 length:2];
+    if (!signature) {
+        return nil;
+    }
+    const uint8_t *bytes = signature.bytes;
+
+    OWSImageHeader *_Nullable header;
+    if (bytes[0] == 0x47 && bytes[1] == 0x49) {
+        header = [self probeGifWithReader:reader];
+    } else if (bytes[0] == 0x89 && bytes[1] == 0x50) {
+        header = [self probePngWithReader:reader];
+    } else if (bytes[0] == 0xff && bytes[1] == 0xd8) {
+        header = [self probeJpegWithReader:reader];
+    } else if (bytes[0] == 0x52 && bytes[1] == 0x49) {
+        // First two letters of RIFF tag.
+        header = [self probeWebpWithReader:reader];
+    } else if (bytes[0] == 0x42 && bytes[1] == 0x4d) {
+        header = [self probeWithImageSourceBlock:imageSourceBlock imageFormat:ImageFormat_Bmp];
+    } else if ((bytes[0] == 0x4D && bytes[1] == 0x4D) || (bytes[0] == 0x49 && bytes[1] == 0x49)) {
+        // Motorola or Intel byte order TIFF
+        header = [self probeWithImageSourceBlock:imageSourceBlock imageFormat:ImageFormat_Tiff];
+    }
+
+    header.fileSize = reader.length;
+    header.bytesRead = reader.bytesRead;
+    return header;
+}
+
+#pragma mark - JPEG
+
+// See: https://www.w3.org/Graphics/JPEG/itu-t81.pdf
++ (nullable OWSImageHeader *)probeJpegWithReader:(OWSImageProbeReader *)reader
+{
+    CGImagePropertyOrientation orientation = kCGImagePropertyOrientationUp;
+    unsigned long long offset = 2;
+
+    for (NSUInteger segmentCount = 0; segmentCount < kMaxSegmentCount; segmentCount++) {
+        NSData *_Nullable markerData = [reader dataAtOffset:offset length:4];
+        if (!markerData) {
+            return nil;
+        }
+        const uint8_t *markerBytes = markerData.bytes;
+        if (markerBytes[0] != 0xff) {
+            return nil;
+        }
+        uint8_t marker = markerBytes[1];
+        if (marker == 0xff) {
+            // Fill byte.
+            offset += 1;
+            continue;
+        }
+        if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd8)) {
+            // Markers without a segment.
+            offset += 2;
+            continue;
+        }
+        if (marker == 0xd9 || marker == 0xda) {
+            // The image ended or its data began without a frame header.
+            return nil;
+        }
+
+        uint16_t segmentLength = ReadUInt16BE(markerBytes + 2);
+        if (segmentLength < 2) {
+            return nil;
+        }
+
+        BOOL isStartOfFrame = (marker >= 0xc0 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc);
+        if (isStartOfFrame) {
+            NSData *_Nullable frameData = [reader dataAtOffset:offset + 4 length:6];
+            if (!frameData) {
+                return nil;
+            }
+            const uint8_t *frameBytes = frameData.bytes;
+
+            OWSImageHeader *header = [[OWSImageHeader alloc] initWithImageFormat:ImageFormat_Jpeg];
+            header.depthBits = frameBytes[0];
+            header.encodedPixelSize = CGSizeMake(ReadUInt16BE(frameBytes + 3), ReadUInt16BE(frameBytes + 1));
+            // 1 component is gray, 3 are YCbCr. 4 are CMYK or YCCK.
+            uint8_t componentCount = frameBytes[5];
+            header.isRGBOrGray = (componentCount == 1 || componentCount == 3);
+            header.orientation = orientation;
+            return header;
+        }
+
+        if (marker == 0xe1) {
+            // The orientation is in IFD0, at the start of the segment.
+            NSUInteger exifLength = MIN(segmentLength - 2, kMaxExifReadLength);
+            NSData *_Nullable exifData = [reader dataAtOffset:offset + 4 length:exifLength];
+            if (exifData) {
+                orientation = [self orientationForExifData:exifData] ?: orientation;
+            }
+        }
+
+        offset += 2 + segmentLength;
+    }
+
+    return nil;
+}
+
+// Returns 0 if the orientation is missing or invalid.
++ (CGImagePropertyOrientation)orientationForExifData:(NSData *)exifData
+{
+    const NSUInteger kExifHeaderLength = 6;
+    const NSUInteger kTiffHeaderLength = 8;
+    const NSUInteger kEntryLength = 12;
+    const uint16_t kOrientationTag = 0x0112;
+
+    if (exifData.length < kExifHeaderLength + kTiffHeaderLength || memcmp(exifData.bytes, "Exif\0\0", 6) != 0) {
+        return 0;
+    }
+    const uint8_t *tiffBytes = (const uint8_t *)exifData.bytes + kExifHeaderLength;
+    NSUInteger tiffLength = exifData.length - kExifHeaderLength;
+
+    BOOL isLittleEndian;
+    if (tiffBytes[0] == 'I' && tiffBytes[1] == 'I') {
+        isLittleEndian = YES;
+    } else if (tiffBytes[0] == 'M' && tiffBytes[1] == 'M') {
+        isLittleEndian = NO;
+    } else {
+        return 0;
+    }
+    uint16_t (^readShort)(NSUInteger) = ^(NSUInteger index) {
+        return isLittleEndian ? ReadUInt16LE(tiffBytes + index) : ReadUInt16BE(tiffBytes + index);
+    };
+    uint32_t ifdOffset = isLittleEndian ? ReadUInt32LE(tiffBytes + 4) : ReadUInt32BE(tiffBytes + 4);
+    if (ifdOffset > tiffLength - 2) {
+        return 0;
+    }
+
+    uint16_t entryCount = readShort(ifdOffset);
+    for (NSUInteger entryIndex = 0; entryIndex < entryCount; entryIndex++) {
+        NSUInteger entryOffset = ifdOffset + 2 + entryIndex * kEntryLength;
+        if (entryOffset + kEntryLength > tiffLength) {
+            return 0;
+        }
+        if (readShort(entryOffset) == kOrientationTag) {
+            uint16_t value = readShort(entryOffset + 8);
+            if (value < kCGImagePropertyOrientationUp || value > kCGImagePropertyOrientationLeft) {
+                return 0;
+            }
+            return (CGImagePropertyOrientation)value;
+        }
+    }
+    return 0;
+}
+
+#pragma mark - PNG
+
+// See: https://www.w3.org/TR/PNG/ and https://wiki.mozilla.org/APNG_Specification
++ (nullable OWSImageHeader *)probePngWithReader:(OWSImageProbeReader *)reader
+{
+    const NSUInteger kSignatureLength = 8;
+    const NSUInteger kChunkHeaderLength = 8;
+    const NSUInteger kChunkCrcLength = 4;
+    const NSUInteger kImageHeaderLength = 13;
+
+    NSData *_Nullable headerData = [reader dataAtOffset:0
+                                                 length:kSignatureLength + kChunkHeaderLength + kImageHeaderLength];
+    if (!headerData) {
+        return nil;
+    }
+    const uint8_t *headerBytes = headerData.bytes;
+    const uint8_t kPngSignature[kSignatureLength] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    if (memcmp(headerBytes, kPngSignature, kSignatureLength) != 0
+        || !HasFourCC(headerBytes + kSignatureLength + 4, "IHDR")) {
+        return nil;
+    }
+    const uint8_t *imageHeaderBytes = headerBytes + kSignatureLength + kChunkHeaderLength;
+    uint8_t colorType = imageHeaderBytes[9];
+
+    OWSImageHeader *header = [[OWSImageHeader alloc] initWithImageFormat:ImageFormat_Png];
+    header.encodedPixelSize = CGSizeMake(ReadUInt32BE(imageHeaderBytes), ReadUInt32BE(imageHeaderBytes + 4));
+    header.depthBits = imageHeaderBytes[8];
+    // Gray, RGB, indexed, gray with alpha, RGB with alpha.
+    header.isRGBOrGray = (colorType == 0 || colorType == 2 || colorType == 3 || colorType == 4 || colorType == 6);
+    header.hasAlpha = (colorType == 4 || colorType == 6);
+
+    // Transparency and animation chunks precede the image data.
+    unsigned long long offset = kSignatureLength + kChunkHeaderLength + kImageHeaderLength + kChunkCrcLength;
+    for (NSUInteger chunkCount = 0; chunkCount < kMaxSegmentCount; chunkCount++) {
+        NSData *_Nullable chunkData = [reader dataAtOffset:offset length:kChunkHeaderLength + 4];
+        if (!chunkData) {
+            break;
+        }
+        const uint8_t *chunkBytes = chunkData.bytes;
+        uint32_t chunkLength = ReadUInt32BE(chunkBytes);
+        const uint8_t *chunkType = chunkBytes + 4;
+
+        if (HasFourCC(chunkType, "IDAT") || HasFourCC(chunkType, "IEND")) {
+            break;
+        } else if (HasFourCC(chunkType, "tRNS")) {
+            header.hasAlpha = YES;
+        } else if (HasFourCC(chunkType, "acTL")) {
+            uint32_t frameCount = ReadUInt32BE(chunkBytes + kChunkHeaderLength);
+            header.frameCount = frameCount;
+            header.isAnimated = frameCount > 1;
+        }
+
+        offset += kChunkHeaderLength + chunkLength + kChunkCrcLength;
+    }
+
+    return header;
+}
+
+#pragma mark - GIF
+
+// See: https://www.w3.org/Graphics/GIF/spec-gif89a.txt
++ (nullable OWSImageHeader *)probeGifWithReader:(OWSImageProbeReader *)reader
+{
+    const NSUInteger kHeaderLength = 13;
+    const NSUInteger kImageDescriptorLength = 10;
+
+    NSData *_Nullable headerData = [reader dataAtOffset:0 length:kHeaderLength];
+    if (!headerData) {
+        return nil;
+    }
+    const uint8_t *headerBytes = headerData.bytes;
+    if (memcmp(headerBytes, "GIF87a", 6) != 0 && memcmp(headerBytes, "GIF89a", 6) != 0) {
+        return nil;
+    }
+
+    OWSImageHeader *header = [[OWSImageHeader alloc] initWithImageFormat:ImageFormat_Gif];
+    header.encodedPixelSize = CGSizeMake(ReadUInt16LE(headerBytes + 6), ReadUInt16LE(headerBytes + 8));
+
+    uint8_t flags = headerBytes[10];
+    unsigned long long offset = kHeaderLength + [self gifColorTableLengthWithFlags:flags];
+
+    // Walk the blocks to count frames, seeking past the image data. The
+    // blocks are walked in order, so the budget is checked against the
+    // offset rather than bytesRead, which only counts the bytes requested
+    // when probing data in memory.
+    NSUInteger frameCount = 0;
+    BOOL hasLoopExtension = NO;
+    BOOL didReachTrailer = NO;
+    while (offset <= kMaxFrameCountReadLength) {
+        NSData *_Nullable blockData = [reader dataAtOffset:offset length:1];
+        if (!blockData) {
+            break;
+        }
+        uint8_t blockType = ((const uint8_t *)blockData.bytes)[0];
+
+        if (blockType == 0x21) {
+            // Extension.
+            NSData *_Nullable extensionData = [reader dataAtOffset:offset + 1 length:3];
+            if (!extensionData) {
+                break;
+            }
+            const uint8_t *extensionBytes = extensionData.bytes;
+            uint8_t label = extensionBytes[0];
+            if (label == 0xf9) {
+                // Graphic control extension.
+                header.hasAlpha = header.hasAlpha || (extensionBytes[2] & 0x01) != 0;
+            } else if (label == 0xff && extensionBytes[1] == 11) {
+                // Application extension.
+                NSData *_Nullable identifierData = [reader dataAtOffset:offset + 3 length:11];
+                hasLoopExtension = hasLoopExtension
+                    || (identifierData != nil
+                        && (memcmp(identifierData.bytes, "NETSCAPE2.0", 11) == 0
+                            || memcmp(identifierData.bytes, "ANIMEXTS1.0", 11) == 0));
+            }
+            offset = [self offsetAfterGifSubBlocksAtOffset:offset + 2 reader:reader];
+        } else if (blockType == 0x2c) {
+            // Image descriptor.
+            NSData *_Nullable descriptorData = [reader dataAtOffset:offset length:kImageDescriptorLength];
+            if (!descriptorData) {
+                break;
+            }
+            uint8_t descriptorFlags = ((const uint8_t *)descriptorData.bytes)[9];
+            frameCount++;
+            // Skip the local color table and the LZW minimum code size.
+            offset += kImageDescriptorLength + [self gifColorTableLengthWithFlags:descriptorFlags] + 1;
+            offset = [self offsetAfterGifSubBlocksAtOffset:offset reader:reader];
+        } else if (blockType == 0x3b) {
+            didReachTrailer = YES;
+            break;
+        } else {
+            break;
+        }
+
+        if (offset == 0) {
+            break;
+        }
+    }
+
+    header.isAnimated = hasLoopExtension || frameCount > 1;
+    header.frameCount = didReachTrailer ? frameCount : 0;
+    return header;
+}
+
++ (NSUInteger)gifColorTableLengthWithFlags:(uint8_t)flags
+{
+    if ((flags & 0x80) == 0) {
+        return 0;
+    }
+    return 3 * (1 << ((flags & 0x07) + 1));
+}
+
+// Returns 0 if the sub-blocks are truncated or run past kMaxFrameCountReadLength.
++ (unsigned long long)offsetAfterGifSubBlocksAtOffset:(unsigned long long)offset reader:(OWSImageProbeReader *)reader
+{
+    while (offset <= kMaxFrameCountReadLength) {
+        NSData *_Nullable sizeData = [reader dataAtOffset:offset length:1];
+        if (!sizeData) {
+            return 0;
+        }
+        uint8_t blockSize = ((const uint8_t *)sizeData.bytes)[0];
+        offset += 1 + blockSize;
+        if (blockSize == 0) {
+            return offset;
+        }
+    }
+    return 0;
+}
+
+#pragma mark - WebP
+
+// See: https://developers.google.com/speed/webp/docs/riff_container
++ (nullable OWSImageHeader *)probeWebpWithReader:(OWSImageProbeReader *)reader
+{
+    const NSUInteger kRiffHeaderLength = 12;
+    const NSUInteger kChunkHeaderLength = 8;
+    const NSUInteger kMaxImageHeaderLength = 10;
+
+    NSData *_Nullable headerData =
+        [reader dataAtOffset:0 length:kRiffHeaderLength + kChunkHeaderLength + kMaxImageHeaderLength];
+    if (!headerData) {
+        return nil;
+    }
+    const uint8_t *headerBytes = headerData.bytes;
+    if (!HasFourCC(headerBytes, "RIFF") || !HasFourCC(headerBytes + 8, "WEBP")) {
+        return nil;
+    }
+    const uint8_t *chunkType = headerBytes + kRiffHeaderLength;
+    uint32_t chunkLength = ReadUInt32LE(headerBytes + kRiffHeaderLength + 4);
+    const uint8_t *imageHeaderBytes = headerBytes + kRiffHeaderLength + kChunkHeaderLength;
+
+    OWSImageHeader *header = [[OWSImageHeader alloc] initWithImageFormat:ImageFormat_Webp];
+    if (HasFourCC(chunkType, "VP8 ")) {
+        // Simple lossy.
+        if (imageHeaderBytes[3] != 0x9d || imageHeaderBytes[4] != 0x01 || imageHeaderBytes[5] != 0x2a) {
+            return nil;
+        }
+        header.encodedPixelSize
+            = CGSizeMake(ReadUInt16LE(imageHeaderBytes + 6) & 0x3fff, ReadUInt16LE(imageHeaderBytes + 8) & 0x3fff);
+    } else if (HasFourCC(chunkType, "VP8L")) {
+        // Simple lossless.
+        if (imageHeaderBytes[0] != 0x2f) {
+            return nil;
+        }
+        uint32_t bits = ReadUInt32LE(imageHeaderBytes + 1);
+        header.encodedPixelSize = CGSizeMake((bits & 0x3fff) + 1, ((bits >> 14) & 0x3fff) + 1);
+        header.hasAlpha = ((bits >> 28) & 0x01) != 0;
+    } else if (HasFourCC(chunkType, "VP8X")) {
+        // Extended.
+        uint8_t flags = imageHeaderBytes[0];
+        header.encodedPixelSize
+            = CGSizeMake(ReadUInt24LE(imageHeaderBytes + 4) + 1, ReadUInt24LE(imageHeaderBytes + 7) + 1);
+        header.hasAlpha = (flags & 0x10) != 0;
+        header.isAnimated = (flags & 0x02) != 0;
+        if (header.isAnimated) {
+            unsigned long long offset = kRiffHeaderLength + kChunkHeaderLength + chunkLength + (chunkLength & 1);
+            header.frameCount = [self webpFrameCountAtOffset:offset reader:reader];
+        }
+    } else {
+        return nil;
+    }
+
+    return header;
+}
+
+// Counts the animation frames by seeking from chunk header to chunk header.
+// Returns 0 if the chunks run past what we'll read.
++ (NSUInteger)webpFrameCountAtOffset:(unsigned long long)offset reader:(OWSImageProbeReader *)reader
+{
+    const NSUInteger kChunkHeaderLength = 8;
+
+    NSUInteger frameCount = 0;
+    while (reader.bytesRead <= kMaxFrameCountReadLength) {
+        NSData *_Nullable chunkData = [reader dataAtOffset:offset length:kChunkHeaderLength];
+        if (!chunkData) {
+            // The last chunk.
+            return frameCount;
+        }
+        const uint8_t *chunkBytes = chunkData.bytes;
+        if (HasFourCC(chunkBytes, "ANMF")) {
+            frameCount++;
+        }
+        uint32_t chunkLength = ReadUInt32LE(chunkBytes + 4);
+        offset += kChunkHeaderLength + chunkLength + (chunkLength & 1);
+    }
+    return 0;
+}
+
+#pragma mark - ImageIO
+
++ (nullable OWSImageHeader *)probeWithImageSourceBlock:(CGImageSourceRef _Nullable (^)(void))imageSourceBlock
+                                           imageFormat:(ImageFormat)imageFormat
+{
+    CGImageSourceRef _Nullable imageSource = imageSourceBlock();
+    if (imageSource == NULL) {
+        return nil;
+    }
+    NSDictionary *options = @{
+        (NSString *)kCGImageSourceShouldCache : @(NO),
+    };
+    NSDictionary *_Nullable imageProperties
+        = (__bridge_transfer NSDictionary *)CGImageSourceCopyPropertiesAtIndex(imageSource, 0, (CFDictionaryRef)options);
+    CFRelease(imageSource);
+    if (!imageProperties) {
+        return nil;
+    }
+
+    NSNumber *_Nullable widthNumber = imageProperties[(__bridge NSString *)kCGImagePropertyPixelWidth];
+    NSNumber *_Nullable heightNumber = imageProperties[(__bridge NSString *)kCGImagePropertyPixelHeight];
+    NSNumber *_Nullable depthNumber = imageProperties[(__bridge NSString *)kCGImagePropertyDepth];
+    NSString *_Nullable colorModel = imageProperties[(__bridge NSString *)kCGImagePropertyColorModel];
+    if (!widthNumber || !heightNumber || !depthNumber || !colorModel) {
+        OWSLogError(@"Missing image properties.");
+        return nil;
+    }
+
+    OWSImageHeader *header = [[OWSImageHeader alloc] initWithImageFormat:imageFormat];
+    header.encodedPixelSize = CGSizeMake(widthNumber.floatValue, heightNumber.floatValue);
+    header.depthBits = depthNumber.unsignedIntegerValue;
+    header.isRGBOrGray = ([colorModel isEqualToString:(__bridge NSString *)kCGImagePropertyColorModelRGB] ||
+        [colorModel isEqualToString:(__bridge NSString *)kCGImagePropertyColorModelGray]);
+    NSNumber *_Nullable orientationNumber = imageProperties[(__bridge NSString *)kCGImagePropertyOrientation];
+    if (orientationNumber != nil) {
+        header.orientation = (CGImagePropertyOrientation)orientationNumber.intValue;
+    }
+    header.hasAlpha = [imageProperties[(__bridge NSString *)kCGImagePropertyHasAlpha] boolValue];
+    return header;
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
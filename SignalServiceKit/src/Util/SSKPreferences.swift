@@ -90,6 +90,29 @@ public class SSKPreferences: NSObject {
 
     // MARK: -
 
+    private static let isYdbMigrationResumableKey = "isYdbMigrationResumable"
+
+    // Set while a YDB-to-GRDB migration is in progress. The migration
+    // checkpoints its progress, so a partially migrated GRDB database
+    // should be preserved and the migration resumed.
+    @objc
+    public static func isYdbMigrationResumable() -> Bool {
+        let appUserDefaults = CurrentAppContext().appUserDefaults()
+        guard let preference = appUserDefaults.object(forKey: isYdbMigrationResumableKey) as? NSNumber else {
+            return false
+        }
+        return preference.boolValue
+    }
+
+    @objc
+    public static func setIsYdbMigrationResumable(_ value: Bool) {
+        let appUserDefaults = CurrentAppContext().appUserDefaults()
+        appUserDefaults.set(value, forKey: isYdbMigrationResumableKey)
+        appUserDefaults.synchronize()
+    }
+
+    // MARK: -
+
     private static let didEverUseYdbKey = "didEverUseYdb"
 
     @objc
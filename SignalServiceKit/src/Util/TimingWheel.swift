@@ -0,0 +1,152 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+import SignalCoreKit
+
+// A hashed timing wheel: tracks timeouts for many keys with a single
+// repeating timer rather than one timer per key.
+//
+// Keys hash into slots by their deadline. Each tick advances the wheel
+// by one slot and expires the keys in it whose remaining rounds have
+// elapsed, so scheduling and cancelling are O(1). Timeouts never fire
+// early and fire at most one tick late.
+//
+// Must only be used on its queue. The timer only runs while keys are
+// scheduled.
+class TimingWheel<Key: Hashable> {
+
+    typealias TimeoutBlock = (Key) -> Void
+
+    private struct Entry {
+        let slotIndex: Int
+        var remainingRounds: Int
+    }
+
+    let tickInterval: TimeInterval
+
+    private let queue: DispatchQueue
+    private let timeoutBlock: TimeoutBlock
+
+    private var slots: [Set<Key>]
+    private var entries = [Key: Entry]()
+    private var currentSlotIndex = 0
+    private var lastTickTime: TimeInterval = 0
+    private var timer: DispatchSourceTimer?
+
+    init(queue: DispatchQueue, tickInterval: TimeInterval, slotCount: Int, timeoutBlock: @escaping TimeoutBlock) {
+        assert(tickInterval > 0)
+        assert(slotCount > 0)
+
+        self.queue = queue
+        self.tickInterval = tickInterval
+        self.timeoutBlock = timeoutBlock
+        self.slots = [Set<Key>](repeating: Set(), count: slotCount)
+    }
+
+    deinit {
+        timer?.cancel()
+    }
+
+    var count: Int {
+        return entries.count
+    }
+
+    // MARK: -
+
+    func schedule(key: Key, timeout: TimeInterval) {
+        assertOnQueue(queue)
+
+        cancel(key: key)
+        startTimerIfNecessary()
+
+        // Ticks are counted from the last tick, not from now.
+        let sinceLastTick = CACurrentMediaTime() - lastTickTime
+        let tickCount = max(1, Int(ceil((timeout + sinceLastTick) / tickInterval)))
+        let slotIndex = (currentSlotIndex + tickCount) % slots.count
+        let remainingRounds = (tickCount - 1) / slots.count
+
+        slots[slotIndex].insert(key)
+        entries[key] = Entry(slotIndex: slotIndex, remainingRounds: remainingRounds)
+    }
+
+    func cancel(key: Key) {
+        assertOnQueue(queue)
+
+        guard let entry = entries.removeValue(forKey: key) else {
+            return
+        }
+        slots[entry.slotIndex].remove(key)
+        stopTimerIfNecessary()
+    }
+
+    func cancelAll() {
+        assertOnQueue(queue)
+
+        entries.removeAll()
+        for slotIndex in 0..<slots.count {
+            slots[slotIndex].removeAll()
+        }
+        stopTimerIfNecessary()
+    }
+
+    // MARK: - Timer
+
+    private func startTimerIfNecessary() {
+        guard timer == nil else {
+            return
+        }
+        currentSlotIndex = 0
+        lastTickTime = CACurrentMediaTime()
+
+        let timer = DispatchSource.makeTimerSource(queue: queue)
+        timer.schedule(deadline: .now() + tickInterval,
+                       repeating: tickInterval,
+                       leeway: .milliseconds(Int(tickInterval * 100)))
+        timer.setEventHandler { [weak self] in
+            self?.tick()
+        }
+        timer.resume()
+        self.timer = timer
+    }
+
+    private func stopTimerIfNecessary() {
+        guard entries.isEmpty, let timer = timer else {
+            return
+        }
+        timer.cancel()
+        self.timer = nil
+    }
+
+    private func tick() {
+        assertOnQueue(queue)
+
+        lastTickTime = CACurrentMediaTime()
+        currentSlotIndex = (currentSlotIndex + 1) % slots.count
+
+        var expiredKeys = [Key]()
+        for key in slots[currentSlotIndex] {
+            guard var entry = entries[key] else {
+                owsFailDebug("Missing entry.")
+                continue
+            }
+            if entry.remainingRounds > 0 {
+                entry.remainingRounds -= 1
+                entries[key] = entry
+            } else {
+                expiredKeys.append(key)
+            }
+        }
+        for key in expiredKeys {
+            slots[currentSlotIndex].remove(key)
+            entries.removeValue(forKey: key)
+        }
+
+        stopTimerIfNecessary()
+
+        for key in expiredKeys {
+            timeoutBlock(key)
+        }
+    }
+}
@@ -114,7 +114,7 @@ public class TypingIndicatorsImpl: NSObject, TypingIndicators {
             _areTypingIndicatorsEnabled = value
         }
 
-        databaseStorage.write { transaction in
+        databaseStorage.asyncCoalescedWrite { transaction in
             self.keyValueStore.setBool(value,
                                        key: self.kDatabaseKey_TypingIndicatorsEnabled,
                                        transaction: transaction)
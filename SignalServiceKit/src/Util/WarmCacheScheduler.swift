@@ -0,0 +1,100 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+
+@objc
+public enum WarmCachePriority: UInt {
+    // Must be warm before launch continues, e.g. before migrations
+    // run, to avoid sneaky transactions at inopportune times.
+    case critical
+    // Loads lazily if needed, so can wait until the app is presented.
+    case deferred
+}
+
+// MARK: -
+
+// Warms the caches of independent singletons during launch.
+//
+// The critical warmups are run concurrently, and warmCriticalCaches()
+// only returns once they have all completed. The deferred warmups are
+// run once, in the background, when warmDeferredCaches() is called
+// after the first frame has been presented.
+//
+// Each warmup is recorded as a LaunchTrace phase.
+@objc
+public class WarmCacheScheduler: NSObject {
+
+    private struct Warmup {
+        let name: String
+        let priority: WarmCachePriority
+        let block: () -> Void
+    }
+
+    private let trace: LaunchTrace
+
+    // Should only be accessed while synchronized on self.
+    private var warmups = [Warmup]()
+    private var hasWarmedDeferredCaches = false
+
+    @objc
+    public init(trace: LaunchTrace) {
+        self.trace = trace
+
+        super.init()
+    }
+
+    @objc
+    public convenience override init() {
+        self.init(trace: LaunchTrace.shared)
+    }
+
+    // MARK: -
+
+    @objc
+    public func addWarmup(name: String, priority: WarmCachePriority, block: @escaping () -> Void) {
+        objc_sync_enter(self)
+        warmups.append(Warmup(name: name, priority: priority, block: block))
+        objc_sync_exit(self)
+    }
+
+    private func warmups(priority: WarmCachePriority) -> [Warmup] {
+        objc_sync_enter(self)
+        defer { objc_sync_exit(self) }
+        return warmups.filter { $0.priority == priority }
+    }
+
+    private func run(warmup: Warmup) {
+        trace.tracePhase("Warm cache: \(warmup.name)", block: warmup.block)
+    }
+
+    // Blocks until every critical cache is warm.
+    @objc
+    public func warmCriticalCaches() {
+        let criticalWarmups = warmups(priority: .critical)
+        trace.tracePhase("Warm critical caches") {
+            DispatchQueue.concurrentPerform(iterations: criticalWarmups.count) { index in
+                run(warmup: criticalWarmups[index])
+            }
+        }
+    }
+
+    @objc
+    public func warmDeferredCaches() {
+        objc_sync_enter(self)
+        let shouldWarm = !hasWarmedDeferredCaches
+        hasWarmedDeferredCaches = true
+        objc_sync_exit(self)
+        guard shouldWarm else {
+            return
+        }
+
+        let deferredWarmups = warmups(priority: .deferred)
+        DispatchQueue.global(qos: .utility).async {
+            for warmup in deferredWarmups {
+                self.run(warmup: warmup)
+            }
+        }
+    }
+}
@@ -0,0 +1,106 @@
+//
+//  Copyright (c) 2020 Open Whisper Systems. All rights reserved.
+//
+
+import XCTest
+import Contacts
+@testable import SignalServiceKit
+
+class ContactImportPerformanceTest: SSKBaseTestSwift {
+
+    private var tsAccountManager: TSAccountManager {
+        return TSAccountManager.sharedInstance()
+    }
+
+    override func setUp() {
+        super.setUp()
+
+        tsAccountManager.registerForTests(withLocalNumber: "+13235550000", uuid: UUID())
+    }
+
+    // Numbers in the forms people save them in: formatted local numbers,
+    // formatted international numbers, and E.164.
+    private func buildSystemContacts(count: Int, seed: Int) -> [CNContact] {
+        return (0..<count).map { index in
+            let contact = CNMutableContact()
+            contact.givenName = "Contact"
+            contact.familyName = "\(seed)-\(index)"
+
+            // Each seed gets its own exchanges, and so its own numbers.
+            let exchange = 200 + seed
+            let subscriber = index % 10000
+            var phoneNumbers = [
+                String(format: "(323) %03d-%04d", exchange, subscriber),
+                String(format: "+1 213 %03d %04d", exchange, subscriber)
+            ]
+            if index % 2 == 0 {
+                phoneNumbers.append(String(format: "+1415%03d%04d", exchange, subscriber))
+            }
+            if index % 10 == 0 {
+                phoneNumbers.append(String(format: "+44 20 7%03d %04d", exchange, subscriber))
+            }
+            contact.phoneNumbers = phoneNumbers.map { phoneNumber in
+                CNLabeledValue(label: CNLabelPhoneNumberMobile, value: CNPhoneNumber(stringValue: phoneNumber))
+            }
+            return contact
+        }
+    }
+
+    // MARK: -
+
+    func testContactsWithSystemContacts() {
+        let systemContacts = buildSystemContacts(count: 200, seed: 0)
+
+        let expectedContacts = systemContacts.map { Contact(systemContact: $0) }
+        let contacts = Contact.contacts(withSystemContacts: systemContacts)
+        XCTAssertEqual(contacts.count, expectedContacts.count)
+        for (contact, expectedContact) in zip(contacts, expectedContacts) {
+            XCTAssertEqual(contact.cnContactId, expectedContact.cnContactId)
+            XCTAssertEqual(contact.parsedPhoneNumbers.map { $0.toE164() },
+                           expectedContact.parsedPhoneNumbers.map { $0.toE164() })
+        }
+
+        XCTAssertEqual(Contact.contacts(withSystemContacts: []).count, 0)
+    }
+
+    // Imports 10k contacts with 2-3 numbers each, first one at a time and
+    // then in parallel batches. Each import uses numbers the other hasn't
+    // parsed, so that neither is served by the other's cache.
+    func testImportPerformance() {
+        let contactCount = 10000
+        let serialSystemContacts = buildSystemContacts(count: contactCount, seed: 0)
+        let parallelSystemContacts = buildSystemContacts(count: contactCount, seed: 1)
+
+        let serialStartDate = Date()
+        let serialContacts = serialSystemContacts.map { Contact(systemContact: $0) }
+        let serialDuration = Date().timeIntervalSince(serialStartDate)
+
+        let parallelStartDate = Date()
+        let parallelContacts = Contact.contacts(withSystemContacts: parallelSystemContacts)
+        let parallelDuration = Date().timeIntervalSince(parallelStartDate)
+
+        XCTAssertEqual(serialContacts.count, contactCount)
+        XCTAssertEqual(parallelContacts.count, contactCount)
+
+        // A re-import, as when the system contacts change, is served from
+        // the cache.
+        let reimportStartDate = Date()
+        _ = Contact.contacts(withSystemContacts: parallelSystemContacts)
+        let reimportDuration = Date().timeIntervalSince(reimportStartDate)
+
+        // E.164 numbers we've already seen take the fast path.
+        let e164s = parallelContacts.flatMap { $0.parsedPhoneNumbers.map { $0.toE164() } }
+        let e164StartDate = Date()
+        for e164 in e164s {
+            XCTAssertNotNil(PhoneNumber.tryParsePhoneNumber(fromE164: e164))
+        }
+        let e164Duration = Date().timeIntervalSince(e164StartDate)
+
+        Logger.info(String(format: "[Bench] Imported %d contacts: serial %0.2fs, parallel %0.2fs, re-import %0.2fs; E.164 lookup %0.2fus",
+                           contactCount,
+                           serialDuration,
+                           parallelDuration,
+                           reimportDuration,
+                           e164Duration * 1000 * 1000 / Double(e164s.count)))
+    }
+}
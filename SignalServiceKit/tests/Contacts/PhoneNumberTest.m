@@ -28,6 +28,19 @@
     XCTAssertNil([[PhoneNumber tryParsePhoneNumberFromUserSpecifiedText:@""] toE164]);
 }
 
+- (void)testCanonicalE164
+{
+    // Canonical E.164 numbers are served from a cache.
+    PhoneNumber *phoneNumber = [PhoneNumber tryParsePhoneNumberFromE164:@"+13235551234"];
+    XCTAssertEqualObjects(@"+13235551234", [phoneNumber toE164]);
+    XCTAssertEqual(phoneNumber, [PhoneNumber tryParsePhoneNumberFromE164:@"+13235551234"]);
+    XCTAssertEqual(phoneNumber, [PhoneNumber tryParsePhoneNumberFromUserSpecifiedText:@"+13235551234"]);
+
+    // Other forms of the number still parse to it.
+    XCTAssertEqualObjects(phoneNumber, [PhoneNumber tryParsePhoneNumberFromUserSpecifiedText:@"+1 323 555 1234"]);
+    XCTAssertEqualObjects(phoneNumber, [PhoneNumber tryParsePhoneNumberFromUserSpecifiedText:@"(323) 555-1234"]);
+}
+
 - (void)testTryParsePhoneNumberFromUserSpecifiedTextAssumesLocalRegion {
     PhoneNumber *actual = [PhoneNumber tryParsePhoneNumberFromUserSpecifiedText:@"3235551234"];
     XCTAssertEqualObjects(@"+13235551234", [actual toE164]);
@@ -4,6 +4,7 @@
 
 #import "PhoneNumberUtil.h"
 #import "SSKBaseTestObjC.h"
+#import <libPhoneNumber_iOS/NBPhoneNumber.h>
 
 @interface PhoneNumberUtilTest : SSKBaseTestObjC
 
@@ -35,6 +36,26 @@
     XCTAssertFalse([PhoneNumberUtil name:@"dave" matchesQuery:@"big"]);
 }
 
+- (void)testParseCache
+{
+    PhoneNumberUtil *phoneNumberUtil = [PhoneNumberUtil sharedThreadLocal];
+
+    NSError *_Nullable error;
+    NBPhoneNumber *_Nullable phoneNumber = [phoneNumberUtil parse:@"3235551234" defaultRegion:@"US" error:&error];
+    XCTAssertNil(error);
+    XCTAssertEqualObjects(phoneNumber.countryCode, @(1));
+    // Cached numbers are parsed in the region they were parsed in.
+    phoneNumber = [phoneNumberUtil parse:@"3235551234" defaultRegion:@"GB" error:&error];
+    XCTAssertEqualObjects(phoneNumber.countryCode, @(44));
+
+    // Failures are cached too, and fail the same way.
+    XCTAssertNil([phoneNumberUtil parse:@"not a number" defaultRegion:@"US" error:&error]);
+    XCTAssertNotNil(error);
+    NSError *_Nullable cachedError;
+    XCTAssertNil([phoneNumberUtil parse:@"not a number" defaultRegion:@"US" error:&cachedError]);
+    XCTAssertEqualObjects(cachedError, error);
+}
+
 - (void)testTranslateCursorPosition
 {
     XCTAssertEqual(0, [PhoneNumberUtil translateCursorPosition:0 from:@"" to:@"" stickingRightward:true]);
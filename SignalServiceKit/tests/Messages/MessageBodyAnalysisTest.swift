@@ -0,0 +1,149 @@
+//
+//  Copyright (c) 2020 Open Whisper Systems. All rights reserved.
+//
+
+import XCTest
+@testable import SignalServiceKit
+
+class MessageBodyAnalysisTest: SSKBaseTestSwift {
+
+    private func roundTrip(_ analysis: MessageBodyAnalysis) -> MessageBodyAnalysis {
+        return MessageBodyAnalysis.parse(analysis.serialize())!
+    }
+
+    private func assertEqualAnalyses(_ lhs: MessageBodyAnalysis,
+                                     _ rhs: MessageBodyAnalysis,
+                                     body: String,
+                                     file: StaticString = #file,
+                                     line: UInt = #line) {
+        XCTAssertEqual(lhs.filteredText(body: body), rhs.filteredText(body: body), file: file, line: line)
+        XCTAssertEqual(lhs.naturalAlignment, rhs.naturalAlignment, file: file, line: line)
+        XCTAssertEqual(lhs.jumbomojiCount, rhs.jumbomojiCount, file: file, line: line)
+        XCTAssertEqual(lhs.shouldAllowLinkification, rhs.shouldAllowLinkification, file: file, line: line)
+    }
+
+    // MARK: -
+
+    func testAnalysis() {
+        let boringText = "boring text"
+        let boringAnalysis = MessageBodyAnalysis.analyze(body: boringText)
+        XCTAssertEqual(boringAnalysis.filteredText(body: boringText), boringText)
+        XCTAssertEqual(boringAnalysis.naturalAlignment, .left)
+        XCTAssertEqual(boringAnalysis.jumbomojiCount, 0)
+        XCTAssertTrue(boringAnalysis.shouldAllowLinkification)
+        // Unfiltered text isn't stored again.
+        XCTAssertEqual(boringAnalysis.serialize().count, 4)
+
+        let zalgoText = "L̷̳͔̲͝Ģ̵̮̯̤̩̙͍̬̟͉̹̘̹͍͈̮̦̰̣͟͝O̶̴̮̻̮̗͘͡!̴̷̟͓͓"
+        XCTAssertEqual(MessageBodyAnalysis.analyze(body: zalgoText).filteredText(body: zalgoText), "LGO!")
+
+        let rtlText = "שלום, מה שלומך היום?"
+        XCTAssertEqual(MessageBodyAnalysis.analyze(body: rtlText).naturalAlignment, .right)
+
+        XCTAssertEqual(MessageBodyAnalysis.analyze(body: "😍").jumbomojiCount, 1)
+        XCTAssertEqual(MessageBodyAnalysis.analyze(body: "🐵🙈🙉🙊").jumbomojiCount, 4)
+        XCTAssertEqual(MessageBodyAnalysis.analyze(body: "👾🙇💁🙅🙆🙋🙎🙍").jumbomojiCount, 0)
+        XCTAssertEqual(MessageBodyAnalysis.analyze(body: "🇹🇹 ").jumbomojiCount, 0)
+
+        XCTAssertTrue(MessageBodyAnalysis.analyze(body: "foo google.com and https://кц.рф/foo").shouldAllowLinkification)
+
+        // Cyrillic host with ascii tld.
+        XCTAssertFalse(MessageBodyAnalysis.analyze(body: "foo http://asĸ.com").shouldAllowLinkification)
+        XCTAssertFalse(MessageBodyAnalysis.shouldAllowLinkification(text: "asĸ.com"))
+        XCTAssertTrue(MessageBodyAnalysis.shouldAllowLinkification(text: "asĸ"))
+    }
+
+    func testSerialization() {
+        let bodies = [
+            "boring text",
+            "H҉̸̧͘͠A͢͞V̛̛I̴̸N͏̕͏G҉̵͜͏͢ ̧̧́T̶̛͘͡R̸̵̨̢̀O̷̡U͡҉B̶̛͢͞L̸̸͘͢͟É̸ ̸̛͘͏R͟È͠͞A̸͝Ḑ̕͘͜I̵͘҉͜͞N̷̡̢͠G̴͘͠ ͟͞T͏̢́͡È̀X̕҉̢̀T̢͠?̕͏̢͘͢",
+            "שלום, מה שלומך היום?",
+            "❤️💔💌",
+            "foo google.com and https://кц.рф/foo",
+            "foo http://asĸ.com"
+        ]
+        for body in bodies {
+            let analysis = MessageBodyAnalysis.analyze(body: body)
+            assertEqualAnalyses(roundTrip(analysis), analysis, body: body)
+        }
+
+        // Analyses in an unknown format are ignored.
+        var data = MessageBodyAnalysis.analyze(body: "boring text").serialize()
+        data[0] = 0xff
+        XCTAssertNil(MessageBodyAnalysis.parse(data))
+    }
+
+    func testStorage() {
+        let body = "foo google.com 🙈"
+        let factory = IncomingMessageFactory()
+        factory.messageBodyBuilder = { body }
+
+        var message: TSIncomingMessage!
+        write { transaction in
+            message = factory.create(transaction: transaction)
+        }
+
+        read { transaction in
+            let analysis = MessageBodyAnalysis.fetch(messageId: message.uniqueId, transaction: transaction)!
+            self.assertEqualAnalyses(analysis, MessageBodyAnalysis.analyze(body: body), body: body)
+        }
+
+        write { transaction in
+            message.anyRemove(transaction: transaction)
+        }
+
+        read { transaction in
+            XCTAssertNil(MessageBodyAnalysis.fetch(messageId: message.uniqueId, transaction: transaction))
+        }
+    }
+
+    // Loads the body analyses of a 100-message page, and compares that
+    // against analyzing the bodies again.
+    func testPagePerformance() {
+        let pageSize = 100
+        let bodies = (0..<pageSize).map { index -> String in
+            switch index % 4 {
+            case 0:
+                return CommonGenerator.paragraph
+            case 1:
+                return CommonGenerator.sentence + " https://signal.org/blog/"
+            case 2:
+                return "שלום, מה שלומך היום? " + CommonGenerator.word
+            default:
+                return "🐵🙈🙉"
+            }
+        }
+        let factory = IncomingMessageFactory()
+        var bodyIterator = bodies.makeIterator()
+        factory.messageBodyBuilder = { bodyIterator.next()! }
+
+        var messages = [TSIncomingMessage]()
+        write { transaction in
+            messages = factory.create(count: UInt(pageSize), transaction: transaction)
+        }
+
+        let iterationCount = 20
+        let analyzeStartDate = Date()
+        for _ in 0..<iterationCount {
+            for message in messages {
+                _ = MessageBodyAnalysis.analyze(body: message.body!)
+            }
+        }
+        let analyzeDuration = Date().timeIntervalSince(analyzeStartDate)
+
+        let fetchStartDate = Date()
+        read { transaction in
+            for _ in 0..<iterationCount {
+                for message in messages {
+                    XCTAssertNotNil(MessageBodyAnalysis.fetch(messageId: message.uniqueId, transaction: transaction))
+                }
+            }
+        }
+        let fetchDuration = Date().timeIntervalSince(fetchStartDate)
+
+        Logger.info(String(format: "[Bench] %d-message page: analyze %0.2fms, load stored analysis %0.2fms",
+                           pageSize,
+                           analyzeDuration * 1000 / Double(iterationCount),
+                           fetchDuration * 1000 / Double(iterationCount)))
+    }
+}
@@ -0,0 +1,261 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import XCTest
+@testable import SignalServiceKit
+
+// Feeds a stream of encrypted envelopes from fake senders through the real
+// receive pipeline (OWSMessageReceiver -> SSKMessageDecryptJobQueue ->
+// OWSBatchMessageProcessor -> OWSMessageManager) into a fresh GRDB store,
+// and reports sustained throughput, per-stage latency and peak memory.
+class MessageIngestBenchmarkTest: SSKBaseTestSwift {
+
+    // MARK: - Dependencies
+
+    var messageReceiver: OWSMessageReceiver {
+        return SSKEnvironment.shared.messageReceiver
+    }
+
+    var tsAccountManager: TSAccountManager {
+        return SSKEnvironment.shared.tsAccountManager
+    }
+
+    var identityManager: OWSIdentityManager {
+        return SSKEnvironment.shared.identityManager
+    }
+
+    var storageCoordinator: StorageCoordinator {
+        return SSKEnvironment.shared.storageCoordinator
+    }
+
+    // MARK: -
+
+    let localE164Identifier = "+13235551234"
+    let localUUID = UUID()
+
+    let envelopeCount = 500
+    let senderCount = 8
+    let outgoingMessageCountPerSender = 5
+
+    var senderClients = [SignalClient]()
+    var outgoingMessageTimestamps = [SignalE164Identifier: [UInt64]]()
+    let groupId = Randomness.generateRandomBytes(Int32(kGroupIdLength))
+
+    let localClient = LocalSignalClient()
+    let runner = TestProtocolRunner()
+    lazy var fakeService = FakeService(localClient: localClient, runner: runner)
+
+    let trace = MessageIngestTrace.shared
+
+    private enum EnvelopeKind: CaseIterable {
+        case contactText
+        case groupText
+        case attachmentPointer
+        case receipt
+        case typing
+    }
+
+    // Roughly the mix of envelopes that an active account receives.
+    private func envelopeKind(index: Int) -> EnvelopeKind {
+        switch index % 20 {
+        case 0..<10:
+            return .contactText
+        case 10..<14:
+            return .groupText
+        case 14..<16:
+            return .attachmentPointer
+        case 16..<18:
+            return .receipt
+        default:
+            return .typing
+        }
+    }
+
+    // MARK: - Hooks
+
+    override func setUp() {
+        super.setUp()
+
+        storageCoordinator.useGRDBForTests()
+
+        // ensure local client has necessary "registered" state
+        identityManager.generateNewIdentityKey()
+        tsAccountManager.registerForTests(withLocalNumber: localE164Identifier, uuid: localUUID)
+
+        senderClients = (0..<senderCount).map { index in
+            FakeSignalClient.generate(e164Identifier: "+1808323\(String(format: "%04d", index))")
+        }
+
+        write { transaction in
+            for senderClient in self.senderClients {
+                try! self.runner.initialize(senderClient: senderClient,
+                                            recipientClient: self.localClient,
+                                            transaction: transaction)
+
+                // Receipts are for messages we've sent.
+                let thread = TSContactThread.getOrCreateThread(withContactAddress: senderClient.address,
+                                                               transaction: transaction)
+                let outgoingMessageFactory = OutgoingMessageFactory()
+                outgoingMessageFactory.threadCreator = { _ in thread }
+                self.outgoingMessageTimestamps[senderClient.e164Identifier!] = (0..<self.outgoingMessageCountPerSender).map { _ in
+                    outgoingMessageFactory.create(transaction: transaction).timestamp
+                }
+            }
+
+            _ = try! GroupManager.createGroupForTests(transaction: transaction,
+                                                      members: self.senderClients.map { $0.address } + [self.localClient.address],
+                                                      name: "Benchmark",
+                                                      groupId: self.groupId)
+        }
+
+        // for unit tests, we must manually start the decryptJobQueue
+        SSKEnvironment.shared.messageDecryptJobQueue.setup()
+
+        trace.reset()
+        trace.isEnabled = true
+    }
+
+    override func tearDown() {
+        trace.isEnabled = false
+        trace.reset()
+
+        super.tearDown()
+    }
+
+    // MARK: -
+
+    private func buildEnvelopeStream() -> [Data] {
+        return (0..<envelopeCount).map { index in
+            let senderClient = senderClients[index % senderClients.count]
+            let kind = envelopeKind(index: index)
+            let envelopeBuilder = try! fakeService.envelopeBuilder(fromSenderClient: senderClient) { timestamp in
+                switch kind {
+                case .contactText:
+                    return try self.fakeService.buildContentData(bodyText: nil)
+                case .groupText:
+                    return try self.fakeService.buildGroupContentData(groupId: self.groupId, bodyText: nil)
+                case .attachmentPointer:
+                    return try self.fakeService.buildAttachmentContentData(contentType: OWSMimeTypeImageJpeg,
+                                                                           byteCount: 256 * 1024)
+                case .receipt:
+                    return try self.fakeService.buildReceiptContentData(type: index % 2 == 0 ? .delivery : .read,
+                                                                        messageTimestamps: self.outgoingMessageTimestamps[senderClient.e164Identifier!]!)
+                case .typing:
+                    return try self.fakeService.buildTypingContentData(timestamp: timestamp,
+                                                                       action: .started,
+                                                                       groupId: index % 2 == 0 ? self.groupId : nil)
+                }
+            }
+            envelopeBuilder.setSourceE164(senderClient.e164Identifier!)
+            return try! envelopeBuilder.buildSerializedData()
+        }
+    }
+
+    private func percentile(_ percentile: Double, of values: [CFTimeInterval]) -> CFTimeInterval {
+        guard !values.isEmpty else {
+            return 0
+        }
+        let sortedValues = values.sorted()
+        let index = Int((percentile * Double(sortedValues.count)).rounded(.up)) - 1
+        return sortedValues[max(0, min(sortedValues.count - 1, index))]
+    }
+
+    // MARK: - Tests
+
+    func testIngestThroughput() {
+        // Encrypting the stream isn't part of the measurement.
+        let envelopeStream = buildEnvelopeStream()
+        let envelopeCount = self.envelopeCount
+
+        let memorySampler = PeakMemorySampler()
+        memorySampler.start()
+
+        let expectIngested = expectation(for: NSPredicate { _, _ in
+            return self.trace.count(stage: .processed) == envelopeCount
+        }, evaluatedWith: nil, handler: nil)
+
+        // Envelopes arrive off the main thread, as they do from the socket.
+        DispatchQueue.global(qos: .userInitiated).async {
+            for envelopeData in envelopeStream {
+                self.messageReceiver.handleReceivedEnvelopeData(envelopeData)
+            }
+        }
+
+        wait(for: [expectIngested], timeout: 120)
+        memorySampler.stop()
+
+        let duration = trace.span(from: .received, to: .processed)
+        XCTAssertGreaterThan(duration, 0)
+        Logger.info(String(format: "[Bench] Ingested %d envelopes in %0.2fs: %0.1f envelopes/sec",
+                           envelopeCount,
+                           duration,
+                           Double(envelopeCount) / duration))
+
+        let stages: [(String, MessageIngestStage, MessageIngestStage)] = [
+            ("Queued for decryption", .received, .decryptStarted),
+            ("Decrypt", .decryptStarted, .decrypted),
+            ("Queued for processing", .decrypted, .processStarted),
+            ("Process", .processStarted, .processed),
+            ("End to end", .received, .processed)
+        ]
+        for (stageName, fromStage, toStage) in stages {
+            let latencies = trace.latencies(from: fromStage, to: toStage)
+            XCTAssertEqual(envelopeCount, latencies.count)
+            Logger.info(String(format: "[Bench] %@ latency p50: %0.2fms, p99: %0.2fms",
+                               stageName,
+                               percentile(0.5, of: latencies) * 1000,
+                               percentile(0.99, of: latencies) * 1000))
+        }
+
+        let byteFormatter = ByteCountFormatter()
+        Logger.info("[Bench] Memory: \(byteFormatter.string(fromByteCount: Int64(memorySampler.initialSize))) -> \(byteFormatter.string(fromByteCount: Int64(memorySampler.peakSize)))")
+
+        let messageEnvelopeCount = (0..<envelopeCount).filter { index in
+            [.contactText, .groupText, .attachmentPointer].contains(envelopeKind(index: index))
+        }.count
+        let attachmentEnvelopeCount = (0..<envelopeCount).filter { envelopeKind(index: $0) == .attachmentPointer }.count
+        read { transaction in
+            let incomingMessages = TSInteraction.anyFetchAll(transaction: transaction).filter { $0 is TSIncomingMessage }
+            XCTAssertEqual(messageEnvelopeCount, incomingMessages.count)
+            let attachmentPointers = TSAttachment.anyFetchAll(transaction: transaction).filter { $0 is TSAttachmentPointer }
+            XCTAssertEqual(attachmentEnvelopeCount, attachmentPointers.count)
+        }
+    }
+}
+
+// MARK: -
+
+// Samples resident memory on a timer, since the pipeline's allocations
+// happen on queues the benchmark doesn't control.
+private class PeakMemorySampler {
+
+    private(set) var initialSize: mach_vm_size_t = 0
+    private(set) var peakSize: mach_vm_size_t = 0
+
+    private let serialQueue = DispatchQueue(label: "org.signal.peakMemorySampler")
+    private var timer: DispatchSourceTimer?
+
+    func start() {
+        initialSize = BenchResidentMemorySize() ?? 0
+        peakSize = initialSize
+
+        let timer = DispatchSource.makeTimerSource(queue: serialQueue)
+        timer.schedule(deadline: .now(), repeating: .milliseconds(10))
+        timer.setEventHandler { [weak self] in
+            guard let self = self, let size = BenchResidentMemorySize() else {
+                return
+            }
+            self.peakSize = max(self.peakSize, size)
+        }
+        timer.resume()
+        self.timer = timer
+    }
+
+    func stop() {
+        serialQueue.sync {
+            timer?.cancel()
+            timer = nil
+        }
+    }
+}
@@ -186,27 +186,21 @@ class MessageProcessingIntegrationTest: SSKBaseTestSwift {
 // MARK: - Helpers
 
 class DatabaseSnapshotBlockDelegate {
-    let block: (Database) -> Void
-    init(block: @escaping (Database) -> Void) {
+    let block: (DatabaseChangeSet) -> Void
+    init(block: @escaping (DatabaseChangeSet) -> Void) {
         self.block = block
     }
 }
 
 extension DatabaseSnapshotBlockDelegate: DatabaseSnapshotDelegate {
 
-    // MARK: - Transaction Lifecycle
+    // MARK: - Snapshot LifeCycle (Post Commit)
 
-    func snapshotTransactionDidChange(with event: DatabaseEvent) { /* no-op */ }
+    func databaseSnapshotWillUpdate() { /* no-op */ }
 
-    func snapshotTransactionDidCommit(db: Database) {
-        block(db)
+    func databaseSnapshotDidUpdate(changes: DatabaseChangeSet) {
+        block(changes)
     }
 
-    func snapshotTransactionDidRollback(db: Database) { /* no-op */ }
-
-    // MARK: - Snapshot LifeCycle (Post Commit)
-
-    func databaseSnapshotWillUpdate() { /* no-op */ }
-    func databaseSnapshotDidUpdate() { /* no-op */ }
     func databaseSnapshotDidUpdateExternally() { /* no-op */ }
 }
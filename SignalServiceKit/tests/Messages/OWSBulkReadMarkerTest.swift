@@ -0,0 +1,151 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+import XCTest
+@testable import SignalServiceKit
+
+class OWSBulkReadMarkerTest: SSKBaseTestSwift {
+
+    // MARK: - Dependencies
+
+    var storageCoordinator: StorageCoordinator {
+        return SSKEnvironment.shared.storageCoordinator
+    }
+
+    // MARK: -
+
+    let aliceAddress = SignalServiceAddress(phoneNumber: "+13213334444")
+    let bobAddress = SignalServiceAddress(phoneNumber: "+13213334445")
+
+    override func setUp() {
+        super.setUp()
+
+        storageCoordinator.useGRDBForTests()
+    }
+
+    // Returns the uniqueIds of the new messages, oldest first.
+    private func createIncomingMessages(count: Int,
+                                        thread: TSThread,
+                                        authorAddress: SignalServiceAddress,
+                                        expiresInSeconds: UInt32 = 0,
+                                        transaction: SDSAnyWriteTransaction) -> [String] {
+        let factory = IncomingMessageFactory()
+        factory.threadCreator = { _ in thread }
+        factory.authorAddressBuilder = { _ in authorAddress }
+        factory.expiresInSecondsBuilder = { expiresInSeconds }
+        var nextTimestamp: UInt64 = 1
+        factory.timestampBuilder = {
+            defer { nextTimestamp += 1 }
+            return nextTimestamp
+        }
+        return (0..<count).map { _ in factory.create(transaction: transaction).uniqueId }
+    }
+
+    private func fetchMessage(uniqueId: String, transaction: SDSAnyReadTransaction) -> TSIncomingMessage {
+        return TSIncomingMessage.anyFetch(uniqueId: uniqueId, transaction: transaction) as! TSIncomingMessage
+    }
+
+    func testMarkAsReadBeforeSortId() {
+        var thread: TSThread!
+        var messageIds = [String]()
+        write { transaction in
+            thread = TSContactThread.getOrCreateThread(withContactAddress: self.aliceAddress, transaction: transaction)
+            messageIds = self.createIncomingMessages(count: 5, thread: thread, authorAddress: self.aliceAddress, transaction: transaction)
+        }
+
+        var result: OWSBulkReadResult?
+        write { transaction in
+            let sortId = self.fetchMessage(uniqueId: messageIds[2], transaction: transaction).sortId
+            XCTAssertTrue(OWSBulkReadMarker.hasUnreadInteractions(threadUniqueId: thread.uniqueId,
+                                                                  beforeSortId: sortId,
+                                                                  transaction: transaction))
+            result = OWSBulkReadMarker.markAsRead(threadUniqueId: thread.uniqueId,
+                                                  beforeSortId: sortId,
+                                                  readTimestamp: 1000,
+                                                  transaction: transaction)
+            XCTAssertFalse(OWSBulkReadMarker.hasUnreadInteractions(threadUniqueId: thread.uniqueId,
+                                                                   beforeSortId: sortId,
+                                                                   transaction: transaction))
+        }
+
+        XCTAssertEqual(3, result?.markedCount)
+        XCTAssertEqual([aliceAddress: [1, 2, 3]], result?.messageTimestampsByAuthor)
+        XCTAssertEqual(aliceAddress, result?.latestMessageAuthor)
+        XCTAssertEqual(3, result?.latestMessageTimestamp)
+        XCTAssertNil(result?.nextExpirationDate)
+
+        read { transaction in
+            let readStates = messageIds.map { self.fetchMessage(uniqueId: $0, transaction: transaction).wasRead }
+            XCTAssertEqual([true, true, true, false, false], readStates)
+            XCTAssertEqual(2, InteractionFinder(threadUniqueId: thread.uniqueId).unreadCount(transaction: transaction))
+        }
+    }
+
+    func testStartsExpiration() {
+        var thread: TSThread!
+        var messageIds = [String]()
+        write { transaction in
+            thread = TSContactThread.getOrCreateThread(withContactAddress: self.bobAddress, transaction: transaction)
+            messageIds = self.createIncomingMessages(count: 2,
+                                                     thread: thread,
+                                                     authorAddress: self.bobAddress,
+                                                     expiresInSeconds: 60,
+                                                     transaction: transaction)
+        }
+
+        var result: OWSBulkReadResult?
+        write { transaction in
+            result = OWSBulkReadMarker.markAsRead(threadUniqueId: thread.uniqueId,
+                                                  beforeSortId: UInt64.max >> 1,
+                                                  readTimestamp: 1000,
+                                                  transaction: transaction)
+        }
+
+        XCTAssertEqual(2, result?.markedCount)
+        XCTAssertEqual(NSDate.ows_date(withMillisecondsSince1970: 61000), result?.nextExpirationDate)
+
+        read { transaction in
+            for messageId in messageIds {
+                let message = self.fetchMessage(uniqueId: messageId, transaction: transaction)
+                XCTAssertTrue(message.wasRead)
+                XCTAssertEqual(1000, message.expireStartedAt)
+                XCTAssertEqual(61000, message.expiresAt)
+                XCTAssertTrue(message.shouldStartExpireTimer)
+            }
+        }
+    }
+
+    // Measures marking a 10k message backlog as read, which previously
+    // loaded and saved every message individually.
+    func testMarkManyMessagesAsRead() {
+        let messageCount = 10000
+        var thread: TSThread!
+        write { transaction in
+            thread = TSContactThread.getOrCreateThread(withContactAddress: self.aliceAddress, transaction: transaction)
+        }
+
+        measureMetrics(XCTestCase.defaultPerformanceMetrics, automaticallyStartMeasuring: false) {
+            write { transaction in
+                _ = self.createIncomingMessages(count: messageCount,
+                                                thread: thread,
+                                                authorAddress: self.aliceAddress,
+                                                transaction: transaction)
+            }
+
+            var result: OWSBulkReadResult?
+            startMeasuring()
+            write { transaction in
+                result = OWSBulkReadMarker.markAsRead(threadUniqueId: thread.uniqueId,
+                                                      beforeSortId: UInt64.max >> 1,
+                                                      readTimestamp: NSDate.ows_millisecondTimeStamp(),
+                                                      transaction: transaction)
+            }
+            stopMeasuring()
+
+            XCTAssertEqual(messageCount, result?.markedCount)
+            XCTAssertEqual(messageCount, result?.messageTimestampsByAuthor[aliceAddress]?.count)
+        }
+    }
+}
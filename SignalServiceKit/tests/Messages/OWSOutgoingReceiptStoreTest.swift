@@ -0,0 +1,124 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+import XCTest
+@testable import SignalServiceKit
+
+class OWSOutgoingReceiptStoreTest: SSKBaseTestSwift {
+
+    // MARK: - Dependencies
+
+    var storageCoordinator: StorageCoordinator {
+        return SSKEnvironment.shared.storageCoordinator
+    }
+
+    // MARK: -
+
+    let aliceAddress = SignalServiceAddress(phoneNumber: "+13213334444")
+    let bobAddress = SignalServiceAddress(phoneNumber: "+13213334445")
+
+    override func setUp() {
+        super.setUp()
+
+        storageCoordinator.useGRDBForTests()
+    }
+
+    private func pendingBatches(store: OWSOutgoingReceiptStore,
+                                maxTimestampsPerBatch: Int = 100,
+                                maxBatchCount: Int = 100) -> [OWSOutgoingReceiptBatch] {
+        var batches = [OWSOutgoingReceiptBatch]()
+        read { transaction in
+            batches = store.pendingBatches(maxTimestampsPerBatch: maxTimestampsPerBatch,
+                                           maxBatchCount: maxBatchCount,
+                                           transaction: transaction)
+        }
+        return batches
+    }
+
+    func testMergesReceiptsPerRecipient() {
+        let store = OWSOutgoingReceiptStore()
+
+        write { transaction in
+            for timestamp: UInt64 in 1...5 {
+                store.enqueueReceipt(address: self.aliceAddress, timestamp: timestamp, receiptType: .delivery, transaction: transaction)
+                store.enqueueReceipt(address: self.bobAddress, timestamp: timestamp, receiptType: .delivery, transaction: transaction)
+            }
+            // Duplicates are ignored.
+            store.enqueueReceipt(address: self.aliceAddress, timestamp: 1, receiptType: .delivery, transaction: transaction)
+        }
+
+        let batches = pendingBatches(store: store)
+        XCTAssertEqual(2, batches.count)
+        XCTAssertEqual([1, 2, 3, 4, 5], batches[0].timestamps)
+        XCTAssertEqual(aliceAddress, batches[0].address)
+        XCTAssertEqual([1, 2, 3, 4, 5], batches[1].timestamps)
+        XCTAssertEqual(bobAddress, batches[1].address)
+
+        // Batches are bounded in size.
+        let smallBatches = pendingBatches(store: store, maxTimestampsPerBatch: 2, maxBatchCount: 4)
+        XCTAssertEqual(4, smallBatches.count)
+        XCTAssertEqual([[1, 2], [3, 4], [1, 2], [3, 4]], smallBatches.map { $0.timestamps })
+    }
+
+    func testReadReceiptSupersedesDeliveryReceipt() {
+        let store = OWSOutgoingReceiptStore()
+
+        write { transaction in
+            store.enqueueReceipt(address: self.aliceAddress, timestamp: 1, receiptType: .delivery, transaction: transaction)
+            store.enqueueReceipt(address: self.aliceAddress, timestamp: 2, receiptType: .delivery, transaction: transaction)
+            store.enqueueReceipt(address: self.aliceAddress, timestamp: 1, receiptType: .read, transaction: transaction)
+            store.enqueueReceipt(address: self.aliceAddress, timestamp: 1, receiptType: .delivery, transaction: transaction)
+        }
+
+        let batches = pendingBatches(store: store)
+        XCTAssertEqual(2, batches.count)
+        XCTAssertEqual(.delivery, batches[0].receiptType)
+        XCTAssertEqual([2], batches[0].timestamps)
+        XCTAssertEqual(.read, batches[1].receiptType)
+        XCTAssertEqual([1], batches[1].timestamps)
+    }
+
+    func testRemoveBatch() {
+        let store = OWSOutgoingReceiptStore()
+
+        write { transaction in
+            for timestamp: UInt64 in 1...3 {
+                store.enqueueReceipt(address: self.aliceAddress, timestamp: timestamp, receiptType: .read, transaction: transaction)
+            }
+        }
+
+        let batches = pendingBatches(store: store, maxTimestampsPerBatch: 2)
+        XCTAssertEqual(2, batches.count)
+        write { transaction in
+            store.removeBatch(batches[0], transaction: transaction)
+        }
+
+        XCTAssertEqual([[3]], pendingBatches(store: store).map { $0.timestamps })
+    }
+
+    func testMigratesLegacyReceipts() {
+        let store = OWSOutgoingReceiptStore()
+
+        write { transaction in
+            let legacyTimestamps: Set<NSNumber> = [NSNumber(value: 1), NSNumber(value: 2)]
+            OWSOutgoingReceiptStore.readReceiptStore.setObject(legacyTimestamps,
+                                                              key: self.aliceAddress.phoneNumber!,
+                                                              transaction: transaction)
+        }
+
+        // Legacy receipts aren't sent until they're migrated.
+        XCTAssertEqual(0, pendingBatches(store: store).count)
+
+        store.migrateLegacyReceiptsIfNecessary()
+
+        let batches = pendingBatches(store: store)
+        XCTAssertEqual(1, batches.count)
+        XCTAssertEqual(.read, batches[0].receiptType)
+        XCTAssertEqual([1, 2], batches[0].timestamps.sorted())
+        read { transaction in
+            XCTAssertEqual(0, OWSOutgoingReceiptStore.readReceiptStore.numberOfKeys(transaction: transaction))
+        }
+    }
+}
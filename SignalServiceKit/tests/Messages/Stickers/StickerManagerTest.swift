@@ -6,6 +6,7 @@ import XCTest
 import Foundation
 import SignalCoreKit
 import SignalMetadataKit
+import PromiseKit
 @testable import SignalServiceKit
 
 class StickerManagerTest: SSKBaseTestSwift {
@@ -131,6 +132,47 @@ class StickerManagerTest: SSKBaseTestSwift {
         XCTAssertEqual(0, stickerManager.suggestedStickers(forTextInput: "This is a flag: 🇨🇦").count)
     }
 
+    func testPackInstaller() {
+        let packInfo = StickerPackInfo(packId: Randomness.generateRandomBytes(16),
+                                       packKey: Randomness.generateRandomBytes(Int32(StickerManager.packKeyLength)))
+        let items = [StickerPackItem(stickerId: 0, emojiString: "🌼"),
+                     StickerPackItem(stickerId: 1, emojiString: "🌼🇨🇦"),
+                     StickerPackItem(stickerId: 2, emojiString: "🇨🇦"),
+                     StickerPackItem(stickerId: 3, emojiString: "🇹🇹")]
+        let stickerPack = StickerPack(info: packInfo, title: nil, author: nil, cover: items[0], stickers: items)
+        let stickerInfos = stickerPack.stickerInfos
+        let failingStickerInfo = stickerInfos[3]
+
+        var fetchedStickerIds = [UInt32]()
+        let installer = StickerPackInstaller(stickerPack: stickerPack, stickerInfos: stickerInfos) { stickerInfo in
+            fetchedStickerIds.append(stickerInfo.stickerId)
+            // Nothing is installed until the whole pack has been fetched.
+            XCTAssertFalse(StickerManager.isStickerInstalled(stickerInfo: stickerInfo))
+            guard stickerInfo != failingStickerInfo else {
+                return Promise(error: StickerError.invalidInput)
+            }
+            return Promise.value(Randomness.generateRandomBytes(1))
+        }
+
+        let expectation = self.expectation(description: "Wait for sticker pack to be installed.")
+        installer.install().done {
+            XCTFail("Install should report the failed sticker.")
+        }.catch { _ in
+            expectation.fulfill()
+        }.retainUntilComplete()
+        waitForExpectations(timeout: 1.0, handler: nil)
+
+        XCTAssertEqual([0, 1, 2, 3], fetchedStickerIds.sorted())
+        XCTAssertEqual(4, installer.progress.completedUnitCount)
+        XCTAssertEqual(stickerInfos.prefix(3).map { $0.asKey() },
+                       StickerManager.installedStickers(forStickerPack: stickerPack).map { $0.asKey() })
+        XCTAssertNil(StickerManager.filepathForInstalledSticker(stickerInfo: failingStickerInfo))
+
+        XCTAssertEqual(2, StickerManager.suggestedStickers(forTextInput: "🌼").count)
+        XCTAssertEqual(2, StickerManager.suggestedStickers(forTextInput: "🇨🇦").count)
+        XCTAssertEqual(0, StickerManager.suggestedStickers(forTextInput: "🇹🇹").count)
+    }
+
     func testInfos() {
         let packId = Randomness.generateRandomBytes(16)
         let packKey = Randomness.generateRandomBytes(Int32(StickerManager.packKeyLength))
@@ -0,0 +1,121 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import XCTest
+@testable import SignalServiceKit
+
+class StickerSuggestionIndexTest: SSKBaseTestSwift {
+
+    private func buildSticker(emojiString: String?) -> InstalledSticker {
+        let stickerInfo = StickerInfo(packId: Randomness.generateRandomBytes(16),
+                                      packKey: Randomness.generateRandomBytes(Int32(StickerManager.packKeyLength)),
+                                      stickerId: 0)
+        return InstalledSticker(info: stickerInfo, emojiString: emojiString)
+    }
+
+    private func uniqueIds(_ stickers: [InstalledSticker]) -> [String] {
+        return stickers.map { $0.uniqueId }
+    }
+
+    // MARK: -
+
+    func testChanges() {
+        let index = StickerSuggestionIndex()
+        XCTAssertTrue(index.load(stickerIdsByEmoji: [:], stickers: [], changeCountBeforeRead: index.currentChangeCount))
+
+        let sticker1 = buildSticker(emojiString: "🌼")
+        let sticker2 = buildSticker(emojiString: "🌼🇨🇦")
+        let sticker3 = buildSticker(emojiString: nil)
+        index.addStickers([sticker1, sticker2, sticker3])
+
+        // Most recent first.
+        XCTAssertEqual(uniqueIds([sticker2, sticker1]), uniqueIds(index.stickers(forEmoji: "🌼")))
+        XCTAssertEqual(uniqueIds([sticker2]), uniqueIds(index.stickers(forEmoji: "🇨🇦")))
+        XCTAssertEqual([], index.stickers(forEmoji: "🇹🇹"))
+
+        // Re-adding a sticker makes it the most recent.
+        index.addStickers([sticker1])
+        XCTAssertEqual(uniqueIds([sticker1, sticker2]), uniqueIds(index.stickers(forEmoji: "🌼")))
+
+        index.removeSticker(sticker2)
+        XCTAssertEqual(uniqueIds([sticker1]), uniqueIds(index.stickers(forEmoji: "🌼")))
+        XCTAssertEqual([], index.stickers(forEmoji: "🇨🇦"))
+    }
+
+    func testLoadRacingChange() {
+        let index = StickerSuggestionIndex()
+        let changeCount = index.currentChangeCount
+
+        // A sticker is installed while the index is being read.
+        index.addStickers([buildSticker(emojiString: "🌼")])
+
+        XCTAssertFalse(index.load(stickerIdsByEmoji: [:], stickers: [], changeCountBeforeRead: changeCount))
+        XCTAssertFalse(index.isLoaded)
+        XCTAssertTrue(index.load(stickerIdsByEmoji: [:], stickers: [], changeCountBeforeRead: index.currentChangeCount))
+        XCTAssertTrue(index.isLoaded)
+    }
+
+    func testMatchesEmojiMap() {
+        let stickers = [buildSticker(emojiString: "🌼"),
+                        buildSticker(emojiString: "🌼🇨🇦"),
+                        buildSticker(emojiString: "🇨🇦🌼")]
+        write { transaction in
+            StickerManager.installStickers(stickers, transaction: transaction)
+        }
+        // Changes are applied to the index once they commit.
+        StickerManager.shared.suggestionIndexQueue.sync {}
+
+        for textInput in ["🌼", "🇨🇦", "🇹🇹", "🌼🇨🇦", "a🌼"] {
+            XCTAssertEqual(uniqueIds(StickerManager.suggestedStickers(forTextInput: textInput)),
+                           uniqueIds(StickerManager.shared.suggestedStickers(forTextInput: textInput)))
+        }
+
+        write { transaction in
+            StickerManager.uninstallSticker(stickerInfo: stickers[1].info, transaction: transaction)
+        }
+        StickerManager.shared.suggestionIndexQueue.sync {}
+
+        for textInput in ["🌼", "🇨🇦"] {
+            XCTAssertEqual(uniqueIds(StickerManager.suggestedStickers(forTextInput: textInput)),
+                           uniqueIds(StickerManager.shared.suggestedStickers(forTextInput: textInput)))
+        }
+    }
+
+    // Measures suggestion lookups, which the composer makes on every
+    // keystroke, with a large number of installed stickers.
+    func testLookupPerformance() {
+        let stickerCount = 5000
+        let emojiCount = 250
+        let lookupCount = 10000
+
+        var emojis = [String]()
+        for index in 0..<emojiCount {
+            emojis.append(String(UnicodeScalar(0x1F400 + index)!))
+        }
+        var stickers = [InstalledSticker]()
+        var stickerIdsByEmoji = [String: [String]]()
+        for index in 0..<stickerCount {
+            let emoji = emojis[index % emojiCount]
+            let sticker = buildSticker(emojiString: emoji)
+            stickers.append(sticker)
+            stickerIdsByEmoji[emoji, default: []].append(sticker.uniqueId)
+        }
+
+        let index = StickerSuggestionIndex()
+        XCTAssertTrue(index.load(stickerIdsByEmoji: stickerIdsByEmoji,
+                                 stickers: stickers,
+                                 changeCountBeforeRead: index.currentChangeCount))
+
+        measure {
+            let startDate = Date()
+            var suggestionCount = 0
+            for lookup in 0..<lookupCount {
+                suggestionCount += index.stickers(forEmoji: emojis[lookup % emojiCount]).count
+            }
+            let duration = Date().timeIntervalSince(startDate)
+            XCTAssertEqual(lookupCount * stickerCount / emojiCount, suggestionCount)
+            Logger.info(String(format: "[Bench] Sticker suggestion lookup: %0.2fus", duration * 1000 * 1000 / Double(lookupCount)))
+        }
+    }
+}
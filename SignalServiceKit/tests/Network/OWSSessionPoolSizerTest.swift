@@ -0,0 +1,70 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+import XCTest
+@testable import SignalServiceKit
+
+class OWSSessionPoolSizerTest: SSKBaseTestSwift {
+
+    private var now: TimeInterval = 1000
+
+    private func buildSizer() -> OWSSessionPoolSizer {
+        return OWSSessionPoolSizer(currentTime: { [unowned self] in self.now })
+    }
+
+    func testTracksPeakConcurrency() {
+        let sizer = buildSizer()
+        XCTAssertEqual(OWSSessionPoolSizer.minIdleCount, sizer.targetIdleCount)
+
+        for _ in 0..<5 {
+            sizer.didCheckOut()
+        }
+        for _ in 0..<5 {
+            sizer.didCheckIn()
+        }
+        XCTAssertEqual(0, sizer.inFlightCount)
+        XCTAssertEqual(5, sizer.targetIdleCount)
+
+        for _ in 0..<100 {
+            sizer.didCheckOut()
+        }
+        XCTAssertEqual(OWSSessionPoolSizer.maxIdleCount, sizer.targetIdleCount)
+        for _ in 0..<100 {
+            sizer.didCheckIn()
+        }
+    }
+
+    func testShrinksAfterLoadDrops() {
+        let sizer = buildSizer()
+        for _ in 0..<8 {
+            sizer.didCheckOut()
+        }
+        for _ in 0..<8 {
+            sizer.didCheckIn()
+        }
+        XCTAssertEqual(8, sizer.targetIdleCount)
+
+        // The previous window's peak is still honored...
+        now += OWSSessionPoolSizer.windowDuration
+        XCTAssertEqual(8, sizer.targetIdleCount)
+
+        // ...but not once it has aged out.
+        now += OWSSessionPoolSizer.windowDuration
+        XCTAssertEqual(OWSSessionPoolSizer.minIdleCount, sizer.targetIdleCount)
+    }
+
+    func testIdleGapForgetsPeak() {
+        let sizer = buildSizer()
+        for _ in 0..<6 {
+            sizer.didCheckOut()
+        }
+        for _ in 0..<6 {
+            sizer.didCheckIn()
+        }
+
+        now += 3 * OWSSessionPoolSizer.windowDuration
+        XCTAssertEqual(OWSSessionPoolSizer.minIdleCount, sizer.targetIdleCount)
+    }
+}
@@ -0,0 +1,101 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+import XCTest
+@testable import SignalServiceKit
+
+class OWSWebSocketEnvelopeBatcherTest: SSKBaseTestSwift {
+
+    private let socketQueue = DispatchQueue(label: "org.signal.websocket.test")
+
+    // Should only be accessed on socketQueue.
+    private var persistedEnvelopeCount = 0
+    private var ackedRequestIds = [UInt64]()
+
+    override func setUp() {
+        super.setUp()
+
+        persistedEnvelopeCount = 0
+        ackedRequestIds = []
+    }
+
+    private func buildRequest(requestId: UInt64) -> WebSocketProtoWebSocketRequestMessage {
+        return try! WebSocketProtoWebSocketRequestMessage.builder(verb: "PUT",
+                                                                  path: "/api/v1/message",
+                                                                  requestID: requestId).build()
+    }
+
+    private func buildBatcher(persistBlock: @escaping ([Data]) -> Void,
+                              expectation: XCTestExpectation,
+                              requestCount: Int) -> OWSWebSocketEnvelopeBatcher {
+        let socketQueue = self.socketQueue
+        let persistAndCount: OWSWebSocketEnvelopeBatcher.PersistBlock = { [weak self] envelopes, _ in
+            persistBlock(envelopes)
+            socketQueue.sync {
+                self?.persistedEnvelopeCount += envelopes.count
+            }
+        }
+        let ackBlock: OWSWebSocketEnvelopeBatcher.AckBlock = { [weak self] requests in
+            guard let self = self else { return }
+            // Acks must never precede the persistence of the envelopes they cover.
+            XCTAssertGreaterThanOrEqual(self.persistedEnvelopeCount, self.ackedRequestIds.count + requests.count)
+            self.ackedRequestIds += requests.map { $0.requestID }
+            if self.ackedRequestIds.count == requestCount {
+                expectation.fulfill()
+            }
+        }
+        return OWSWebSocketEnvelopeBatcher(socketQueue: socketQueue, persistBlock: persistAndCount, ackBlock: ackBlock)
+    }
+
+    func testAcksInOrderAfterPersistence() {
+        let requestCount = 500
+        let expectation = self.expectation(description: "All requests acked")
+        var batchSizes = [Int]()
+        let batcher = buildBatcher(persistBlock: { envelopes in
+            batchSizes.append(envelopes.count)
+        }, expectation: expectation, requestCount: requestCount)
+
+        socketQueue.async {
+            for requestId in 0..<UInt64(requestCount) {
+                batcher.enqueue(envelopeData: Randomness.generateRandomBytes(64),
+                                request: self.buildRequest(requestId: requestId))
+            }
+        }
+        waitForExpectations(timeout: 5.0, handler: nil)
+
+        XCTAssertEqual(Array(0..<UInt64(requestCount)), ackedRequestIds)
+        XCTAssertEqual(requestCount, batchSizes.reduce(0, +))
+        XCTAssertLessThan(batchSizes.count, requestCount)
+        XCTAssertLessThanOrEqual(batchSizes.max() ?? 0, OWSWebSocketEnvelopeBatcher.maxBatchSize)
+    }
+
+    // Measures ingest throughput from frame hand-off to ack, persisting
+    // envelopes as decrypt jobs the way OWSMessageReceiver does.
+    func testIngestThroughput() {
+        let requestCount = 2000
+
+        measure {
+            self.persistedEnvelopeCount = 0
+            self.ackedRequestIds = []
+
+            let expectation = self.expectation(description: "All requests acked")
+            let batcher = buildBatcher(persistBlock: { envelopes in
+                self.write { transaction in
+                    for envelopeData in envelopes {
+                        OWSMessageDecryptJob(envelopeData: envelopeData).anyInsert(transaction: transaction)
+                    }
+                }
+            }, expectation: expectation, requestCount: requestCount)
+
+            socketQueue.async {
+                for requestId in 0..<UInt64(requestCount) {
+                    batcher.enqueue(envelopeData: Randomness.generateRandomBytes(512),
+                                    request: self.buildRequest(requestId: requestId))
+                }
+            }
+            waitForExpectations(timeout: 30.0, handler: nil)
+        }
+    }
+}
@@ -0,0 +1,115 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import XCTest
+@testable import SignalServiceKit
+
+class ProxiedContentDiskCacheTest: SSKBaseTestSwift {
+
+    var folderPath: String!
+
+    override func setUp() {
+        super.setUp()
+
+        folderPath = OWSFileSystem.temporaryFilePath()
+    }
+
+    override func tearDown() {
+        OWSFileSystem.deleteFileIfExists(folderPath)
+
+        super.tearDown()
+    }
+
+    // MARK: -
+
+    private func url(_ name: String) -> NSURL {
+        return NSURL(string: "https://media.giphy.com/media/\(name)/200w.gif")!
+    }
+
+    private func writeAsset(byteCount: Int) -> (String, Data) {
+        let data = Randomness.generateRandomBytes(Int32(byteCount))
+        let filePath = OWSFileSystem.temporaryFilePath(withFileExtension: "gif")
+        try! data.write(to: URL(fileURLWithPath: filePath))
+        return (filePath, data)
+    }
+
+    private func linkedData(cache: ProxiedContentDiskCache, url: NSURL) -> Data? {
+        let filePath = OWSFileSystem.temporaryFilePath(withFileExtension: "gif")
+        guard cache.linkCachedAsset(url: url, toFilePath: filePath) else {
+            return nil
+        }
+        defer { OWSFileSystem.deleteFileIfExists(filePath) }
+        return try! Data(contentsOf: URL(fileURLWithPath: filePath))
+    }
+
+    // MARK: - Tests
+
+    func testHitsAndMisses() {
+        let cache = ProxiedContentDiskCache(folderPath: folderPath, maxByteCount: 1000)
+        XCTAssertNil(linkedData(cache: cache, url: url("a")))
+
+        let (filePath, data) = writeAsset(byteCount: 100)
+        cache.storeAsset(url: url("a"), filePath: filePath)
+        // The cache keeps its own link to the asset.
+        OWSFileSystem.deleteFile(filePath)
+
+        XCTAssertEqual(data, linkedData(cache: cache, url: url("a")))
+        XCTAssertEqual(data, linkedData(cache: cache, url: url("a")))
+        XCTAssertNil(linkedData(cache: cache, url: url("b")))
+
+        let metrics = cache.metrics
+        XCTAssertEqual(2, metrics.hitCount)
+        XCTAssertEqual(2, metrics.missCount)
+        XCTAssertEqual(200, metrics.bytesSaved)
+        XCTAssertEqual(100, cache.byteCount)
+    }
+
+    func testEvictsLeastRecentlyUsed() {
+        let cache = ProxiedContentDiskCache(folderPath: folderPath, maxByteCount: 250)
+        for name in ["a", "b"] {
+            cache.storeAsset(url: url(name), filePath: writeAsset(byteCount: 100).0)
+        }
+        XCTAssertNotNil(linkedData(cache: cache, url: url("a")))
+
+        cache.storeAsset(url: url("c"), filePath: writeAsset(byteCount: 100).0)
+
+        XCTAssertEqual(200, cache.byteCount)
+        XCTAssertNotNil(linkedData(cache: cache, url: url("a")))
+        XCTAssertNil(linkedData(cache: cache, url: url("b")))
+        XCTAssertNotNil(linkedData(cache: cache, url: url("c")))
+
+        // Assets larger than the whole cache aren't cached.
+        cache.storeAsset(url: url("d"), filePath: writeAsset(byteCount: 300).0)
+        XCTAssertNil(linkedData(cache: cache, url: url("d")))
+        XCTAssertEqual(200, cache.byteCount)
+    }
+
+    func testPersistsAcrossInstances() {
+        let (filePath, data) = writeAsset(byteCount: 100)
+        ProxiedContentDiskCache(folderPath: folderPath, maxByteCount: 1000).storeAsset(url: url("a"), filePath: filePath)
+
+        let cache = ProxiedContentDiskCache(folderPath: folderPath, maxByteCount: 1000)
+        XCTAssertEqual(100, cache.byteCount)
+        XCTAssertEqual(data, linkedData(cache: cache, url: url("a")))
+    }
+
+    func testSegmentsWriteAtOffsets() {
+        let data = Randomness.generateRandomBytes(1000)
+        let filePath = OWSFileSystem.temporaryFilePath(withFileExtension: "gif")
+        defer { OWSFileSystem.deleteFileIfExists(filePath) }
+
+        let assetFile = ProxiedContentAssetFile(filePath: filePath, contentLength: UInt(data.count))!
+        XCTAssertEqual(data.count, OWSFileSystem.fileSize(ofPath: filePath)?.intValue)
+
+        // Segments complete out of order, and the last one overlaps its
+        // predecessor.
+        XCTAssertTrue(assetFile.write(data: data.subdata(in: 700..<1000), offset: 700))
+        XCTAssertTrue(assetFile.write(data: data.subdata(in: 0..<400), offset: 0))
+        XCTAssertTrue(assetFile.write(data: data.subdata(in: 400..<800), offset: 400))
+        assetFile.close()
+
+        XCTAssertEqual(data, try! Data(contentsOf: URL(fileURLWithPath: filePath)))
+        XCTAssertFalse(assetFile.write(data: data, offset: 0))
+    }
+}
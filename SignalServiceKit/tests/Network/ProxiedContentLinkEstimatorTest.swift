@@ -0,0 +1,229 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import XCTest
+@testable import SignalServiceKit
+
+class ProxiedContentLinkEstimatorTest: SSKBaseTestSwift {
+
+    let host = "media.giphy.com"
+
+    // MARK: -
+
+    private func measuredEstimator(roundTripTime: TimeInterval, throughput: Double) -> ProxiedContentLinkEstimator {
+        let estimator = ProxiedContentLinkEstimator()
+        let byteCount: Int64 = 100 * 1024
+        estimator.recordRoundTrip(host: host, duration: roundTripTime)
+        estimator.recordTransfer(host: host, byteCount: byteCount, duration: Double(byteCount) / throughput)
+        return estimator
+    }
+
+    func testDefaultsUntilMeasured() {
+        let estimator = ProxiedContentLinkEstimator()
+        XCTAssertNil(estimator.segmentSize(host: host, contentLength: 100_000))
+        XCTAssertEqual(ProxiedContentLinkEstimator.defaultMaxConcurrentRequests, estimator.maxConcurrentRequests(host: host))
+
+        // Small transfers don't count towards throughput.
+        estimator.recordRoundTrip(host: host, duration: 0.1)
+        estimator.recordTransfer(host: host, byteCount: 1024, duration: 0.001)
+        XCTAssertNil(estimator.estimate(host: host))
+        XCTAssertNil(estimator.estimate(host: "media1.giphy.com"))
+    }
+
+    func testSmoothsSamples() {
+        let estimator = measuredEstimator(roundTripTime: 0.1, throughput: 100_000)
+        estimator.recordRoundTrip(host: host, duration: 0.5)
+
+        XCTAssertEqual(0.2, estimator.estimate(host: host)!.roundTripTime, accuracy: 0.0001)
+        XCTAssertEqual(100_000, estimator.estimate(host: host)!.throughput, accuracy: 1)
+    }
+
+    func testFastLink() {
+        let estimator = measuredEstimator(roundTripTime: 0.08, throughput: 2_000_000)
+
+        // Whole GIF stills in a single request, several at a time.
+        XCTAssertEqual(80_000, estimator.segmentSize(host: host, contentLength: 80_000))
+        XCTAssertEqual(625 * 1024, estimator.segmentSize(host: host, contentLength: 3_000_000))
+        XCTAssertEqual(4, estimator.maxConcurrentRequests(host: host))
+    }
+
+    func testSlowLink() {
+        let estimator = measuredEstimator(roundTripTime: 0.6, throughput: 10_000)
+
+        XCTAssertEqual(16 * 1024, estimator.segmentSize(host: host, contentLength: 3_000_000))
+        XCTAssertEqual(2, estimator.maxConcurrentRequests(host: host))
+    }
+
+    // MARK: - Simulated Link
+
+    // Simulates loading a grid of GIF stills over a link with a fixed round
+    // trip time and a fixed capacity, which is shared equally by the
+    // requests transferring at any moment. Mirrors the scheduling in
+    // ProxiedContentDownloader. Returns each asset's time to first frame.
+    private func simulateGrid(assetSizes: [UInt],
+                              roundTripTime: TimeInterval,
+                              capacity: Double,
+                              isAdaptive: Bool) -> [TimeInterval] {
+
+        class SimulatedAsset {
+            let contentLength: UInt
+            var hasContentLength = false
+            var isRequestingSize = false
+            var waitingSegmentLengths = [UInt]()
+            var downloadingCount: UInt = 0
+            var completionTime: TimeInterval?
+
+            init(contentLength: UInt) {
+                self.contentLength = contentLength
+            }
+        }
+
+        class SimulatedRequest {
+            let asset: SimulatedAsset
+            let isSizeRequest: Bool
+            let byteCount: Double
+            let startTime: TimeInterval
+            var latencyRemaining: TimeInterval
+            var bytesRemaining: Double
+            var firstByteTime: TimeInterval?
+
+            init(asset: SimulatedAsset, isSizeRequest: Bool, byteCount: UInt, startTime: TimeInterval, roundTripTime: TimeInterval) {
+                self.asset = asset
+                self.isSizeRequest = isSizeRequest
+                self.byteCount = Double(byteCount)
+                self.startTime = startTime
+                self.latencyRemaining = roundTripTime
+                self.bytesRemaining = Double(byteCount)
+            }
+        }
+
+        let estimator = ProxiedContentLinkEstimator()
+        let initialSegmentLength: UInt = 1536
+        let assets = assetSizes.map { SimulatedAsset(contentLength: $0) }
+        var requests = [SimulatedRequest]()
+        var now: TimeInterval = 0
+
+        func fixedSegmentSize(contentLength: UInt) -> UInt {
+            for segmentSize: UInt in [1024 * 1024, 500 * 1024, 100 * 1024, 50 * 1024, 10 * 1024, 1024] where contentLength >= segmentSize {
+                return segmentSize
+            }
+            return contentLength
+        }
+
+        func startRequests() {
+            while true {
+                let maxRequestCount = (isAdaptive
+                    ? estimator.maxConcurrentRequests(host: host)
+                    : ProxiedContentLinkEstimator.defaultMaxConcurrentRequests)
+                guard requests.count < maxRequestCount else {
+                    return
+                }
+                let maxRequestsPerAssetCount = max(1, maxRequestCount - 1)
+                guard let asset = assets.first(where: { asset in
+                    guard asset.completionTime == nil, !asset.isRequestingSize else {
+                        return false
+                    }
+                    return (!asset.hasContentLength ||
+                        (!asset.waitingSegmentLengths.isEmpty && asset.downloadingCount < maxRequestsPerAssetCount))
+                }) else {
+                    return
+                }
+                let request: SimulatedRequest
+                if !asset.hasContentLength {
+                    asset.isRequestingSize = true
+                    request = SimulatedRequest(asset: asset, isSizeRequest: true, byteCount: initialSegmentLength, startTime: now, roundTripTime: roundTripTime)
+                } else {
+                    request = SimulatedRequest(asset: asset, isSizeRequest: false, byteCount: asset.waitingSegmentLengths.removeFirst(), startTime: now, roundTripTime: roundTripTime)
+                }
+                asset.downloadingCount += 1
+                requests.append(request)
+            }
+        }
+
+        startRequests()
+        while !requests.isEmpty {
+            let transferringCount = requests.filter { $0.firstByteTime != nil }.count
+            let rate = transferringCount > 0 ? capacity / Double(transferringCount) : 0
+            let step = requests.map { request -> TimeInterval in
+                return request.firstByteTime == nil ? request.latencyRemaining : request.bytesRemaining / rate
+            }.min()!
+            now += step
+
+            var completedRequests = [SimulatedRequest]()
+            for request in requests {
+                if request.firstByteTime == nil {
+                    request.latencyRemaining -= step
+                    if request.latencyRemaining <= 1e-9 {
+                        request.firstByteTime = now
+                    }
+                } else {
+                    request.bytesRemaining -= rate * step
+                    if request.bytesRemaining <= 1e-6 {
+                        completedRequests.append(request)
+                    }
+                }
+            }
+
+            for request in completedRequests {
+                requests.removeAll { $0 === request }
+                let asset = request.asset
+                asset.downloadingCount -= 1
+                let firstByteTime = request.firstByteTime!
+                estimator.recordRoundTrip(host: host, duration: firstByteTime - request.startTime)
+                estimator.recordTransfer(host: host, byteCount: Int64(request.byteCount), duration: now - firstByteTime)
+
+                if request.isSizeRequest {
+                    asset.isRequestingSize = false
+                    asset.hasContentLength = true
+                    let segmentLength = (isAdaptive
+                        ? estimator.segmentSize(host: host, contentLength: asset.contentLength)
+                        : nil) ?? fixedSegmentSize(contentLength: asset.contentLength)
+                    let remainingLength = asset.contentLength - min(asset.contentLength, initialSegmentLength)
+                    let segmentCount = (remainingLength + segmentLength - 1) / segmentLength
+                    asset.waitingSegmentLengths = Array(repeating: segmentLength, count: Int(segmentCount))
+                }
+                if asset.hasContentLength, asset.waitingSegmentLengths.isEmpty, asset.downloadingCount == 0 {
+                    asset.completionTime = now
+                }
+            }
+            startRequests()
+        }
+
+        return assets.map { $0.completionTime! }.sorted()
+    }
+
+    func testGridTimeToFirstFrame() {
+        // GIF stills are typically 30-120 KB.
+        let assetSizes: [UInt] = (0..<30).map { index in UInt(30 * 1024 + (index * 7919) % (90 * 1024)) }
+
+        let links: [(String, TimeInterval, Double)] = [
+            ("Wi-Fi", 0.03, 5_000_000),
+            ("LTE", 0.08, 1_500_000),
+            ("3G", 0.3, 100_000),
+            ("EDGE", 0.6, 15_000)
+        ]
+        for (name, roundTripTime, capacity) in links {
+            let fixedTimes = simulateGrid(assetSizes: assetSizes, roundTripTime: roundTripTime, capacity: capacity, isAdaptive: false)
+            let adaptiveTimes = simulateGrid(assetSizes: assetSizes, roundTripTime: roundTripTime, capacity: capacity, isAdaptive: true)
+
+            let fixedMedian = fixedTimes[fixedTimes.count / 2]
+            let adaptiveMedian = adaptiveTimes[adaptiveTimes.count / 2]
+            Logger.info(String(format: "[Bench] %@ grid time to first frame, fixed median: %0.2fs, last: %0.2fs; adaptive median: %0.2fs, last: %0.2fs",
+                               name,
+                               fixedMedian,
+                               fixedTimes.last!,
+                               adaptiveMedian,
+                               adaptiveTimes.last!))
+
+            // Adaptive scheduling should never be meaningfully worse.
+            XCTAssertLessThanOrEqual(adaptiveMedian, fixedMedian * 1.1, name)
+            XCTAssertLessThanOrEqual(adaptiveTimes.last!, fixedTimes.last! * 1.1, name)
+        }
+
+        // ...and should fill the grid much sooner on a fast link.
+        let fixedTimes = simulateGrid(assetSizes: assetSizes, roundTripTime: 0.08, capacity: 1_500_000, isAdaptive: false)
+        let adaptiveTimes = simulateGrid(assetSizes: assetSizes, roundTripTime: 0.08, capacity: 1_500_000, isAdaptive: true)
+        XCTAssertLessThan(adaptiveTimes.last!, fixedTimes.last! * 0.8)
+    }
+}
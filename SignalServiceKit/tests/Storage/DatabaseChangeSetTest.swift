@@ -0,0 +1,138 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+import XCTest
+@testable import SignalServiceKit
+
+class DatabaseChangeSetTest: SSKBaseTestSwift {
+
+    private var lastChanges: DatabaseChangeSet?
+    private var expectation: XCTestExpectation?
+
+    override func setUp() {
+        super.setUp()
+
+        storageCoordinator.useGRDBForTests()
+        try! databaseStorage.grdbStorage.setupUIDatabase()
+    }
+
+    override func tearDown() {
+        databaseStorage.grdbStorage.testing_tearDownUIDatabase()
+
+        super.tearDown()
+    }
+
+    // MARK: - Dependencies
+
+    var storageCoordinator: StorageCoordinator {
+        return SSKEnvironment.shared.storageCoordinator
+    }
+
+    // MARK: -
+
+    private func observeNextChange(_ writeBlock: (SDSAnyWriteTransaction) -> Void) -> DatabaseChangeSet? {
+        lastChanges = nil
+        expectation = self.expectation(description: "Database snapshot did update")
+        write(writeBlock)
+        waitForExpectations(timeout: 1.0, handler: nil)
+        return lastChanges
+    }
+
+    func testChangeSetCapturesUniqueIds() {
+        let snapshotDelegate = DatabaseSnapshotBlockDelegate { [weak self] changes in
+            guard let self = self else { return }
+            self.lastChanges = changes
+            self.expectation?.fulfill()
+            self.expectation = nil
+        }
+        guard let observer = databaseStorage.grdbStorage.uiDatabaseObserver else {
+            XCTFail("Missing uiDatabaseObserver.")
+            return
+        }
+        observer.appendSnapshotDelegate(snapshotDelegate)
+
+        var thread: TSContactThread!
+        var message: TSOutgoingMessage!
+        let insertChanges = observeNextChange { transaction in
+            thread = TSContactThread.getOrCreateThread(withContactAddress: SignalServiceAddress(phoneNumber: "+12345678900"),
+                                                       transaction: transaction)
+            message = TSOutgoingMessage(in: thread, messageBody: "Hello Alice", attachmentId: nil)
+            message.anyInsert(transaction: transaction)
+        }
+        guard let changes = insertChanges else {
+            XCTFail("Missing changes.")
+            return
+        }
+        XCTAssertTrue(changes.tableNames.contains(InteractionRecord.databaseTableName))
+        XCTAssertEqual([message.uniqueId], try changes.updatedUniqueIds(tableName: InteractionRecord.databaseTableName))
+        XCTAssertEqual([thread.uniqueId], try changes.updatedUniqueIds(tableName: ThreadRecord.databaseTableName))
+        let interactionChanges = try! changes.rowChanges(tableName: InteractionRecord.databaseTableName)
+        XCTAssertEqual(1, interactionChanges.count)
+        XCTAssertEqual(.insert, interactionChanges.first?.kind)
+        XCTAssertEqual(thread.uniqueId, interactionChanges.first?.threadUniqueId)
+
+        let touchChanges = observeNextChange { transaction in
+            databaseStorage.touch(interaction: message, transaction: transaction)
+        }
+        XCTAssertEqual([message.uniqueId], try touchChanges?.updatedUniqueIds(tableName: InteractionRecord.databaseTableName))
+        XCTAssertEqual(.update, try touchChanges?.rowChanges(tableName: InteractionRecord.databaseTableName).first?.kind)
+
+        let removeChanges = observeNextChange { transaction in
+            message.anyRemove(transaction: transaction)
+        }
+        XCTAssertEqual([], try removeChanges?.updatedUniqueIds(tableName: InteractionRecord.databaseTableName))
+        XCTAssertEqual([message.uniqueId], try removeChanges?.deletedUniqueIds(tableName: InteractionRecord.databaseTableName))
+    }
+
+    func testRolledBackSavepointIsDropped() {
+        let snapshotDelegate = DatabaseSnapshotBlockDelegate { [weak self] changes in
+            guard let self = self else { return }
+            guard changes.tableNames.contains(InteractionRecord.databaseTableName) else { return }
+            self.lastChanges = changes
+            self.expectation?.fulfill()
+            self.expectation = nil
+        }
+        guard let observer = databaseStorage.grdbStorage.uiDatabaseObserver else {
+            XCTFail("Missing uiDatabaseObserver.")
+            return
+        }
+        observer.appendSnapshotDelegate(snapshotDelegate)
+
+        var thread: TSContactThread!
+        write { transaction in
+            thread = TSContactThread.getOrCreateThread(withContactAddress: SignalServiceAddress(phoneNumber: "+12345678900"),
+                                                       transaction: transaction)
+        }
+
+        // Both writes are coalesced into one transaction, but the second
+        // is rolled back to its savepoint.
+        struct WriteError: Error {}
+        let keptMessage = TSOutgoingMessage(in: thread, messageBody: "Hello Alice", attachmentId: nil)
+        let rolledBackMessage = TSOutgoingMessage(in: thread, messageBody: "Goodbye Alice", attachmentId: nil)
+        lastChanges = nil
+        expectation = self.expectation(description: "Database snapshot did update")
+        databaseStorage.asyncCoalescedWrite(block: { transaction in
+            keptMessage.anyInsert(transaction: transaction)
+        }, completionQueue: .main) { error in
+            XCTAssertNil(error)
+        }
+        databaseStorage.asyncCoalescedWrite(block: { transaction in
+            rolledBackMessage.anyInsert(transaction: transaction)
+            throw WriteError()
+        }, completionQueue: .main) { error in
+            XCTAssertNotNil(error)
+        }
+        waitForExpectations(timeout: 1.0, handler: nil)
+
+        XCTAssertEqual([keptMessage.uniqueId], try lastChanges?.updatedUniqueIds(tableName: InteractionRecord.databaseTableName))
+    }
+
+    func testMergeKinds() {
+        XCTAssertEqual(.insert, DatabaseChangeCollector.merge(kind: .insert, withLaterKind: .update))
+        XCTAssertEqual(.delete, DatabaseChangeCollector.merge(kind: .insert, withLaterKind: .delete))
+        XCTAssertEqual(.delete, DatabaseChangeCollector.merge(kind: .update, withLaterKind: .delete))
+        XCTAssertEqual(.update, DatabaseChangeCollector.merge(kind: .delete, withLaterKind: .insert))
+    }
+}
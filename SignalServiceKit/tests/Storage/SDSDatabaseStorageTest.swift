@@ -166,4 +166,32 @@ class SDSDatabaseStorageTest: SSKBaseTestSwift {
         XCTAssertEqual(1, TSThread.anyFetchAll(databaseStorage: storage).count)
         XCTAssertEqual(0, TSInteraction.anyFetchAll(databaseStorage: storage).count)
     }
+
+    func test_coalescedWrites() {
+        SSKEnvironment.shared.storageCoordinator.useGRDBForTests()
+        let storage = SDSDatabaseStorage.shared
+
+        let threadCount = 10
+        var errorCount = 0
+        for index in 0..<threadCount {
+            let expectation = self.expectation(description: "Write \(index)")
+            storage.asyncCoalescedWrite(block: { transaction in
+                let contactAddress = SignalServiceAddress(phoneNumber: "+1321321430\(index)")
+                TSContactThread(contactAddress: contactAddress).anyInsert(transaction: transaction)
+                if index % 2 == 1 {
+                    // Only this write should be rolled back.
+                    throw OWSErrorMakeAssertionError("Failing write \(index)")
+                }
+            }, completion: { error in
+                if error != nil {
+                    errorCount += 1
+                }
+                expectation.fulfill()
+            })
+        }
+        waitForExpectations(timeout: 5.0, handler: nil)
+
+        XCTAssertEqual(threadCount / 2, errorCount)
+        XCTAssertEqual(threadCount / 2, TSThread.anyFetchAll(databaseStorage: storage).count)
+    }
 }
@@ -0,0 +1,123 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+import XCTest
+@testable import SignalServiceKit
+
+class SSKSessionStoreTest: SSKBaseTestSwift {
+
+    // MARK: - Dependencies
+
+    var storageCoordinator: StorageCoordinator {
+        return SSKEnvironment.shared.storageCoordinator
+    }
+
+    // MARK: -
+
+    let address = SignalServiceAddress(phoneNumber: "+13213334444")
+
+    override func setUp() {
+        super.setUp()
+
+        storageCoordinator.useGRDBForTests()
+    }
+
+    func testStoreAndLoad() {
+        let sessionStore = SSKSessionStore()
+
+        write { transaction in
+            XCTAssertTrue(sessionStore.loadSession(for: self.address, deviceId: 1, transaction: transaction).isFresh)
+
+            sessionStore.storeSession(SessionRecord(), for: self.address, deviceId: 1, transaction: transaction)
+            sessionStore.storeSession(SessionRecord(), for: self.address, deviceId: 2, transaction: transaction)
+        }
+
+        write { transaction in
+            XCTAssertFalse(sessionStore.loadSession(for: self.address, deviceId: 1, transaction: transaction).isFresh)
+            XCTAssertFalse(sessionStore.loadSession(for: self.address, deviceId: 2, transaction: transaction).isFresh)
+            XCTAssertTrue(sessionStore.loadSession(for: self.address, deviceId: 3, transaction: transaction).isFresh)
+        }
+
+        // With an empty cache, this reads the stored rows.
+        SSKSessionRecordCache.shared.removeAll()
+        write { transaction in
+            let otherSessionStore = SSKSessionStore()
+            XCTAssertFalse(otherSessionStore.loadSession(for: self.address, deviceId: 1, transaction: transaction).isFresh)
+            XCTAssertEqual(Set([1, 2]),
+                           Set(otherSessionStore.subDevicesSessions(for: self.address, transaction: transaction).compactMap { ($0 as? NSNumber)?.intValue }))
+        }
+    }
+
+    func testStoresShareCache() {
+        let sessionStore = SSKSessionStore()
+
+        write { transaction in
+            sessionStore.storeSession(SessionRecord(), for: self.address, deviceId: 1, transaction: transaction)
+        }
+
+        // Archiving through another store mustn't leave a stale record in
+        // the first store's cache.
+        write { transaction in
+            SSKSessionStore().archiveAllSessions(for: self.address, transaction: transaction)
+        }
+
+        write { transaction in
+            let record = sessionStore.loadSession(for: self.address, deviceId: 1, transaction: transaction)
+            XCTAssertEqual(1, record.previousSessionStates().count)
+        }
+    }
+
+    func testDeleteSession() {
+        let sessionStore = SSKSessionStore()
+
+        write { transaction in
+            sessionStore.storeSession(SessionRecord(), for: self.address, deviceId: 1, transaction: transaction)
+            sessionStore.storeSession(SessionRecord(), for: self.address, deviceId: 2, transaction: transaction)
+            sessionStore.deleteSession(for: self.address, deviceId: 1, transaction: transaction)
+        }
+
+        write { transaction in
+            XCTAssertTrue(sessionStore.loadSession(for: self.address, deviceId: 1, transaction: transaction).isFresh)
+            XCTAssertFalse(sessionStore.loadSession(for: self.address, deviceId: 2, transaction: transaction).isFresh)
+
+            sessionStore.deleteAllSessions(for: self.address, transaction: transaction)
+        }
+
+        write { transaction in
+            XCTAssertTrue(sessionStore.loadSession(for: self.address, deviceId: 2, transaction: transaction).isFresh)
+        }
+    }
+
+    func testMigratesLegacySessions() {
+        let sessionStore = SSKSessionStore()
+        let legacyStore = SDSKeyValueStore(collection: "TSStorageManagerSessionStoreCollection")
+
+        write { transaction in
+            let accountId = OWSAccountIdFinder().ensureAccountId(forAddress: self.address, transaction: transaction)
+            let legacyRecord = SessionRecord()
+            legacyRecord.markAsUnFresh()
+            let legacySessions: NSDictionary = [NSNumber(value: 1): legacyRecord, NSNumber(value: 2): legacyRecord]
+            legacyStore.setObject(legacySessions, key: accountId, transaction: transaction)
+        }
+
+        // Legacy sessions can be read before they are migrated.
+        write { transaction in
+            XCTAssertFalse(sessionStore.loadSession(for: self.address, deviceId: 1, transaction: transaction).isFresh)
+            XCTAssertEqual(1, legacyStore.numberOfKeys(transaction: transaction))
+        }
+
+        // Modifying the account's sessions migrates them.
+        write { transaction in
+            sessionStore.storeSession(SessionRecord(), for: self.address, deviceId: 3, transaction: transaction)
+            XCTAssertEqual(0, legacyStore.numberOfKeys(transaction: transaction))
+        }
+
+        write { transaction in
+            for deviceId: Int32 in 1...3 {
+                XCTAssertFalse(sessionStore.loadSession(for: self.address, deviceId: deviceId, transaction: transaction).isFresh)
+            }
+        }
+    }
+}
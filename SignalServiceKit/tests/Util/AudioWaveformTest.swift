@@ -0,0 +1,164 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import XCTest
+import AVFoundation
+@testable import SignalServiceKit
+
+class AudioWaveformTest: SSKBaseTestSwift {
+
+    private func buildDecibelSamples(count: Int) -> [Float] {
+        return (0..<count).map { index in
+            return -50 * Float(index % 17) / 16
+        }
+    }
+
+    // Speech-like audio: a tone whose loudness rises and falls a few times a
+    // second, with pauses.
+    private func buildVoiceNote(duration: TimeInterval) -> URL {
+        let url = URL(fileURLWithPath: OWSFileSystem.temporaryFilePath(withFileExtension: "m4a"))
+        let sampleRate: Double = 44100
+        let format = AVAudioFormat(standardFormatWithSampleRate: sampleRate, channels: 1)!
+
+        autoreleasepool {
+            let file = try! AVAudioFile(forWriting: url,
+                                        settings: [AVFormatIDKey: kAudioFormatMPEG4AAC,
+                                                   AVSampleRateKey: sampleRate,
+                                                   AVNumberOfChannelsKey: 1],
+                                        commonFormat: .pcmFormatFloat32,
+                                        interleaved: false)
+            let frameCapacity = AVAudioFrameCount(sampleRate)
+            let buffer = AVAudioPCMBuffer(pcmFormat: format, frameCapacity: frameCapacity)!
+            var frameIndex = 0
+            for _ in 0..<Int(duration) {
+                let samples = buffer.floatChannelData![0]
+                for index in 0..<Int(frameCapacity) {
+                    let time = Double(frameIndex + index) / sampleRate
+                    let envelope = max(0, sin(time * 2 * .pi * 0.7)) * (time.truncatingRemainder(dividingBy: 7) < 5 ? 1 : 0)
+                    samples[index] = Float(envelope * 0.5 * sin(time * 2 * .pi * 220))
+                }
+                buffer.frameLength = frameCapacity
+                try! file.write(from: buffer)
+                frameIndex += Int(frameCapacity)
+            }
+        }
+        return url
+    }
+
+    // MARK: -
+
+    func testFileRoundTrip() {
+        let decibelSamples = buildDecibelSamples(count: 100)
+        let data = AudioWaveform.serialize(decibelSamples: decibelSamples)
+        XCTAssertEqual(112, data.count)
+
+        let parsedSamples = try! AudioWaveform.parseDecibelSamples(data: data)
+        XCTAssertEqual(decibelSamples.count, parsedSamples.count)
+        for (sample, parsedSample) in zip(decibelSamples, parsedSamples) {
+            XCTAssertEqual(sample, parsedSample, accuracy: 0.1)
+        }
+
+        XCTAssertThrowsError(try AudioWaveform.parseDecibelSamples(data: data.prefix(50)))
+    }
+
+    func testReadFiles() {
+        let decibelSamples = buildDecibelSamples(count: 100)
+        let filePath = OWSFileSystem.temporaryFilePath()
+        defer { _ = OWSFileSystem.deleteFileIfExists(filePath) }
+
+        try! AudioWaveform(decibelSamples: decibelSamples).write(toFile: filePath, atomically: true)
+        let waveform = try! AudioWaveform(contentsOfFile: filePath)
+        XCTAssertTrue(waveform.isSamplingComplete)
+        XCTAssertEqual(100, waveform.normalizedLevelsToDisplay(sampleCount: 100)!.count)
+
+        // Waveforms cached before the binary format are keyed archives.
+        let archivedData = NSKeyedArchiver.archivedData(withRootObject: decibelSamples)
+        try! archivedData.write(to: URL(fileURLWithPath: filePath))
+        let legacyWaveform = try! AudioWaveform(contentsOfFile: filePath)
+        assertEqualLevels(waveform.normalizedLevelsToDisplay(sampleCount: 40)!,
+                          legacyWaveform.normalizedLevelsToDisplay(sampleCount: 40)!,
+                          accuracy: 0.01)
+    }
+
+    func testNormalizedLevels() {
+        let waveform = AudioWaveform(decibelSamples: [-50, -25, 0, -50, -25, 0])
+
+        assertEqualLevels([0, 0.5, 1, 0, 0.5, 1], waveform.normalizedLevelsToDisplay(sampleCount: 6)!, accuracy: 0.001)
+        assertEqualLevels([0, 0.5, 1, 0, 0.5, 1], waveform.normalizedLevelsToDisplay(sampleCount: 10)!, accuracy: 0.001)
+        assertEqualLevels([0.5, 0.5], waveform.normalizedLevelsToDisplay(sampleCount: 2)!, accuracy: 0.001)
+        XCTAssertEqual([], waveform.normalizedLevelsToDisplay(sampleCount: 0)!)
+
+        // Repeated requests are served from the cache.
+        XCTAssertEqual(waveform.normalizedLevelsToDisplay(sampleCount: 4)!,
+                       waveform.normalizedLevelsToDisplay(sampleCount: 4)!)
+    }
+
+    func testConvertToDecibels() {
+        let fullScale = Float(Int16.max) * Float(Int16.max)
+        let decibels = AudioWaveform.convertToDecibels(meanSquares: [fullScale, fullScale / 100, 0])
+        assertEqualLevels([0, -20, -50], decibels, accuracy: 0.001)
+    }
+
+    // Samples a voice note just under the ten minute limit, and then draws
+    // it repeatedly, as the conversation view does while scrolling.
+    func testSamplingPerformance() {
+        let url = buildVoiceNote(duration: 10 * 60 - 1)
+        defer { _ = OWSFileSystem.deleteFileIfExists(url.path) }
+
+        let startDate = Date()
+        let expectation = self.expectation(description: "sampling")
+        let observer = SamplingObserver {
+            expectation.fulfill()
+        }
+        let waveform = AudioWaveform(asset: AVURLAsset(url: url))!
+        waveform.addSamplingObserver(observer)
+        waitForExpectations(timeout: 60)
+        let samplingDuration = Date().timeIntervalSince(startDate)
+
+        let levels = waveform.normalizedLevelsToDisplay(sampleCount: 100)!
+        XCTAssertEqual(100, levels.count)
+        // The pauses are silent, and the tone isn't.
+        XCTAssertEqual(0, levels.min()!, accuracy: 0.01)
+        XCTAssertGreaterThan(levels.max()!, 0.5)
+
+        let drawCount = 10000
+        let drawStartDate = Date()
+        for index in 0..<drawCount {
+            _ = waveform.normalizedLevelsToDisplay(sampleCount: 40 + index % 2)
+        }
+        let drawDuration = Date().timeIntervalSince(drawStartDate)
+
+        Logger.info(String(format: "[Bench] Sampled 10 minute voice note in %0.3fs; levels to display: %0.2fus",
+                           samplingDuration,
+                           drawDuration * 1000 * 1000 / Double(drawCount)))
+    }
+}
+
+// MARK: -
+
+private class SamplingObserver: NSObject, AudioWaveformSamplingObserver {
+    private let block: () -> Void
+
+    init(block: @escaping () -> Void) {
+        self.block = block
+        super.init()
+    }
+
+    func audioWaveformDidFinishSampling(_ audioWaveform: AudioWaveform) {
+        block()
+    }
+}
+
+// MARK: -
+
+private func assertEqualLevels(_ expression1: [Float],
+                               _ expression2: [Float],
+                               accuracy: Float,
+                               file: StaticString = #file,
+                               line: UInt = #line) {
+    XCTAssertEqual(expression1.count, expression2.count, file: file, line: line)
+    for (value1, value2) in zip(expression1, expression2) {
+        XCTAssertEqual(value1, value2, accuracy: accuracy, file: file, line: line)
+    }
+}
@@ -0,0 +1,272 @@
+//
+//  Copyright (c) 2020 Open Whisper Systems. All rights reserved.
+//
+
+import XCTest
+import ImageIO
+import MobileCoreServices
+@testable import SignalServiceKit
+
+class ImageProbeTest: SSKBaseTestSwift {
+
+    private var tempFilePaths = [String]()
+
+    override func tearDown() {
+        for filePath in tempFilePaths {
+            _ = OWSFileSystem.deleteFileIfExists(filePath)
+        }
+        tempFilePaths = []
+
+        super.tearDown()
+    }
+
+    private func write(data: Data, fileExtension: String) -> String {
+        let filePath = OWSFileSystem.temporaryFilePath(withFileExtension: fileExtension)
+        try! data.write(to: URL(fileURLWithPath: filePath))
+        tempFilePaths.append(filePath)
+        return filePath
+    }
+
+    private func buildImage(size: CGSize, opaque: Bool = true) -> UIImage {
+        let format = UIGraphicsImageRendererFormat()
+        format.scale = 1
+        format.opaque = opaque
+        return UIGraphicsImageRenderer(size: size, format: format).image { context in
+            UIColor.red.setFill()
+            context.fill(CGRect(x: 0, y: 0, width: size.width / 2, height: size.height / 2))
+            UIColor.blue.setFill()
+            context.fill(CGRect(x: size.width / 2, y: size.height / 2, width: size.width / 2, height: size.height / 2))
+        }
+    }
+
+    private func encode(images: [UIImage],
+                        type: CFString,
+                        properties: [CFString: Any] = [:],
+                        frameProperties: [CFString: Any] = [:]) -> Data {
+        let data = NSMutableData()
+        let destination = CGImageDestinationCreateWithData(data, type, images.count, nil)!
+        CGImageDestinationSetProperties(destination, properties as CFDictionary)
+        for image in images {
+            CGImageDestinationAddImage(destination, image.cgImage!, frameProperties as CFDictionary)
+        }
+        XCTAssertTrue(CGImageDestinationFinalize(destination))
+        return data as Data
+    }
+
+    private func buildWebpChunk(_ fourCC: String, payload: [UInt8]) -> [UInt8] {
+        var chunk = Array(fourCC.utf8)
+        let length = UInt32(payload.count)
+        chunk += [UInt8(length & 0xff), UInt8((length >> 8) & 0xff), UInt8((length >> 16) & 0xff), UInt8(length >> 24)]
+        chunk += payload
+        if payload.count % 2 == 1 {
+            chunk.append(0)
+        }
+        return chunk
+    }
+
+    private func buildWebp(chunks: [[UInt8]]) -> Data {
+        let body = Array("WEBP".utf8) + chunks.joined()
+        return Data(buildWebpChunk("RIFF", payload: body))
+    }
+
+    // The properties ImageIO reports for the same image.
+    private func imageSourceProperties(data: Data) -> (size: CGSize, hasAlpha: Bool, frameCount: Int) {
+        let source = CGImageSourceCreateWithData(data as CFData, nil)!
+        let properties = CGImageSourceCopyPropertiesAtIndex(source, 0, nil) as! [CFString: Any]
+        var size = CGSize(width: properties[kCGImagePropertyPixelWidth] as! Int,
+                          height: properties[kCGImagePropertyPixelHeight] as! Int)
+        if let orientation = properties[kCGImagePropertyOrientation] as? UInt32,
+            [.left, .leftMirrored, .right, .rightMirrored].contains(CGImagePropertyOrientation(rawValue: orientation)!) {
+            size = CGSize(width: size.height, height: size.width)
+        }
+        return (size: size,
+                hasAlpha: properties[kCGImagePropertyHasAlpha] as? Bool ?? false,
+                frameCount: CGImageSourceGetCount(source))
+    }
+
+    // MARK: -
+
+    func testJpeg() {
+        let data = encode(images: [buildImage(size: CGSize(width: 300, height: 200))],
+                          type: kUTTypeJPEG,
+                          frameProperties: [kCGImagePropertyOrientation: CGImagePropertyOrientation.right.rawValue])
+
+        let header = OWSImageProbe.probeImageData(data)!
+        XCTAssertEqual(header.imageFormat, .jpeg)
+        XCTAssertEqual(header.encodedPixelSize, CGSize(width: 300, height: 200))
+        XCTAssertEqual(header.orientation, .right)
+        XCTAssertEqual(header.pixelSize, CGSize(width: 200, height: 300))
+        XCTAssertEqual(header.depthBits, 8)
+        XCTAssertTrue(header.isRGBOrGray)
+        XCTAssertFalse(header.hasAlpha)
+        XCTAssertFalse(header.isAnimated)
+        XCTAssertEqual(header.frameCount, 1)
+        XCTAssertEqual(header.pixelSize, imageSourceProperties(data: data).size)
+
+        let imageData = (data as NSData).imageData(withPath: nil, mimeType: OWSMimeTypeImageJpeg)
+        XCTAssertTrue(imageData.isValid)
+        XCTAssertEqual(imageData.pixelSize, CGSize(width: 200, height: 300))
+    }
+
+    func testPng() {
+        let data = buildImage(size: CGSize(width: 120, height: 80), opaque: false).pngData()!
+
+        let header = OWSImageProbe.probeImageData(data)!
+        XCTAssertEqual(header.imageFormat, .png)
+        XCTAssertEqual(header.pixelSize, CGSize(width: 120, height: 80))
+        XCTAssertTrue(header.hasAlpha)
+        XCTAssertFalse(header.isAnimated)
+        XCTAssertEqual(header.frameCount, 1)
+
+        let imageSourceProperties = self.imageSourceProperties(data: data)
+        XCTAssertEqual(header.pixelSize, imageSourceProperties.size)
+        XCTAssertEqual(header.hasAlpha, imageSourceProperties.hasAlpha)
+
+        let filePath = write(data: data, fileExtension: "png")
+        XCTAssertTrue(NSData.hasAlpha(forValidImageFilePath: filePath))
+        let imageData = NSData.imageData(withPath: filePath, mimeType: OWSMimeTypeImagePng)
+        XCTAssertTrue(imageData.isValid)
+        XCTAssertTrue(imageData.hasAlpha)
+    }
+
+    func testAnimatedGif() {
+        let images = (0..<3).map { index in
+            buildImage(size: CGSize(width: 64 + index, height: 48))
+        }
+        let data = encode(images: images,
+                          type: kUTTypeGIF,
+                          properties: [kCGImagePropertyGIFDictionary: [kCGImagePropertyGIFLoopCount: 0]],
+                          frameProperties: [kCGImagePropertyGIFDictionary: [kCGImagePropertyGIFDelayTime: 0.1]])
+        let filePath = write(data: data, fileExtension: "gif")
+
+        let header = OWSImageProbe.probeImage(atPath: filePath)!
+        XCTAssertEqual(header.imageFormat, .gif)
+        XCTAssertTrue(header.isAnimated)
+        XCTAssertEqual(header.frameCount, 3)
+        XCTAssertEqual(Int(header.frameCount), imageSourceProperties(data: data).frameCount)
+        XCTAssertEqual(header.fileSize, UInt64(data.count))
+
+        let imageData = NSData.imageData(withPath: filePath, mimeType: OWSMimeTypeImageGif)
+        XCTAssertTrue(imageData.isValid)
+        XCTAssertTrue(imageData.isAnimated)
+        XCTAssertEqual(imageData.frameCount, 3)
+    }
+
+    // The probe stops walking a long GIF's frames part way through its
+    // image data, and leaves them uncounted.
+    func testLongGif() {
+        var bytes = Array("GIF89a".utf8) + [64, 0, 48, 0, 0, 0, 0]
+        for _ in 0..<300 {
+            // Image descriptor, LZW minimum code size, one full sub-block and a terminator.
+            bytes += [0x2c, 0, 0, 0, 0, 64, 0, 48, 0, 0]
+            bytes += [2, 255] + [UInt8](repeating: 0, count: 255) + [0]
+        }
+        bytes.append(0x3b)
+        let data = Data(bytes)
+
+        let header = OWSImageProbe.probeImageData(data)!
+        XCTAssertEqual(header.imageFormat, .gif)
+        XCTAssertEqual(header.pixelSize, CGSize(width: 64, height: 48))
+        XCTAssertTrue(header.isAnimated)
+        XCTAssertEqual(header.frameCount, 0)
+
+        let filePath = write(data: data, fileExtension: "gif")
+        XCTAssertEqual(OWSImageProbe.probeImage(atPath: filePath)!.frameCount, 0)
+    }
+
+    func testWebp() {
+        // Lossless: 14-bit width and height less one, and an alpha bit.
+        let losslessBits: UInt32 = (99) | (49 << 14) | (1 << 28)
+        let lossless = buildWebp(chunks: [
+            buildWebpChunk("VP8L", payload: [0x2f,
+                                             UInt8(losslessBits & 0xff),
+                                             UInt8((losslessBits >> 8) & 0xff),
+                                             UInt8((losslessBits >> 16) & 0xff),
+                                             UInt8(losslessBits >> 24),
+                                             0, 0, 0, 0, 0])
+        ])
+        let losslessHeader = OWSImageProbe.probeImageData(lossless)!
+        XCTAssertEqual(losslessHeader.imageFormat, .webp)
+        XCTAssertEqual(losslessHeader.pixelSize, CGSize(width: 100, height: 50))
+        XCTAssertTrue(losslessHeader.hasAlpha)
+        XCTAssertFalse(losslessHeader.isAnimated)
+
+        // Extended: animation and alpha flags, then 24-bit canvas width and
+        // height less one.
+        let frame = buildWebpChunk("ANMF", payload: [UInt8](repeating: 0, count: 2001))
+        let animated = buildWebp(chunks: [
+            buildWebpChunk("VP8X", payload: [0x12, 0, 0, 0, 0x3f, 0x01, 0, 0xef, 0, 0]),
+            buildWebpChunk("ANIM", payload: [0, 0, 0, 0, 0, 0]),
+            frame,
+            frame,
+            frame,
+            frame
+        ])
+        let animatedHeader = OWSImageProbe.probeImageData(animated)!
+        XCTAssertEqual(animatedHeader.pixelSize, CGSize(width: 320, height: 240))
+        XCTAssertTrue(animatedHeader.hasAlpha)
+        XCTAssertTrue(animatedHeader.isAnimated)
+        XCTAssertEqual(animatedHeader.frameCount, 4)
+    }
+
+    func testInvalidData() {
+        XCTAssertNil(OWSImageProbe.probeImageData(Data()))
+        XCTAssertNil(OWSImageProbe.probeImageData(Data("not an image".utf8)))
+
+        // A GIF without a size is parsed, but isn't valid.
+        var gifData = Data("GIF89a".utf8)
+        gifData += [0, 0, 0, 0, 0, 0, 0, 0x3b]
+        XCTAssertNotNil(OWSImageProbe.probeImageData(gifData))
+        XCTAssertFalse((gifData as NSData).ows_isValidImage())
+
+        // So is a truncated one.
+        let jpegData = encode(images: [buildImage(size: CGSize(width: 30, height: 20))], type: kUTTypeJPEG)
+        XCTAssertNil(OWSImageProbe.probeImageData(jpegData.prefix(4)))
+    }
+
+    // Probes a corpus of large photos and GIFs, and compares the probe
+    // against reading the properties with ImageIO.
+    func testProbePerformance() {
+        let jpegData = encode(images: [buildImage(size: CGSize(width: 4032, height: 3024))],
+                              type: kUTTypeJPEG,
+                              frameProperties: [kCGImagePropertyOrientation: CGImagePropertyOrientation.right.rawValue])
+        let pngData = buildImage(size: CGSize(width: 2048, height: 2048), opaque: false).pngData()!
+        let gifData = encode(images: (0..<20).map { _ in buildImage(size: CGSize(width: 480, height: 480)) },
+                             type: kUTTypeGIF,
+                             properties: [kCGImagePropertyGIFDictionary: [kCGImagePropertyGIFLoopCount: 0]])
+        let filePaths = [
+            write(data: jpegData, fileExtension: "jpg"),
+            write(data: pngData, fileExtension: "png"),
+            write(data: gifData, fileExtension: "gif")
+        ]
+
+        let iterationCount = 500
+        var bytesRead: UInt = 0
+        var fileSize: UInt64 = 0
+        let probeStartDate = Date()
+        for _ in 0..<iterationCount {
+            for filePath in filePaths {
+                let header = OWSImageProbe.probeImage(atPath: filePath)!
+                bytesRead += header.bytesRead
+                fileSize += header.fileSize
+            }
+        }
+        let probeDuration = Date().timeIntervalSince(probeStartDate)
+
+        let imageSourceStartDate = Date()
+        for _ in 0..<iterationCount {
+            for filePath in filePaths {
+                let source = CGImageSourceCreateWithURL(URL(fileURLWithPath: filePath) as CFURL, nil)!
+                XCTAssertNotNil(CGImageSourceCopyPropertiesAtIndex(source, 0, nil))
+                _ = CGImageSourceGetCount(source)
+            }
+        }
+        let imageSourceDuration = Date().timeIntervalSince(imageSourceStartDate)
+
+        let probeCount = Double(iterationCount * filePaths.count)
+        Logger.info(String(format: "[Bench] Image probe: %0.0f probes/s, %0.1f%% of file bytes read; ImageIO: %0.0f probes/s",
+                           probeCount / probeDuration,
+                           Double(bytesRead) * 100 / Double(fileSize),
+                           probeCount / imageSourceDuration))
+    }
+}
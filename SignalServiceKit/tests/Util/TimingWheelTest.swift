@@ -0,0 +1,102 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+import XCTest
+@testable import SignalServiceKit
+
+class TimingWheelTest: SSKBaseTestSwift {
+
+    private let queue = DispatchQueue(label: "org.signal.timing-wheel.test")
+
+    func testTimeoutPrecision() {
+        let tickInterval: TimeInterval = 0.05
+        let timeout: TimeInterval = 0.3
+        let keyCount = 200
+
+        var deadlines = [Int: TimeInterval]()
+        var lateness = [TimeInterval]()
+        let expectation = self.expectation(description: "All keys timed out")
+        let wheel = TimingWheel<Int>(queue: queue, tickInterval: tickInterval, slotCount: 4) { key in
+            guard let deadline = deadlines[key] else {
+                XCTFail("Missing deadline.")
+                return
+            }
+            lateness.append(CACurrentMediaTime() - deadline)
+            if lateness.count == keyCount {
+                expectation.fulfill()
+            }
+        }
+
+        // Stagger scheduling across ticks so that keys land mid-tick.
+        for key in 0..<keyCount {
+            queue.asyncAfter(deadline: .now() + Double(key % 10) * 0.013) {
+                deadlines[key] = CACurrentMediaTime() + timeout
+                wheel.schedule(key: key, timeout: timeout)
+            }
+        }
+        waitForExpectations(timeout: 5.0, handler: nil)
+
+        queue.sync {
+            // Allow for timer leeway and scheduling jitter.
+            let slack: TimeInterval = 0.02
+            XCTAssertGreaterThanOrEqual(lateness.min() ?? -1, -slack)
+            XCTAssertLessThanOrEqual(lateness.max() ?? .infinity, tickInterval + slack)
+            XCTAssertEqual(0, wheel.count)
+        }
+    }
+
+    func testCancel() {
+        var timedOutKeys = [Int]()
+        let wheel = TimingWheel<Int>(queue: queue, tickInterval: 0.01, slotCount: 8) { key in
+            timedOutKeys.append(key)
+        }
+        queue.sync {
+            wheel.schedule(key: 1, timeout: 0.05)
+            wheel.schedule(key: 2, timeout: 0.05)
+            wheel.cancel(key: 1)
+        }
+
+        let expectation = self.expectation(description: "Timeouts elapsed")
+        queue.asyncAfter(deadline: .now() + 0.2) {
+            expectation.fulfill()
+        }
+        waitForExpectations(timeout: 1.0, handler: nil)
+
+        queue.sync {
+            XCTAssertEqual([2], timedOutKeys)
+        }
+    }
+
+    // Measures the per-request cost of registering and completing a
+    // socket request, which the registry pays on every websocket send.
+    func testRegistryOverhead() {
+        let requestCount = 10000
+        let registry = OWSSocketRequestRegistry()
+
+        measure {
+            for requestId in 0..<UInt64(requestCount) {
+                registry.add(request: FakeSocketRequest(requestId: requestId), timeout: 10)
+            }
+            for requestId in 0..<UInt64(requestCount) {
+                XCTAssertNotNil(registry.removeRequest(requestId: requestId))
+            }
+        }
+        XCTAssertEqual(0, registry.removeAllRequests().count)
+    }
+}
+
+// MARK: -
+
+private class FakeSocketRequest: NSObject, OWSSocketRequest {
+    let requestId: UInt64
+
+    init(requestId: UInt64) {
+        self.requestId = requestId
+    }
+
+    func timeoutIfNecessary() {
+        XCTFail("Unexpected timeout.")
+    }
+}
@@ -0,0 +1,89 @@
+//
+//  Copyright (c) 2019 Open Whisper Systems. All rights reserved.
+//
+
+import Foundation
+import XCTest
+@testable import SignalServiceKit
+
+class WarmCacheSchedulerTest: SSKBaseTestSwift {
+
+    // MARK: - Dependencies
+
+    var storageCoordinator: StorageCoordinator {
+        return SSKEnvironment.shared.storageCoordinator
+    }
+
+    // MARK: -
+
+    func testCriticalWarmupsCompleteBeforeReturning() {
+        let trace = LaunchTrace()
+        let scheduler = WarmCacheScheduler(trace: trace)
+
+        let lock = NSLock()
+        var warmedNames = [String]()
+        for name in ["a", "b", "c"] {
+            scheduler.addWarmup(name: name, priority: .critical) {
+                Thread.sleep(forTimeInterval: 0.01)
+                lock.lock()
+                warmedNames.append(name)
+                lock.unlock()
+            }
+        }
+        scheduler.addWarmup(name: "d", priority: .deferred) {
+            XCTFail("Unexpected warmup.")
+        }
+
+        scheduler.warmCriticalCaches()
+
+        XCTAssertEqual(["a", "b", "c"], warmedNames.sorted())
+        XCTAssertEqual(Set(["Warm cache: a", "Warm cache: b", "Warm cache: c", "Warm critical caches"]),
+                       Set(trace.phases.map { $0.name }))
+        XCTAssertGreaterThan(trace.duration(phase: "Warm critical caches"), 0)
+    }
+
+    func testDeferredWarmupsRunOnce() {
+        let trace = LaunchTrace()
+        let scheduler = WarmCacheScheduler(trace: trace)
+
+        let expectation = self.expectation(description: "Deferred warmup")
+        scheduler.addWarmup(name: "deferred", priority: .deferred) {
+            XCTAssertFalse(Thread.isMainThread)
+            expectation.fulfill()
+        }
+
+        scheduler.warmDeferredCaches()
+        scheduler.warmDeferredCaches()
+        waitForExpectations(timeout: 1.0, handler: nil)
+    }
+
+    // Warming the critical caches blocks launch, so it must stay within
+    // budget for a database with a realistic amount of data in it.
+    func testLaunchBudget() {
+        let launchBudget: TimeInterval = 1.0
+
+        storageCoordinator.useGRDBForTests()
+
+        let factory = ContactThreadFactory()
+        factory.messageCount = 10
+        write { transaction in
+            _ = factory.create(count: 200, transaction: transaction)
+
+            let blockedPhoneNumbers = (0..<100).map { "+1321555\(String(format: "%04d", $0))" }
+            OWSBlockingManager.keyValueStore().setObject(blockedPhoneNumbers,
+                                                         key: "kOWSBlockingManager_BlockedPhoneNumbersKey",
+                                                         transaction: transaction)
+            KeyBackupService.keyValueStore.setData(Randomness.generateRandomBytes(32),
+                                                   key: "masterKey",
+                                                   transaction: transaction)
+        }
+
+        let trace = LaunchTrace.shared
+        let durationBefore = trace.duration(phase: "Warm critical caches")
+        SSKEnvironment.shared.warmCaches()
+        let duration = trace.duration(phase: "Warm critical caches") - durationBefore
+
+        XCTAssertGreaterThan(duration, 0)
+        XCTAssertLessThan(duration, launchBudget)
+    }
+}
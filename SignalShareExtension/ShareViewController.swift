@@ -845,13 +845,13 @@ public class ShareViewController: UIViewController, ShareViewDelegate, SAEFailed
             guard !SignalAttachment.isInvalidVideo(dataSource: dataSource, dataUTI: utiType) else {
                 // This can happen, e.g. when sharing a quicktime-video from iCloud drive.
                 
-                let (promise, exportSession) = SignalAttachment.compressVideoAsMp4(dataSource: dataSource, dataUTI: utiType)
+                let (promise, transcoder) = SignalAttachment.compressVideoAsMp4(dataSource: dataSource, dataUTI: utiType)
                 
                 // TODO: How can we move waiting for this export to the end of the share flow rather than having to do it up front?
                 // Ideally we'd be able to start it here, and not block the UI on conversion unless there's still work to be done
                 // when the user hits "send".
-                if let exportSession = exportSession {
-                    let progressPoller = ProgressPoller(timeInterval: 0.1, ratioCompleteBlock: { return exportSession.progress })
+                if let transcoder = transcoder {
+                    let progressPoller = ProgressPoller(timeInterval: 0.1, ratioCompleteBlock: { return Float(transcoder.progress.fractionCompleted) })
                     AssertIsOnMainThread()
                     self.progressPoller = progressPoller
                     progressPoller.startPolling()